@@ -640,13 +640,33 @@ static Dart_Isolate CreateIsolateAndSetupHelper(const char* script_uri,
   result = Dart_SetEnvironmentCallback(EnvironmentCallback);
   CHECK_RESULT(result);
 
-  // Load the script.
-  result = DartUtils::LoadScript(script_uri, builtin_lib);
-  CHECK_RESULT(result);
-
-  // Run event-loop and wait for script loading to complete.
-  result = Dart_RunLoop();
+  // Isolates spawned from a function of this program load it from the
+  // snapshot their isolate group keeps, once the group has one.
+  result = Dart_LoadScriptFromIsolateGroup();
   CHECK_RESULT(result);
+  if (Dart_IsNull(result)) {
+    // Load the script.
+    result = DartUtils::LoadScript(script_uri, builtin_lib);
+    CHECK_RESULT(result);
+
+    // Run event-loop and wait for script loading to complete.
+    result = Dart_RunLoop();
+    CHECK_RESULT(result);
+  } else {
+    // Loading from the snapshot does not need the load port, but the script
+    // may still load deferred libraries.
+    Dart_Port load_port = Dart_ServiceWaitForLoadPort();
+    if (load_port == ILLEGAL_PORT) {
+      *error = strdup("Service did not return load port.");
+      *exit_code = kErrorExitCode;
+      Dart_ExitScope();
+      Dart_ShutdownIsolate();
+      return NULL;
+    }
+    Builtin::SetLoadPort(load_port);
+    result = Dart_FinalizeLoading(false);
+    CHECK_RESULT(result);
+  }
 
   Platform::SetPackageRoot(package_root);
 
@@ -980,6 +1000,13 @@ void main(int argc, char** argv) {
     exit(kErrorExitCode);
   }
 
+  // Isolates spawned by the script are cloned from the heap of the first
+  // isolate created from the snapshot, as it is right after reading it. Its
+  // libraries are not initialized and no script is loaded at that point.
+  if (isolate_snapshot_buffer != NULL) {
+    Dart_RegisterIsolateTemplate(isolate_snapshot_buffer);
+  }
+
   Dart_RegisterIsolateServiceRequestCallback(
         "io", &ServiceRequestHandler, NULL);
 
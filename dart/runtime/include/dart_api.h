@@ -670,6 +670,19 @@ typedef void (*Dart_GcPrologueWeakHandleCallback)(void* isolate_callback_data,
 DART_EXPORT Dart_Handle Dart_VisitPrologueWeakHandles(
     Dart_GcPrologueWeakHandleCallback callback);
 
+/**
+ * Notifies the VM that the current isolate is about to be idle, so that it
+ * can do garbage collection work which would otherwise interrupt the
+ * isolate later, e.g., while handling a request.
+ *
+ * Only work that is expected to be done before the deadline is started, but
+ * the call may return after the deadline.
+ *
+ * \param deadline The time in microseconds since the Unix epoch (as returned
+ *   by gettimeofday) at which the embedder expects the idle period to end.
+ */
+DART_EXPORT void Dart_NotifyIdle(int64_t deadline);
+
 /*
  * ==========================
  * Initialization and Globals
@@ -714,8 +727,8 @@ DART_EXPORT const char* Dart_VersionString();
  *   This uri will be NULL if the isolate is being created using the
  *   spawnFunction isolate API.
  *   The callback is responsible for loading the script used in the
- *   parent isolate by a call to Dart_LoadScript or
- *   Dart_LoadScriptFromSnapshot.
+ *   parent isolate by a call to Dart_LoadScript,
+ *   Dart_LoadScriptFromSnapshot or Dart_LoadScriptFromIsolateGroup.
  * \param main The name of the main entry point this isolate will
  *   eventually run.  This is provided for advisory purposes only to
  *   improve debugging messages.  The main function is not invoked by
@@ -910,6 +923,25 @@ DART_EXPORT Dart_Isolate Dart_CreateIsolate(const char* script_uri,
 /* TODO(turnidge): Document behavior when there is already a current
  * isolate. */
 
+/**
+ * Registers a snapshot whose first isolate is kept as a template.
+ *
+ * The heap of the first isolate created from the snapshot afterwards is
+ * saved as it is right after reading the snapshot, before the isolate runs
+ * or loads anything. Later isolates created from the same snapshot are
+ * cloned from the template instead of reading the snapshot, which makes
+ * their creation much faster.
+ *
+ * The snapshot is identified by its buffer, which must not change or be
+ * freed until Dart_Cleanup is called.
+ *
+ * Requires the VM to be initialized.
+ *
+ * \param snapshot A buffer containing a snapshot of an isolate, as passed
+ *   to Dart_CreateIsolate.
+ */
+DART_EXPORT void Dart_RegisterIsolateTemplate(const uint8_t* snapshot);
+
 /**
  * Shuts down the current isolate. After this call, the current isolate
  * is NULL. Invokes the shutdown callback and any callbacks of remaining
@@ -2594,6 +2626,31 @@ DART_EXPORT Dart_Handle Dart_LoadScript(Dart_Handle url,
 DART_EXPORT Dart_Handle Dart_LoadScriptFromSnapshot(const uint8_t* buffer,
                                                     intptr_t buffer_len);
 
+/**
+ * Loads the root script for the current isolate from a snapshot shared by
+ * the isolates spawned from functions of the same program.
+ *
+ * An isolate spawned using the spawnFunction isolate API runs the program of
+ * the isolate which spawned it and joins its isolate group. The group keeps a
+ * snapshot of the program, taken from the first member which, after calling
+ * this function, was loaded by other means and then made runnable by
+ * Dart_IsolateMakeRunnable.
+ *
+ * Loading from the snapshot replaces loading the script and its imports and
+ * sources. The embedder still finalizes loading with Dart_FinalizeLoading.
+ * As the snapshot does not carry native resolvers, none is taken of a program
+ * with a library which has one, e.g. because it imports a native extension.
+ *
+ * Groups only keep a snapshot when the VM runs with
+ * --isolate_group_snapshots, otherwise Dart_Null() is always returned.
+ *
+ * \return If the group has a snapshot and no error occurs, the Library object
+ *   corresponding to the root script is returned. If the group has no
+ *   snapshot yet, Dart_Null() is returned and the script is to be loaded by
+ *   other means. Otherwise an error handle is returned.
+ */
+DART_EXPORT Dart_Handle Dart_LoadScriptFromIsolateGroup();
+
 /**
  * Gets the library for the root script for the current isolate.
  *
@@ -97,6 +97,123 @@ typedef struct _Dart_CObject {
  */
 DART_EXPORT bool Dart_PostCObject(Dart_Port port_id, Dart_CObject* message);
 
+/**
+ * A message builder writes a message value by value, without a
+ * Dart_CObject graph. A message is a single value, which may be an
+ * array begun with Dart_MessageBuilderBeginArray and given all its
+ * elements before it is ended.
+ *
+ * Strings are UTF-8. Typed data has a length in bytes, and is of type
+ * Dart_TypedData_kInt8, Dart_TypedData_kUint8 or
+ * Dart_TypedData_kUint32.
+ *
+ * A builder keeps its buffers from one message to the next, and is
+ * used by one thread at a time.
+ */
+typedef struct _Dart_MessageBuilder* Dart_MessageBuilder;
+
+DART_EXPORT Dart_MessageBuilder Dart_NewMessageBuilder();
+DART_EXPORT void Dart_DeleteMessageBuilder(Dart_MessageBuilder builder);
+
+/**
+ * Add the next value of the message. Returns false if the value is
+ * invalid or does not fit the message, in which case the message can
+ * no longer be posted.
+ */
+DART_EXPORT bool Dart_MessageBuilderAddNull(Dart_MessageBuilder builder);
+DART_EXPORT bool Dart_MessageBuilderAddBool(Dart_MessageBuilder builder,
+                                            bool value);
+DART_EXPORT bool Dart_MessageBuilderAddInt64(Dart_MessageBuilder builder,
+                                             int64_t value);
+DART_EXPORT bool Dart_MessageBuilderAddDouble(Dart_MessageBuilder builder,
+                                              double value);
+DART_EXPORT bool Dart_MessageBuilderAddString(Dart_MessageBuilder builder,
+                                              const char* value);
+DART_EXPORT bool Dart_MessageBuilderAddTypedData(Dart_MessageBuilder builder,
+                                                 Dart_TypedData_Type type,
+                                                 const uint8_t* values,
+                                                 intptr_t length);
+DART_EXPORT bool Dart_MessageBuilderBeginArray(Dart_MessageBuilder builder,
+                                               intptr_t length);
+DART_EXPORT bool Dart_MessageBuilderEndArray(Dart_MessageBuilder builder);
+
+/**
+ * Posts the message built on some port, and resets the builder for the
+ * next message, even if the message could not be posted.
+ *
+ * \param port_id The destination port.
+ * \param builder The builder of a complete message.
+ *
+ * \return True if the message was posted.
+ */
+DART_EXPORT bool Dart_PostMessageBuilder(Dart_Port port_id,
+                                         Dart_MessageBuilder builder);
+
+/**
+ * A message reader reads a message received on a native port value by
+ * value, without decoding it into a Dart_CObject graph.
+ *
+ * The values are read in the order Dart_MessageBuilder adds them.
+ * Strings are read as NUL terminated UTF-8 with their length in bytes,
+ * and typed data with its length in bytes. Either is only valid until
+ * the next value is read.
+ *
+ * A message which cannot be read value by value, such as one with
+ * instances of Dart classes, reads as a value of type
+ * Dart_CObject_kUnsupported, and can still be decoded with
+ * Dart_MessageReaderReadCObject.
+ */
+typedef struct _Dart_MessageReader* Dart_MessageReader;
+
+/**
+ * Returns the type of the next value, or Dart_CObject_kUnsupported if
+ * there is none. Integers are of type Dart_CObject_kInt32 or
+ * Dart_CObject_kInt64 depending on their value.
+ */
+DART_EXPORT Dart_CObject_Type Dart_MessageReaderNextType(
+    Dart_MessageReader reader);
+
+/**
+ * Read the next value. Returns false if it is of another type.
+ */
+DART_EXPORT bool Dart_MessageReaderReadNull(Dart_MessageReader reader);
+DART_EXPORT bool Dart_MessageReaderReadBool(Dart_MessageReader reader,
+                                            bool* value);
+DART_EXPORT bool Dart_MessageReaderReadInt64(Dart_MessageReader reader,
+                                             int64_t* value);
+DART_EXPORT bool Dart_MessageReaderReadDouble(Dart_MessageReader reader,
+                                              double* value);
+DART_EXPORT bool Dart_MessageReaderReadString(Dart_MessageReader reader,
+                                              const char** value,
+                                              intptr_t* length);
+DART_EXPORT bool Dart_MessageReaderReadTypedData(Dart_MessageReader reader,
+                                                 Dart_TypedData_Type* type,
+                                                 const uint8_t** values,
+                                                 intptr_t* length);
+DART_EXPORT bool Dart_MessageReaderReadSendPort(Dart_MessageReader reader,
+                                                Dart_Port* port_id);
+DART_EXPORT bool Dart_MessageReaderBeginArray(Dart_MessageReader reader,
+                                              intptr_t* length);
+
+/**
+ * Ends reading an array, all of whose elements must have been read or
+ * skipped.
+ */
+DART_EXPORT bool Dart_MessageReaderEndArray(Dart_MessageReader reader);
+
+/**
+ * Skips the next value, whatever its type.
+ */
+DART_EXPORT bool Dart_MessageReaderSkip(Dart_MessageReader reader);
+
+/**
+ * Decodes the whole message into a Dart_CObject graph, as for a
+ * Dart_NativeMessageHandler. The graph is reclaimed when the handler
+ * returns.
+ */
+DART_EXPORT Dart_CObject* Dart_MessageReaderReadCObject(
+    Dart_MessageReader reader);
+
 /**
  * A native message handler.
  *
@@ -130,6 +247,27 @@ DART_EXPORT Dart_Port Dart_NewNativePort(const char* name,
                                          bool handle_concurrently);
 /* TODO(turnidge): Currently handle_concurrently is ignored. */
 
+/**
+ * A native message handler which reads the message received with a
+ * Dart_MessageReader.
+ *
+ * The reader is only valid until the handler returns.
+ */
+typedef void (*Dart_NativeMessageStreamHandler)(Dart_Port dest_port_id,
+                                                Dart_MessageReader reader);
+
+/**
+ * Creates a new native port like Dart_NewNativePort, whose messages are
+ * read by the handler rather than decoded first.
+ *
+ * \return If successful, returns the port id for the native port.  In
+ *   case of error, returns ILLEGAL_PORT.
+ */
+DART_EXPORT Dart_Port Dart_NewNativeStreamPort(
+    const char* name,
+    Dart_NativeMessageStreamHandler handler,
+    bool handle_concurrently);
+
 /**
  * Closes the native port with the given id.
  *
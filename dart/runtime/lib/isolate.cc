@@ -9,6 +9,7 @@
 #include "vm/dart_api_impl.h"
 #include "vm/dart_entry.h"
 #include "vm/exceptions.h"
+#include "vm/isolate_group.h"
 #include "vm/lockers.h"
 #include "vm/longjump.h"
 #include "vm/message_handler.h"
@@ -172,12 +173,19 @@ static bool CreateIsolate(Isolate* parent_isolate,
   }
 
   void* init_data = parent_isolate->init_callback_data();
-  Isolate* child_isolate = reinterpret_cast<Isolate*>(
-      (callback)(state->script_url(),
-                 state->function_name(),
-                 state->package_root(),
-                 init_data,
-                 error));
+  Isolate* child_isolate;
+  {
+    // Isolates spawned using the spawnFunction semantics run the program of
+    // the parent isolate, so they join its group.
+    IsolateGroupScope group_scope(
+        state->is_spawn_uri() ? NULL : parent_isolate->group());
+    child_isolate = reinterpret_cast<Isolate*>(
+        (callback)(state->script_url(),
+                   state->function_name(),
+                   state->package_root(),
+                   init_data,
+                   error));
+  }
   if (child_isolate == NULL) {
     return false;
   }
@@ -11,22 +11,40 @@ import 'dominator_tree.dart';
 // Port of dart::ReadStream from vm/datastream.h.
 class ReadStream {
   int _cur = 0;
-  final ByteData _data;
-  
-  ReadStream(this._data);
-  
-  int get pendingBytes => _data.lengthInBytes - _cur;
-  
+  int _chunkIndex = 0;
+  final List<ByteData> _chunks;
+
+  ReadStream(ByteData data) : _chunks = [data];
+
+  // Reads the concatenation of the chunks of a streamed object graph.
+  ReadStream.fromChunks(this._chunks);
+
+  int get pendingBytes {
+    int result = 0;
+    for (int i = _chunkIndex; i < _chunks.length; i++) {
+      result += _chunks[i].lengthInBytes;
+    }
+    return result - _cur;
+  }
+
+  int _readByte() {
+    while (_cur == _chunks[_chunkIndex].lengthInBytes) {
+      _cur = 0;
+      ++_chunkIndex;
+    }
+    return _chunks[_chunkIndex].getUint8(_cur++);
+  }
+
   int readUnsigned() {
     int result = 0;
     int shift = 0;
-    while (_data.getUint8(_cur) <= maxUnsignedDataPerByte) {
-      result |= _data.getUint8(_cur) << shift;
+    int b = _readByte();
+    while (b <= maxUnsignedDataPerByte) {
+      result |= b << shift;
       shift += dataBitsPerByte;
-      ++_cur;
+      b = _readByte();
     }
-    result |= (_data.getUint8(_cur) & byteMask) << shift;
-    ++_cur;
+    result |= (b & byteMask) << shift;
     return result;
   }
 
@@ -699,8 +699,8 @@ class HeapSnapshot {
   final DateTime timeStamp;
   final Isolate isolate;
 
-  HeapSnapshot(this.isolate, ByteData data) :
-      graph = new ObjectGraph(new ReadStream(data)),
+  HeapSnapshot(this.isolate, List<ByteData> chunks) :
+      graph = new ObjectGraph(new ReadStream.fromChunks(chunks)),
       timeStamp = new DateTime.now() {
   }
 
@@ -879,9 +879,19 @@ class Isolate extends ServiceObjectOwner with Coverage {
   @observable DartError error;
   @observable HeapSnapshot latestSnapshot;
   Completer<HeapSnapshot> _snapshotFetch;
+  List<ByteData> _snapshotChunks;
 
   void _loadHeapSnapshot(ServiceEvent event) {
-    latestSnapshot = new HeapSnapshot(this, event.data);
+    // The graph arrives in chunks, one event each.
+    if (event.chunkIndex == 0) {
+      _snapshotChunks = new List<ByteData>();
+    }
+    _snapshotChunks.add(event.data);
+    if (!event.lastChunk) {
+      return;
+    }
+    latestSnapshot = new HeapSnapshot(this, _snapshotChunks);
+    _snapshotChunks = null;
     if (_snapshotFetch != null) {
       _snapshotFetch.complete(latestSnapshot);
     }
@@ -1422,6 +1432,8 @@ class ServiceEvent extends ServiceObject {
   @observable ServiceMap topFrame;
   @observable ServiceMap exception;
   @observable ByteData data;
+  @observable int chunkIndex;
+  @observable bool lastChunk;
   @observable int count;
 
   void _update(ObservableMap map, bool mapIsRef) {
@@ -1443,6 +1455,10 @@ class ServiceEvent extends ServiceObject {
     if (map['_data'] != null) {
       data = map['_data'];
     }
+    if (map['chunkIndex'] != null) {
+      chunkIndex = map['chunkIndex'];
+      lastChunk = map['lastChunk'];
+    }
     if (map['count'] != null) {
       count = map['count'];
     }
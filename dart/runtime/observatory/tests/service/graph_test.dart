@@ -4,6 +4,7 @@
 // VMOptions=--compile-all --error_on_bad_type --error_on_bad_override
 
 import 'dart:async';
+import 'dart:typed_data';
 import 'package:observatory/object_graph.dart';
 import 'package:observatory/service_io.dart';
 import 'package:unittest/unittest.dart';
@@ -39,9 +40,14 @@ var tests = [
 
 (Isolate isolate) {
   Completer completer = new Completer();
+  List<ByteData> chunks = [];
   isolate.vm.events.stream.listen((ServiceEvent event) {
     if (event.eventType == ServiceEvent.kGraph) {
-      ReadStream reader = new ReadStream(event.data);
+      chunks.add(event.data);
+      if (!event.lastChunk) {
+        return;
+      }
+      ReadStream reader = new ReadStream.fromChunks(chunks);
       ObjectGraph graph = new ObjectGraph(reader);
       expect(fooId, isNotNull);
       Iterable<ObjectVertex> foos = graph.vertices.where(
@@ -0,0 +1,128 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/allocation_site_table.h"
+
+#include "platform/assert.h"
+#include "vm/flags.h"
+
+namespace dart {
+
+DECLARE_FLAG(int, pretenure_threshold);
+
+static const intptr_t kInitialCapacity = 64;
+
+
+AllocationSiteTable::AllocationSiteTable() : index_(NULL), capacity_(0) {
+  Rehash(kInitialCapacity);
+}
+
+
+AllocationSiteTable::~AllocationSiteTable() {
+  free(index_);
+}
+
+
+uword AllocationSiteTable::Hash(intptr_t owner_cid,
+                                intptr_t function_pos,
+                                intptr_t site_pos) {
+  uword hash = static_cast<uword>(owner_cid);
+  hash = (hash * 31) + static_cast<uword>(function_pos);
+  hash = (hash * 31) + static_cast<uword>(site_pos);
+  return hash ^ (hash >> 7);
+}
+
+
+intptr_t AllocationSiteTable::Find(intptr_t owner_cid,
+                                   intptr_t function_pos,
+                                   intptr_t site_pos) const {
+  const intptr_t mask = capacity_ - 1;
+  intptr_t slot = Hash(owner_cid, function_pos, site_pos) & mask;
+  while (index_[slot] >= 0) {
+    const Site& site = sites_[index_[slot]];
+    if ((site.owner_cid == owner_cid) &&
+        (site.function_pos == function_pos) &&
+        (site.site_pos == site_pos)) {
+      return index_[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+  return -1;
+}
+
+
+intptr_t AllocationSiteTable::Lookup(intptr_t owner_cid,
+                                     intptr_t function_pos,
+                                     intptr_t site_pos) {
+  intptr_t index = Find(owner_cid, function_pos, site_pos);
+  if (index >= 0) {
+    return index;
+  }
+  Site site;
+  site.owner_cid = owner_cid;
+  site.function_pos = function_pos;
+  site.site_pos = site_pos;
+  site.samples = 0;
+  site.survived = 0;
+  index = sites_.length();
+  sites_.Add(site);
+  // Keep the load factor at most one half.
+  if (2 * sites_.length() > capacity_) {
+    Rehash(2 * capacity_);
+  } else {
+    const intptr_t mask = capacity_ - 1;
+    intptr_t slot = Hash(owner_cid, function_pos, site_pos) & mask;
+    while (index_[slot] >= 0) {
+      slot = (slot + 1) & mask;
+    }
+    index_[slot] = index;
+  }
+  return index;
+}
+
+
+void AllocationSiteTable::Rehash(intptr_t capacity) {
+  ASSERT(Utils::IsPowerOfTwo(capacity));
+  free(index_);
+  index_ = reinterpret_cast<intptr_t*>(malloc(capacity * sizeof(*index_)));
+  if (index_ == NULL) {
+    FATAL("Out of memory.\n");
+  }
+  capacity_ = capacity;
+  for (intptr_t i = 0; i < capacity_; i++) {
+    index_[i] = -1;
+  }
+  const intptr_t mask = capacity_ - 1;
+  for (intptr_t i = 0; i < sites_.length(); i++) {
+    const Site& site = sites_[i];
+    intptr_t slot = Hash(site.owner_cid, site.function_pos, site.site_pos) &
+        mask;
+    while (index_[slot] >= 0) {
+      slot = (slot + 1) & mask;
+    }
+    index_[slot] = i;
+  }
+}
+
+
+void AllocationSiteTable::AddSample(intptr_t index, bool survived) {
+  Site& site = sites_[index];
+  if (site.samples == kMaxSamples) {
+    site.samples /= 2;
+    site.survived /= 2;
+  }
+  site.samples++;
+  if (survived) {
+    site.survived++;
+  }
+}
+
+
+bool AllocationSiteTable::ShouldPretenure(intptr_t index) const {
+  const Site& site = sites_[index];
+  return (site.samples >= kMinSamples) &&
+      ((100 * site.survived) >= (FLAG_pretenure_threshold * site.samples));
+}
+
+}  // namespace dart
@@ -0,0 +1,73 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_ALLOCATION_SITE_TABLE_H_
+#define VM_ALLOCATION_SITE_TABLE_H_
+
+#include "vm/allocation.h"
+#include "vm/globals.h"
+#include "vm/growable_array.h"
+
+namespace dart {
+
+// Survival feedback for the allocation sites of unoptimized code, used to
+// pretenure the objects of sites whose objects survive their first scavenge.
+//
+// A site is identified by the class owning its function, the token position of
+// that function and its own token position, all of which are stable across
+// compilations. Functions sharing all three merely share their feedback.
+class AllocationSiteTable {
+ public:
+  AllocationSiteTable();
+  ~AllocationSiteTable();
+
+  // Returns the index of the site, which is added if it is not yet known.
+  intptr_t Lookup(intptr_t owner_cid, intptr_t function_pos, intptr_t site_pos);
+
+  // Returns the index of the site or -1 if it is not known.
+  intptr_t Find(intptr_t owner_cid,
+                intptr_t function_pos,
+                intptr_t site_pos) const;
+
+  // Records whether an object allocated at the site survived its first
+  // scavenge. Older samples are given less weight over time.
+  void AddSample(intptr_t index, bool survived);
+
+  // Whether at least 'pretenure_threshold' percent of the sampled objects of
+  // the site survived.
+  bool ShouldPretenure(intptr_t index) const;
+
+  intptr_t Length() const { return sites_.length(); }
+
+ private:
+  // Sites are pretenured only after this many samples.
+  static const intptr_t kMinSamples = 8;
+  // The sample counts are halved when reaching this many samples.
+  static const intptr_t kMaxSamples = 64;
+
+  struct Site {
+    intptr_t owner_cid;
+    intptr_t function_pos;
+    intptr_t site_pos;
+    intptr_t samples;
+    intptr_t survived;
+  };
+
+  static uword Hash(intptr_t owner_cid,
+                    intptr_t function_pos,
+                    intptr_t site_pos);
+
+  // Rebuilds the open-addressed index into sites_ with 'capacity' slots.
+  void Rehash(intptr_t capacity);
+
+  MallocGrowableArray<Site> sites_;
+  intptr_t* index_;  // -1 for an empty slot.
+  intptr_t capacity_;  // A power of two.
+
+  DISALLOW_COPY_AND_ASSIGN(AllocationSiteTable);
+};
+
+}  // namespace dart
+
+#endif  // VM_ALLOCATION_SITE_TABLE_H_
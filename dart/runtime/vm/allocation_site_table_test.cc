@@ -0,0 +1,48 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/assert.h"
+#include "vm/allocation_site_table.h"
+#include "vm/unit_test.h"
+
+namespace dart {
+
+UNIT_TEST_CASE(AllocationSiteTable) {
+  AllocationSiteTable table;
+  EXPECT_EQ(-1, table.Find(1, 2, 3));
+  // Grow the table past its initial capacity.
+  const intptr_t kNumSites = 1000;
+  for (intptr_t i = 0; i < kNumSites; i++) {
+    EXPECT_EQ(i, table.Lookup(i % 7, i, i + 1));
+  }
+  EXPECT_EQ(kNumSites, table.Length());
+  for (intptr_t i = 0; i < kNumSites; i++) {
+    EXPECT_EQ(i, table.Find(i % 7, i, i + 1));
+    EXPECT_EQ(i, table.Lookup(i % 7, i, i + 1));
+  }
+  EXPECT_EQ(-1, table.Find(0, 1, 2));
+  EXPECT_EQ(kNumSites, table.Length());
+
+  // A site is pretenured only after enough samples.
+  const intptr_t survivor = table.Lookup(100, 0, 0);
+  const intptr_t mortal = table.Lookup(100, 0, 1);
+  for (intptr_t i = 0; i < 4; i++) {
+    table.AddSample(survivor, true);
+    table.AddSample(mortal, false);
+  }
+  EXPECT(!table.ShouldPretenure(survivor));
+  for (intptr_t i = 0; i < 100; i++) {
+    table.AddSample(survivor, true);
+    table.AddSample(mortal, (i % 2) == 0);
+  }
+  EXPECT(table.ShouldPretenure(survivor));
+  EXPECT(!table.ShouldPretenure(mortal));
+  // Older samples lose their weight once the objects of the site die young.
+  for (intptr_t i = 0; i < 10; i++) {
+    table.AddSample(survivor, false);
+  }
+  EXPECT(!table.ShouldPretenure(survivor));
+}
+
+}  // namespace dart
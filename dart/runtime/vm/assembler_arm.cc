@@ -7,6 +7,8 @@
 
 #include "vm/assembler.h"
 #include "vm/cpu.h"
+#include "vm/dart.h"
+#include "vm/heap.h"
 #include "vm/longjump.h"
 #include "vm/runtime_entry.h"
 #include "vm/simulator.h"
@@ -21,6 +23,7 @@
 namespace dart {
 
 DEFINE_FLAG(bool, print_stop_message, true, "Print stop message.");
+DECLARE_FLAG(bool, incremental_marking);
 DECLARE_FLAG(bool, inline_alloc);
 
 // Instruction encoding bits.
@@ -1769,12 +1772,53 @@ void Assembler::VerifiedWrite(const Address& address,
 }
 
 
+// Preserves object and value registers.
+void Assembler::StoreIntoObjectMarkingBarrier(Register object,
+                                              Register value,
+                                              bool can_value_be_smi) {
+  Isolate* isolate = Isolate::Current();
+  if (!FLAG_incremental_marking || (isolate == Dart::vm_isolate())) {
+    return;
+  }
+  StubCode* stub_code = isolate->stub_code();
+  if (stub_code->MarkingBarrier_entry() == NULL) {
+    // Generating the stubs that precede the marking barrier stub.
+    return;
+  }
+  Label done;
+  LoadImmediate(IP, isolate->heap()->IncrementalMarkingAddress());
+  ldr(IP, Address(IP, 0));
+  cmp(IP, Operand(0));
+  b(&done, EQ);
+  if (can_value_be_smi) {
+    tst(value, Operand(kSmiTagMask));
+    b(&done, EQ);
+  }
+  // Only old values stored into old objects need to be shaded.
+  orr(IP, object, Operand(value));
+  tst(IP, Operand(kNewObjectAlignmentOffset));
+  b(&done, NE);
+  RegList regs = (1 << LR);
+  if (value != R0) {
+    regs |= (1 << R0);  // Preserve R0.
+  }
+  PushList(regs);
+  if (value != R0) {
+    mov(R0, Operand(value));
+  }
+  BranchLink(&stub_code->MarkingBarrierLabel());
+  PopList(regs);
+  Bind(&done);
+}
+
+
 void Assembler::StoreIntoObject(Register object,
                                 const Address& dest,
                                 Register value,
                                 bool can_value_be_smi) {
   ASSERT(object != value);
   VerifiedWrite(dest, value, kHeapObjectOrSmi);
+  StoreIntoObjectMarkingBarrier(object, value, can_value_be_smi);
   Label done;
   if (can_value_be_smi) {
     StoreIntoObjectFilter(object, value, &done);
@@ -1782,11 +1826,12 @@ void Assembler::StoreIntoObject(Register object,
     StoreIntoObjectFilterNoSmi(object, value, &done);
   }
   // A store buffer update is required.
-  RegList regs = (1 << LR);
+  RegList regs = (1 << LR) | (1 << R1);
   if (value != R0) {
     regs |= (1 << R0);  // Preserve R0.
   }
   PushList(regs);
+  LoadSlotAddress(R1, dest);
   if (object != R0) {
     mov(R0, Operand(object));
   }
@@ -1797,6 +1842,26 @@ void Assembler::StoreIntoObject(Register object,
 }
 
 
+void Assembler::LoadSlotAddress(Register rd, const Address& dest) {
+  // Object fields are addressed without writeback.
+  ASSERT((dest.mode() == Address::Offset) ||
+         (dest.mode() == Address::NegOffset));
+  const bool is_positive = (dest.encoding() & (1 << kUShift)) != 0;
+  if (dest.kind() == Address::Immediate) {
+    const int32_t offset = dest.encoding() & kOffset12Mask;
+    AddImmediate(rd, dest.rn(), is_positive ? offset : -offset);
+  } else {
+    const Instr* instr = Instr::At(reinterpret_cast<uword>(&dest.encoding_));
+    Operand index(dest.rm(), instr->ShiftField(), instr->ShiftAmountField());
+    if (is_positive) {
+      add(rd, dest.rn(), index);
+    } else {
+      sub(rd, dest.rn(), index);
+    }
+  }
+}
+
+
 void Assembler::StoreIntoObjectOffset(Register object,
                                       int32_t offset,
                                       Register value,
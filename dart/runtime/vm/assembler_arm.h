@@ -1098,11 +1098,20 @@ class Assembler : public ValueObject {
 
   void StoreIntoObjectFilter(Register object, Register value, Label* no_update);
 
+  // Shades old values stored into old objects while the heap is being marked
+  // incrementally. Emitted only with --incremental_marking.
+  void StoreIntoObjectMarkingBarrier(Register object,
+                                     Register value,
+                                     bool can_value_be_smi);
+
   // Shorter filtering sequence that assumes that value is not a smi.
   void StoreIntoObjectFilterNoSmi(Register object,
                                   Register value,
                                   Label* no_update);
 
+  // Loads the address of the slot 'dest' of a pointer store into 'rd'.
+  void LoadSlotAddress(Register rd, const Address& dest);
+
   // Helpers for write-barrier verification.
 
   // Returns VerifiedMemory::offset() as an Operand.
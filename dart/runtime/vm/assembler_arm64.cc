@@ -7,6 +7,8 @@
 
 #include "vm/assembler.h"
 #include "vm/cpu.h"
+#include "vm/dart.h"
+#include "vm/heap.h"
 #include "vm/longjump.h"
 #include "vm/runtime_entry.h"
 #include "vm/simulator.h"
@@ -22,6 +24,7 @@ namespace dart {
 
 DEFINE_FLAG(bool, use_far_branches, false, "Always use far branches");
 DEFINE_FLAG(bool, print_stop_message, false, "Print stop message.");
+DECLARE_FLAG(bool, incremental_marking);
 DECLARE_FLAG(bool, inline_alloc);
 
 
@@ -83,6 +86,15 @@ Assembler::Assembler(bool use_far_branches)
     } else {
       object_pool_.AddObject(vacant, kNotPatchable);
     }
+    // The marking barrier is also called from intrinsics, which run with the
+    // pool pointer of the caller.
+    if (stub_code->MarkingBarrier_entry() != NULL) {
+      intptr_t index = object_pool_.AddExternalLabel(
+          &stub_code->MarkingBarrierLabel(), kNotPatchable);
+      ASSERT(index == kMarkingBarrierCPIndex);
+    } else {
+      object_pool_.AddObject(vacant, kNotPatchable);
+    }
   }
 }
 
@@ -926,12 +938,57 @@ void Assembler::StoreIntoObjectOffset(Register object,
 }
 
 
+// Preserves object and value registers.
+void Assembler::StoreIntoObjectMarkingBarrier(Register object,
+                                              Register value,
+                                              bool can_value_be_smi) {
+  Isolate* isolate = Isolate::Current();
+  if (!FLAG_incremental_marking || (isolate == Dart::vm_isolate())) {
+    return;
+  }
+  StubCode* stub_code = isolate->stub_code();
+  if (stub_code->MarkingBarrier_entry() == NULL) {
+    // Generating the stubs that precede the marking barrier stub.
+    return;
+  }
+  Label done;
+  LoadImmediate(TMP, isolate->heap()->IncrementalMarkingAddress(), kNoPP);
+  ldr(TMP, Address(TMP));
+  cmp(TMP, Operand(0));
+  b(&done, EQ);
+  if (can_value_be_smi) {
+    tsti(value, Immediate(kSmiTagMask));
+    b(&done, EQ);
+  }
+  // Only old values stored into old objects need to be shaded.
+  orr(TMP, object, Operand(value));
+  tsti(TMP, Immediate(kNewObjectAlignmentOffset));
+  b(&done, NE);
+  if (value != R0) {
+    // Preserve R0.
+    Push(R0);
+  }
+  Push(LR);
+  if (value != R0) {
+    mov(R0, value);
+  }
+  BranchLink(&stub_code->MarkingBarrierLabel(), PP);
+  Pop(LR);
+  if (value != R0) {
+    // Restore R0.
+    Pop(R0);
+  }
+  Bind(&done);
+}
+
+
 void Assembler::StoreIntoObject(Register object,
                                 const Address& dest,
                                 Register value,
                                 bool can_value_be_smi) {
   ASSERT(object != value);
   str(value, dest);
+  StoreIntoObjectMarkingBarrier(object, value, can_value_be_smi);
   Label done;
   if (can_value_be_smi) {
     StoreIntoObjectFilter(object, value, &done);
@@ -943,13 +1000,16 @@ void Assembler::StoreIntoObject(Register object,
     // Preserve R0.
     Push(R0);
   }
+  Push(R1);
   Push(LR);
+  LoadSlotAddress(R1, dest);
   if (object != R0) {
     mov(R0, object);
   }
   StubCode* stub_code = Isolate::Current()->stub_code();
   BranchLink(&stub_code->UpdateStoreBufferLabel(), PP);
   Pop(LR);
+  Pop(R1);
   if (value != R0) {
     // Restore R0.
     Pop(R0);
@@ -958,6 +1018,32 @@ void Assembler::StoreIntoObject(Register object,
 }
 
 
+void Assembler::LoadSlotAddress(Register rd, const Address& dest) {
+  // Pointers are stored as double words.
+  if (dest.type_ == Address::Offset) {
+    int32_t offset;
+    if ((dest.encoding_ & B24) != 0) {
+      offset = ((dest.encoding_ >> kImm12Shift) & 0xfff) << kWordSizeLog2;
+    } else {
+      // The unscaled offset is a signed 9 bit value.
+      offset = (dest.encoding_ >> kImm9Shift) & 0x1ff;
+      if ((offset & 0x100) != 0) {
+        offset -= 0x200;
+      }
+    }
+    AddImmediate(rd, dest.base_, offset, kNoPP);
+  } else {
+    ASSERT(dest.type_ == Address::Reg);
+    const Register rm =
+        static_cast<Register>((dest.encoding_ >> kRmShift) & 0x1f);
+    const Extend ext =
+        static_cast<Extend>((dest.encoding_ >> kExtendTypeShift) & 0x7);
+    const int32_t scale = ((dest.encoding_ & B12) != 0) ? kWordSizeLog2 : 0;
+    add(rd, dest.base_, Operand(rm, ext, scale));
+  }
+}
+
+
 void Assembler::StoreIntoObjectNoBarrier(Register object,
                                          const Address& dest,
                                          Register value) {
@@ -1303,6 +1303,7 @@ class Assembler : public ValueObject {
   static const int kICCallBreakpointCPIndex = 5;
   static const int kClosureCallBreakpointCPIndex = 6;
   static const int kRuntimeCallBreakpointCPIndex = 7;
+  static const int kMarkingBarrierCPIndex = 8;
 
   bool allow_constant_pool() const {
     return allow_constant_pool_;
@@ -1919,11 +1920,20 @@ class Assembler : public ValueObject {
 
   void StoreIntoObjectFilter(Register object, Register value, Label* no_update);
 
+  // Shades old values stored into old objects while the heap is being marked
+  // incrementally. Emitted only with --incremental_marking.
+  void StoreIntoObjectMarkingBarrier(Register object,
+                                     Register value,
+                                     bool can_value_be_smi);
+
   // Shorter filtering sequence that assumes that value is not a smi.
   void StoreIntoObjectFilterNoSmi(Register object,
                                   Register value,
                                   Label* no_update);
 
+  // Loads the address of the slot 'dest' of a pointer store into 'rd'.
+  void LoadSlotAddress(Register rd, const Address& dest);
+
   DISALLOW_ALLOCATION();
   DISALLOW_COPY_AND_ASSIGN(Assembler);
 };
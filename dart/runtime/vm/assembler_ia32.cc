@@ -8,6 +8,7 @@
 #include "vm/assembler.h"
 #include "vm/code_generator.h"
 #include "vm/cpu.h"
+#include "vm/dart.h"
 #include "vm/heap.h"
 #include "vm/memory_region.h"
 #include "vm/runtime_entry.h"
@@ -18,6 +19,7 @@
 namespace dart {
 
 DEFINE_FLAG(bool, print_stop_message, true, "Print stop message.");
+DECLARE_FLAG(bool, incremental_marking);
 DECLARE_FLAG(bool, inline_alloc);
 
 
@@ -2317,6 +2319,44 @@ void Assembler::VerifySmi(const Address& dest, const char* stop_msg) {
 #endif  // defined(DEBUG)
 
 
+// Preserves object and value registers.
+void Assembler::StoreIntoObjectMarkingBarrier(Register object,
+                                              Register value,
+                                              bool can_value_be_smi) {
+  Isolate* isolate = Isolate::Current();
+  if (!FLAG_incremental_marking || (isolate == Dart::vm_isolate())) {
+    return;
+  }
+  StubCode* stub_code = isolate->stub_code();
+  if (stub_code->MarkingBarrier_entry() == NULL) {
+    // Generating the stubs that precede the marking barrier stub.
+    return;
+  }
+  Label done;
+  cmpl(Address::Absolute(isolate->heap()->IncrementalMarkingAddress()),
+       Immediate(0));
+  j(EQUAL, &done);
+  if (can_value_be_smi) {
+    testl(value, Immediate(kSmiTagMask));
+    j(ZERO, &done);
+  }
+  // Only old values stored into old objects need to be shaded.
+  testl(object, Immediate(kNewObjectAlignmentOffset));
+  j(NOT_ZERO, &done);
+  testl(value, Immediate(kNewObjectAlignmentOffset));
+  j(NOT_ZERO, &done);
+  if (value != EDX) {
+    pushl(EDX);  // Preserve EDX.
+    movl(EDX, value);
+  }
+  call(&stub_code->MarkingBarrierLabel());
+  if (value != EDX) {
+    popl(EDX);  // Restore EDX.
+  }
+  Bind(&done);
+}
+
+
 // Destroys the value register.
 void Assembler::StoreIntoObject(Register object,
                                 const Address& dest,
@@ -2324,6 +2364,7 @@ void Assembler::StoreIntoObject(Register object,
                                 bool can_value_be_smi) {
   ASSERT(object != value);
   VerifiedWrite(dest, value, kHeapObjectOrSmi);
+  StoreIntoObjectMarkingBarrier(object, value, can_value_be_smi);
   Label done;
   if (can_value_be_smi) {
     StoreIntoObjectFilter(object, value, &done);
@@ -2334,11 +2375,15 @@ void Assembler::StoreIntoObject(Register object,
   if (value != EDX) {
     pushl(EDX);  // Preserve EDX.
   }
+  // The filter destroyed the value register, use it to pass the slot.
+  leal(value, dest);
+  pushl(value);
   if (object != EDX) {
     movl(EDX, object);
   }
   StubCode* stub_code = Isolate::Current()->stub_code();
   call(&stub_code->UpdateStoreBufferLabel());
+  popl(value);
   if (value != EDX) {
     popl(EDX);  // Restore EDX.
   }
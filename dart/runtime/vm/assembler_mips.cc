@@ -6,6 +6,8 @@
 #if defined(TARGET_ARCH_MIPS)
 
 #include "vm/assembler.h"
+#include "vm/dart.h"
+#include "vm/heap.h"
 #include "vm/longjump.h"
 #include "vm/runtime_entry.h"
 #include "vm/simulator.h"
@@ -18,6 +20,7 @@ namespace dart {
 DECLARE_FLAG(int, trace_sim_after);
 #endif
 DEFINE_FLAG(bool, print_stop_message, false, "Print stop message.");
+DECLARE_FLAG(bool, incremental_marking);
 DECLARE_FLAG(bool, inline_alloc);
 
 void Assembler::InitializeMemoryWithBreakpoints(uword data, intptr_t length) {
@@ -521,6 +524,56 @@ void Assembler::StoreIntoObjectFilter(Register object,
 }
 
 
+// Preserves object and value registers.
+void Assembler::StoreIntoObjectMarkingBarrier(Register object,
+                                              Register value,
+                                              bool can_value_be_smi) {
+  ASSERT(!in_delay_slot_);
+  Isolate* isolate = Isolate::Current();
+  if (!FLAG_incremental_marking || (isolate == Dart::vm_isolate())) {
+    return;
+  }
+  StubCode* stub_code = isolate->stub_code();
+  if (stub_code->MarkingBarrier_entry() == NULL) {
+    // Generating the stubs that precede the marking barrier stub.
+    return;
+  }
+  Label done;
+  LoadImmediate(TMP, isolate->heap()->IncrementalMarkingAddress());
+  lw(TMP, Address(TMP));
+  beq(TMP, ZR, &done);
+  if (can_value_be_smi) {
+    andi(CMPRES1, value, Immediate(kSmiTagMask));
+    beq(CMPRES1, ZR, &done);
+  }
+  // Only old values stored into old objects need to be shaded.
+  or_(TMP, object, value);
+  andi(CMPRES1, TMP, Immediate(kNewObjectAlignmentOffset));
+  bne(CMPRES1, ZR, &done);
+  if (value != T0) {
+    // Preserve T0.
+    addiu(SP, SP, Immediate(-2 * kWordSize));
+    sw(T0, Address(SP, 1 * kWordSize));
+  } else {
+    addiu(SP, SP, Immediate(-1 * kWordSize));
+  }
+  sw(RA, Address(SP, 0 * kWordSize));
+  if (value != T0) {
+    mov(T0, value);
+  }
+  BranchLink(&stub_code->MarkingBarrierLabel());
+  lw(RA, Address(SP, 0 * kWordSize));
+  if (value != T0) {
+    // Restore T0.
+    lw(T0, Address(SP, 1 * kWordSize));
+    addiu(SP, SP, Immediate(2 * kWordSize));
+  } else {
+    addiu(SP, SP, Immediate(1 * kWordSize));
+  }
+  Bind(&done);
+}
+
+
 void Assembler::StoreIntoObject(Register object,
                                 const Address& dest,
                                 Register value,
@@ -528,6 +581,7 @@ void Assembler::StoreIntoObject(Register object,
   ASSERT(!in_delay_slot_);
   ASSERT(object != value);
   sw(value, dest);
+  StoreIntoObjectMarkingBarrier(object, value, can_value_be_smi);
   Label done;
   if (can_value_be_smi) {
     StoreIntoObjectFilter(object, value, &done);
@@ -535,27 +589,27 @@ void Assembler::StoreIntoObject(Register object,
     StoreIntoObjectFilterNoSmi(object, value, &done);
   }
   // A store buffer update is required.
+  addiu(SP, SP, Immediate(-3 * kWordSize));
   if (value != T0) {
     // Preserve T0.
-    addiu(SP, SP, Immediate(-2 * kWordSize));
-    sw(T0, Address(SP, 1 * kWordSize));
-  } else {
-    addiu(SP, SP, Immediate(-1 * kWordSize));
+    sw(T0, Address(SP, 2 * kWordSize));
   }
+  sw(T1, Address(SP, 1 * kWordSize));
   sw(RA, Address(SP, 0 * kWordSize));
+  // The stub marks the card of the slot in card remembered arrays.
+  AddImmediate(T1, dest.base(), dest.offset());
   if (object != T0) {
     mov(T0, object);
   }
   StubCode* stub_code = Isolate::Current()->stub_code();
   BranchLink(&stub_code->UpdateStoreBufferLabel());
   lw(RA, Address(SP, 0 * kWordSize));
+  lw(T1, Address(SP, 1 * kWordSize));
   if (value != T0) {
     // Restore T0.
-    lw(T0, Address(SP, 1 * kWordSize));
-    addiu(SP, SP, Immediate(2 * kWordSize));
-  } else {
-    addiu(SP, SP, Immediate(1 * kWordSize));
+    lw(T0, Address(SP, 2 * kWordSize));
   }
+  addiu(SP, SP, Immediate(3 * kWordSize));
   Bind(&done);
 }
 
@@ -1735,6 +1735,12 @@ class Assembler : public ValueObject {
 
   void StoreIntoObjectFilter(Register object, Register value, Label* no_update);
 
+  // Shades old values stored into old objects while the heap is being marked
+  // incrementally. Emitted only with --incremental_marking.
+  void StoreIntoObjectMarkingBarrier(Register object,
+                                     Register value,
+                                     bool can_value_be_smi);
+
   // Shorter filtering sequence that assumes that value is not a smi.
   void StoreIntoObjectFilterNoSmi(Register object,
                                   Register value,
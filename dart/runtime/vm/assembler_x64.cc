@@ -7,6 +7,7 @@
 
 #include "vm/assembler.h"
 #include "vm/cpu.h"
+#include "vm/dart.h"
 #include "vm/heap.h"
 #include "vm/instructions.h"
 #include "vm/locations.h"
@@ -18,6 +19,7 @@
 namespace dart {
 
 DEFINE_FLAG(bool, print_stop_message, true, "Print stop message.");
+DECLARE_FLAG(bool, incremental_marking);
 DECLARE_FLAG(bool, inline_alloc);
 
 
@@ -80,6 +82,15 @@ Assembler::Assembler(bool use_far_branches)
     } else {
       object_pool_.AddObject(vacant, kNotPatchable);
     }
+    // The marking barrier is also called from intrinsics, which run with the
+    // pool pointer of the caller.
+    if (stub_code->MarkingBarrier_entry() != NULL) {
+      index = object_pool_.AddExternalLabel(
+          &stub_code->MarkingBarrierLabel(), kNotPatchable);
+      ASSERT(index == kMarkingBarrierCPIndex);
+    } else {
+      object_pool_.AddObject(vacant, kNotPatchable);
+    }
   }
 }
 
@@ -3069,12 +3080,48 @@ void Assembler::VerifySmi(const Address& dest, const char* stop_msg) {
 #endif  // defined(DEBUG)
 
 
+void Assembler::StoreIntoObjectMarkingBarrier(Register object,
+                                              Register value,
+                                              bool can_value_be_smi) {
+  Isolate* isolate = Isolate::Current();
+  if (!FLAG_incremental_marking || (isolate == Dart::vm_isolate())) {
+    return;
+  }
+  StubCode* stub_code = isolate->stub_code();
+  if (stub_code->MarkingBarrier_entry() == NULL) {
+    // Generating the stubs that precede the marking barrier stub.
+    return;
+  }
+  Label done;
+  movq(TMP, Immediate(isolate->heap()->IncrementalMarkingAddress()));
+  cmpq(Address(TMP, 0), Immediate(0));
+  j(EQUAL, &done);
+  if (can_value_be_smi) {
+    testq(value, Immediate(kSmiTagMask));
+    j(ZERO, &done);
+  }
+  // Only old values stored into old objects need to be shaded.
+  testq(object, Immediate(kNewObjectAlignmentOffset));
+  j(NOT_ZERO, &done);
+  testq(value, Immediate(kNewObjectAlignmentOffset));
+  j(NOT_ZERO, &done);
+  if (value != RDX) {
+    pushq(RDX);
+    movq(RDX, value);
+  }
+  Call(&stub_code->MarkingBarrierLabel(), PP);
+  if (value != RDX) popq(RDX);
+  Bind(&done);
+}
+
+
 void Assembler::StoreIntoObject(Register object,
                                 const Address& dest,
                                 Register value,
                                 bool can_value_be_smi) {
   ASSERT(object != value);
   VerifiedWrite(dest, value, kHeapObjectOrSmi);
+  StoreIntoObjectMarkingBarrier(object, value, can_value_be_smi);
   Label done;
   if (can_value_be_smi) {
     StoreIntoObjectFilter(object, value, &done);
@@ -3083,11 +3130,15 @@ void Assembler::StoreIntoObject(Register object,
   }
   // A store buffer update is required.
   if (value != RDX) pushq(RDX);
+  // The filter destroyed the value register, use it to pass the slot.
+  leaq(value, dest);
+  pushq(value);
   if (object != RDX) {
     movq(RDX, object);
   }
   StubCode* stub_code = Isolate::Current()->stub_code();
   Call(&stub_code->UpdateStoreBufferLabel(), PP);
+  popq(value);
   if (value != RDX) popq(RDX);
   Bind(&done);
 }
@@ -3527,11 +3578,22 @@ void Assembler::TryAllocate(const Class& cls,
                             bool near_jump,
                             Register instance_reg,
                             Register pp) {
+  Heap* heap = Isolate::Current()->heap();
+  TryAllocate(cls, heap->SpaceForAllocation(cls.id()),
+              failure, near_jump, instance_reg, pp);
+}
+
+
+void Assembler::TryAllocate(const Class& cls,
+                            Heap::Space space,
+                            Label* failure,
+                            bool near_jump,
+                            Register instance_reg,
+                            Register pp) {
   ASSERT(failure != NULL);
   if (FLAG_inline_alloc) {
     Heap* heap = Isolate::Current()->heap();
     const intptr_t instance_size = cls.instance_size();
-    Heap::Space space = heap->SpaceForAllocation(cls.id());
     LoadImmediate(TMP, Immediate(heap->TopAddress(space)), pp);
     movq(instance_reg, Address(TMP, 0));
     AddImmediate(instance_reg, Immediate(instance_size), pp);
@@ -3564,11 +3626,23 @@ void Assembler::TryAllocateArray(intptr_t cid,
                                  bool near_jump,
                                  Register instance,
                                  Register end_address) {
+  Heap* heap = Isolate::Current()->heap();
+  TryAllocateArray(cid, heap->SpaceForAllocation(cid), instance_size,
+                   failure, near_jump, instance, end_address);
+}
+
+
+void Assembler::TryAllocateArray(intptr_t cid,
+                                 Heap::Space space,
+                                 intptr_t instance_size,
+                                 Label* failure,
+                                 bool near_jump,
+                                 Register instance,
+                                 Register end_address) {
   ASSERT(failure != NULL);
   if (FLAG_inline_alloc) {
     Isolate* isolate = Isolate::Current();
     Heap* heap = isolate->heap();
-    Heap::Space space = heap->SpaceForAllocation(cid);
     movq(instance, Immediate(heap->TopAddress(space)));
     movq(instance, Address(instance, 0));
     movq(end_address, RAX);
@@ -911,6 +911,7 @@ class Assembler : public ValueObject {
   static const int kICCallBreakpointCPIndex = 5;
   static const int kClosureCallBreakpointCPIndex = 6;
   static const int kRuntimeCallBreakpointCPIndex = 7;
+  static const int kMarkingBarrierCPIndex = 8;
 
   void LoadPoolPointer(Register pp);
 
@@ -994,6 +995,14 @@ class Assembler : public ValueObject {
                    bool near_jump,
                    Register instance_reg,
                    Register pp);
+  // As above, but allocates in 'space' rather than in the space the heap
+  // chooses for the class.
+  void TryAllocate(const Class& cls,
+                   Heap::Space space,
+                   Label* failure,
+                   bool near_jump,
+                   Register instance_reg,
+                   Register pp);
 
   void TryAllocateArray(intptr_t cid,
                         intptr_t instance_size,
@@ -1001,6 +1010,13 @@ class Assembler : public ValueObject {
                         bool near_jump,
                         Register instance,
                         Register end_address);
+  void TryAllocateArray(intptr_t cid,
+                        Heap::Space space,
+                        intptr_t instance_size,
+                        Label* failure,
+                        bool near_jump,
+                        Register instance,
+                        Register end_address);
 
   // Debugging and bringup support.
   void Stop(const char* message, bool fixed_length_encoding = false);
@@ -1097,6 +1113,12 @@ class Assembler : public ValueObject {
 
   void StoreIntoObjectFilter(Register object, Register value, Label* no_update);
 
+  // Shades old values stored into old objects while the heap is being marked
+  // incrementally. Emitted only with --incremental_marking.
+  void StoreIntoObjectMarkingBarrier(Register object,
+                                     Register value,
+                                     bool can_value_be_smi);
+
   // Shorter filtering sequence that assumes that value is not a smi.
   void StoreIntoObjectFilterNoSmi(Register object,
                                   Register value,
@@ -22,6 +22,14 @@ class AtomicOperations : public AllStatic {
   static uintptr_t FetchAndIncrement(uintptr_t* p);
 
   static uword CompareAndSwapWord(uword* ptr, uword old_value, uword new_value);
+
+  // Atomically load or store the value at ptr, without ordering any other
+  // memory accesses.
+  //
+  // NOTE: Not to be used for memory locations that are accessed by generated
+  // code.
+  static uword LoadRelaxed(uword* ptr);
+  static void StoreRelaxed(uword* ptr, uword value);
 };
 
 
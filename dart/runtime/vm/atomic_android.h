@@ -21,6 +21,16 @@ inline uintptr_t AtomicOperations::FetchAndIncrement(uintptr_t* p) {
 }
 
 
+inline uword AtomicOperations::LoadRelaxed(uword* ptr) {
+  return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+
+inline void AtomicOperations::StoreRelaxed(uword* ptr, uword value) {
+  __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+}
+
+
 #if !defined(USING_SIMULATOR)
 inline uword AtomicOperations::CompareAndSwapWord(uword* ptr,
                                                   uword old_value,
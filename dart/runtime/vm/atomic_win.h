@@ -28,6 +28,17 @@ inline uintptr_t AtomicOperations::FetchAndIncrement(uintptr_t* p) {
 }
 
 
+// Aligned word accesses are atomic on the supported targets.
+inline uword AtomicOperations::LoadRelaxed(uword* ptr) {
+  return *static_cast<volatile uword*>(ptr);
+}
+
+
+inline void AtomicOperations::StoreRelaxed(uword* ptr, uword value) {
+  *static_cast<volatile uword*>(ptr) = value;
+}
+
+
 #if !defined(USING_SIMULATOR)
 inline uword AtomicOperations::CompareAndSwapWord(uword* ptr,
                                                   uword old_value,
@@ -11,6 +11,14 @@
 #include "platform/globals.h"
 
 #include "vm/dart_api_impl.h"
+#include "vm/dart_api_message.h"
+#include "vm/isolate_template.h"
+#include "vm/lockers.h"
+#include "vm/message.h"
+#include "vm/message_handler.h"
+#include "vm/os_thread.h"
+#include "vm/page_pool.h"
+#include "vm/port.h"
 #include "vm/stack_frame.h"
 #include "vm/unit_test.h"
 
@@ -18,6 +26,8 @@ using dart::bin::File;
 
 namespace dart {
 
+DECLARE_FLAG(bool, huge_pages);
+
 Benchmark* Benchmark::first_ = NULL;
 Benchmark* Benchmark::tail_ = NULL;
 const char* Benchmark::executable_ = NULL;
@@ -72,6 +82,27 @@ BENCHMARK(CorelibIsolateStartup) {
 }
 
 
+BENCHMARK(CorelibIsolateStartupFromTemplate) {
+  const int kNumIterations = 1000;
+  Timer timer(true, "CorelibIsolateStartupFromTemplate");
+  Isolate* isolate = Isolate::Current();
+  Thread::ExitIsolate();
+  IsolateTemplate::Register(bin::isolate_snapshot_buffer);
+  // The first isolate is taken as the template.
+  TestCase::CreateTestIsolate();
+  Dart_ShutdownIsolate();
+  for (int i = 0; i < kNumIterations; i++) {
+    timer.Start();
+    TestCase::CreateTestIsolate();
+    timer.Stop();
+    Dart_ShutdownIsolate();
+  }
+  IsolateTemplate::Cleanup();
+  benchmark->set_score(timer.TotalElapsedTime() / kNumIterations);
+  Thread::EnterIsolate(isolate);
+}
+
+
 //
 // Measure invocation of Dart API functions.
 //
@@ -601,4 +632,337 @@ BENCHMARK(SimpleMessage) {
   benchmark->set_score(elapsed_time);
 }
 
+
+// Posting [42, "hello", [1, 2]] from native code: building and writing a
+// Dart_CObject graph, versus writing the values with a message builder.
+BENCHMARK(CObjectMessage) {
+  const intptr_t kLoopCount = 1000000;
+  static char kHello[] = "hello";
+  Timer timer(true, "CObject Message");
+  timer.Start();
+  for (intptr_t i = 0; i < kLoopCount; i++) {
+    Dart_CObject* values[6];
+    for (intptr_t j = 0; j < 6; j++) {
+      values[j] = reinterpret_cast<Dart_CObject*>(malloc(sizeof(Dart_CObject)));
+    }
+    Dart_CObject* inner[] = { values[3], values[4] };
+    Dart_CObject* outer[] = { values[1], values[2], values[5] };
+    values[0]->type = Dart_CObject_kArray;
+    values[0]->value.as_array.length = 3;
+    values[0]->value.as_array.values = outer;
+    values[1]->type = Dart_CObject_kInt32;
+    values[1]->value.as_int32 = 42;
+    values[2]->type = Dart_CObject_kString;
+    values[2]->value.as_string = kHello;
+    values[3]->type = Dart_CObject_kInt32;
+    values[3]->value.as_int32 = 1;
+    values[4]->type = Dart_CObject_kInt32;
+    values[4]->value.as_int32 = 2;
+    values[5]->type = Dart_CObject_kArray;
+    values[5]->value.as_array.length = 2;
+    values[5]->value.as_array.values = inner;
+    uint8_t* buffer = NULL;
+    ApiMessageWriter writer(&buffer, &malloc_allocator);
+    writer.WriteCMessage(values[0]);
+    free(buffer);
+    for (intptr_t j = 0; j < 6; j++) {
+      free(values[j]);
+    }
+  }
+  timer.Stop();
+  int64_t elapsed_time = timer.TotalElapsedTime();
+  benchmark->set_score(elapsed_time);
+}
+
+
+BENCHMARK(MessageBuilderMessage) {
+  const intptr_t kLoopCount = 1000000;
+  ApiMessageBuilder builder;
+  Timer timer(true, "Message Builder Message");
+  timer.Start();
+  for (intptr_t i = 0; i < kLoopCount; i++) {
+    builder.BeginArray(3);
+    builder.AddInt64(42);
+    builder.AddString("hello");
+    builder.BeginArray(2);
+    builder.AddInt64(1);
+    builder.AddInt64(2);
+    builder.EndArray();
+    builder.EndArray();
+    uint8_t* buffer = NULL;
+    intptr_t buffer_len = 0;
+    builder.Finish(&buffer, &buffer_len);
+    free(buffer);
+  }
+  timer.Stop();
+  int64_t elapsed_time = timer.TotalElapsedTime();
+  benchmark->set_score(elapsed_time);
+}
+
+
+BENCHMARK(LargeByteArrayMessage) {
+  const intptr_t kLength = 1 * MB;
+  const TypedData& typed_data = TypedData::Handle(
+      TypedData::New(kTypedDataUint8ArrayCid, kLength));
+  const intptr_t kLoopCount = 1000;
+  Isolate* isolate = Isolate::Current();
+  uint8_t* buffer;
+  Timer timer(true, "Large Byte Array Message");
+  timer.Start();
+  for (intptr_t i = 0; i < kLoopCount; i++) {
+    StackZone zone(isolate);
+    MessageWriter writer(&buffer, &malloc_allocator, true);
+    writer.WriteMessage(typed_data);
+    Message* message = new Message(Message::kIllegalPort,
+                                   buffer,
+                                   writer.BytesWritten(),
+                                   Message::kNormalPriority);
+
+    // Read object back from the message, as the receiving isolate does.
+    SnapshotReader reader(message->data(), message->len(), Snapshot::kMessage,
+                          isolate, zone.GetZone());
+    reader.set_adoptable_message(message);
+    reader.ReadObject();
+    delete message;
+  }
+  timer.Stop();
+  int64_t elapsed_time = timer.TotalElapsedTime();
+  benchmark->set_score(elapsed_time);
+}
+
+
+// Counts messages on the thread pool and stops after the expected number.
+class FanInMessageHandler : public MessageHandler {
+ public:
+  explicit FanInMessageHandler(intptr_t expected)
+      : expected_(expected), count_(0), done_(false) { }
+
+  virtual bool HandleMessage(Message* message) {
+    delete message;
+    return ++count_ < expected_;
+  }
+
+  static void End(CallbackData data) {
+    FanInMessageHandler* handler = reinterpret_cast<FanInMessageHandler*>(data);
+    MonitorLocker ml(&handler->done_monitor_);
+    handler->done_ = true;
+    ml.Notify();
+  }
+
+  void WaitUntilDone() {
+    MonitorLocker ml(&done_monitor_);
+    while (!done_) {
+      ml.Wait();
+    }
+  }
+
+ private:
+  const intptr_t expected_;
+  intptr_t count_;
+  Monitor done_monitor_;
+  bool done_;
+};
+
+
+struct FanInProducerInfo {
+  Dart_Port port;
+  intptr_t count;
+};
+
+
+static void PostFanInMessages(uword param) {
+  FanInProducerInfo* info = reinterpret_cast<FanInProducerInfo*>(param);
+  for (intptr_t i = 0; i < info->count; i++) {
+    PortMap::PostMessage(
+        new Message(info->port, NULL, 0, Message::kNormalPriority));
+  }
+}
+
+
+//
+// Measure the throughput of many threads posting messages to one handler.
+//
+BENCHMARK(MessageFanIn) {
+  const intptr_t kNumProducers = 8;
+  const intptr_t kMessagesPerProducer = 100000;
+  ThreadPool pool;
+  FanInMessageHandler handler(kNumProducers * kMessagesPerProducer);
+  Dart_Port port = PortMap::CreatePort(&handler);
+  PortMap::SetPortState(port, PortMap::kLivePort);
+  handler.Run(&pool, NULL, FanInMessageHandler::End,
+              reinterpret_cast<uword>(&handler));
+  FanInProducerInfo info;
+  info.port = port;
+  info.count = kMessagesPerProducer;
+  Timer timer(true, "Message Fan In");
+  timer.Start();
+  for (intptr_t i = 0; i < kNumProducers; i++) {
+    int result = OSThread::Start(PostFanInMessages,
+                                 reinterpret_cast<uword>(&info));
+    EXPECT_EQ(0, result);
+  }
+  handler.WaitUntilDone();
+  timer.Stop();
+  PortMap::ClosePorts(&handler);
+  int64_t elapsed_time = timer.TotalElapsedTime();
+  benchmark->set_score(elapsed_time);
+}
+
+
+// Answers every message it receives with a message to its peer, until it has
+// sent the given number of messages.
+class PingPongMessageHandler : public FanInMessageHandler {
+ public:
+  PingPongMessageHandler(intptr_t expected, intptr_t sends)
+      : FanInMessageHandler(expected), sends_(sends), peer_(ILLEGAL_PORT) { }
+
+  void set_peer(Dart_Port peer) { peer_ = peer; }
+
+  virtual bool HandleMessage(Message* message) {
+    if (sends_ > 0) {
+      sends_--;
+      PortMap::PostMessage(
+          new Message(peer_, NULL, 0, Message::kNormalPriority));
+    }
+    return FanInMessageHandler::HandleMessage(message);
+  }
+
+ private:
+  intptr_t sends_;
+  Dart_Port peer_;
+};
+
+
+//
+// Measure the throughput of many pairs of handlers exchanging messages on one
+// thread pool, as isolates sending each other messages do.
+//
+BENCHMARK(MessagePingPong) {
+  const intptr_t kNumPairs = 8;
+  const intptr_t kRoundTrips = 20000;
+  ThreadPool pool;
+  PingPongMessageHandler* handlers[2 * kNumPairs];
+  Dart_Port ports[2 * kNumPairs];
+  for (intptr_t i = 0; i < 2 * kNumPairs; i++) {
+    // The first handler of a pair receives the message that starts the game.
+    const bool is_first = (i % 2) == 0;
+    handlers[i] = new PingPongMessageHandler(
+        kRoundTrips, is_first ? kRoundTrips : kRoundTrips - 1);
+    ports[i] = PortMap::CreatePort(handlers[i]);
+    PortMap::SetPortState(ports[i], PortMap::kLivePort);
+  }
+  for (intptr_t i = 0; i < 2 * kNumPairs; i++) {
+    handlers[i]->set_peer(ports[i ^ 1]);
+    handlers[i]->Run(&pool, NULL, FanInMessageHandler::End,
+                     reinterpret_cast<uword>(handlers[i]));
+  }
+  Timer timer(true, "Message Ping Pong");
+  timer.Start();
+  for (intptr_t i = 0; i < kNumPairs; i++) {
+    PortMap::PostMessage(
+        new Message(ports[2 * i], NULL, 0, Message::kNormalPriority));
+  }
+  for (intptr_t i = 0; i < 2 * kNumPairs; i++) {
+    handlers[i]->WaitUntilDone();
+  }
+  timer.Stop();
+  for (intptr_t i = 0; i < 2 * kNumPairs; i++) {
+    PortMap::ClosePorts(handlers[i]);
+    delete handlers[i];
+  }
+  int64_t elapsed_time = timer.TotalElapsedTime();
+  benchmark->set_score(elapsed_time);
+}
+
+
+//
+// Measure the time of a full collection with a large live heap, backed by small
+// or huge pages.
+//
+static void GCThroughput(Benchmark* benchmark, bool huge_pages) {
+  const char* kScriptChars =
+      "class Node {\n"
+      "  var left, right;\n"
+      "  Node(this.left, this.right);\n"
+      "}\n"
+      "build(depth) => (depth == 0)\n"
+      "    ? new Node(null, null)\n"
+      "    : new Node(build(depth - 1), build(depth - 1));\n"
+      "var tree;\n"
+      "main() {\n"
+      "  tree = build(18);\n"
+      "}\n";
+  const bool saved_huge_pages = FLAG_huge_pages;
+  FLAG_huge_pages = huge_pages;
+  // New pages and semispaces must not come from a pool filled in other mode.
+  PagePool::Trim(0);
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  Dart_Handle result = Dart_Invoke(lib, NewString("main"), 0, NULL);
+  EXPECT_VALID(result);
+  Heap* heap = benchmark->isolate()->heap();
+  const intptr_t kNumCollections = 10;
+  Timer timer(true, "GCThroughput benchmark");
+  timer.Start();
+  for (intptr_t i = 0; i < kNumCollections; i++) {
+    heap->CollectAllGarbage();
+  }
+  timer.Stop();
+  FLAG_huge_pages = saved_huge_pages;
+  PagePool::Trim(0);
+  benchmark->set_score(timer.TotalElapsedTime() / kNumCollections);
+}
+
+
+BENCHMARK(GCThroughputSmallPages) {
+  GCThroughput(benchmark, false);
+}
+
+
+BENCHMARK(GCThroughputHugePages) {
+  GCThroughput(benchmark, true);
+}
+
+
+//
+// Measure the time of a full collection with a 1M-entry Expando whose keys are
+// only reachable through the values of other entries.
+//
+BENCHMARK(Expando1M) {
+  const char* kScriptChars =
+      "var expando = new Expando();\n"
+      "var head;\n"
+      "main() {\n"
+      "  head = new Object();\n"
+      "  var key = head;\n"
+      "  for (var i = 0; i < 1000000; i++) {\n"
+      "    var next = new Object();\n"
+      "    expando[key] = next;\n"
+      "    key = next;\n"
+      "  }\n"
+      "}\n"
+      "check() {\n"
+      "  var length = 0;\n"
+      "  for (var key = expando[head]; key != null; key = expando[key]) {\n"
+      "    length++;\n"
+      "  }\n"
+      "  return length;\n"
+      "}\n";
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  EXPECT_VALID(Dart_Invoke(lib, NewString("main"), 0, NULL));
+  Heap* heap = benchmark->isolate()->heap();
+  const intptr_t kNumCollections = 5;
+  Timer timer(true, "Expando1M benchmark");
+  timer.Start();
+  for (intptr_t i = 0; i < kNumCollections; i++) {
+    heap->CollectAllGarbage();
+  }
+  timer.Stop();
+  Dart_Handle result = Dart_Invoke(lib, NewString("check"), 0, NULL);
+  EXPECT_VALID(result);
+  int64_t length = 0;
+  EXPECT_VALID(Dart_IntegerToInt64(result, &length));
+  EXPECT_EQ(1000000, length);
+  benchmark->set_score(timer.TotalElapsedTime() / kNumCollections);
+}
+
 }  // namespace dart
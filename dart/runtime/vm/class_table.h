@@ -196,6 +196,7 @@ class ClassTable {
 
  private:
   friend class MarkingVisitor;
+  friend class ParallelScavengerVisitor;
   friend class ScavengerVisitor;
   friend class ClassHeapStatsTestHelper;
   static const int initial_capacity_ = 512;
@@ -98,13 +98,34 @@ DEFINE_RUNTIME_ENTRY(TraceFunctionExit, 1) {
 }
 
 
-// Allocation of a fixed length array of given element type.
-// This runtime entry is never called for allocating a List of a generic type,
-// because a prior run time call instantiates the element type if necessary.
-// Arg0: array length.
-// Arg1: array type arguments, i.e. vector of 1 type, the element type.
-// Return value: newly allocated array of length arg0.
-DEFINE_RUNTIME_ENTRY(AllocateArray, 2) {
+// Takes the allocation sample of a new object allocated by unoptimized code,
+// if it is one, so that the survival of the object is fed back to its
+// allocation site.
+static void SampleAllocationSite(Isolate* isolate, const Instance& instance) {
+  Heap* heap = isolate->heap();
+  if (!heap->TakeAllocationSample(instance.raw())) {
+    return;
+  }
+  DartFrameIterator iterator;
+  StackFrame* caller_frame = iterator.NextFrame();
+  ASSERT(caller_frame != NULL);
+  const Code& code = Code::Handle(isolate, caller_frame->LookupDartCode());
+  // Token positions of optimized code may belong to inlined functions.
+  if (code.is_optimized()) {
+    return;
+  }
+  const intptr_t token_pos = caller_frame->GetTokenPos();
+  if (token_pos < 0) {
+    return;
+  }
+  const Function& function = Function::Handle(isolate, code.function());
+  heap->AddAllocationSample(instance.raw(), function, token_pos);
+}
+
+
+static void AllocateArray(Isolate* isolate,
+                          NativeArguments arguments,
+                          Heap::Space space) {
   const Instance& length = Instance::CheckedHandle(arguments.ArgAt(0));
   if (!length.IsSmi()) {
     const String& error = String::Handle(String::NewFormatted(
@@ -120,7 +141,6 @@ DEFINE_RUNTIME_ENTRY(AllocateArray, 2) {
     Exceptions::ThrowArgumentError(error);
   }
 
-  Heap::Space space = isolate->heap()->SpaceForAllocation(kArrayCid);
   const Array& array = Array::Handle(Array::New(len, space));
   arguments.SetReturn(array);
   TypeArguments& element_type =
@@ -131,6 +151,27 @@ DEFINE_RUNTIME_ENTRY(AllocateArray, 2) {
   ASSERT(element_type.IsNull() ||
          ((element_type.Length() >= 1) && element_type.IsInstantiated()));
   array.SetTypeArguments(element_type);  // May be null.
+  SampleAllocationSite(isolate, array);
+}
+
+
+// Allocation of a fixed length array of given element type.
+// This runtime entry is never called for allocating a List of a generic type,
+// because a prior run time call instantiates the element type if necessary.
+// Arg0: array length.
+// Arg1: array type arguments, i.e. vector of 1 type, the element type.
+// Return value: newly allocated array of length arg0.
+DEFINE_RUNTIME_ENTRY(AllocateArray, 2) {
+  AllocateArray(isolate,
+                arguments,
+                isolate->heap()->SpaceForAllocation(kArrayCid));
+}
+
+
+// Allocation of an array for an allocation site pretenured by optimized code.
+// Arguments and return value as for AllocateArray.
+DEFINE_RUNTIME_ENTRY(AllocateArrayPretenured, 2) {
+  AllocateArray(isolate, arguments, Heap::kPretenured);
 }
 
 
@@ -143,11 +184,9 @@ static intptr_t GetCallerLocation() {
 }
 
 
-// Allocate a new object.
-// Arg0: class of the object that needs to be allocated.
-// Arg1: type arguments of the object that needs to be allocated.
-// Return value: newly allocated object.
-DEFINE_RUNTIME_ENTRY(AllocateObject, 2) {
+static void AllocateObject(Isolate* isolate,
+                           NativeArguments arguments,
+                           Heap::Space space) {
   const Class& cls = Class::CheckedHandle(arguments.ArgAt(0));
 
 #ifdef DEBUG
@@ -160,10 +199,10 @@ DEFINE_RUNTIME_ENTRY(AllocateObject, 2) {
     }
   }
 #endif
-  Heap::Space space = isolate->heap()->SpaceForAllocation(cls.id());
   const Instance& instance = Instance::Handle(Instance::New(cls, space));
 
   arguments.SetReturn(instance);
+  SampleAllocationSite(isolate, instance);
   if (cls.NumTypeArguments() == 0) {
     // No type arguments required for a non-parameterized type.
     ASSERT(Instance::CheckedHandle(arguments.ArgAt(1)).IsNull());
@@ -181,6 +220,25 @@ DEFINE_RUNTIME_ENTRY(AllocateObject, 2) {
 }
 
 
+// Allocate a new object.
+// Arg0: class of the object that needs to be allocated.
+// Arg1: type arguments of the object that needs to be allocated.
+// Return value: newly allocated object.
+DEFINE_RUNTIME_ENTRY(AllocateObject, 2) {
+  const Class& cls = Class::CheckedHandle(arguments.ArgAt(0));
+  AllocateObject(isolate,
+                 arguments,
+                 isolate->heap()->SpaceForAllocation(cls.id()));
+}
+
+
+// Allocation of an object for an allocation site pretenured by optimized code.
+// Arguments and return value as for AllocateObject.
+DEFINE_RUNTIME_ENTRY(AllocateObjectPretenured, 2) {
+  AllocateObject(isolate, arguments, Heap::kPretenured);
+}
+
+
 // Instantiate type.
 // Arg0: uninstantiated type.
 // Arg1: instantiator type arguments.
@@ -17,8 +17,10 @@ class Instance;
 
 // Declaration of runtime entries called from stub or generated code.
 DECLARE_RUNTIME_ENTRY(AllocateArray);
+DECLARE_RUNTIME_ENTRY(AllocateArrayPretenured);
 DECLARE_RUNTIME_ENTRY(AllocateContext);
 DECLARE_RUNTIME_ENTRY(AllocateObject);
+DECLARE_RUNTIME_ENTRY(AllocateObjectPretenured);
 DECLARE_RUNTIME_ENTRY(BreakpointRuntimeHandler);
 DECLARE_RUNTIME_ENTRY(SingleStepHandler);
 DECLARE_RUNTIME_ENTRY(CloneContext);
@@ -688,6 +688,12 @@ static bool CompileParsedFunctionHelper(CompilationPipeline* pipeline,
           sinking->DetachMaterializations();
         }
 
+        // Allocate the objects of sites with mostly long-lived objects in old
+        // space.
+        if (FlowGraphCompiler::SupportsSitePretenuring()) {
+          optimizer.PretenureAllocationSites(inline_id_to_function);
+        }
+
         // Compute and store graph informations (call & instruction counts)
         // to be later used by the inliner.
         FlowGraphInliner::CollectGraphInfo(flow_graph, true);
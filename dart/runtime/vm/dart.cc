@@ -14,10 +14,12 @@
 #include "vm/handles.h"
 #include "vm/heap.h"
 #include "vm/isolate.h"
+#include "vm/isolate_template.h"
 #include "vm/metrics.h"
 #include "vm/object.h"
 #include "vm/object_store.h"
 #include "vm/object_id_ring.h"
+#include "vm/page_pool.h"
 #include "vm/port.h"
 #include "vm/profiler.h"
 #include "vm/service_isolate.h"
@@ -43,6 +45,9 @@ DEFINE_FLAG(int, external_max_size, (kWordSize <= 4) ? 512 : 1024,
 
 DEFINE_FLAG(bool, keep_code, false,
             "Keep deoptimized code for profiling.");
+DEFINE_FLAG(bool, isolate_templates, true,
+            "Clone isolates from the template of their snapshot, if the "
+            "snapshot has been registered for one.");
 
 DECLARE_FLAG(bool, print_class_table);
 DECLARE_FLAG(bool, trace_isolates);
@@ -101,8 +106,9 @@ const char* Dart::InitOnce(const uint8_t* vm_isolate_snapshot,
   CodeObservers::InitOnce();
   ThreadInterrupter::InitOnce();
   Profiler::InitOnce();
-  SemiSpace::InitOnce();
+  PagePool::InitOnce();
   Metric::InitOnce();
+  IsolateTemplate::InitOnce();
 
 #if defined(USING_SIMULATOR)
   Simulator::InitOnce();
@@ -194,6 +200,8 @@ const char* Dart::Cleanup() {
 
   Profiler::Shutdown();
   CodeObservers::DeleteAll();
+  IsolateTemplate::Cleanup();
+  PagePool::Trim(0);
 
   return NULL;
 }
@@ -224,11 +232,20 @@ RawError* Dart::InitializeIsolate(const uint8_t* snapshot_buffer, void* data) {
   // Setup for profiling.
   Profiler::InitProfilingForIsolate(isolate);
 
+  bool capture = false;
+  const IsolateTemplate* isolate_template = NULL;
+  if ((snapshot_buffer != NULL) && FLAG_isolate_templates) {
+    isolate_template = IsolateTemplate::Lookup(snapshot_buffer, &capture);
+  }
   if (snapshot_buffer == NULL) {
     const Error& error = Error::Handle(Object::Init(isolate));
     if (!error.IsNull()) {
       return error.raw();
     }
+  } else if (isolate_template != NULL) {
+    // The template holds the heap of an isolate which has just been read
+    // from the snapshot, see below.
+    isolate_template->InitializeIsolate(isolate);
   } else {
     // Initialize from snapshot (this should replicate the functionality
     // of Object::Init(..) in a regular isolate creation path.
@@ -255,6 +272,9 @@ RawError* Dart::InitializeIsolate(const uint8_t* snapshot_buffer, void* data) {
       isolate->heap()->PrintSizes();
       isolate->megamorphic_cache_table()->PrintSizes();
     }
+    if (capture) {
+      IsolateTemplate::Capture(snapshot_buffer, isolate);
+    }
   }
 
   Object::VerifyBuiltinVtables();
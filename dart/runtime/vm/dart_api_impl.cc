@@ -19,6 +19,8 @@
 #include "vm/exceptions.h"
 #include "vm/flags.h"
 #include "vm/growable_array.h"
+#include "vm/isolate_group.h"
+#include "vm/isolate_template.h"
 #include "vm/lockers.h"
 #include "vm/message.h"
 #include "vm/message_handler.h"
@@ -47,6 +49,9 @@ DECLARE_FLAG(bool, print_class_table);
 DECLARE_FLAG(bool, verify_handles);
 DEFINE_FLAG(bool, check_function_fingerprints, false,
             "Check function fingerprints");
+DEFINE_FLAG(bool, isolate_group_snapshots, false,
+            "Load isolates spawned from a function from a script snapshot of "
+            "the program their isolate group keeps.");
 DEFINE_FLAG(bool, trace_api, false,
             "Trace invocation of API calls (debug mode only)");
 DEFINE_FLAG(bool, verify_acquired_data, false,
@@ -1193,6 +1198,13 @@ DART_EXPORT Dart_Handle Dart_VisitPrologueWeakHandles(
 }
 
 
+DART_EXPORT void Dart_NotifyIdle(int64_t deadline) {
+  Isolate* isolate = Isolate::Current();
+  CHECK_ISOLATE(isolate);
+  isolate->heap()->NotifyIdle(deadline);
+}
+
+
 // --- Initialization and Globals ---
 
 DART_EXPORT const char* Dart_VersionString() {
@@ -1310,6 +1322,14 @@ DART_EXPORT Dart_Isolate Dart_CreateIsolate(const char* script_uri,
 }
 
 
+DART_EXPORT void Dart_RegisterIsolateTemplate(const uint8_t* snapshot) {
+  if (snapshot == NULL) {
+    FATAL1("%s expects argument 'snapshot' to be non-null.", CURRENT_FUNC);
+  }
+  IsolateTemplate::Register(snapshot);
+}
+
+
 DART_EXPORT void Dart_ShutdownIsolate() {
   Isolate* isolate = Isolate::Current();
   CHECK_ISOLATE(isolate);
@@ -1494,6 +1514,59 @@ DART_EXPORT void Dart_InterruptIsolate(Dart_Isolate isolate) {
 }
 
 
+static uint8_t* MallocReallocate(uint8_t* ptr,
+                                 intptr_t old_size,
+                                 intptr_t new_size) {
+  return reinterpret_cast<uint8_t*>(realloc(ptr, new_size));
+}
+
+
+// Whether a library of the program, as opposed to one read from the full
+// snapshot, has a native resolver. A script snapshot does not carry native
+// resolvers, and a member loaded from it never calls the library tag handler,
+// which sets them up for 'dart-ext:' imports.
+static bool HasProgramNativeResolver(Isolate* isolate) {
+  const GrowableObjectArray& libs = GrowableObjectArray::Handle(
+      isolate, isolate->object_store()->libraries());
+  Library& lib = Library::Handle(isolate);
+  for (intptr_t i = 0; i < libs.Length(); i++) {
+    lib ^= libs.At(i);
+    if (!lib.raw()->IsCreatedFromSnapshot() &&
+        (lib.native_entry_resolver() != NULL)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// Takes the script snapshot the group of 'isolate' asked for. The isolate has
+// loaded its program and not run any Dart code yet, as when the standalone
+// embedder writes a script snapshot.
+static void TakeIsolateGroupSnapshot(Isolate* isolate) {
+  uint8_t* buffer = NULL;
+  intptr_t size = 0;
+  {
+    StartIsolateScope start_scope(isolate);
+    StackZone zone(isolate);
+    HANDLESCOPE(isolate);
+    const Library& core_lib = Library::Handle(isolate, Library::CoreLibrary());
+    const Library& library =
+        Library::Handle(isolate, isolate->object_store()->root_library());
+    // A script snapshot leaves out what was read from the full snapshot, so
+    // without one it would hold the core libraries as well.
+    if (core_lib.raw()->IsCreatedFromSnapshot() &&
+        ClassFinalizer::AllClassesFinalized() &&
+        !HasProgramNativeResolver(isolate)) {
+      ScriptSnapshotWriter writer(&buffer, &MallocReallocate);
+      writer.WriteScriptSnapshot(library);
+      size = writer.BytesWritten();
+    }
+  }
+  isolate->group()->SetScriptSnapshot(buffer, size);
+}
+
+
 DART_EXPORT bool Dart_IsolateMakeRunnable(Dart_Isolate isolate) {
   CHECK_NO_ISOLATE(Isolate::Current());
   if (isolate == NULL) {
@@ -1505,6 +1578,9 @@ DART_EXPORT bool Dart_IsolateMakeRunnable(Dart_Isolate isolate) {
     // The embedder should have called Dart_LoadScript by now.
     return false;
   }
+  if (iso->group()->WantsScriptSnapshot()) {
+    TakeIsolateGroupSnapshot(iso);
+  }
   return iso->MakeRunnable();
 }
 
@@ -5088,6 +5164,24 @@ DART_EXPORT Dart_Handle Dart_LoadScriptFromSnapshot(const uint8_t* buffer,
 }
 
 
+DART_EXPORT Dart_Handle Dart_LoadScriptFromIsolateGroup() {
+  Isolate* isolate = Isolate::Current();
+  CHECK_ISOLATE(isolate);
+  if (!FLAG_isolate_group_snapshots) {
+    return Api::Null();
+  }
+  IsolateGroup* group = isolate->group();
+  intptr_t size = 0;
+  const uint8_t* buffer = group->ScriptSnapshot(&size);
+  if (buffer == NULL) {
+    // Have the snapshot taken once this isolate is loaded.
+    group->RequestScriptSnapshot();
+    return Api::Null();
+  }
+  return Dart_LoadScriptFromSnapshot(buffer, size);
+}
+
+
 DART_EXPORT Dart_Handle Dart_RootLibrary() {
   Isolate* isolate = Isolate::Current();
   CHECK_ISOLATE(isolate);
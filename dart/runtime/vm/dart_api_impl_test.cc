@@ -7299,6 +7299,80 @@ UNIT_TEST_CASE(NewNativePort) {
 }
 
 
+void NewNativeStreamPort_reply(Dart_Port dest_port_id,
+                               Dart_MessageReader reader) {
+  // Gets [replyPort, string, [ints]].
+  intptr_t length = 0;
+  EXPECT(Dart_MessageReaderBeginArray(reader, &length));
+  EXPECT_EQ(3, length);
+  Dart_Port reply_port = ILLEGAL_PORT;
+  EXPECT(Dart_MessageReaderReadSendPort(reader, &reply_port));
+  const char* str = NULL;
+  EXPECT(Dart_MessageReaderReadString(reader, &str, &length));
+  char* copy = strdup(str);
+  int64_t sum = 0;
+  EXPECT(Dart_MessageReaderBeginArray(reader, &length));
+  for (intptr_t i = 0; i < length; i++) {
+    int64_t value = 0;
+    EXPECT(Dart_MessageReaderReadInt64(reader, &value));
+    sum += value;
+  }
+  EXPECT(Dart_MessageReaderEndArray(reader));
+  EXPECT(Dart_MessageReaderEndArray(reader));
+
+  // Post [string, sum].
+  Dart_MessageBuilder builder = Dart_NewMessageBuilder();
+  EXPECT(Dart_MessageBuilderBeginArray(builder, 2));
+  EXPECT(Dart_MessageBuilderAddString(builder, copy));
+  EXPECT(Dart_MessageBuilderAddInt64(builder, sum));
+  EXPECT(Dart_MessageBuilderEndArray(builder));
+  EXPECT(Dart_PostMessageBuilder(reply_port, builder));
+  Dart_DeleteMessageBuilder(builder);
+  free(copy);
+}
+
+
+UNIT_TEST_CASE(NewNativeStreamPort) {
+  // Create a port with a bogus handler.
+  Dart_Port error_port = Dart_NewNativeStreamPort("Foo", NULL, true);
+  EXPECT_EQ(ILLEGAL_PORT, error_port);
+
+  Dart_Port port_id =
+      Dart_NewNativeStreamPort("Reply", NewNativeStreamPort_reply, true);
+
+  TestIsolateScope __test_isolate__;
+  const char* kScriptChars =
+      "import 'dart:isolate';\n"
+      "void callPort(SendPort port) {\n"
+      "  var receivePort = new RawReceivePort();\n"
+      "  var replyPort = receivePort.sendPort;\n"
+      "  port.send([replyPort, 'sum', [1, 2, 3]]);\n"
+      "  receivePort.handler = (message) {\n"
+      "    receivePort.close();\n"
+      "    throw new Exception(message);\n"
+      "  };\n"
+      "}\n";
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  Dart_EnterScope();
+
+  Dart_Handle send_port = Dart_NewSendPort(port_id);
+  EXPECT_VALID(send_port);
+  Dart_Handle dart_args[1];
+  dart_args[0] = send_port;
+  Dart_Handle result =
+      Dart_Invoke(lib, NewString("callPort"), 1, dart_args);
+  EXPECT_VALID(result);
+  result = Dart_RunLoop();
+  EXPECT(Dart_IsError(result));
+  EXPECT(Dart_ErrorHasException(result));
+  EXPECT_SUBSTRING("Exception: [sum, 6]\n", Dart_GetError(result));
+
+  Dart_ExitScope();
+
+  EXPECT(Dart_CloseNativePort(port_id));
+}
+
+
 static Dart_Isolate RunLoopTestCallback(const char* script_name,
                                         const char* main,
                                         const char* package_root,
@@ -1229,4 +1229,1126 @@ bool ApiMessageWriter::WriteCMessage(Dart_CObject* object) {
   return true;
 }
 
+
+static uint8_t* malloc_allocator(uint8_t* ptr,
+                                 intptr_t old_size,
+                                 intptr_t new_size) {
+  void* new_ptr = realloc(reinterpret_cast<void*>(ptr), new_size);
+  return reinterpret_cast<uint8_t*>(new_ptr);
+}
+
+
+static void WriteInlinedObjectHeader(WriteStream* stream, intptr_t id) {
+  ASSERT(id <= kMaxObjectId);
+  intptr_t value = 0;
+  value = SerializedHeaderTag::update(kInlined, value);
+  value = SerializedHeaderData::update(id, value);
+  WriteStream::Raw<sizeof(int32_t), int32_t>::Write(stream, value);
+}
+
+
+// The elements of an array, or the message itself for the root segment.
+class ApiMessageBuilder::Segment {
+ public:
+  static const intptr_t kInitialSize = 256;
+
+  Segment()
+      : buffer_(NULL),
+        stream_(&buffer_, malloc_allocator, kInitialSize),
+        length_(0),
+        count_(0),
+        object_count_(0),
+        base_id_(0),
+        id_(0),
+        children_(4) {
+  }
+
+  ~Segment() {
+    free(buffer_);
+  }
+
+  void Reset() {
+    stream_.set_current(stream_.buffer());
+    length_ = 0;
+    count_ = 0;
+    object_count_ = 0;
+    base_id_ = 0;
+    id_ = 0;
+    children_.Clear();
+  }
+
+  template <typename T>
+  void Write(T value) {
+    WriteStream::Raw<sizeof(T), T>::Write(&stream_, value);
+  }
+
+  void WriteBytes(const uint8_t* addr, intptr_t len) {
+    stream_.WriteBytes(addr, len);
+  }
+
+  void WriteSmi(int64_t value) {
+    ASSERT(Smi::IsValid(value));
+    Write<RawObject*>(Smi::New(static_cast<intptr_t>(value)));
+  }
+
+  void WriteIndexedObject(intptr_t object_id) {
+    intptr_t value = 0;
+    value = SerializedHeaderTag::update(kObjectId, value);
+    value = SerializedHeaderData::update(object_id, value);
+    Write<int32_t>(value);
+  }
+
+  void WriteVMIsolateObject(intptr_t object_id) {
+    intptr_t value = 0;
+    value = SerializedHeaderTag::update(kObjectId, value);
+    value = SerializedHeaderData::update(object_id, value);
+    Write<int32_t>(-value);  // Write as a negative value.
+  }
+
+  void WriteTags(intptr_t tags) {
+    Write<int8_t>(static_cast<int8_t>(tags & 0xff));
+  }
+
+  // Writes the header of an object which takes an object id. The id is
+  // omitted, as it follows from the order in which the objects are read.
+  void WriteObjectHeader() {
+    WriteInlinedObjectHeader(&stream_, kOmittedObjectId);
+    object_count_++;
+  }
+
+  // Writes a reference to a nested array, whose elements are written to
+  // 'body'.
+  void WriteArrayRef(Segment* body, intptr_t length) {
+    Child child = { object_count_, body };
+    children_.Add(child);
+    WriteObjectHeader();
+    WriteIndexedObject(kArrayCid);
+    WriteSmi(length);
+  }
+
+  void WriteArrayBody(intptr_t length) {
+    WriteIndexedObject(kArrayCid);
+    WriteTags(0);
+    WriteSmi(length);
+    // The type arguments.
+    WriteVMIsolateObject(kNullObject);
+    length_ = length;
+    count_ = 0;
+  }
+
+  const uint8_t* buffer() const { return stream_.buffer(); }
+  intptr_t bytes_written() const { return stream_.bytes_written(); }
+
+ private:
+  friend class ApiMessageBuilder;
+
+  struct Child {
+    intptr_t index;  // Among the objects of the segment which take an id.
+    Segment* segment;
+  };
+
+  uint8_t* buffer_;
+  WriteStream stream_;
+  intptr_t length_;  // Of the array.
+  intptr_t count_;  // The elements added so far.
+  intptr_t object_count_;  // The objects written which take an id.
+  intptr_t base_id_;  // The id of the first of those objects.
+  intptr_t id_;  // The id of the array.
+  MallocGrowableArray<Child> children_;
+
+  DISALLOW_COPY_AND_ASSIGN(Segment);
+};
+
+
+ApiMessageBuilder::ApiMessageBuilder()
+    : root_(NULL),
+      open_arrays_(4),
+      segments_(4),
+      free_segments_(4),
+      complete_(false),
+      failed_(false) {
+  root_ = NewSegment();
+}
+
+
+ApiMessageBuilder::~ApiMessageBuilder() {
+  for (intptr_t i = 0; i < segments_.length(); i++) {
+    delete segments_[i];
+  }
+  for (intptr_t i = 0; i < free_segments_.length(); i++) {
+    delete free_segments_[i];
+  }
+}
+
+
+ApiMessageBuilder::Segment* ApiMessageBuilder::NewSegment() {
+  Segment* segment =
+      free_segments_.is_empty() ? new Segment() : free_segments_.RemoveLast();
+  segments_.Add(segment);
+  return segment;
+}
+
+
+ApiMessageBuilder::Segment* ApiMessageBuilder::NextValue() {
+  if (failed_) {
+    return NULL;
+  }
+  if (open_arrays_.is_empty()) {
+    if (complete_) {
+      return NULL;
+    }
+    complete_ = true;
+    return root_;
+  }
+  Segment* array = open_arrays_.Last();
+  if (array->count_ == array->length_) {
+    return NULL;
+  }
+  array->count_++;
+  return array;
+}
+
+
+bool ApiMessageBuilder::Fail() {
+  failed_ = true;
+  return false;
+}
+
+
+bool ApiMessageBuilder::AddNull() {
+  Segment* segment = NextValue();
+  if (segment == NULL) {
+    return Fail();
+  }
+  segment->WriteVMIsolateObject(kNullObject);
+  return true;
+}
+
+
+bool ApiMessageBuilder::AddBool(bool value) {
+  Segment* segment = NextValue();
+  if (segment == NULL) {
+    return Fail();
+  }
+  segment->WriteVMIsolateObject(value ? kTrueValue : kFalseValue);
+  return true;
+}
+
+
+bool ApiMessageBuilder::AddInt64(int64_t value) {
+  Segment* segment = NextValue();
+  if (segment == NULL) {
+    return Fail();
+  }
+  if (Smi::IsValid(value)) {
+    segment->WriteSmi(value);
+  } else {
+    segment->WriteObjectHeader();
+    segment->WriteIndexedObject(kMintCid);
+    segment->WriteTags(0);
+    segment->Write<int64_t>(value);
+  }
+  return true;
+}
+
+
+bool ApiMessageBuilder::AddDouble(double value) {
+  Segment* segment = NextValue();
+  if (segment == NULL) {
+    return Fail();
+  }
+  segment->WriteVMIsolateObject(kDoubleObject);
+  segment->WriteBytes(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+  return true;
+}
+
+
+bool ApiMessageBuilder::AddString(const char* value) {
+  if (value == NULL) {
+    return Fail();
+  }
+  const uint8_t* utf8_str = reinterpret_cast<const uint8_t*>(value);
+  intptr_t utf8_len = strlen(value);
+  bool is_ascii = true;
+  for (intptr_t i = 0; i < utf8_len; i++) {
+    if (utf8_str[i] > Utf8::kMaxOneByteChar) {
+      is_ascii = false;
+      break;
+    }
+  }
+  Utf8::Type type = Utf8::kLatin1;
+  intptr_t len = utf8_len;
+  if (!is_ascii) {
+    if (!Utf8::IsValid(utf8_str, utf8_len)) {
+      return Fail();
+    }
+    len = Utf8::CodeUnitCount(utf8_str, utf8_len, &type);
+  }
+  if (len > String::kMaxElements) {
+    return Fail();
+  }
+  Segment* segment = NextValue();
+  if (segment == NULL) {
+    return Fail();
+  }
+  segment->WriteObjectHeader();
+  segment->WriteIndexedObject(
+      (type == Utf8::kLatin1) ? kOneByteStringCid : kTwoByteStringCid);
+  segment->WriteTags(0);
+  segment->WriteSmi(len);
+  segment->WriteSmi(0);  // The hash, which the reader computes.
+  if (is_ascii) {
+    segment->WriteBytes(utf8_str, len);
+    return true;
+  }
+  // Decode the string as it is written, rather than into a copy.
+  intptr_t i = 0;
+  while (i < utf8_len) {
+    int32_t ch;
+    i += Utf8::Decode(&utf8_str[i], utf8_len - i, &ch);
+    if (type == Utf8::kLatin1) {
+      segment->Write<uint8_t>(ch);
+    } else if (Utf::IsSupplementary(ch)) {
+      uint16_t pair[2];
+      Utf16::Encode(ch, pair);
+      segment->Write<uint16_t>(pair[0]);
+      segment->Write<uint16_t>(pair[1]);
+    } else {
+      segment->Write<uint16_t>(ch);
+    }
+  }
+  return true;
+}
+
+
+bool ApiMessageBuilder::AddTypedData(Dart_TypedData_Type type,
+                                     const uint8_t* values,
+                                     intptr_t length) {
+  // The same types as Dart_PostCObject supports.
+  intptr_t class_id;
+  switch (type) {
+    case Dart_TypedData_kInt8:
+      class_id = kTypedDataInt8ArrayCid;
+      break;
+    case Dart_TypedData_kUint8:
+      class_id = kTypedDataUint8ArrayCid;
+      break;
+    case Dart_TypedData_kUint32:
+      class_id = kTypedDataUint32ArrayCid;
+      break;
+    default:
+      return Fail();
+  }
+  const intptr_t element_size = GetTypedDataSizeInBytes(type);
+  if ((length < 0) ||
+      ((length % element_size) != 0) ||
+      ((length > 0) && (values == NULL))) {
+    return Fail();
+  }
+  const intptr_t len = length / element_size;
+  if (len > TypedData::MaxElements(class_id)) {
+    return Fail();
+  }
+  Segment* segment = NextValue();
+  if (segment == NULL) {
+    return Fail();
+  }
+  segment->WriteObjectHeader();
+  segment->WriteIndexedObject(class_id);
+  segment->WriteTags(RawObject::ClassIdTag::update(class_id, 0));
+  segment->WriteSmi(len);
+  if (element_size == 1) {
+    segment->WriteBytes(values, len);
+  } else {
+    // The values need not be aligned.
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(values);
+    for (intptr_t i = 0; i < len; i++) {
+      segment->Write<uint32_t>(ReadUnaligned(&words[i]));
+    }
+  }
+  return true;
+}
+
+
+bool ApiMessageBuilder::BeginArray(intptr_t length) {
+  if ((length < 0) || (length > Array::kMaxElements)) {
+    return Fail();
+  }
+  const bool is_root = open_arrays_.is_empty();
+  Segment* segment = NextValue();
+  if (segment == NULL) {
+    return Fail();
+  }
+  Segment* body;
+  if (is_root) {
+    // The elements of the root array follow it.
+    segment->WriteObjectHeader();
+    body = segment;
+  } else {
+    body = NewSegment();
+    segment->WriteArrayRef(body, length);
+  }
+  body->WriteArrayBody(length);
+  open_arrays_.Add(body);
+  return true;
+}
+
+
+bool ApiMessageBuilder::EndArray() {
+  if (failed_ || open_arrays_.is_empty()) {
+    return Fail();
+  }
+  Segment* array = open_arrays_.Last();
+  if (array->count_ != array->length_) {
+    return Fail();
+  }
+  open_arrays_.RemoveLast();
+  return true;
+}
+
+
+bool ApiMessageBuilder::Finish(uint8_t** buffer, intptr_t* length) {
+  if (failed_ || !complete_ || !open_arrays_.is_empty()) {
+    Reset();
+    return false;
+  }
+  // The elements of a nested array are read after all objects with a
+  // smaller id, in the order of the ids of the arrays. Number the objects
+  // and order the segments breadth first, which reads them in that order.
+  intptr_t size = root_->bytes_written();
+  intptr_t next_id = root_->object_count_;
+  segments_.Clear();
+  segments_.Add(root_);
+  for (intptr_t i = 0; i < segments_.length(); i++) {
+    Segment* segment = segments_[i];
+    if (i > 0) {
+      segment->base_id_ = next_id;
+      next_id += segment->object_count_;
+    }
+    for (intptr_t j = 0; j < segment->children_.length(); j++) {
+      Segment* child = segment->children_[j].segment;
+      child->id_ = segment->base_id_ + segment->children_[j].index;
+      segments_.Add(child);
+      size += child->bytes_written() + sizeof(int32_t) + 1;
+    }
+  }
+  if ((kMaxPredefinedObjectIds + next_id) > kMaxObjectId) {
+    Reset();
+    return false;
+  }
+
+  uint8_t* result = NULL;
+  WriteStream stream(&result, malloc_allocator, size);
+  stream.WriteBytes(root_->buffer(), root_->bytes_written());
+  for (intptr_t i = 1; i < segments_.length(); i++) {
+    Segment* segment = segments_[i];
+    WriteInlinedObjectHeader(&stream, kMaxPredefinedObjectIds + segment->id_);
+    stream.WriteBytes(segment->buffer(), segment->bytes_written());
+  }
+  *buffer = result;
+  *length = stream.bytes_written();
+  Reset();
+  return true;
+}
+
+
+void ApiMessageBuilder::Reset() {
+  for (intptr_t i = 0; i < segments_.length(); i++) {
+    segments_[i]->Reset();
+    if (segments_[i] != root_) {
+      free_segments_.Add(segments_[i]);
+    }
+  }
+  segments_.Clear();
+  segments_.Add(root_);
+  open_arrays_.Clear();
+  complete_ = false;
+  failed_ = false;
+}
+
+
+static bool IsArrayClassId(intptr_t class_id) {
+  return (class_id == kArrayCid) || (class_id == kImmutableArrayCid);
+}
+
+
+static Dart_TypedData_Type GetTypedDataType(intptr_t class_id) {
+  switch (class_id) {
+    case kTypedDataInt8ArrayCid:
+    case kExternalTypedDataInt8ArrayCid:
+      return Dart_TypedData_kInt8;
+    case kTypedDataUint8ArrayCid:
+    case kExternalTypedDataUint8ArrayCid:
+      return Dart_TypedData_kUint8;
+    case kTypedDataUint8ClampedArrayCid:
+    case kExternalTypedDataUint8ClampedArrayCid:
+      return Dart_TypedData_kUint8Clamped;
+    case kTypedDataInt16ArrayCid:
+    case kExternalTypedDataInt16ArrayCid:
+      return Dart_TypedData_kInt16;
+    case kTypedDataUint16ArrayCid:
+    case kExternalTypedDataUint16ArrayCid:
+      return Dart_TypedData_kUint16;
+    case kTypedDataInt32ArrayCid:
+    case kExternalTypedDataInt32ArrayCid:
+      return Dart_TypedData_kInt32;
+    case kTypedDataUint32ArrayCid:
+    case kExternalTypedDataUint32ArrayCid:
+      return Dart_TypedData_kUint32;
+    case kTypedDataInt64ArrayCid:
+    case kExternalTypedDataInt64ArrayCid:
+      return Dart_TypedData_kInt64;
+    case kTypedDataUint64ArrayCid:
+    case kExternalTypedDataUint64ArrayCid:
+      return Dart_TypedData_kUint64;
+    case kTypedDataFloat32ArrayCid:
+    case kExternalTypedDataFloat32ArrayCid:
+      return Dart_TypedData_kFloat32;
+    case kTypedDataFloat64ArrayCid:
+    case kExternalTypedDataFloat64ArrayCid:
+      return Dart_TypedData_kFloat64;
+    default:
+      return Dart_TypedData_kInvalid;
+  }
+}
+
+
+// Negative header values are the ids of VM isolate objects.
+static intptr_t VMIsolateObjectId(intptr_t header) {
+  ASSERT(header < 0);
+  return SerializedHeaderData::decode(-header);
+}
+
+
+static intptr_t LookupClassId(intptr_t class_header) {
+  if (class_header < 0) {
+    return VMIsolateObjectId(class_header);
+  }
+  ASSERT(SerializedHeaderTag::decode(class_header) == kObjectId);
+  return SerializedHeaderData::decode(class_header);
+}
+
+
+static Dart_CObject_Type IntegerType(int64_t value) {
+  return ((kMinInt32 <= value) && (value <= kMaxInt32)) ? Dart_CObject_kInt32
+                                                        : Dart_CObject_kInt64;
+}
+
+
+ApiMessageStreamReader::ApiMessageStreamReader()
+    : buffer_(NULL),
+      length_(0),
+      stream_(NULL, 0),
+      valid_(false),
+      objects_(16),
+      frames_(8),
+      scratch_(NULL),
+      scratch_size_(0) {
+}
+
+
+ApiMessageStreamReader::~ApiMessageStreamReader() {
+  free(scratch_);
+}
+
+
+bool ApiMessageStreamReader::Reset(const uint8_t* buffer, intptr_t length) {
+  buffer_ = buffer;
+  length_ = length;
+  stream_.SetStream(buffer, length);
+  objects_.Clear();
+  frames_.Clear();
+  valid_ = (buffer != NULL) && (length > 0) && Index();
+  Frame message = { 0, 1, false, -1, 0 };
+  frames_.Add(message);
+  return valid_;
+}
+
+
+intptr_t ApiMessageStreamReader::ReadSmiValue() {
+  intptr_t value = Read<int32_t>();
+  ASSERT((value & kSmiTagMask) == kSmiTag);
+  return Smi::Value(reinterpret_cast<RawSmi*>(value));
+}
+
+
+bool ApiMessageStreamReader::Index() {
+  if (!Scan(false, true)) {
+    return false;
+  }
+  // Like ApiMessageReader::ReadObject, read the elements of the arrays which
+  // were only referenced, in the order of their ids.
+  for (intptr_t i = 0; i < objects_.length(); i++) {
+    if (objects_[i].body_offset != kBodyPending) {
+      continue;
+    }
+    if (stream_.PendingBytes() == 0) {
+      return false;
+    }
+    int64_t value64 = Read<int64_t>();
+    if (((value64 & kSmiTagMask) == kSmiTag) || (value64 < 0)) {
+      return false;
+    }
+    intptr_t value = static_cast<intptr_t>(value64);
+    if ((SerializedHeaderTag::decode(value) != kInlined) ||
+        (SerializedHeaderData::decode(value) !=
+         (i + kMaxPredefinedObjectIds))) {
+      return false;
+    }
+    objects_[i].body_offset = stream_.Position();
+    if (!IsArrayClassId(LookupClassId(Read<int32_t>()))) {
+      return false;
+    }
+    Read<int8_t>();  // Tags.
+    intptr_t len = ReadSmiValue();
+    if (!Scan(false, true)) {  // Type arguments.
+      return false;
+    }
+    for (intptr_t j = 0; j < len; j++) {
+      if (!Scan(true, true)) {
+        return false;
+      }
+    }
+  }
+  return stream_.PendingBytes() == 0;
+}
+
+
+bool ApiMessageStreamReader::Scan(bool refs, bool index) {
+  if (stream_.PendingBytes() == 0) {
+    return false;
+  }
+  const intptr_t header_offset = stream_.Position();
+  int64_t value64 = Read<int64_t>();
+  if ((value64 & kSmiTagMask) == kSmiTag) {
+    return true;
+  }
+  intptr_t value = static_cast<intptr_t>(value64);
+  if (value < 0) {
+    intptr_t object_id = VMIsolateObjectId(value);
+    if (object_id == kDoubleObject) {
+      stream_.Advance(sizeof(double));
+      return true;
+    }
+    return (object_id == kNullObject) ||
+        (object_id == kTrueValue) ||
+        (object_id == kFalseValue) ||
+        Symbols::IsVMSymbolId(object_id);
+  }
+  if (SerializedHeaderTag::decode(value) == kObjectId) {
+    // A type, or an object read before.
+    intptr_t object_id = SerializedHeaderData::decode(value);
+    return (object_id < kMaxPredefinedObjectIds) ||
+        ((object_id - kMaxPredefinedObjectIds) < objects_.length());
+  }
+  ASSERT(SerializedHeaderTag::decode(value) == kInlined);
+  const intptr_t class_offset = stream_.Position();
+  intptr_t class_header = Read<int32_t>();
+  if (SerializedHeaderData::decode(class_header) == kInstanceObjectId) {
+    return false;
+  }
+  intptr_t class_id = LookupClassId(class_header);
+  if (refs && IsArrayClassId(class_id)) {
+    // The elements are written later.
+    ReadSmiValue();
+    if (index) {
+      AddObject(header_offset, class_offset, true);
+    }
+    return true;
+  }
+  Read<int8_t>();  // Tags.
+  if (index) {
+    AddObject(header_offset, class_offset, false);
+  }
+  switch (class_id) {
+    case kArrayCid:
+    case kImmutableArrayCid: {
+      intptr_t len = ReadSmiValue();
+      if (!Scan(false, index)) {  // Type arguments.
+        return false;
+      }
+      for (intptr_t i = 0; i < len; i++) {
+        if (!Scan(true, index)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case kGrowableObjectArrayCid:
+      ReadSmiValue();
+      return Scan(false, index);
+    case kTypeArgumentsCid: {
+      int64_t len = Read<int64_t>();
+      if ((len & kSmiTagMask) != kSmiTag) {
+        return false;
+      }
+      len >>= kSmiTagShift;
+      for (int64_t i = 0; i < len; i++) {
+        if (!Scan(false, index)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case kMintCid:
+      Read<int64_t>();
+      return true;
+    case kOneByteStringCid: {
+      intptr_t len = ReadSmiValue();
+      ReadSmiValue();  // Hash.
+      stream_.Advance(len);
+      return true;
+    }
+    case kTwoByteStringCid: {
+      intptr_t len = ReadSmiValue();
+      ReadSmiValue();  // Hash.
+      for (intptr_t i = 0; i < len; i++) {
+        Read<uint16_t>();
+      }
+      return true;
+    }
+    case kSendPortCid:
+      Read<int64_t>();
+      Read<uint64_t>();
+      return true;
+    default: {
+      Dart_TypedData_Type type = GetTypedDataType(class_id);
+      if (type == Dart_TypedData_kInvalid) {
+        return false;
+      }
+      intptr_t len = ReadSmiValue();
+      switch (GetTypedDataSizeInBytes(type)) {
+        case 1:
+          stream_.Advance(len);
+          break;
+        case 2:
+          for (intptr_t i = 0; i < len; i++) Read<int16_t>();
+          break;
+        case 4:
+          for (intptr_t i = 0; i < len; i++) Read<int32_t>();
+          break;
+        default:
+          for (intptr_t i = 0; i < len; i++) Read<int64_t>();
+          break;
+      }
+      return true;
+    }
+  }
+}
+
+
+void ApiMessageStreamReader::AddObject(intptr_t header_offset,
+                                       intptr_t class_offset,
+                                       bool deferred) {
+  Object object;
+  object.header_offset = header_offset;
+  object.class_offset = class_offset;
+  object.body_offset = deferred ? kBodyPending : kNotDeferred;
+  objects_.Add(object);
+}
+
+
+intptr_t ApiMessageStreamReader::FindObject(intptr_t header_offset) const {
+  // The objects of the root and of each array body are indexed in the order
+  // they are written, and the bodies in the order they follow the root.
+  intptr_t lo = 0;
+  intptr_t hi = objects_.length() - 1;
+  while (lo <= hi) {
+    intptr_t mid = lo + (hi - lo) / 2;
+    intptr_t offset = objects_[mid].header_offset;
+    if (offset == header_offset) {
+      return mid;
+    } else if (offset < header_offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
+
+bool ApiMessageStreamReader::Describe(intptr_t position,
+                                      bool refs,
+                                      Value* value) {
+  stream_.SetPosition(position);
+  value->class_id = kIllegalCid;
+  value->class_offset = -1;
+  value->end = -1;
+  int64_t value64 = Read<int64_t>();
+  if ((value64 & kSmiTagMask) == kSmiTag) {
+    value->int_value = value64 >> kSmiTagShift;
+    value->type = IntegerType(value->int_value);
+    value->end = stream_.Position();
+    return true;
+  }
+  intptr_t header = static_cast<intptr_t>(value64);
+  if (header < 0) {
+    intptr_t object_id = VMIsolateObjectId(header);
+    if (object_id == kNullObject) {
+      value->type = Dart_CObject_kNull;
+    } else if ((object_id == kTrueValue) || (object_id == kFalseValue)) {
+      value->type = Dart_CObject_kBool;
+      value->int_value = (object_id == kTrueValue) ? 1 : 0;
+    } else if (object_id == kDoubleObject) {
+      value->type = Dart_CObject_kDouble;
+      stream_.ReadBytes(reinterpret_cast<uint8_t*>(&value->double_value),
+                        sizeof(value->double_value));
+    } else {
+      ASSERT(Symbols::IsVMSymbolId(object_id));
+      value->type = Dart_CObject_kString;
+      value->int_value = object_id;
+    }
+    value->end = stream_.Position();
+    return true;
+  }
+  if (SerializedHeaderTag::decode(header) == kObjectId) {
+    intptr_t index =
+        SerializedHeaderData::decode(header) - kMaxPredefinedObjectIds;
+    if (index < 0) {
+      return false;  // A type.
+    }
+    const intptr_t end = stream_.Position();
+    const Object& object = objects_[index];
+    if (object.body_offset != kNotDeferred) {
+      value->type = Dart_CObject_kArray;
+      value->class_id = kArrayCid;
+      value->class_offset = object.body_offset;
+    } else if (!DescribeObject(object.class_offset, value)) {
+      return false;
+    }
+    value->end = end;
+    return true;
+  }
+  ASSERT(SerializedHeaderTag::decode(header) == kInlined);
+  const intptr_t class_offset = stream_.Position();
+  if (refs && IsArrayClassId(LookupClassId(Read<int32_t>()))) {
+    intptr_t index = FindObject(position);
+    ASSERT(index >= 0);
+    ReadSmiValue();
+    value->type = Dart_CObject_kArray;
+    value->class_id = kArrayCid;
+    value->class_offset = objects_[index].body_offset;
+    value->end = stream_.Position();
+    return true;
+  }
+  return DescribeObject(class_offset, value);
+}
+
+
+bool ApiMessageStreamReader::DescribeObject(intptr_t class_offset,
+                                            Value* value) {
+  stream_.SetPosition(class_offset);
+  intptr_t class_id = LookupClassId(Read<int32_t>());
+  Read<int8_t>();  // Tags.
+  value->class_id = class_id;
+  value->class_offset = class_offset;
+  value->end = -1;
+  switch (class_id) {
+    case kArrayCid:
+    case kImmutableArrayCid:
+    case kGrowableObjectArrayCid:
+      value->type = Dart_CObject_kArray;
+      return true;
+    case kOneByteStringCid:
+    case kTwoByteStringCid:
+      value->type = Dart_CObject_kString;
+      return true;
+    case kMintCid:
+      value->int_value = Read<int64_t>();
+      value->type = IntegerType(value->int_value);
+      break;
+    case kSendPortCid:
+      value->type = Dart_CObject_kSendPort;
+      value->int_value = Read<int64_t>();
+      Read<uint64_t>();  // Origin id.
+      break;
+    default:
+      if (GetTypedDataType(class_id) == Dart_TypedData_kInvalid) {
+        return false;  // Type arguments.
+      }
+      value->type = Dart_CObject_kTypedData;
+      return true;
+  }
+  value->end = stream_.Position();
+  return true;
+}
+
+
+bool ApiMessageStreamReader::NextValue(Value* value) {
+  if (!valid_) {
+    return false;
+  }
+  const Frame& frame = frames_.Last();
+  if (frame.remaining == 0) {
+    return false;
+  }
+  return Describe(frame.position, frame.refs, value);
+}
+
+
+void ApiMessageStreamReader::Consume(const Value& value) {
+  ASSERT(value.end >= 0);
+  Frame& frame = frames_.Last();
+  frame.position = value.end;
+  frame.remaining--;
+}
+
+
+Dart_CObject_Type ApiMessageStreamReader::NextType() {
+  Value value;
+  if (!NextValue(&value)) {
+    return Dart_CObject_kUnsupported;
+  }
+  return value.type;
+}
+
+
+bool ApiMessageStreamReader::ReadNull() {
+  Value value;
+  if (!NextValue(&value) || (value.type != Dart_CObject_kNull)) {
+    return false;
+  }
+  Consume(value);
+  return true;
+}
+
+
+bool ApiMessageStreamReader::ReadBool(bool* result) {
+  Value value;
+  if (!NextValue(&value) || (value.type != Dart_CObject_kBool)) {
+    return false;
+  }
+  *result = (value.int_value != 0);
+  Consume(value);
+  return true;
+}
+
+
+bool ApiMessageStreamReader::ReadInt64(int64_t* result) {
+  Value value;
+  if (!NextValue(&value) ||
+      ((value.type != Dart_CObject_kInt32) &&
+       (value.type != Dart_CObject_kInt64))) {
+    return false;
+  }
+  *result = value.int_value;
+  Consume(value);
+  return true;
+}
+
+
+bool ApiMessageStreamReader::ReadDouble(double* result) {
+  Value value;
+  if (!NextValue(&value) || (value.type != Dart_CObject_kDouble)) {
+    return false;
+  }
+  *result = value.double_value;
+  Consume(value);
+  return true;
+}
+
+
+bool ApiMessageStreamReader::ReadString(const char** result,
+                                        intptr_t* length) {
+  Value value;
+  if (!NextValue(&value) || (value.type != Dart_CObject_kString)) {
+    return false;
+  }
+  const uint8_t* latin1;
+  intptr_t len;
+  uint16_t* utf16 = NULL;
+  if (value.class_id == kIllegalCid) {
+    RawOneByteString* str = reinterpret_cast<RawOneByteString*>(
+        Symbols::GetVMSymbol(value.int_value));
+    latin1 = str->ptr()->data();
+    len = Smi::Value(str->ptr()->length_);
+  } else {
+    stream_.SetPosition(value.class_offset);
+    Read<int32_t>();  // Class.
+    Read<int8_t>();  // Tags.
+    len = ReadSmiValue();
+    ReadSmiValue();  // Hash.
+    if (value.class_id == kOneByteStringCid) {
+      latin1 = stream_.AddressOfCurrentPosition();
+      stream_.Advance(len);
+    } else {
+      latin1 = NULL;
+      // Each code unit takes up to three bytes in UTF-8.
+      utf16 = reinterpret_cast<uint16_t*>(
+          ScratchBuffer(len * sizeof(uint16_t) + len * 3 + 1));
+      for (intptr_t i = 0; i < len; i++) {
+        utf16[i] = Read<uint16_t>();
+      }
+    }
+    if (value.end < 0) {
+      value.end = stream_.Position();
+    }
+  }
+  char* utf8;
+  char* p;
+  if (latin1 != NULL) {
+    utf8 = reinterpret_cast<char*>(ScratchBuffer(len * 2 + 1));
+    p = utf8;
+    for (intptr_t i = 0; i < len; i++) {
+      p += Utf8::Encode(latin1[i], p);
+    }
+  } else {
+    utf8 = reinterpret_cast<char*>(utf16 + len);
+    p = utf8;
+    intptr_t i = 0;
+    while (i < len) {
+      int32_t ch = Utf16::Next(utf16, &i, len);
+      if (Utf16::IsSurrogate(ch)) {
+        return false;  // Not valid UTF-16, like for ApiMessageReader.
+      }
+      p += Utf8::Encode(ch, p);
+    }
+  }
+  *p = '\0';
+  *result = utf8;
+  *length = p - utf8;
+  Consume(value);
+  return true;
+}
+
+
+bool ApiMessageStreamReader::ReadTypedData(Dart_TypedData_Type* type,
+                                           const uint8_t** values,
+                                           intptr_t* length) {
+  Value value;
+  if (!NextValue(&value) || (value.type != Dart_CObject_kTypedData)) {
+    return false;
+  }
+  stream_.SetPosition(value.class_offset);
+  Read<int32_t>();  // Class.
+  Read<int8_t>();  // Tags.
+  intptr_t len = ReadSmiValue();
+  *type = GetTypedDataType(value.class_id);
+  const intptr_t element_size = GetTypedDataSizeInBytes(*type);
+  if (element_size == 1) {
+    *values = stream_.AddressOfCurrentPosition();
+    stream_.Advance(len);
+  } else {
+    // Wider elements are written as variable length integers.
+    uint8_t* data = ScratchBuffer(len * element_size);
+    for (intptr_t i = 0; i < len; i++) {
+      if (element_size == 2) {
+        int16_t element = Read<int16_t>();
+        memmove(data + i * element_size, &element, element_size);
+      } else if (element_size == 4) {
+        int32_t element = Read<int32_t>();
+        memmove(data + i * element_size, &element, element_size);
+      } else {
+        int64_t element = Read<int64_t>();
+        memmove(data + i * element_size, &element, element_size);
+      }
+    }
+    *values = data;
+  }
+  *length = len * element_size;
+  if (value.end < 0) {
+    value.end = stream_.Position();
+  }
+  Consume(value);
+  return true;
+}
+
+
+bool ApiMessageStreamReader::ReadSendPort(Dart_Port* id) {
+  Value value;
+  if (!NextValue(&value) || (value.type != Dart_CObject_kSendPort)) {
+    return false;
+  }
+  *id = value.int_value;
+  Consume(value);
+  return true;
+}
+
+
+void ApiMessageStreamReader::ArrayElements(const Value& value,
+                                           intptr_t* first,
+                                           intptr_t* length,
+                                           intptr_t* unused) {
+  stream_.SetPosition(value.class_offset);
+  intptr_t class_id = LookupClassId(Read<int32_t>());
+  Read<int8_t>();  // Tags.
+  *length = ReadSmiValue();
+  *unused = 0;
+  if (class_id == kGrowableObjectArrayCid) {
+    // The elements are those of its backing array, which may have more.
+    Read<int64_t>();  // Header.
+    Read<int32_t>();  // Class.
+    Read<int8_t>();  // Tags.
+    *unused = ReadSmiValue() - *length;
+  }
+  Scan(false, false);  // Type arguments.
+  *first = stream_.Position();
+}
+
+
+bool ApiMessageStreamReader::BeginArray(intptr_t* length) {
+  Value value;
+  if (!NextValue(&value) || (value.type != Dart_CObject_kArray)) {
+    return false;
+  }
+  Frame elements;
+  ArrayElements(value, &elements.position, &elements.remaining,
+                &elements.unused);
+  elements.refs = true;
+  elements.next_position = value.end;
+  frames_.Last().remaining--;
+  frames_.Add(elements);
+  *length = elements.remaining;
+  return true;
+}
+
+
+bool ApiMessageStreamReader::EndArray() {
+  if (!valid_ || (frames_.length() < 2) || (frames_.Last().remaining != 0)) {
+    return false;
+  }
+  Frame elements = frames_.RemoveLast();
+  Frame& frame = frames_.Last();
+  if (elements.next_position >= 0) {
+    frame.position = elements.next_position;
+  } else {
+    // The array was written in place, and ends after its elements.
+    frame.position = elements.position;
+    if (elements.unused > 0) {
+      stream_.SetPosition(elements.position);
+      for (intptr_t i = 0; i < elements.unused; i++) {
+        Scan(true, false);
+      }
+      frame.position = stream_.Position();
+    }
+  }
+  return true;
+}
+
+
+bool ApiMessageStreamReader::Skip() {
+  if (!valid_) {
+    return false;
+  }
+  Frame& frame = frames_.Last();
+  if (frame.remaining == 0) {
+    return false;
+  }
+  stream_.SetPosition(frame.position);
+  Scan(frame.refs, false);
+  frame.position = stream_.Position();
+  frame.remaining--;
+  return true;
+}
+
+
+uint8_t* ApiMessageStreamReader::ScratchBuffer(intptr_t size) {
+  if (size > scratch_size_) {
+    scratch_ = reinterpret_cast<uint8_t*>(realloc(scratch_, size));
+    scratch_size_ = size;
+  }
+  return scratch_;
+}
+
 }  // namespace dart
@@ -191,6 +191,174 @@ class ApiMessageWriter : public BaseWriter {
   DISALLOW_COPY_AND_ASSIGN(ApiMessageWriter);
 };
 
+
+// Builds a message from a stream of values, writing the snapshot format as
+// the values are added instead of building a Dart_CObject graph first. The
+// builder keeps its buffers from one message to the next.
+//
+// A message is a single value. An array is added by BeginArray, followed by
+// its elements, followed by EndArray. Adding a value which does not fit the
+// message fails, and so does finishing the message afterwards.
+//
+// The elements of an array nested in another one are written after all the
+// objects of the outer array, so the body of each array is written into a
+// segment of its own. Finish joins the segments in the order the message
+// reader expects them, which also decides the ids of the nested arrays.
+class ApiMessageBuilder {
+ public:
+  ApiMessageBuilder();
+  ~ApiMessageBuilder();
+
+  bool AddNull();
+  bool AddBool(bool value);
+  bool AddInt64(int64_t value);
+  bool AddDouble(double value);
+  // Adds a NUL terminated UTF-8 string.
+  bool AddString(const char* value);
+  // The length is in bytes, as for Dart_CObject.
+  bool AddTypedData(Dart_TypedData_Type type,
+                    const uint8_t* values,
+                    intptr_t length);
+  bool BeginArray(intptr_t length);
+  bool EndArray();
+
+  // Copies the message into a buffer allocated with malloc, and resets the
+  // builder for the next message. Returns false if the message is invalid or
+  // incomplete, which also resets the builder.
+  bool Finish(uint8_t** buffer, intptr_t* length);
+
+  // Drops the values added so far.
+  void Reset();
+
+ private:
+  class Segment;
+
+  // Returns the segment to write the next value to, or NULL if no more
+  // values fit the message.
+  Segment* NextValue();
+  Segment* NewSegment();
+  bool Fail();
+
+  Segment* root_;
+  MallocGrowableArray<Segment*> open_arrays_;
+  MallocGrowableArray<Segment*> segments_;  // In use, root_ first.
+  MallocGrowableArray<Segment*> free_segments_;
+  bool complete_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApiMessageBuilder);
+};
+
+
+// Reads a message value by value, without building a Dart_CObject graph.
+// Strings are decoded into a buffer owned by the reader, typed data of
+// bytes points into the message, and either is only valid until the next
+// value is read. The reader keeps its buffers from one message to the next.
+//
+// The message is indexed when it is reset, as the elements of an array may
+// be written anywhere after the array. A message with objects the reader
+// cannot index, such as instances, reads as a single unsupported value.
+class ApiMessageStreamReader {
+ public:
+  ApiMessageStreamReader();
+  ~ApiMessageStreamReader();
+
+  // Starts reading a message. Returns false if it cannot be read.
+  bool Reset(const uint8_t* buffer, intptr_t length);
+
+  const uint8_t* buffer() const { return buffer_; }
+  intptr_t length() const { return length_; }
+
+  // Returns the type of the next value, which is Dart_CObject_kUnsupported
+  // if it cannot be read or there is none.
+  Dart_CObject_Type NextType();
+
+  bool ReadNull();
+  bool ReadBool(bool* value);
+  bool ReadInt64(int64_t* value);
+  bool ReadDouble(double* value);
+  // Reads a string as NUL terminated UTF-8. The length is in bytes.
+  bool ReadString(const char** value, intptr_t* length);
+  // The length is in bytes, as for Dart_CObject.
+  bool ReadTypedData(Dart_TypedData_Type* type,
+                     const uint8_t** values,
+                     intptr_t* length);
+  bool ReadSendPort(Dart_Port* id);
+  bool BeginArray(intptr_t* length);
+  // All elements of the array must have been read.
+  bool EndArray();
+  // Skips the next value, whatever its type.
+  bool Skip();
+
+ private:
+  // An object of the message which has an object id.
+  struct Object {
+    intptr_t header_offset;  // Of its serialization header.
+    intptr_t class_offset;  // Of its class header.
+    intptr_t body_offset;  // Of the class header of a deferred array body.
+  };
+
+  // The values left in an array, or of the message.
+  struct Frame {
+    intptr_t position;
+    intptr_t remaining;
+    bool refs;  // Whether the values are written as object references.
+    // The position of the value after the array in the enclosing frame, or
+    // -1 if it follows the last element.
+    intptr_t next_position;
+    // The elements of the backing array of a growable array past its
+    // length, which are skipped.
+    intptr_t unused;
+  };
+
+  // What the value at a position is.
+  struct Value {
+    Dart_CObject_Type type;
+    intptr_t class_id;
+    intptr_t class_offset;  // For objects with a class header.
+    intptr_t end;  // Where the value ends, or -1 for an inlined array.
+    int64_t int_value;  // Also the id of VM symbols.
+    double double_value;
+  };
+
+  static const intptr_t kNotDeferred = -1;
+  static const intptr_t kBodyPending = -2;
+
+  template <typename T>
+  T Read() {
+    return ReadStream::Raw<sizeof(T), T>::Read(&stream_);
+  }
+  intptr_t ReadSmiValue();
+
+  bool Index();
+  bool Scan(bool refs, bool index);
+  void AddObject(intptr_t header_offset,
+                 intptr_t class_offset,
+                 bool deferred);
+  intptr_t FindObject(intptr_t header_offset) const;
+
+  bool Describe(intptr_t position, bool refs, Value* value);
+  bool DescribeObject(intptr_t class_offset, Value* value);
+  bool NextValue(Value* value);
+  void Consume(const Value& value);
+  void ArrayElements(const Value& value,
+                     intptr_t* first,
+                     intptr_t* length,
+                     intptr_t* unused);
+  uint8_t* ScratchBuffer(intptr_t size);
+
+  const uint8_t* buffer_;
+  intptr_t length_;
+  ReadStream stream_;
+  bool valid_;
+  MallocGrowableArray<Object> objects_;
+  MallocGrowableArray<Frame> frames_;
+  uint8_t* scratch_;
+  intptr_t scratch_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApiMessageStreamReader);
+};
+
 }  // namespace dart
 
 #endif  // VM_DART_API_MESSAGE_H_
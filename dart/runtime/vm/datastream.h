@@ -94,7 +94,7 @@ class ReadStream : public ValueObject {
   }
 
   void Advance(intptr_t value) {
-    ASSERT((end_ - current_) > value);
+    ASSERT((end_ - current_) >= value);
     current_ = current_ + value;
   }
 
@@ -0,0 +1,155 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/ephemeron_table.h"
+
+#include "platform/assert.h"
+#include "platform/utils.h"
+#include "vm/raw_object.h"
+
+namespace dart {
+
+static const intptr_t kInitialCapacity = 64;
+
+
+EphemeronTable::EphemeronTable()
+    : slots_(NULL),
+      capacity_(0),
+      used_slots_(0),
+      num_keys_(0),
+      num_delayed_(0) {
+}
+
+
+EphemeronTable::~EphemeronTable() {
+  free(slots_);
+}
+
+
+intptr_t EphemeronTable::Hash(RawObject* raw_key) {
+  return Utils::WordHash(
+      reinterpret_cast<intptr_t>(raw_key) >> kObjectAlignmentLog2);
+}
+
+
+intptr_t EphemeronTable::FindSlot(RawObject* raw_key) const {
+  ASSERT(capacity_ > 0);
+  const intptr_t mask = capacity_ - 1;
+  intptr_t slot = Hash(raw_key) & mask;
+  while ((slots_[slot].key != NULL) && (slots_[slot].key != raw_key)) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+
+bool EphemeronTable::Add(RawObject* raw_key, RawWeakProperty* raw_weak) {
+  ASSERT(raw_key != NULL);
+  // Keep the load factor at most one half.
+  if (2 * (used_slots_ + 1) > capacity_) {
+    Rehash(num_keys_ + 1);
+  }
+  const intptr_t slot = FindSlot(raw_key);
+  if (slots_[slot].key == NULL) {
+    slots_[slot].key = raw_key;
+    slots_[slot].head = -1;
+    used_slots_++;
+  }
+  const bool is_first = (slots_[slot].head < 0);
+  if (is_first) {
+    num_keys_++;
+  }
+  Entry entry;
+  entry.weak = raw_weak;
+  entry.next = slots_[slot].head;
+  slots_[slot].head = entries_.length();
+  entries_.Add(entry);
+  num_delayed_++;
+  return is_first;
+}
+
+
+void EphemeronTable::Remove(
+    RawObject* raw_key,
+    MallocGrowableArray<RawWeakProperty*>* weak_properties) {
+  if (num_delayed_ == 0) {
+    return;
+  }
+  const intptr_t slot = FindSlot(raw_key);
+  intptr_t index = slots_[slot].head;
+  if (index < 0) {
+    return;
+  }
+  // The slot keeps its key, so that probing for other keys is not disturbed.
+  slots_[slot].head = -1;
+  num_keys_--;
+  while (index >= 0) {
+    const Entry& entry = entries_[index];
+    weak_properties->Add(entry.weak);
+    num_delayed_--;
+    index = entry.next;
+  }
+  if (num_delayed_ == 0) {
+    // The removed entries are only reclaimed once none are left.
+    entries_.Clear();
+  }
+}
+
+
+void EphemeronTable::RemoveAll(
+    MallocGrowableArray<RawObject*>* keys,
+    MallocGrowableArray<RawWeakProperty*>* weak_properties) {
+  for (intptr_t slot = 0; slot < capacity_; slot++) {
+    intptr_t index = slots_[slot].head;
+    if ((slots_[slot].key == NULL) || (index < 0)) {
+      continue;
+    }
+    if (keys != NULL) {
+      keys->Add(slots_[slot].key);
+    }
+    while (index >= 0) {
+      const Entry& entry = entries_[index];
+      weak_properties->Add(entry.weak);
+      index = entry.next;
+    }
+  }
+  for (intptr_t slot = 0; slot < capacity_; slot++) {
+    slots_[slot].key = NULL;
+  }
+  used_slots_ = 0;
+  num_keys_ = 0;
+  num_delayed_ = 0;
+  entries_.Clear();
+}
+
+
+void EphemeronTable::Rehash(intptr_t min_keys) {
+  intptr_t capacity = kInitialCapacity;
+  while (capacity < 4 * min_keys) {
+    capacity *= 2;
+  }
+  Slot* old_slots = slots_;
+  const intptr_t old_capacity = capacity_;
+  slots_ = reinterpret_cast<Slot*>(malloc(capacity * sizeof(*slots_)));
+  if (slots_ == NULL) {
+    FATAL("Out of memory.\n");
+  }
+  capacity_ = capacity;
+  for (intptr_t slot = 0; slot < capacity_; slot++) {
+    slots_[slot].key = NULL;
+  }
+  used_slots_ = 0;
+  for (intptr_t i = 0; i < old_capacity; i++) {
+    if ((old_slots[i].key != NULL) && (old_slots[i].head >= 0)) {
+      const intptr_t slot = FindSlot(old_slots[i].key);
+      ASSERT(slots_[slot].key == NULL);
+      slots_[slot] = old_slots[i];
+      used_slots_++;
+    }
+  }
+  ASSERT(used_slots_ == num_keys_);
+  free(old_slots);
+}
+
+}  // namespace dart
@@ -0,0 +1,78 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_EPHEMERON_TABLE_H_
+#define VM_EPHEMERON_TABLE_H_
+
+#include "vm/allocation.h"
+#include "vm/globals.h"
+#include "vm/growable_array.h"
+
+namespace dart {
+
+// Forward declarations.
+class RawObject;
+class RawWeakProperty;
+
+// The weak properties delayed by a collector because their keys were not yet
+// known to be reachable, keyed by those keys. Once a key is found reachable,
+// all weak properties depending on it are removed at once, so that each
+// delayed weak property is processed at most twice per collection regardless
+// of how the keys are chained.
+//
+// The table only compares key addresses and never dereferences them.
+class EphemeronTable {
+ public:
+  EphemeronTable();
+  ~EphemeronTable();
+
+  bool IsEmpty() const { return num_delayed_ == 0; }
+
+  // Delays 'raw_weak' until 'raw_key' is found reachable. Returns true if no
+  // other weak property is currently waiting for 'raw_key'.
+  bool Add(RawObject* raw_key, RawWeakProperty* raw_weak);
+
+  // Removes the weak properties waiting for 'raw_key' and appends them to
+  // 'weak_properties'.
+  void Remove(RawObject* raw_key,
+              MallocGrowableArray<RawWeakProperty*>* weak_properties);
+
+  // Removes all delayed weak properties and appends them to 'weak_properties'.
+  // The keys they were waiting for are appended to 'keys' unless it is NULL.
+  void RemoveAll(MallocGrowableArray<RawObject*>* keys,
+                 MallocGrowableArray<RawWeakProperty*>* weak_properties);
+
+ private:
+  struct Slot {
+    RawObject* key;  // NULL for an empty slot.
+    intptr_t head;  // First entry waiting for the key, or -1 if none.
+  };
+
+  struct Entry {
+    RawWeakProperty* weak;
+    intptr_t next;  // Next entry waiting for the same key, or -1.
+  };
+
+  static intptr_t Hash(RawObject* raw_key);
+
+  // Returns the slot of 'raw_key', or the empty slot where it belongs.
+  intptr_t FindSlot(RawObject* raw_key) const;
+
+  // Rebuilds the table with room for at least 'min_keys' keys. Keys without
+  // waiting weak properties are dropped.
+  void Rehash(intptr_t min_keys);
+
+  Slot* slots_;
+  intptr_t capacity_;  // Zero or a power of two.
+  intptr_t used_slots_;  // Including slots of keys with no waiting entries.
+  intptr_t num_keys_;  // Slots with waiting entries.
+  intptr_t num_delayed_;
+  MallocGrowableArray<Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(EphemeronTable);
+};
+
+}  // namespace dart
+
+#endif  // VM_EPHEMERON_TABLE_H_
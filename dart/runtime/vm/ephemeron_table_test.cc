@@ -0,0 +1,63 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/assert.h"
+#include "vm/ephemeron_table.h"
+#include "vm/unit_test.h"
+
+namespace dart {
+
+// The table never dereferences keys or weak properties.
+static RawObject* FakeKey(intptr_t i) {
+  return reinterpret_cast<RawObject*>((i + 1) * kObjectAlignment + 1);
+}
+
+
+static RawWeakProperty* FakeWeak(intptr_t i) {
+  return reinterpret_cast<RawWeakProperty*>((i + 1) * kObjectAlignment + 1);
+}
+
+
+UNIT_TEST_CASE(EphemeronTable) {
+  EphemeronTable table;
+  EXPECT(table.IsEmpty());
+  MallocGrowableArray<RawWeakProperty*> weak_properties;
+  table.Remove(FakeKey(0), &weak_properties);
+  EXPECT_EQ(0, weak_properties.length());
+
+  // Three weak properties per key, past the initial capacity.
+  const intptr_t kNumKeys = 1000;
+  for (intptr_t i = 0; i < 3 * kNumKeys; i++) {
+    EXPECT_EQ(i < kNumKeys, table.Add(FakeKey(i % kNumKeys), FakeWeak(i)));
+  }
+  EXPECT(!table.IsEmpty());
+  for (intptr_t i = 0; i < kNumKeys; i += 2) {
+    weak_properties.Clear();
+    table.Remove(FakeKey(i), &weak_properties);
+    EXPECT_EQ(3, weak_properties.length());
+    for (intptr_t j = 0; j < weak_properties.length(); j++) {
+      intptr_t index = (reinterpret_cast<intptr_t>(weak_properties[j]) - 1) /
+          kObjectAlignment - 1;
+      EXPECT_EQ(i, index % kNumKeys);
+    }
+    weak_properties.Clear();
+    table.Remove(FakeKey(i), &weak_properties);
+    EXPECT_EQ(0, weak_properties.length());
+  }
+  // A removed key can be delayed on again.
+  EXPECT(table.Add(FakeKey(0), FakeWeak(0)));
+  EXPECT(!table.Add(FakeKey(0), FakeWeak(1)));
+
+  MallocGrowableArray<RawObject*> keys;
+  weak_properties.Clear();
+  table.RemoveAll(&keys, &weak_properties);
+  EXPECT_EQ(kNumKeys / 2 + 1, keys.length());
+  EXPECT_EQ(3 * (kNumKeys / 2) + 2, weak_properties.length());
+  EXPECT(table.IsEmpty());
+  weak_properties.Clear();
+  table.Remove(FakeKey(1), &weak_properties);
+  EXPECT_EQ(0, weak_properties.length());
+}
+
+}  // namespace dart
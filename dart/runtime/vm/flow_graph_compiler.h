@@ -280,6 +280,9 @@ class FlowGraphCompiler : public ValueObject {
   static bool SupportsSinCos();
   static bool SupportsUnboxedSimd128();
   static bool SupportsHardwareDivision();
+  // Whether AllocateObject and CreateArray can allocate in old space, see
+  // FlowGraphOptimizer::PretenureAllocationSites.
+  static bool SupportsSitePretenuring();
 
   // Accessors.
   Assembler* assembler() const { return assembler_; }
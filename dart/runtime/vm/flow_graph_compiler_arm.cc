@@ -64,6 +64,11 @@ bool FlowGraphCompiler::SupportsHardwareDivision() {
 }
 
 
+bool FlowGraphCompiler::SupportsSitePretenuring() {
+  return false;
+}
+
+
 void FlowGraphCompiler::EnterIntrinsicMode() {
   ASSERT(!intrinsic_mode());
   intrinsic_mode_ = true;
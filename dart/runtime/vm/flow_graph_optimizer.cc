@@ -8010,6 +8010,52 @@ void FlowGraphOptimizer::EliminateEnvironments() {
 }
 
 
+void FlowGraphOptimizer::PretenureAllocationSites(
+    const GrowableArray<const Function*>& inline_id_to_function) {
+  Heap* heap = I->heap();
+  for (intptr_t i = 0; i < block_order_.length(); ++i) {
+    BlockEntryInstr* block = block_order_[i];
+    for (ForwardInstructionIterator it(block); !it.Done(); it.Advance()) {
+      Instruction* current = it.Current();
+      // Instructions created by the optimizer have no site in unoptimized
+      // code.
+      if (!current->has_inlining_id()) {
+        continue;
+      }
+      const Function& function =
+          *inline_id_to_function[current->inlining_id()];
+      AllocateObjectInstr* alloc = current->AsAllocateObject();
+      if ((alloc != NULL) &&
+          Heap::IsAllocatableInNewSpace(alloc->cls().instance_size()) &&
+          heap->ShouldPretenureSite(function, alloc->token_pos())) {
+        alloc->set_is_pretenured(true);
+      }
+      CreateArrayInstr* create = current->AsCreateArray();
+      if ((create != NULL) &&
+          create->num_elements()->BindsToConstant() &&
+          create->num_elements()->BoundConstant().IsSmi()) {
+        // Only arrays of constant length are allocated inline.
+        const intptr_t length =
+            Smi::Cast(create->num_elements()->BoundConstant()).Value();
+        if ((length >= 0) &&
+            (length <= Array::kMaxElements) &&
+            Heap::IsAllocatableInNewSpace(Array::InstanceSize(length)) &&
+            heap->ShouldPretenureSite(function, create->token_pos())) {
+          create->set_is_pretenured(true);
+        }
+      }
+      if (FLAG_trace_optimization &&
+          (((alloc != NULL) && alloc->is_pretenured()) ||
+           ((create != NULL) && create->is_pretenured()))) {
+        ISL_Print("Pretenuring v%" Pd " in %s\n",
+                  current->AsDefinition()->ssa_temp_index(),
+                  function.ToFullyQualifiedCString());
+      }
+    }
+  }
+}
+
+
 enum SafeUseCheck { kOptimisticCheck, kStrictCheck };
 
 // Check if the use is safe for allocation sinking. Allocation sinking
@@ -61,6 +61,13 @@ class FlowGraphOptimizer : public FlowGraphVisitor {
   // Remove environments from the instructions which do not deoptimize.
   void EliminateEnvironments();
 
+  // Mark the allocations at sites whose objects were found to survive their
+  // first scavenge in unoptimized code, so that they are allocated directly
+  // in old space. 'inline_id_to_function' maps the inlining ids of the
+  // instructions to the functions they came from.
+  void PretenureAllocationSites(
+      const GrowableArray<const Function*>& inline_id_to_function);
+
   virtual void VisitStaticCall(StaticCallInstr* instr);
   virtual void VisitInstanceCall(InstanceCallInstr* instr);
   virtual void VisitStoreInstanceField(StoreInstanceFieldInstr* instr);
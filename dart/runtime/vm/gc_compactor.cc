@@ -0,0 +1,332 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/gc_compactor.h"
+
+#include "vm/dart_api_state.h"
+#include "vm/freelist.h"
+#include "vm/growable_array.h"
+#include "vm/heap.h"
+#include "vm/isolate.h"
+#include "vm/lockers.h"
+#include "vm/object_id_ring.h"
+#include "vm/pages.h"
+#include "vm/stack_frame.h"
+#include "vm/store_buffer.h"
+#include "vm/visitor.h"
+#include "vm/weak_table.h"
+
+namespace dart {
+
+static const uword kMarkBitMask = 1 << RawObject::kMarkBit;
+
+
+static inline bool IsForwarding(uword header) {
+  return (header & kMarkBitMask) == 0;
+}
+
+
+static inline RawObject* Forwarded(RawObject* raw_obj) {
+  if (!raw_obj->IsHeapObject() || raw_obj->IsNewObject()) {
+    return raw_obj;
+  }
+  uword header = *reinterpret_cast<uword*>(RawObject::ToAddr(raw_obj));
+  if (IsForwarding(header)) {
+    return RawObject::FromAddr(header);
+  }
+  return raw_obj;
+}
+
+
+class ForwardPointersVisitor : public ObjectPointerVisitor {
+ public:
+  explicit ForwardPointersVisitor(Isolate* isolate)
+      : ObjectPointerVisitor(isolate) {}
+
+  void VisitPointers(RawObject** first, RawObject** last) {
+    for (RawObject** current = first; current <= last; current++) {
+      *current = Forwarded(*current);
+    }
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ForwardPointersVisitor);
+};
+
+
+class ForwardMarkedObjectsVisitor : public ObjectVisitor {
+ public:
+  ForwardMarkedObjectsVisitor(Isolate* isolate, ObjectPointerVisitor* visitor)
+      : ObjectVisitor(isolate), visitor_(visitor) {}
+
+  void VisitObject(RawObject* raw_obj) {
+    // Unmarked objects are garbage and may point to released pages.
+    if (raw_obj->IsMarked()) {
+      raw_obj->VisitPointers(visitor_);
+    }
+  }
+
+ private:
+  ObjectPointerVisitor* visitor_;
+
+  DISALLOW_COPY_AND_ASSIGN(ForwardMarkedObjectsVisitor);
+};
+
+
+class ForwardHandlesVisitor : public HandleVisitor {
+ public:
+  explicit ForwardHandlesVisitor(Isolate* isolate) : HandleVisitor(isolate) {}
+
+  void VisitHandle(uword addr) {
+    FinalizablePersistentHandle* handle =
+        reinterpret_cast<FinalizablePersistentHandle*>(addr);
+    RawObject** p = handle->raw_addr();
+    *p = Forwarded(*p);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ForwardHandlesVisitor);
+};
+
+
+// Sums the sizes of the marked objects in a page.
+static intptr_t LiveInBytes(HeapPage* page) {
+  intptr_t live = 0;
+  uword current = page->object_start();
+  uword end = page->object_end();
+  while (current < end) {
+    RawObject* raw_obj = RawObject::FromAddr(current);
+    intptr_t size = raw_obj->Size();
+    if (raw_obj->IsMarked()) {
+      live += size;
+    }
+    current += size;
+  }
+  return live;
+}
+
+
+static intptr_t PageUsableInBytes() {
+  return (PageSpace::kPageSizeInWords << kWordSizeLog2) -
+      HeapPage::ObjectStartOffset();
+}
+
+
+HeapPage* GCCompactor::SelectSparsePages(intptr_t max_live_percent) {
+  const intptr_t max_live = PageUsableInBytes() / 100 * max_live_percent;
+  HeapPage* sparse = NULL;
+  MutexLocker ml(page_space_->pages_lock_);
+  HeapPage* prev_page = NULL;
+  HeapPage* page = page_space_->pages_;
+  while (page != NULL) {
+    HeapPage* next_page = page->next();
+    intptr_t live = LiveInBytes(page);
+    if (live < max_live) {
+      if (prev_page != NULL) {
+        prev_page->set_next(next_page);
+      } else {
+        page_space_->pages_ = next_page;
+      }
+      if (page == page_space_->pages_tail_) {
+        page_space_->pages_tail_ = prev_page;
+      }
+      page->set_next(sparse);
+      sparse = page;
+    } else {
+      prev_page = page;
+    }
+    page = next_page;
+  }
+  return sparse;
+}
+
+
+intptr_t GCCompactor::PagesNeeded(HeapPage* pages) {
+  // Objects do not straddle pages, so simulate the allocation.
+  const intptr_t usable = PageUsableInBytes();
+  intptr_t needed = 0;
+  intptr_t remaining = 0;
+  for (HeapPage* page = pages; page != NULL; page = page->next()) {
+    uword current = page->object_start();
+    uword end = page->object_end();
+    while (current < end) {
+      RawObject* raw_obj = RawObject::FromAddr(current);
+      intptr_t size = raw_obj->Size();
+      if (raw_obj->IsMarked()) {
+        if (size > remaining) {
+          needed++;
+          remaining = usable;
+        }
+        remaining -= size;
+      }
+      current += size;
+    }
+  }
+  return needed;
+}
+
+
+void GCCompactor::Evacuate(HeapPage* pages,
+                           const MallocGrowableArray<HeapPage*>& targets) {
+  intptr_t next_target = 0;
+  uword top = 0;
+  uword end = 0;
+  for (HeapPage* page = pages; page != NULL; page = page->next()) {
+    uword current = page->object_start();
+    uword page_end = page->object_end();
+    while (current < page_end) {
+      RawObject* raw_obj = RawObject::FromAddr(current);
+      intptr_t size = raw_obj->Size();
+      if (raw_obj->IsMarked()) {
+        if (static_cast<intptr_t>(end - top) < size) {
+          if (top < end) {
+            FreeListElement::AsElement(top, end - top);
+          }
+          HeapPage* target = targets[next_target++];
+          top = target->object_start();
+          end = target->object_end();
+        }
+        memmove(reinterpret_cast<void*>(top),
+                reinterpret_cast<void*>(current),
+                size);
+        ASSERT(IsForwarding(top));
+        *reinterpret_cast<uword*>(current) = top;
+        top += size;
+      }
+      current += size;
+    }
+  }
+  ASSERT(next_target == targets.length());
+  if (top < end) {
+    FreeListElement::AsElement(top, end - top);
+  }
+}
+
+
+void GCCompactor::ForwardPointers(Isolate* isolate,
+                                  ObjectPointerVisitor* visitor) {
+  // Update the heap first: visiting the stack frames reads the code objects.
+  ForwardMarkedObjectsVisitor object_visitor(isolate, visitor);
+  page_space_->VisitObjects(&object_visitor);
+  heap_->new_space()->VisitObjectPointers(visitor);
+
+  isolate->VisitObjectPointers(visitor,
+                               false,
+                               StackFrameIterator::kDontValidateFrames);
+  ForwardHandlesVisitor handle_visitor(isolate);
+  isolate->VisitWeakPersistentHandles(&handle_visitor, true);
+
+  ObjectIdRing* ring = isolate->object_id_ring();
+  if (ring != NULL) {
+    ring->VisitPointers(visitor);
+  }
+}
+
+
+void GCCompactor::ForwardWeakTables() {
+  for (int sel = 0;
+       sel < Heap::kNumWeakSelectors;
+       sel++) {
+    WeakTable* table = heap_->GetWeakTable(
+        Heap::kOld, static_cast<Heap::WeakSelector>(sel));
+    heap_->SetWeakTable(Heap::kOld,
+                        static_cast<Heap::WeakSelector>(sel),
+                        WeakTable::NewFrom(table));
+    intptr_t size = table->size();
+    for (intptr_t i = 0; i < size; i++) {
+      if (table->IsValidEntryAt(i)) {
+        RawObject* raw_obj = Forwarded(table->ObjectAt(i));
+        heap_->SetWeakEntry(raw_obj,
+                            static_cast<Heap::WeakSelector>(sel),
+                            table->ValueAt(i));
+      }
+    }
+    delete table;
+  }
+}
+
+
+void GCCompactor::ForwardStoreBuffer(Isolate* isolate) {
+  // Marking rebuilt the store buffer, possibly with evacuated objects.
+  StoreBuffer* store_buffer = isolate->store_buffer();
+  StoreBufferBlock* pending = store_buffer->Blocks();
+  while (pending != NULL) {
+    StoreBufferBlock* next = pending->next();
+    for (intptr_t i = 0; i < pending->Count(); i++) {
+      store_buffer->AddObjectGC(Forwarded(pending->At(i)));
+    }
+    delete pending;
+    pending = next;
+  }
+}
+
+
+void GCCompactor::RestorePages(HeapPage* pages) {
+  MutexLocker ml(page_space_->pages_lock_);
+  HeapPage* page = pages;
+  while (page != NULL) {
+    HeapPage* next_page = page->next();
+    page->set_next(NULL);
+    if (page_space_->pages_ == NULL) {
+      page_space_->pages_ = page;
+    } else {
+      page_space_->pages_tail_->set_next(page);
+    }
+    page_space_->pages_tail_ = page;
+    page = next_page;
+  }
+}
+
+
+void GCCompactor::ReleasePages(HeapPage* pages) {
+  {
+    MutexLocker ml(page_space_->pages_lock_);
+    for (HeapPage* page = pages; page != NULL; page = page->next()) {
+      page_space_->IncreaseCapacityInWordsLocked(-PageSpace::kPageSizeInWords);
+    }
+  }
+  page_space_->FreePages(pages);
+}
+
+
+void GCCompactor::CompactSparsePages(Isolate* isolate,
+                                     intptr_t max_live_percent) {
+  HeapPage* sparse = SelectSparsePages(max_live_percent);
+  if (sparse == NULL) {
+    return;
+  }
+  intptr_t sparse_pages = 0;
+  for (HeapPage* page = sparse; page != NULL; page = page->next()) {
+    sparse_pages++;
+  }
+  const intptr_t needed = PagesNeeded(sparse);
+  if ((needed >= sparse_pages) ||
+      !page_space_->CanIncreaseCapacityInWords(
+          needed * PageSpace::kPageSizeInWords)) {
+    RestorePages(sparse);
+    return;
+  }
+  // Reserve all target pages up front, evacuation cannot be undone.
+  MallocGrowableArray<HeapPage*> targets(needed);
+  for (intptr_t i = 0; i < needed; i++) {
+    HeapPage* page = page_space_->AllocatePage(HeapPage::kData);
+    if (page == NULL) {
+      // The empty target pages are released by the sweeper.
+      RestorePages(sparse);
+      return;
+    }
+    FreeListElement::AsElement(page->object_start(),
+                               page->object_end() - page->object_start());
+    targets.Add(page);
+  }
+  Evacuate(sparse, targets);
+  ForwardPointersVisitor visitor(isolate);
+  ForwardPointers(isolate, &visitor);
+  ForwardWeakTables();
+  ForwardStoreBuffer(isolate);
+  ReleasePages(sparse);
+  released_pages_ = sparse_pages - needed;
+}
+
+}  // namespace dart
@@ -0,0 +1,68 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_GC_COMPACTOR_H_
+#define VM_GC_COMPACTOR_H_
+
+#include "vm/allocation.h"
+#include "vm/globals.h"
+#include "vm/growable_array.h"
+
+namespace dart {
+
+// Forward declarations.
+class Heap;
+class HeapPage;
+class Isolate;
+class ObjectPointerVisitor;
+class PageSpace;
+
+// The class GCCompactor is used after marking to evacuate the marked objects of
+// sparsely used data pages into fresh pages, so that the sparse pages can be
+// released instead of being swept into the freelist.
+//
+// The header of an evacuated object is overwritten with its new address. All
+// reachable old objects are marked, so a reachable object with an unmarked
+// header has been evacuated. The pointers in the roots, in the new space, in
+// the marked old objects, in the weak tables and in the object id ring are then
+// updated in place.
+class GCCompactor : public ValueObject {
+ public:
+  GCCompactor(Heap* heap, PageSpace* page_space)
+      : heap_(heap), page_space_(page_space), released_pages_(0) {}
+  ~GCCompactor() {}
+
+  // Evacuates the data pages whose marked objects fill less than
+  // 'max_live_percent' of the page. Does nothing unless fewer pages are needed
+  // to hold the evacuated objects. Code pages must be writable.
+  void CompactSparsePages(Isolate* isolate, intptr_t max_live_percent);
+
+  intptr_t released_pages() const { return released_pages_; }
+
+ private:
+  // Unlinks the sparse data pages from the page space and returns them.
+  HeapPage* SelectSparsePages(intptr_t max_live_percent);
+  // Returns the number of fresh pages needed to hold the marked objects of
+  // 'pages'.
+  intptr_t PagesNeeded(HeapPage* pages);
+  // Copies the marked objects of 'pages' into 'targets' and leaves their new
+  // address in the original header.
+  void Evacuate(HeapPage* pages, const MallocGrowableArray<HeapPage*>& targets);
+  void ForwardPointers(Isolate* isolate, ObjectPointerVisitor* visitor);
+  void ForwardWeakTables();
+  void ForwardStoreBuffer(Isolate* isolate);
+  // Links 'pages' back into the page space, e.g., if there is nothing to gain.
+  void RestorePages(HeapPage* pages);
+  void ReleasePages(HeapPage* pages);
+
+  Heap* heap_;
+  PageSpace* page_space_;
+  intptr_t released_pages_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(GCCompactor);
+};
+
+}  // namespace dart
+
+#endif  // VM_GC_COMPACTOR_H_
@@ -4,24 +4,34 @@
 
 #include "vm/gc_marker.h"
 
-#include <map>
-#include <utility>
-#include <vector>
-
 #include "vm/allocation.h"
 #include "vm/dart_api_state.h"
+#include "vm/ephemeron_table.h"
 #include "vm/isolate.h"
+#include "vm/lockers.h"
 #include "vm/log.h"
 #include "vm/pages.h"
 #include "vm/raw_object.h"
+#include "vm/runtime_entry.h"
 #include "vm/stack_frame.h"
+#include "vm/thread.h"
+#include "vm/thread_pool.h"
 #include "vm/visitor.h"
 #include "vm/object_id_ring.h"
 
 namespace dart {
 
+DEFINE_FLAG(bool, incremental_marking, false,
+            "Mark the old generation incrementally, interleaved with the "
+            "mutator. Must be set before code is generated.");
+DEFINE_FLAG(int, marker_tasks, 0,
+            "Number of helper tasks used to mark in parallel with the "
+            "mutator thread (0 means mark serially).");
+DEFINE_FLAG(int, marking_step_kb, 512,
+            "Minimum amount of KB scanned by an incremental marking step.");
+
 // A simple chunked marking stack.
-class MarkingStack : public ValueObject {
+class MarkingStack {
  public:
   MarkingStack()
       : head_(new MarkingStackChunk()),
@@ -47,6 +57,11 @@ class MarkingStack : public ValueObject {
     return IsMarkingStackChunkEmpty() && (head_->next() == NULL);
   }
 
+  // True if some objects can be given away without emptying the stack.
+  bool HasSharableWork() const {
+    return (top_ > 1) || (head_->next() != NULL);
+  }
+
   void Push(RawObject* value) {
     ASSERT(!IsMarkingStackChunkFull());
     marking_stack_[top_] = value;
@@ -120,6 +135,167 @@ class MarkingStack : public ValueObject {
 };
 
 
+// A batch of marked but unscanned objects passed between parallel marking
+// workers.
+struct MarkingBatch {
+  static const intptr_t kMaxLength = 256;
+
+  intptr_t length;
+  RawObject* objects[kMaxLength];
+};
+
+
+// Batches published by one parallel marking worker. The owner pushes and pops
+// at the back; other workers steal from the front.
+class MarkingDeque {
+ public:
+  MarkingDeque() : head_(0) { }
+
+  ~MarkingDeque() {
+    ASSERT(head_ == batches_.length());
+  }
+
+  void PushBack(MarkingBatch* batch) {
+    MutexLocker ml(&mutex_);
+    batches_.Add(batch);
+  }
+
+  MarkingBatch* PopBack() {
+    MutexLocker ml(&mutex_);
+    if (head_ == batches_.length()) {
+      return NULL;
+    }
+    MarkingBatch* result = batches_.RemoveLast();
+    ResetIfEmpty();
+    return result;
+  }
+
+  MarkingBatch* StealFront() {
+    MutexLocker ml(&mutex_);
+    if (head_ == batches_.length()) {
+      return NULL;
+    }
+    MarkingBatch* result = batches_[head_++];
+    ResetIfEmpty();
+    return result;
+  }
+
+ private:
+  void ResetIfEmpty() {
+    if (head_ == batches_.length()) {
+      batches_.Clear();
+      head_ = 0;
+    }
+  }
+
+  Mutex mutex_;
+  MallocGrowableArray<MarkingBatch*> batches_;
+  intptr_t head_;
+
+  DISALLOW_COPY_AND_ASSIGN(MarkingDeque);
+};
+
+
+// State shared by the workers of a parallel marking phase. Workers only
+// publish batches while others are idle. Marking terminates when all workers
+// are idle and nothing was published since they last looked for work.
+class MarkingWorkList {
+ public:
+  explicit MarkingWorkList(intptr_t num_workers)
+      : num_workers_(num_workers),
+        deques_(new MarkingDeque[num_workers]),
+        epoch_(0),
+        idle_workers_(0),
+        running_tasks_(0),
+        done_(false) { }
+
+  ~MarkingWorkList() {
+    delete[] deques_;
+  }
+
+  MarkingDeque* DequeAt(intptr_t worker_id) const {
+    ASSERT((worker_id >= 0) && (worker_id < num_workers_));
+    return &deques_[worker_id];
+  }
+
+  // Racy hint used by busy workers to decide whether to publish work.
+  bool HasIdleWorkers() const { return idle_workers_ > 0; }
+
+  intptr_t epoch() {
+    MonitorLocker ml(&monitor_);
+    return epoch_;
+  }
+
+  void Published() {
+    MonitorLocker ml(&monitor_);
+    epoch_++;
+    ml.NotifyAll();
+  }
+
+  MarkingBatch* Steal(intptr_t thief_id) {
+    for (intptr_t i = 1; i < num_workers_; i++) {
+      MarkingBatch* batch =
+          deques_[(thief_id + i) % num_workers_].StealFront();
+      if (batch != NULL) {
+        return batch;
+      }
+    }
+    return NULL;
+  }
+
+  // Waits until something is published after 'epoch'. Returns false once all
+  // workers have run out of work.
+  bool WaitForWork(intptr_t epoch) {
+    MonitorLocker ml(&monitor_);
+    idle_workers_++;
+    while (true) {
+      if (epoch_ != epoch) {
+        idle_workers_--;
+        return true;
+      }
+      if (done_) {
+        return false;
+      }
+      if (idle_workers_ == num_workers_) {
+        done_ = true;
+        ml.NotifyAll();
+        return false;
+      }
+      ml.Wait();
+    }
+  }
+
+  void TaskStarted() {
+    MonitorLocker ml(&monitor_);
+    running_tasks_++;
+  }
+
+  void TaskFinished() {
+    MonitorLocker ml(&monitor_);
+    running_tasks_--;
+    ml.NotifyAll();
+  }
+
+  void WaitForTasks() {
+    MonitorLocker ml(&monitor_);
+    while (running_tasks_ > 0) {
+      ml.Wait();
+    }
+  }
+
+ private:
+  const intptr_t num_workers_;
+  MarkingDeque* deques_;
+  Monitor monitor_;
+  intptr_t epoch_;
+  intptr_t idle_workers_;
+  intptr_t running_tasks_;
+  bool done_;
+
+  DISALLOW_COPY_AND_ASSIGN(MarkingWorkList);
+};
+
+
 class MarkingVisitor : public ObjectPointerVisitor {
  public:
   MarkingVisitor(Isolate* isolate,
@@ -134,12 +310,103 @@ class MarkingVisitor : public ObjectPointerVisitor {
         page_space_(page_space),
         marking_stack_(marking_stack),
         visiting_old_object_(NULL),
-        visit_function_code_(visit_function_code) {
+        visit_function_code_(visit_function_code),
+        incremental_(false),
+        work_list_(NULL),
+        worker_id_(-1),
+        live_old_(NULL),
+        marked_bytes_(0) {
     ASSERT(heap_ != vm_heap_);
   }
 
+  ~MarkingVisitor() {
+    delete[] live_old_;
+  }
+
+  // Turns this visitor into worker 'worker_id' of a parallel marking phase.
+  // Marking then uses atomic operations and keeps the results that cannot be
+  // published concurrently local until FinishParallelWork.
+  void StartParallelWork(MarkingWorkList* work_list, intptr_t worker_id) {
+    ASSERT(work_list_ == NULL);
+    work_list_ = work_list;
+    worker_id_ = worker_id;
+    intptr_t num_cids = class_table_->NumCids();
+    live_old_ = new AllocStats<intptr_t>[num_cids];
+    for (intptr_t i = 0; i < num_cids; i++) {
+      live_old_[i].Reset();
+    }
+  }
+
+  // Marks and scans objects until all workers are out of work.
+  void ProcessParallelWork() {
+    ASSERT(work_list_ != NULL);
+    MarkingDeque* own_deque = work_list_->DequeAt(worker_id_);
+    while (true) {
+      while (!marking_stack_->IsEmpty()) {
+        if (work_list_->HasIdleWorkers() &&
+            marking_stack_->HasSharableWork()) {
+          ShareWork(own_deque);
+        }
+        ScanParallel(marking_stack_->Pop());
+      }
+      intptr_t epoch = work_list_->epoch();
+      MarkingBatch* batch = own_deque->PopBack();
+      if (batch == NULL) {
+        batch = work_list_->Steal(worker_id_);
+      }
+      if (batch != NULL) {
+        for (intptr_t i = 0; i < batch->length; i++) {
+          marking_stack_->Push(batch->objects[i]);
+        }
+        delete batch;
+      } else if (!work_list_->WaitForWork(epoch)) {
+        return;
+      }
+    }
+  }
+
+  // Publishes the per-worker results through the serial visitor 'serial' on
+  // the mutator thread and returns the number of bytes this worker marked.
+  intptr_t FinishParallelWork(MarkingVisitor* serial) {
+    ASSERT(work_list_ != NULL);
+    ASSERT(serial->work_list_ == NULL);
+    StoreBuffer* store_buffer = serial->isolate()->store_buffer();
+    for (intptr_t i = 0; i < remembered_.length(); i++) {
+      store_buffer->AddObjectGC(remembered_[i]);
+    }
+    // Helper tasks run on shallow copies of the class table, which do not own
+    // the heap statistics.
+    ClassTable* class_table = serial->class_table_;
+    for (intptr_t cid = 1; cid < class_table->NumCids(); cid++) {
+      if (live_old_[cid].old_count > 0) {
+        ClassHeapStats* stats = class_table->PreliminaryStatsAt(cid);
+        stats->post_gc.old_count += live_old_[cid].old_count;
+        stats->post_gc.old_size += live_old_[cid].old_size;
+      }
+    }
+    for (intptr_t i = 0; i < skipped_code_functions_.length(); i++) {
+      serial->skipped_code_functions_.Add(skipped_code_functions_[i]);
+    }
+    for (intptr_t i = 0; i < delayed_weak_.length(); i++) {
+      RawWeakProperty* raw_weak = delayed_weak_[i];
+      if (raw_weak->ptr()->key_->IsMarked()) {
+        // The key was marked after the weak property was scanned.
+        serial->VisitingOldObject(raw_weak);
+        raw_weak->VisitPointers(serial);
+        serial->VisitingOldObject(NULL);
+      } else {
+        serial->DelayWeakProperty(raw_weak);
+      }
+    }
+    return marked_bytes_;
+  }
+
   MarkingStack* marking_stack() const { return marking_stack_; }
 
+  // An incremental marking visitor keeps the remembered bits, as the store
+  // buffer is not rebuilt by incremental marking.
+  void set_incremental(bool value) { incremental_ = value; }
+
   void VisitPointers(RawObject** first, RawObject** last) {
     for (RawObject** current = first; current <= last; current++) {
       MarkObject(*current, current);
@@ -148,26 +415,54 @@ class MarkingVisitor : public ObjectPointerVisitor {
 
   bool visit_function_code() const { return visit_function_code_; }
 
-  virtual GrowableArray<RawFunction*>* skipped_code_functions() {
+  virtual MallocGrowableArray<RawFunction*>* skipped_code_functions() {
     return &skipped_code_functions_;
   }
 
   void DelayWeakProperty(RawWeakProperty* raw_weak) {
     RawObject* raw_key = raw_weak->ptr()->key_;
-    DelaySet::iterator it = delay_set_.find(raw_key);
-    if (it != delay_set_.end()) {
-      ASSERT(raw_key->IsWatched());
-    } else {
+    if (ephemerons_.Add(raw_key, raw_weak)) {
       ASSERT(!raw_key->IsWatched());
       raw_key->SetWatchedBitUnsynchronized();
+    } else {
+      ASSERT(raw_key->IsWatched());
     }
-    delay_set_.insert(std::make_pair(raw_key, raw_weak));
+  }
+
+  // Moves the delayed weak properties to 'weak_properties' and clears the
+  // watched bits of their keys.
+  void TakeDelayedWeakProperties(
+      MallocGrowableArray<RawWeakProperty*>* weak_properties) {
+    MallocGrowableArray<RawObject*> keys;
+    ephemerons_.RemoveAll(&keys, weak_properties);
+    for (intptr_t i = 0; i < keys.length(); i++) {
+      keys[i]->ClearWatchedBitUnsynchronized();
+    }
+    while (!ready_weak_.is_empty()) {
+      weak_properties->Add(ready_weak_.RemoveLast());
+    }
+  }
+
+  // Visits the weak properties whose keys were marked after they had been
+  // delayed. They are queued rather than visited when their key is marked, so
+  // that long chains of weak keys do not recurse.
+  void VisitReadyWeakProperties() {
+    RawObject* saved_visiting_object = visiting_old_object_;
+    while (!ready_weak_.is_empty()) {
+      RawWeakProperty* raw_weak = ready_weak_.RemoveLast();
+      visiting_old_object_ = raw_weak;
+      raw_weak->VisitPointers(this);
+    }
+    visiting_old_object_ = saved_visiting_object;
   }
 
   void Finalize() {
-    DelaySet::iterator it = delay_set_.begin();
-    for (; it != delay_set_.end(); ++it) {
-      WeakProperty::Clear(it->second);
+    ASSERT(ready_weak_.is_empty());
+    // The remaining keys were not marked.
+    MallocGrowableArray<RawWeakProperty*> unreachable;
+    ephemerons_.RemoveAll(NULL, &unreachable);
+    for (intptr_t i = 0; i < unreachable.length(); i++) {
+      WeakProperty::Clear(unreachable[i]);
     }
     if (!visit_function_code_) {
       DetachCode();
@@ -180,6 +475,52 @@ class MarkingVisitor : public ObjectPointerVisitor {
   }
 
  private:
+  void ShareWork(MarkingDeque* own_deque) {
+    MarkingBatch* batch = new MarkingBatch();
+    batch->length = 0;
+    while ((batch->length < MarkingBatch::kMaxLength) &&
+           marking_stack_->HasSharableWork()) {
+      batch->objects[batch->length++] = marking_stack_->Pop();
+    }
+    own_deque->PushBack(batch);
+    work_list_->Published();
+  }
+
+  void ScanParallel(RawObject* raw_obj) {
+    visiting_old_object_ = raw_obj;
+    if (raw_obj->GetClassId() != kWeakPropertyCid) {
+      marked_bytes_ += raw_obj->VisitPointers(this);
+    } else {
+      RawWeakProperty* raw_weak = reinterpret_cast<RawWeakProperty*>(raw_obj);
+      marked_bytes_ += raw_weak->Size();
+      RawObject* raw_key = raw_weak->ptr()->key_;
+      if (raw_key->IsHeapObject() &&
+          raw_key->IsOldObject() &&
+          !raw_key->IsMarked()) {
+        // Key is white. Decide on the mutator thread after the parallel
+        // phase, when the watched bits can be used without races.
+        delayed_weak_.Add(raw_weak);
+      } else {
+        raw_weak->VisitPointers(this);
+      }
+    }
+    visiting_old_object_ = NULL;
+  }
+
+  void MarkAndPushParallel(RawObject* raw_obj) {
+    if (!raw_obj->TryAcquireMarkBit()) {
+      // Marked by another worker.
+      return;
+    }
+    // Watched bits are not used while marking in parallel.
+    ASSERT(!raw_obj->IsWatched());
+    raw_obj->ClearRememberedBit();
+    intptr_t cid = raw_obj->GetClassId();
+    live_old_[cid].AddOld(
+        RawObject::IsVariableSizeClassId(cid) ? raw_obj->Size() : 0);
+    marking_stack_->Push(raw_obj);
+  }
+
   void MarkAndPush(RawObject* raw_obj) {
     ASSERT(raw_obj->IsHeapObject());
     ASSERT((FLAG_verify_before_gc || FLAG_verify_before_gc) ?
@@ -190,20 +531,14 @@ class MarkingVisitor : public ObjectPointerVisitor {
     ASSERT(!raw_obj->IsMarked());
     const bool is_watched = raw_obj->IsWatched();
     raw_obj->SetMarkBitUnsynchronized();
-    raw_obj->ClearRememberedBitUnsynchronized();
+    if (!incremental_) {
+      raw_obj->ClearRememberedBitUnsynchronized();
+    }
     raw_obj->ClearWatchedBitUnsynchronized();
     if (is_watched) {
-      std::pair<DelaySet::iterator, DelaySet::iterator> ret;
-      // Visit all elements with a key equal to raw_obj.
-      ret = delay_set_.equal_range(raw_obj);
-      // Create a copy of the range in a temporary vector to iterate over it
-      // while delay_set_ may be modified.
-      std::vector<DelaySetEntry> temp_copy(ret.first, ret.second);
-      delay_set_.erase(ret.first, ret.second);
-      for (std::vector<DelaySetEntry>::iterator it = temp_copy.begin();
-           it != temp_copy.end(); ++it) {
-        it->second->VisitPointers(this);
-      }
+      // The weak properties delayed on raw_obj are visited with the marking
+      // stack, which raw_obj is pushed onto below.
+      ephemerons_.Remove(raw_obj, &ready_weak_);
     }
     marking_stack_->Push(raw_obj);
   }
@@ -222,14 +557,29 @@ class MarkingVisitor : public ObjectPointerVisitor {
     // Skip over new objects, but verify consistency of heap while at it.
     if (raw_obj->IsNewObject()) {
       // TODO(iposva): Add consistency check.
+      if ((visiting_old_object_ != NULL) &&
+          visiting_old_object_->IsCardRemembered()) {
+        ASSERT(p != NULL);
+        HeapPage::OfLargeObject(visiting_old_object_)->RememberCard(p);
+      }
       if ((visiting_old_object_ != NULL) &&
           !visiting_old_object_->IsRemembered()) {
         ASSERT(p != NULL);
-        visiting_old_object_->SetRememberedBitUnsynchronized();
-        isolate()->store_buffer()->AddObjectGC(visiting_old_object_);
+        if (work_list_ != NULL) {
+          // Only this worker scans visiting_old_object_.
+          visiting_old_object_->SetRememberedBit();
+          remembered_.Add(visiting_old_object_);
+        } else {
+          visiting_old_object_->SetRememberedBitUnsynchronized();
+          isolate()->store_buffer()->AddObjectGC(visiting_old_object_);
+        }
       }
       return;
     }
+    if (work_list_ != NULL) {
+      MarkAndPushParallel(raw_obj);
+      return;
+    }
     if (RawObject::IsVariableSizeClassId(raw_obj->GetClassId())) {
       class_table_->UpdateLiveOld(raw_obj->GetClassId(), raw_obj->Size());
     } else {
@@ -291,11 +641,19 @@ class MarkingVisitor : public ObjectPointerVisitor {
   PageSpace* page_space_;
   MarkingStack* marking_stack_;
   RawObject* visiting_old_object_;
-  typedef std::multimap<RawObject*, RawWeakProperty*> DelaySet;
-  typedef std::pair<RawObject*, RawWeakProperty*> DelaySetEntry;
-  DelaySet delay_set_;
+  EphemeronTable ephemerons_;
+  MallocGrowableArray<RawWeakProperty*> ready_weak_;
   const bool visit_function_code_;
-  GrowableArray<RawFunction*> skipped_code_functions_;
+  bool incremental_;
+  MallocGrowableArray<RawFunction*> skipped_code_functions_;
+
+  // Parallel marking state, see StartParallelWork.
+  MarkingWorkList* work_list_;
+  intptr_t worker_id_;
+  AllocStats<intptr_t>* live_old_;
+  MallocGrowableArray<RawObject*> remembered_;
+  MallocGrowableArray<RawWeakProperty*> delayed_weak_;
+  intptr_t marked_bytes_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(MarkingVisitor);
 };
@@ -334,12 +692,58 @@ class MarkingWeakVisitor : public HandleVisitor {
 };
 
 
+class MarkTask : public ThreadPool::Task {
+ public:
+  MarkTask(Isolate* task_isolate,
+           MarkingVisitor* visitor,
+           MarkingWorkList* work_list)
+      : task_isolate_(task_isolate),
+        visitor_(visitor),
+        work_list_(work_list) {
+    work_list_->TaskStarted();
+  }
+
+  virtual void Run() {
+    Thread::EnterIsolate(task_isolate_);
+    visitor_->ProcessParallelWork();
+    Thread::ExitIsolate();
+    // The visitor and isolate are released by the mutator thread, which may
+    // proceed as soon as this is signalled.
+    work_list_->TaskFinished();
+  }
+
+ private:
+  Isolate* task_isolate_;
+  MarkingVisitor* visitor_;
+  MarkingWorkList* work_list_;
+
+  DISALLOW_COPY_AND_ASSIGN(MarkTask);
+};
+
+
+GCMarker::GCMarker(Heap* heap)
+    : heap_(heap),
+      marked_bytes_(0),
+      marking_stack_(NULL),
+      visitor_(NULL) {
+}
+
+
+GCMarker::~GCMarker() {
+  if (visitor_ != NULL) {
+    AbortIncremental();
+  }
+}
+
+
 void GCMarker::Prologue(Isolate* isolate, bool invoke_api_callbacks) {
   if (invoke_api_callbacks && (isolate->gc_prologue_callback() != NULL)) {
     (isolate->gc_prologue_callback())();
   }
-  // The store buffers will be rebuilt as part of marking, reset them now.
-  isolate->store_buffer()->Reset();
+  if (visitor_ == NULL) {
+    // The store buffers will be rebuilt as part of marking, reset them now.
+    isolate->store_buffer()->Reset();
+  }
 }
 
 
@@ -431,24 +835,80 @@ void GCMarker::IterateWeakReferences(Isolate* isolate,
 }
 
 
-void GCMarker::DrainMarkingStack(Isolate* isolate,
-                                 MarkingVisitor* visitor) {
+bool GCMarker::DrainMarkingStack(Isolate* isolate,
+                                 MarkingVisitor* visitor,
+                                 intptr_t budget) {
+  intptr_t scanned_bytes = 0;
+  // Weak properties become ready only when their key is pushed.
+  visitor->VisitReadyWeakProperties();
   while (!visitor->marking_stack()->IsEmpty()) {
+    if (scanned_bytes >= budget) {
+      visitor->VisitingOldObject(NULL);
+      return false;
+    }
     RawObject* raw_obj = visitor->marking_stack()->Pop();
     visitor->VisitingOldObject(raw_obj);
     const intptr_t class_id = raw_obj->GetClassId();
     // Currently, classes are considered roots (see issue 18284), so at this
-    // point, they should all be marked.
-    ASSERT(isolate->class_table()->At(class_id)->IsMarked());
+    // point, they should all be marked. Incremental marking only rescans the
+    // roots at the end.
+    ASSERT((visitor_ != NULL) ||
+           isolate->class_table()->At(class_id)->IsMarked());
+    intptr_t size;
     if (class_id != kWeakPropertyCid) {
-      marked_bytes_ += raw_obj->VisitPointers(visitor);
+      size = raw_obj->VisitPointers(visitor);
     } else {
       RawWeakProperty* raw_weak = reinterpret_cast<RawWeakProperty*>(raw_obj);
-      marked_bytes_ += raw_weak->Size();
+      size = raw_weak->Size();
       ProcessWeakProperty(raw_weak, visitor);
     }
+    marked_bytes_ += size;
+    scanned_bytes += size;
+    visitor->VisitReadyWeakProperties();
   }
   visitor->VisitingOldObject(NULL);
+  return true;
+}
+
+
+void GCMarker::ParallelMark(Isolate* isolate,
+                            PageSpace* page_space,
+                            MarkingVisitor* visitor) {
+  const intptr_t num_tasks = FLAG_marker_tasks;
+  const bool visit_function_code = visitor->visit_function_code();
+  MarkingWorkList work_list(num_tasks + 1);
+  // The mutator thread continues with the objects marked from the roots.
+  MarkingVisitor main_visitor(isolate, heap_, page_space,
+                              visitor->marking_stack(), visit_function_code);
+  main_visitor.StartParallelWork(&work_list, 0);
+  Isolate** task_isolates = new Isolate*[num_tasks];
+  MarkingStack** task_stacks = new MarkingStack*[num_tasks];
+  MarkingVisitor** task_visitors = new MarkingVisitor*[num_tasks];
+  ThreadPool* pool = Dart::thread_pool();
+  for (intptr_t i = 0; i < num_tasks; i++) {
+    task_isolates[i] = isolate->ShallowCopy();
+    task_stacks[i] = new MarkingStack();
+    task_visitors[i] = new MarkingVisitor(task_isolates[i], heap_, page_space,
+                                          task_stacks[i], visit_function_code);
+    task_visitors[i]->StartParallelWork(&work_list, i + 1);
+    pool->RunDedicated(
+        new MarkTask(task_isolates[i], task_visitors[i], &work_list));
+  }
+  main_visitor.ProcessParallelWork();
+  work_list.WaitForTasks();
+
+  // Merge the results of all workers. Weak properties whose keys were marked
+  // late are visited here and drained serially.
+  marked_bytes_ += main_visitor.FinishParallelWork(visitor);
+  for (intptr_t i = 0; i < num_tasks; i++) {
+    marked_bytes_ += task_visitors[i]->FinishParallelWork(visitor);
+    delete task_visitors[i];
+    delete task_stacks[i];
+    delete task_isolates[i];
+  }
+  delete[] task_visitors;
+  delete[] task_stacks;
+  delete[] task_isolates;
 }
 
 
@@ -523,12 +983,18 @@ void GCMarker::MarkObjects(Isolate* isolate,
   Prologue(isolate, invoke_api_callbacks);
   // The API prologue/epilogue may create/destroy zones, so we must not
   // depend on zone allocations surviving beyond the epilogue callback.
-  {
+  if (visitor_ != NULL) {
+    StackZone zone(isolate);
+    FinishIncremental(isolate, page_space, invoke_api_callbacks);
+  } else {
     StackZone zone(isolate);
     MarkingStack marking_stack;
     MarkingVisitor mark(
         isolate, heap_, page_space, &marking_stack, visit_function_code);
     IterateRoots(isolate, &mark, !invoke_api_callbacks);
+    if (FLAG_marker_tasks > 0) {
+      ParallelMark(isolate, page_space, &mark);
+    }
     DrainMarkingStack(isolate, &mark);
     IterateWeakReferences(isolate, &mark);
     MarkingWeakVisitor mark_weak;
@@ -540,4 +1006,149 @@ void GCMarker::MarkObjects(Isolate* isolate,
   Epilogue(isolate, invoke_api_callbacks);
 }
 
+
+void GCMarker::StartIncremental(Isolate* isolate, PageSpace* page_space) {
+  ASSERT(visitor_ == NULL);
+  // Code is not collected by incremental marking: skipped code functions could
+  // be reattached by the mutator before the remark.
+  const bool visit_function_code = true;
+  marking_stack_ = new MarkingStack();
+  visitor_ = new MarkingVisitor(
+      isolate, heap_, page_space, marking_stack_, visit_function_code);
+  visitor_->set_incremental(true);
+  page_space->WriteProtectCode(false);
+  IterateRoots(isolate, visitor_, false);
+  page_space->WriteProtectCode(true);
+}
+
+
+bool GCMarker::IncrementalStep(Isolate* isolate, intptr_t budget) {
+  ASSERT(visitor_ != NULL);
+  PageSpace* page_space = heap_->old_space();
+  page_space->WriteProtectCode(false);
+  MarkDeferred();
+  bool done = DrainMarkingStack(isolate, visitor_, budget);
+  page_space->WriteProtectCode(true);
+  return done;
+}
+
+
+void GCMarker::AbortIncremental() {
+  ASSERT(visitor_ != NULL);
+  while (!marking_stack_->IsEmpty()) {
+    marking_stack_->Pop();
+  }
+  MallocGrowableArray<RawWeakProperty*> delayed;
+  visitor_->TakeDelayedWeakProperties(&delayed);
+  delete visitor_;
+  visitor_ = NULL;
+  delete marking_stack_;
+  marking_stack_ = NULL;
+  allocated_.Clear();
+  deferred_.Clear();
+}
+
+
+void GCMarker::MarkIncremental(RawObject* raw_obj) {
+  ASSERT(visitor_ != NULL);
+  ASSERT(raw_obj->IsOldObject());
+  if (raw_obj->IsMarked()) {
+    return;
+  }
+  if (raw_obj->GetClassId() == kInstructionsCid) {
+    // Setting the mark bit has to wait until the code pages are writable.
+    deferred_.Add(raw_obj);
+    return;
+  }
+  visitor_->VisitPointer(&raw_obj);
+}
+
+
+void GCMarker::MarkDeferred() {
+  for (intptr_t i = 0; i < deferred_.length(); i++) {
+    RawObject* raw_obj = deferred_[i];
+    visitor_->VisitPointer(&raw_obj);
+  }
+  deferred_.Clear();
+}
+
+
+void GCMarker::RetryDelayedWeakProperties(MarkingVisitor* visitor) {
+  // The key of a delayed weak property may have been replaced by a marked
+  // object since it was scanned.
+  MallocGrowableArray<RawWeakProperty*> delayed;
+  visitor->TakeDelayedWeakProperties(&delayed);
+  for (intptr_t i = 0; i < delayed.length(); i++) {
+    ProcessWeakProperty(delayed[i], visitor);
+  }
+}
+
+
+void GCMarker::FilterStoreBuffer(Isolate* isolate) {
+  // Unlike full marking, incremental marking does not rebuild the store
+  // buffer. Drop the entries of objects that are about to be swept.
+  StoreBuffer* store_buffer = isolate->store_buffer();
+  StoreBufferBlock* pending = store_buffer->Blocks();
+  while (pending != NULL) {
+    StoreBufferBlock* next = pending->next();
+    for (intptr_t i = 0; i < pending->Count(); i++) {
+      RawObject* raw_object = pending->At(i);
+      if (raw_object->IsMarked()) {
+        store_buffer->AddObjectGC(raw_object);
+      }
+    }
+    delete pending;
+    pending = next;
+  }
+}
+
+
+void GCMarker::FinishIncremental(Isolate* isolate,
+                                 PageSpace* page_space,
+                                 bool invoke_api_callbacks) {
+  MarkingVisitor* visitor = visitor_;
+  IterateRoots(isolate, visitor, !invoke_api_callbacks);
+  // Objects allocated while marking may have been initialized without a
+  // barrier after they were scanned. Their size is already accounted for.
+  for (intptr_t i = 0; i < allocated_.length(); i++) {
+    RawObject* raw_obj = RawObject::FromAddr(allocated_[i]);
+    if (raw_obj->IsMarked()) {
+      visitor->VisitingOldObject(raw_obj);
+      if (raw_obj->GetClassId() != kWeakPropertyCid) {
+        raw_obj->VisitPointers(visitor);
+      } else {
+        ProcessWeakProperty(reinterpret_cast<RawWeakProperty*>(raw_obj),
+                            visitor);
+      }
+    }
+  }
+  visitor->VisitingOldObject(NULL);
+  allocated_.Clear();
+  MarkDeferred();
+  RetryDelayedWeakProperties(visitor);
+  DrainMarkingStack(isolate, visitor);
+  IterateWeakReferences(isolate, visitor);
+  MarkingWeakVisitor mark_weak;
+  IterateWeakRoots(isolate, &mark_weak, invoke_api_callbacks);
+  visitor->Finalize();
+  ProcessWeakTables(page_space);
+  ProcessObjectIdTable(isolate);
+  FilterStoreBuffer(isolate);
+  delete visitor_;
+  visitor_ = NULL;
+  delete marking_stack_;
+  marking_stack_ = NULL;
+}
+
+
+DEFINE_LEAF_RUNTIME_ENTRY(void, MarkingBarrier, 2,
+                          Isolate* isolate,
+                          RawObject* value) {
+  GCMarker* marker = isolate->heap()->old_space()->incremental_marker();
+  if (marker != NULL) {
+    marker->MarkIncremental(value);
+  }
+}
+END_LEAF_RUNTIME_ENTRY
+
 }  // namespace dart
@@ -6,6 +6,8 @@
 #define VM_GC_MARKER_H_
 
 #include "vm/allocation.h"
+#include "vm/flags.h"
+#include "vm/growable_array.h"
 
 namespace dart {
 
@@ -13,23 +15,47 @@ namespace dart {
 class HandleVisitor;
 class Heap;
 class Isolate;
+class MarkingStack;
 class MarkingVisitor;
 class ObjectPointerVisitor;
 class PageSpace;
+class RawObject;
 class RawWeakProperty;
 
+DECLARE_FLAG(bool, incremental_marking);
+DECLARE_FLAG(int, marker_tasks);
+
 // The class GCMarker is used to mark reachable old generation objects as part
 // of the mark-sweep collection. The marking bit used is defined in RawObject.
-class GCMarker : public ValueObject {
+//
+// With --incremental_marking, marking is spread over the mutator's run time:
+// StartIncremental marks the roots, IncrementalStep scans a bounded amount of
+// the heap, and the write barrier shades old objects stored into old objects.
+// MarkObjects then finishes the cycle in a short remark pause.
+class GCMarker {
  public:
-  explicit GCMarker(Heap* heap) : heap_(heap), marked_bytes_(0) { }
-  ~GCMarker() { }
+  explicit GCMarker(Heap* heap);
+  ~GCMarker();
 
   void MarkObjects(Isolate* isolate,
                    PageSpace* page_space,
                    bool invoke_api_callbacks,
                    bool collect_code);
 
+  void StartIncremental(Isolate* isolate, PageSpace* page_space);
+  // Scans about 'budget' bytes of marked objects. Returns true once there is
+  // nothing left to scan before the remark.
+  bool IncrementalStep(Isolate* isolate, intptr_t budget);
+  // Discards the incremental marking state. Leaves the mark bits to the caller.
+  void AbortIncremental();
+
+  // Shades an old object. Used by the write barrier and for objects promoted
+  // while marking.
+  void MarkIncremental(RawObject* raw_obj);
+  // Old objects allocated while marking may be initialized without a barrier.
+  // They are scanned again by the remark.
+  void RecordAllocation(uword addr) { allocated_.Add(addr); }
+
   intptr_t marked_words() { return marked_bytes_ >> kWordSizeLog2; }
 
  private:
@@ -42,15 +68,37 @@ class GCMarker : public ValueObject {
                         HandleVisitor* visitor,
                         bool visit_prologue_weak_persistent_handles);
   void IterateWeakReferences(Isolate* isolate, MarkingVisitor* visitor);
-  void DrainMarkingStack(Isolate* isolate, MarkingVisitor* visitor);
+  // Scans objects until the marking stack is empty or about 'budget' bytes
+  // were scanned. Returns true if the marking stack is empty.
+  bool DrainMarkingStack(Isolate* isolate,
+                         MarkingVisitor* visitor,
+                         intptr_t budget = kIntptrMax);
+  // Drains the marking stack of 'visitor' using the mutator thread and
+  // --marker_tasks helper tasks. The merged results are left to 'visitor'.
+  void ParallelMark(Isolate* isolate,
+                    PageSpace* page_space,
+                    MarkingVisitor* visitor);
   void ProcessWeakProperty(RawWeakProperty* raw_weak, MarkingVisitor* visitor);
   void ProcessWeakTables(PageSpace* page_space);
   void ProcessObjectIdTable(Isolate* isolate);
-
+  // The remark pause of incremental marking.
+  void FinishIncremental(Isolate* isolate,
+                         PageSpace* page_space,
+                         bool invoke_api_callbacks);
+  void MarkDeferred();
+  void RetryDelayedWeakProperties(MarkingVisitor* visitor);
+  void FilterStoreBuffer(Isolate* isolate);
 
   Heap* heap_;
   intptr_t marked_bytes_;
 
+  // Incremental marking state, live between StartIncremental and the remark.
+  MarkingStack* marking_stack_;
+  MarkingVisitor* visitor_;
+  MallocGrowableArray<uword> allocated_;
+  // Instructions shaded while the code pages are write-protected.
+  MallocGrowableArray<RawObject*> deferred_;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(GCMarker);
 };
 
@@ -10,9 +10,14 @@
 #include "vm/lockers.h"
 #include "vm/pages.h"
 #include "vm/thread_pool.h"
+#include "vm/virtual_memory.h"
 
 namespace dart {
 
+// Free blocks smaller than this are not worth returning to the OS.
+static const intptr_t kMinReleaseSize = 64 * KB;
+
+
 bool GCSweeper::SweepPage(HeapPage* page, FreeList* freelist, bool locked) {
   // Keep track whether this page is still in use.
   bool in_use = false;
@@ -50,6 +55,13 @@ bool GCSweeper::SweepPage(HeapPage* page, FreeList* freelist, bool locked) {
 #endif  // DEBUG
       }
       if ((current != start) || (free_end != end)) {
+        if (!is_executable &&
+            FLAG_old_gen_release_memory &&
+            (obj_size >= kMinReleaseSize)) {
+          // Keep the header of the free list element.
+          released_in_bytes_ += VirtualMemory::Discard(
+              current + FreeListElement::HeaderSizeFor(obj_size), free_end);
+        }
         // Only add to the free list if not covering the whole page.
         if (locked) {
           freelist->FreeLocked(current, obj_size);
@@ -137,6 +149,7 @@ class SweeperTask : public ThreadPool::Task {
       if (page == last_) break;
       page = next_page;
     }
+    old_space_->AddReleasedInBytes(sweeper.released_in_bytes());
     // This sweeper task is done. Notify the original isolate.
     {
       MonitorLocker ml(old_space_->tasks_lock());
@@ -166,7 +179,7 @@ void GCSweeper::SweepConcurrent(Isolate* isolate,
                       first, last,
                       freelist);
   ThreadPool* pool = Dart::thread_pool();
-  pool->Run(task);
+  pool->RunDedicated(task);
 }
 
 }  // namespace dart
@@ -20,7 +20,7 @@ class PageSpace;
 // memory.
 class GCSweeper {
  public:
-  GCSweeper() {}
+  GCSweeper() : released_in_bytes_(0) {}
   ~GCSweeper() {}
 
   // Sweep the memory area for the page while clearing the mark bits and adding
@@ -39,6 +39,12 @@ class GCSweeper {
                               HeapPage* first,
                               HeapPage* last,
                               FreeList* freelist);
+
+  // The number of bytes of large free blocks returned to the OS so far.
+  intptr_t released_in_bytes() const { return released_in_bytes_; }
+
+ private:
+  intptr_t released_in_bytes_;
 };
 
 }  // namespace dart
@@ -6,6 +6,7 @@
 
 #include "platform/assert.h"
 #include "platform/utils.h"
+#include "vm/allocation_site_table.h"
 #include "vm/flags.h"
 #include "vm/isolate.h"
 #include "vm/lockers.h"
@@ -26,12 +27,22 @@ namespace dart {
 
 DEFINE_FLAG(bool, disable_alloc_stubs_after_gc, false, "Stress testing flag.");
 DEFINE_FLAG(bool, gc_at_alloc, false, "GC at every allocation.");
+DEFINE_FLAG(int, gc_pause_goal, 0,
+            "Adapt the heap sizes to keep GC pauses under this many "
+            "milliseconds (0 disables).");
+DEFINE_FLAG(int, gc_time_goal, 0,
+            "Adapt the heap sizes to keep the time spent in GC under this "
+            "percentage (0 disables).");
 DEFINE_FLAG(int, new_gen_ext_limit, 64,
             "maximum total external size (MB) in new gen before triggering GC");
 DEFINE_FLAG(int, pretenure_interval, 10,
             "Back off pretenuring after this many cycles.");
+DEFINE_FLAG(int, pretenure_sample_interval, 32,
+            "Sample the survival of one object per this many KB allocated in "
+            "new space to pretenure allocation sites (0 disables sampling).");
 DEFINE_FLAG(int, pretenure_threshold, 98,
-            "Trigger pretenuring when this many percent are promoted.");
+            "Trigger pretenuring when this many percent are promoted, or "
+            "survive their first scavenge for allocation sites.");
 DEFINE_FLAG(bool, verbose_gc, false, "Enables verbose GC.");
 DEFINE_FLAG(int, verbose_gc_hdr, 40, "Print verbose GC header interval.");
 DEFINE_FLAG(bool, verify_after_gc, false,
@@ -39,6 +50,7 @@ DEFINE_FLAG(bool, verify_after_gc, false,
 DEFINE_FLAG(bool, verify_before_gc, false,
             "Enables heap verification before GC.");
 DEFINE_FLAG(bool, pretenure_all, false, "Global pretenuring (for testing).");
+DECLARE_FLAG(int, profile_allocation_interval);
 
 
 Heap::Heap(Isolate* isolate,
@@ -48,7 +60,9 @@ Heap::Heap(Isolate* isolate,
     : isolate_(isolate),
       read_only_(false),
       gc_in_progress_(false),
-      pretenure_policy_(0) {
+      pretenure_policy_(0),
+      allocation_sites_(new AllocationSiteTable()),
+      allocated_since_profile_sample_(0) {
   for (int sel = 0;
        sel < kNumWeakSelectors;
        sel++) {
@@ -72,6 +86,7 @@ Heap::~Heap() {
     delete new_weak_tables_[sel];
     delete old_weak_tables_[sel];
   }
+  delete allocation_sites_;
 }
 
 
@@ -238,6 +253,7 @@ RawObject* Heap::FindOldObject(FindObjectVisitor* visitor) const {
   while (old_space_->tasks() > 0) {
     ml.Wait();
   }
+  old_space_->CompleteSweep();
   return old_space_->FindObject(visitor, HeapPage::kData);
 }
 
@@ -277,9 +293,17 @@ void Heap::CollectGarbage(Space space,
       UpdatePretenurePolicy();
       RecordAfterGC();
       PrintStats();
-      if (old_space_->NeedsGarbageCollection()) {
-        // Old collections should call the API callbacks.
-        CollectGarbage(kOld, kInvokeApiCallbacks, kPromotion);
+      if (old_space_->IsMarking()) {
+        if (old_space_->IncrementalMarkingStep()) {
+          CollectGarbage(kOld, kInvokeApiCallbacks, kPromotion);
+        }
+      } else if (old_space_->NeedsGarbageCollection()) {
+        if (FLAG_incremental_marking) {
+          StartIncrementalMarking();
+        } else {
+          // Old collections should call the API callbacks.
+          CollectGarbage(kOld, kInvokeApiCallbacks, kPromotion);
+        }
       }
       break;
     }
@@ -287,7 +311,9 @@ void Heap::CollectGarbage(Space space,
     case kCode: {
       VMTagScope tagScope(isolate(), VMTag::kGCOldSpaceTagId);
       RecordBeforeGC(kOld, reason);
-      UpdateClassHeapStatsBeforeGC(kOld);
+      if (!old_space_->IsMarking()) {
+        UpdateClassHeapStatsBeforeGC(kOld);
+      }
       old_space_->MarkSweep(invoke_api_callbacks);
       RecordAfterGC();
       PrintStats();
@@ -299,6 +325,58 @@ void Heap::CollectGarbage(Space space,
 }
 
 
+void Heap::StartIncrementalMarking() {
+  ASSERT(FLAG_incremental_marking);
+  if (old_space_->IsMarking()) {
+    return;
+  }
+  VMTagScope tagScope(isolate(), VMTag::kGCOldSpaceTagId);
+  // The live old counts are accumulated while marking.
+  UpdateClassHeapStatsBeforeGC(kOld);
+  old_space_->StartIncrementalMarking();
+}
+
+
+// Whether work estimated to take 'micros' can be done before 'deadline'. Work
+// that has not been timed yet is not started.
+static bool HasTimeFor(int64_t micros, int64_t deadline) {
+  return (micros > 0) && (OS::GetCurrentTimeMicros() + micros <= deadline);
+}
+
+
+void Heap::NotifyIdle(int64_t deadline) {
+  ASSERT(!read_only_);
+  // Scavenging early may promote objects that would have died before the
+  // next scavenge, so only scavenge once new space is half full.
+  if ((2 * new_space_->UsedInWords() >= new_space_->CapacityInWords()) &&
+      HasTimeFor(new_space_->EstimateScavengeMicros(), deadline)) {
+    CollectGarbage(kNew, kInvokeApiCallbacks, kIdle);
+  }
+  if (!old_space_->IsMarking() && old_space_->NeedsIdleGarbageCollection()) {
+    if (FLAG_incremental_marking) {
+      if (OS::GetCurrentTimeMicros() < deadline) {
+        StartIncrementalMarking();
+      }
+    } else if (HasTimeFor(old_space_->EstimateGarbageCollectionMicros(),
+                          deadline)) {
+      CollectGarbage(kOld, kInvokeApiCallbacks, kIdle);
+    }
+  }
+  if (old_space_->IsMarking()) {
+    bool marked = false;
+    {
+      VMTagScope tagScope(isolate(), VMTag::kGCOldSpaceTagId);
+      marked = old_space_->IncrementalMarkingStepUntil(deadline);
+    }
+    if (marked && (OS::GetCurrentTimeMicros() < deadline)) {
+      CollectGarbage(kOld, kInvokeApiCallbacks, kIdle);
+    }
+  }
+  VMTagScope tagScope(isolate(), VMTag::kGCOldSpaceTagId);
+  old_space_->SweepUntil(deadline);
+}
+
+
 void Heap::UpdateClassHeapStatsBeforeGC(Heap::Space space) {
   ClassTable* class_table = isolate()->class_table();
   if (space == kNew) {
@@ -334,7 +412,9 @@ void Heap::CollectAllGarbage() {
   {
     VMTagScope tagScope(isolate(), VMTag::kGCOldSpaceTagId);
     RecordBeforeGC(kOld, kFull);
-    UpdateClassHeapStatsBeforeGC(kOld);
+    if (!old_space_->IsMarking()) {
+      UpdateClassHeapStatsBeforeGC(kOld);
+    }
     old_space_->MarkSweep(kInvokeApiCallbacks);
     RecordAfterGC();
     PrintStats();
@@ -376,6 +456,54 @@ void Heap::UpdatePretenurePolicy() {
 }
 
 
+bool Heap::TakeAllocationSample(RawObject* raw_obj) {
+  return (FLAG_pretenure_sample_interval > 0) &&
+      raw_obj->IsNewObject() &&
+      new_space_->TakeAllocationSample(RawObject::ToAddr(raw_obj));
+}
+
+
+void Heap::AddAllocationSample(RawObject* raw_obj,
+                               const Function& function,
+                               intptr_t token_pos) {
+  const Class& owner = Class::Handle(isolate_, function.Owner());
+  const intptr_t site =
+      allocation_sites_->Lookup(owner.id(), function.token_pos(), token_pos);
+  new_space_->AddAllocationSample(RawObject::ToAddr(raw_obj), site);
+}
+
+
+bool Heap::ShouldProfileAllocation(uword addr, intptr_t size) {
+  if (FLAG_profile_allocation_interval <= 0) {
+    return false;
+  }
+  if (new_space_->Contains(addr)) {
+    // Only allocations past the sampling limit of new space are seen, each
+    // standing for the bytes allocated up to the limit.
+    if (!new_space_->IsAllocationSample(addr)) {
+      return false;
+    }
+    size = Scavenger::SamplingIntervalInBytes();
+  }
+  allocated_since_profile_sample_ += size;
+  if (allocated_since_profile_sample_ <
+      FLAG_profile_allocation_interval * KB) {
+    return false;
+  }
+  allocated_since_profile_sample_ = 0;
+  return true;
+}
+
+
+bool Heap::ShouldPretenureSite(const Function& function,
+                               intptr_t token_pos) const {
+  const Class& owner = Class::Handle(isolate_, function.Owner());
+  const intptr_t site =
+      allocation_sites_->Find(owner.id(), function.token_pos(), token_pos);
+  return (site >= 0) && allocation_sites_->ShouldPretenure(site);
+}
+
+
 void Heap::SetGrowthControlState(bool state) {
   old_space_->SetGrowthControlState(state);
 }
@@ -539,6 +667,8 @@ const char* Heap::GCReasonToString(GCReason gc_reason) {
       return "debugging";
     case kGCTestCase:
       return "test case";
+    case kIdle:
+      return "idle";
     default:
       UNREACHABLE();
       return "";
@@ -551,6 +681,29 @@ int64_t Heap::PeerCount() const {
 }
 
 
+void Heap::SetHash(RawObject* raw_obj, intptr_t hash) {
+#if defined(HASH_IN_OBJECT_HEADER)
+  ASSERT(Utils::IsUint(32, hash));
+  if (raw_obj->IsNewObject() || !raw_obj->IsVMHeapObject()) {
+    raw_obj->SetHeaderHash(static_cast<uint32_t>(hash));
+    return;
+  }
+#endif
+  SetWeakEntry(raw_obj, kHashes, hash);
+}
+
+
+intptr_t Heap::GetHash(RawObject* raw_obj) const {
+#if defined(HASH_IN_OBJECT_HEADER)
+  const intptr_t hash = raw_obj->GetHeaderHash();
+  if ((hash != 0) || raw_obj->IsNewObject() || !raw_obj->IsVMHeapObject()) {
+    return hash;
+  }
+#endif
+  return GetWeakEntry(raw_obj, kHashes);
+}
+
+
 int64_t Heap::HashCount() const {
   return
       new_weak_tables_[kHashes]->count() + old_weak_tables_[kHashes]->count();
@@ -18,6 +18,8 @@
 namespace dart {
 
 // Forward declarations.
+class AllocationSiteTable;
+class Function;
 class Isolate;
 class ObjectPointerVisitor;
 class ObjectSet;
@@ -56,6 +58,7 @@ class Heap {
     kFull,
     kGCAtAlloc,
     kGCTestCase,
+    kIdle,
   };
 
 #if defined(DEBUG)
@@ -128,6 +131,18 @@ class Heap {
   void CollectGarbage(Space space, ApiCallbacks api_callbacks, GCReason reason);
   void CollectAllGarbage();
 
+  // Incremental marking of the old generation, see --incremental_marking.
+  // Marking steps are taken after scavenges and the cycle is finished by the
+  // next old generation collection.
+  void StartIncrementalMarking();
+  void AbortIncrementalMarking() { old_space_->AbortIncrementalMarking(); }
+
+  // Uses the idle time until 'deadline', in microseconds as returned by
+  // OS::GetCurrentTimeMicros, for the GC work that is expected to fit: a
+  // scavenge of a mostly full new space, incremental marking or an old
+  // generation collection that is due soon, and lazy sweeping.
+  void NotifyIdle(int64_t deadline);
+
   // Enables growth control on the page space heaps.  This should be
   // called before any user code is executed.
   void EnableGrowthControl() { SetGrowthControlState(true); }
@@ -144,6 +159,10 @@ class Heap {
   // Accessors for inlined allocation in generated code.
   uword TopAddress(Space space);
   uword EndAddress(Space space);
+  // Word that is non-zero while incremental marking is in progress.
+  uword IncrementalMarkingAddress() {
+    return reinterpret_cast<uword>(old_space_->IncrementalMarkingAddress());
+  }
   Space SpaceForAllocation(intptr_t class_id) const;
 
   // Initialize the heap and register it with the isolate.
@@ -181,13 +200,10 @@ class Heap {
   int64_t PeerCount() const;
 
   // Associate an identity hashCode with an object. An non-existent hashCode
-  // is equal to 0.
-  void SetHash(RawObject* raw_obj, intptr_t hash) {
-    SetWeakEntry(raw_obj, kHashes, hash);
-  }
-  intptr_t GetHash(RawObject* raw_obj) const {
-    return GetWeakEntry(raw_obj, kHashes);
-  }
+  // is equal to 0. With HASH_IN_OBJECT_HEADER, the weak table only holds the
+  // hashCodes of the read-only objects of the VM isolate.
+  void SetHash(RawObject* raw_obj, intptr_t hash);
+  intptr_t GetHash(RawObject* raw_obj) const;
   int64_t HashCount() const;
 
   // Used by the GC algorithms to propagate weak entries.
@@ -238,6 +254,22 @@ class Heap {
 
   bool ShouldPretenure(intptr_t class_id) const;
 
+  // Allocation site feedback. The runtime takes the allocation sample of the
+  // new-space object 'raw_obj', if it is one, and records it for the
+  // allocation site at 'token_pos' in 'function'.
+  bool TakeAllocationSample(RawObject* raw_obj);
+  void AddAllocationSample(RawObject* raw_obj,
+                           const Function& function,
+                           intptr_t token_pos);
+  // Whether most of the sampled objects allocated at 'token_pos' in
+  // 'function' survived their first scavenge.
+  bool ShouldPretenureSite(const Function& function, intptr_t token_pos) const;
+  AllocationSiteTable* allocation_sites() const { return allocation_sites_; }
+
+  // Whether the stack of the allocation of 'size' bytes at 'addr' is to be
+  // recorded by the allocation profiler, see --profile_allocation_interval.
+  bool ShouldProfileAllocation(uword addr, intptr_t size);
+
  private:
   class GCStats : public ValueObject {
    public:
@@ -311,6 +343,10 @@ class Heap {
   bool gc_in_progress_;
 
   int pretenure_policy_;
+  AllocationSiteTable* allocation_sites_;
+
+  // Bytes allocated since the last allocation profiler sample.
+  intptr_t allocated_since_profile_sample_;
 
   friend class GCEvent;
   friend class GCTestHelper;
@@ -5,13 +5,25 @@
 #include "platform/globals.h"
 
 #include "platform/assert.h"
+#include "vm/compiler.h"
 #include "vm/dart_api_impl.h"
+#include "vm/flow_graph_compiler.h"
+#include "vm/gc_marker.h"
 #include "vm/globals.h"
 #include "vm/heap.h"
+#include "vm/json_stream.h"
+#include "vm/scavenger.h"
 #include "vm/unit_test.h"
 
 namespace dart {
 
+DECLARE_FLAG(bool, concurrent_sweep);
+DECLARE_FLAG(int, gc_pause_goal);
+DECLARE_FLAG(bool, lazy_sweep);
+DECLARE_FLAG(int, marking_step_kb);
+DECLARE_FLAG(int, pretenure_sample_interval);
+DECLARE_FLAG(bool, use_osr);
+
 TEST_CASE(OldGC) {
   const char* kScriptChars =
   "main() {\n"
@@ -263,4 +275,687 @@ TEST_CASE(IterateReadOnly) {
   EXPECT(heap->Contains(RawObject::ToAddr(obj.raw())));
 }
 
+TEST_CASE(ParallelScavenge) {
+  const char* kScriptChars =
+  "var root;\n"
+  "var expando = new Expando();\n"
+  "build() {\n"
+  "  root = new List(2000);\n"
+  "  for (var i = 0; i < root.length; i++) {\n"
+  "    root[i] = [i, 'v$i', new List(i % 700)];\n"
+  "    expando[root[i]] = i;\n"
+  "  }\n"
+  "  for (var i = 0; i < 500; i++) {\n"
+  "    expando[new Object()] = i;\n"
+  "  }\n"
+  "}\n"
+  "check() {\n"
+  "  for (var i = 0; i < root.length; i++) {\n"
+  "    var entry = root[i];\n"
+  "    if (entry[0] != i) return false;\n"
+  "    if (entry[1] != 'v$i') return false;\n"
+  "    if (entry[2].length != i % 700) return false;\n"
+  "    if (expando[entry] != i) return false;\n"
+  "  }\n"
+  "  return true;\n"
+  "}\n";
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  Dart_Handle result = Dart_Invoke(lib, NewString("build"), 0, NULL);
+  EXPECT_VALID(result);
+  const intptr_t saved_tasks = FLAG_scavenger_tasks;
+  FLAG_scavenger_tasks = 3;
+  Heap* heap = Isolate::Current()->heap();
+  // The second and third scavenges promote the survivors of the first.
+  for (intptr_t i = 0; i < 3; i++) {
+    heap->CollectGarbage(Heap::kNew);
+    result = Dart_Invoke(lib, NewString("check"), 0, NULL);
+    EXPECT_VALID(result);
+    bool value = false;
+    EXPECT_VALID(Dart_BooleanValue(result, &value));
+    EXPECT(value);
+  }
+  FLAG_scavenger_tasks = saved_tasks;
+}
+
+
+TEST_CASE(ParallelMark) {
+  Isolate* isolate = Isolate::Current();
+  Heap* heap = isolate->heap();
+  const intptr_t kLength = 2000;
+  const Array& root = Array::Handle(Array::New(kLength, Heap::kOld));
+  const Array& weaks = Array::Handle(Array::New(kLength, Heap::kOld));
+  {
+    HANDLESCOPE(isolate);
+    Array& entry = Array::Handle();
+    WeakProperty& weak = WeakProperty::Handle();
+    for (intptr_t i = 0; i < kLength; i++) {
+      entry = Array::New(2, Heap::kOld);
+      entry.SetAt(0, Smi::Handle(Smi::New(i)));
+      entry.SetAt(1, Array::Handle(Array::New(i % 700, Heap::kOld)));
+      // Odd entries are only reachable as the keys of weak properties.
+      if ((i % 2) == 0) {
+        root.SetAt(i, entry);
+      }
+      weak = WeakProperty::New(Heap::kOld);
+      weak.set_key(entry);
+      weak.set_value(Array::Handle(Array::New(1, Heap::kOld)));
+      weaks.SetAt(i, weak);
+    }
+  }
+  const intptr_t saved_tasks = FLAG_marker_tasks;
+  FLAG_marker_tasks = 3;
+  heap->CollectGarbage(Heap::kOld);
+  FLAG_marker_tasks = saved_tasks;
+  Array& entry = Array::Handle();
+  WeakProperty& weak = WeakProperty::Handle();
+  for (intptr_t i = 0; i < kLength; i++) {
+    weak ^= weaks.At(i);
+    if ((i % 2) == 0) {
+      entry ^= root.At(i);
+      EXPECT_EQ(i, Smi::Value(Smi::RawCast(entry.At(0))));
+      EXPECT_EQ(i % 700, Array::Handle(Array::RawCast(entry.At(1))).Length());
+      EXPECT(weak.key() == entry.raw());
+      EXPECT(weak.value() != Object::null());
+    } else {
+      EXPECT(weak.key() == Object::null());
+      EXPECT(weak.value() == Object::null());
+    }
+  }
+  // The helpers' class statistics are merged into the isolate's, which count
+  // at least the live entries.
+  ClassHeapStats* stats = isolate->class_table()->StatsWithUpdatedSize(
+      kArrayCid);
+  EXPECT_LE(kLength / 2, stats->post_gc.old_count);
+}
+
+
+// The write barrier is only generated if the flag is set when the isolate is
+// created.
+UNIT_TEST_CASE(IncrementalMarking) {
+  const char* kScriptChars =
+      "store(holder, value) {\n"
+      "  holder[0] = value;\n"
+      "}\n";
+  const bool saved_incremental_marking = FLAG_incremental_marking;
+  const int saved_step_kb = FLAG_marking_step_kb;
+  FLAG_incremental_marking = true;
+  FLAG_marking_step_kb = 64;
+  Isolate* isolate = reinterpret_cast<Isolate*>(TestCase::CreateTestIsolate());
+  Dart_EnterScope();
+  {
+    StackZone zone(isolate);
+    HandleScope scope(isolate);
+    Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+    Heap* heap = isolate->heap();
+    PageSpace* old_space = heap->old_space();
+    const Array& holder = Array::Handle(Array::New(2, Heap::kOld));
+    // The values are only reachable through 'hidden', which is not scanned
+    // yet when marking starts, and the garbage only through a weak property.
+    const Array& hidden = Array::Handle(Array::New(2, Heap::kOld));
+    const WeakProperty& weak =
+        WeakProperty::Handle(WeakProperty::New(Heap::kOld));
+    {
+      HANDLESCOPE(isolate);
+      hidden.SetAt(0, Array::Handle(Array::New(1, Heap::kOld)));
+      hidden.SetAt(1, Array::Handle(Array::New(1, Heap::kOld)));
+      weak.set_key(Array::Handle(Array::New(1, Heap::kOld)));
+    }
+    // Compile the store before marking starts.
+    Dart_Handle args[2] = { Api::NewHandle(isolate, holder.raw()),
+                            Api::NewHandle(isolate, Smi::New(0)) };
+    EXPECT_VALID(Dart_Invoke(lib, NewString("store"), 2, args));
+
+    heap->StartIncrementalMarking();
+    EXPECT(old_space->IsMarking());
+    Array& value = Array::Handle();
+    // The runtime shades old values stored into old objects.
+    value ^= hidden.At(0);
+    EXPECT(!value.raw()->IsMarked());
+    holder.SetAt(1, value);
+    EXPECT(value.raw()->IsMarked());
+    // So does compiled code.
+    value ^= hidden.At(1);
+    EXPECT(!value.raw()->IsMarked());
+    args[1] = Api::NewHandle(isolate, value.raw());
+    EXPECT_VALID(Dart_Invoke(lib, NewString("store"), 2, args));
+    EXPECT(holder.At(0) == value.raw());
+    EXPECT(value.raw()->IsMarked());
+    hidden.SetAt(0, Object::null_object());
+    hidden.SetAt(1, Object::null_object());
+
+    // Marking steps are taken after scavenges, and the cycle is finished once
+    // there is nothing left to scan.
+    for (intptr_t i = 0; (i < 1000) && old_space->IsMarking(); i++) {
+      Array::New(1000, Heap::kOld);
+      heap->CollectGarbage(Heap::kNew);
+    }
+    EXPECT(!old_space->IsMarking());
+    EXPECT(weak.key() == Object::null());
+    value ^= holder.At(0);
+    EXPECT_EQ(1, value.Length());
+    value ^= holder.At(1);
+    EXPECT_EQ(1, value.Length());
+  }
+  Dart_ExitScope();
+  Dart_ShutdownIsolate();
+  FLAG_marking_step_kb = saved_step_kb;
+  FLAG_incremental_marking = saved_incremental_marking;
+}
+
+
+UNIT_TEST_CASE(NotifyIdle) {
+  const char* kScriptChars =
+      "allocate(n) {\n"
+      "  var list;\n"
+      "  for (var i = 0; i < n; i++) {\n"
+      "    list = new List(8);\n"
+      "  }\n"
+      "  return list;\n"
+      "}\n";
+  const bool saved_incremental_marking = FLAG_incremental_marking;
+  FLAG_incremental_marking = true;
+  Isolate* isolate = reinterpret_cast<Isolate*>(TestCase::CreateTestIsolate());
+  Dart_EnterScope();
+  {
+    StackZone zone(isolate);
+    HandleScope scope(isolate);
+    Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+    Heap* heap = isolate->heap();
+    Scavenger* new_space = heap->new_space();
+    // Only work that has been timed before is done in idle time.
+    heap->CollectGarbage(Heap::kNew);
+    Dart_Handle args[1] = { Dart_NewInteger(1000) };
+    while (2 * new_space->UsedInWords() < new_space->CapacityInWords()) {
+      EXPECT_VALID(Dart_Invoke(lib, NewString("allocate"), 1, args));
+    }
+    const int64_t kIdleMicros = 10 * kMicrosecondsPerSecond;
+    intptr_t collections = heap->Collections(Heap::kNew);
+    Dart_NotifyIdle(0);
+    EXPECT_EQ(collections, heap->Collections(Heap::kNew));
+    Dart_NotifyIdle(OS::GetCurrentTimeMicros() + kIdleMicros);
+    EXPECT_EQ(collections + 1, heap->Collections(Heap::kNew));
+
+    // Idle time is used to finish incremental marking.
+    if (!heap->old_space()->IsMarking()) {
+      heap->StartIncrementalMarking();
+    }
+    collections = heap->Collections(Heap::kOld);
+    Dart_NotifyIdle(OS::GetCurrentTimeMicros() + kIdleMicros);
+    EXPECT(!heap->old_space()->IsMarking());
+    EXPECT_EQ(collections + 1, heap->Collections(Heap::kOld));
+  }
+  Dart_ExitScope();
+  Dart_ShutdownIsolate();
+  FLAG_incremental_marking = saved_incremental_marking;
+}
+
+
+TEST_CASE(IdentityHashCode) {
+  const char* kScriptChars =
+      "hash(object) => identityHashCode(object);\n";
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  Isolate* isolate = Isolate::Current();
+  Heap* heap = isolate->heap();
+  const intptr_t kLength = 1000;
+  const Array& objects = Array::Handle(Array::New(kLength));
+  Array& object = Array::Handle();
+  for (intptr_t i = 0; i < kLength; i++) {
+    object = Array::New(0);
+    heap->SetHash(object.raw(), i + 1);
+    objects.SetAt(i, object);
+  }
+  // The hashes move with the objects, including when they are promoted.
+  heap->CollectGarbage(Heap::kNew);
+  heap->CollectGarbage(Heap::kNew);
+  heap->CollectGarbage(Heap::kOld);
+  for (intptr_t i = 0; i < kLength; i++) {
+    object ^= objects.At(i);
+    EXPECT(object.raw()->IsOldObject());
+    EXPECT_EQ(i + 1, heap->GetHash(object.raw()));
+  }
+  // Compiled code reads the same hash.
+  object ^= objects.At(kLength - 1);
+  Dart_Handle arg = Api::NewHandle(isolate, object.raw());
+  Dart_Handle result = Dart_Invoke(lib, NewString("hash"), 1, &arg);
+  EXPECT_VALID(result);
+  int64_t hash = 0;
+  EXPECT_VALID(Dart_IntegerToInt64(result, &hash));
+  EXPECT_EQ(kLength, hash);
+#if defined(HASH_IN_OBJECT_HEADER)
+  // Only objects of the read-only VM isolate heap use the weak table.
+  EXPECT_EQ(0, heap->HashCount());
+#endif
+}
+
+
+TEST_CASE(CompactOldSpace) {
+  Isolate* isolate = Isolate::Current();
+  Heap* heap = isolate->heap();
+  const intptr_t kLength = 200000;
+  const Array& keep = Array::Handle(Array::New(kLength / 10, Heap::kOld));
+  {
+    HANDLESCOPE(isolate);
+    Array& entry = Array::Handle();
+    for (intptr_t i = 0; i < kLength; i++) {
+      entry = Array::New(2, Heap::kOld);
+      entry.SetAt(0, Smi::Handle(Smi::New(i)));
+      // Keep every tenth entry, spread over all the pages.
+      if ((i % 10) == 0) {
+        keep.SetAt(i / 10, entry);
+      }
+    }
+  }
+  GrowableArray<uword> addresses;
+  for (intptr_t i = 0; i < keep.Length(); i++) {
+    addresses.Add(RawObject::ToAddr(keep.At(i)));
+  }
+  // References from outside the objects that have to be forwarded.
+  int peer = 0;
+  Array& entry = Array::Handle();
+  entry ^= keep.At(1);
+  heap->SetPeer(entry.raw(), &peer);
+  const WeakProperty& weak =
+      WeakProperty::Handle(WeakProperty::New(Heap::kOld));
+  weak.set_key(entry);
+  entry ^= keep.At(2);
+  entry.SetAt(1, String::Handle(String::New("young")));
+
+  const bool saved_compact = FLAG_compact_old_space;
+  FLAG_compact_old_space = true;
+  const intptr_t capacity_before = heap->old_space()->CapacityInWords();
+  heap->CollectGarbage(Heap::kOld);
+  EXPECT(heap->old_space()->CapacityInWords() < capacity_before);
+  intptr_t moved = 0;
+  for (intptr_t i = 0; i < keep.Length(); i++) {
+    entry ^= keep.At(i);
+    EXPECT_EQ(i * 10, Smi::Value(Smi::RawCast(entry.At(0))));
+    if (RawObject::ToAddr(entry.raw()) != addresses[i]) {
+      moved++;
+    }
+  }
+  EXPECT_LT(0, moved);
+  entry ^= keep.At(1);
+  EXPECT(heap->GetPeer(entry.raw()) == &peer);
+  EXPECT(weak.key() == entry.raw());
+  // The store buffer still finds the evacuated entry pointing to new space.
+  heap->CollectGarbage(Heap::kNew);
+  entry ^= keep.At(2);
+  EXPECT(String::Handle(String::RawCast(entry.At(1))).Equals("young"));
+  FLAG_compact_old_space = saved_compact;
+}
+
+
+TEST_CASE(LazySweep) {
+  Isolate* isolate = Isolate::Current();
+  Heap* heap = isolate->heap();
+  const intptr_t kLength = 40000;
+  const Array& keep = Array::Handle(Array::New(kLength / 10, Heap::kOld));
+  {
+    HANDLESCOPE(isolate);
+    Array& entry = Array::Handle();
+    for (intptr_t i = 0; i < kLength; i++) {
+      entry = Array::New(1, Heap::kOld);
+      entry.SetAt(0, Smi::Handle(Smi::New(i)));
+      // Keep the first tenth of the entries, the later pages die.
+      if (i < keep.Length()) {
+        keep.SetAt(i, entry);
+      }
+    }
+  }
+  const bool saved_lazy_sweep = FLAG_lazy_sweep;
+  FLAG_lazy_sweep = true;
+  heap->CollectGarbage(Heap::kOld);
+  // The dead pages are not released until they are swept.
+  const intptr_t capacity_after_gc = heap->old_space()->CapacityInWords();
+  // Old allocations sweep pages instead of growing the heap.
+  for (intptr_t i = 0; i < 1000; i++) {
+    Array::New(2, Heap::kOld);
+  }
+  EXPECT(heap->old_space()->CapacityInWords() <= capacity_after_gc);
+  heap->old_space()->CompleteSweep();
+  EXPECT(heap->old_space()->CapacityInWords() < capacity_after_gc);
+  // Sweeping and allocating did not touch the live entries.
+  Array& entry = Array::Handle();
+  for (intptr_t i = 0; i < keep.Length(); i++) {
+    entry ^= keep.At(i);
+    EXPECT_EQ(i, Smi::Value(Smi::RawCast(entry.At(0))));
+  }
+  FLAG_lazy_sweep = saved_lazy_sweep;
+}
+
+
+// Returns whether 'array' holds at 'index' a list of the index.
+static bool IsFilled(const Array& array, intptr_t index) {
+  const Object& element = Object::Handle(array.At(index));
+  if (!element.IsArray()) {
+    return false;
+  }
+  const Object& value = Object::Handle(Array::Cast(element).At(0));
+  return value.IsSmi() && (Smi::Cast(value).Value() == index);
+}
+
+
+TEST_CASE(CardMarking) {
+  const char* kScriptChars =
+      "fill(big, step) {\n"
+      "  for (var i = 0; i < big.length; i += step) {\n"
+      "    var entry = new List(1);\n"
+      "    entry[0] = i;\n"
+      "    big[i] = entry;\n"
+      "  }\n"
+      "}\n";
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  Isolate* isolate = Isolate::Current();
+  Heap* heap = isolate->heap();
+  const intptr_t kLength = 20000;
+  // Arrays allocated in a large page of old space are remembered per card.
+  EXPECT(Array::Handle(Array::New(kLength, Heap::kOld)).raw()->
+         IsCardRemembered());
+  // So are large arrays promoted into old space.
+  const Array& array = Array::Handle(Array::New(kLength));
+  EXPECT(!array.raw()->IsCardRemembered());
+  heap->CollectGarbage(Heap::kNew);
+  heap->CollectGarbage(Heap::kNew);
+  EXPECT(array.raw()->IsOldObject());
+  EXPECT(array.raw()->IsCardRemembered());
+
+  // The runtime marks the card of each slot it stores a new object into, and
+  // scavenges update the slots of the marked cards.
+  const intptr_t kSlots[] = { 0, 63, 64, 65, kLength / 2, kLength - 1 };
+  const intptr_t kNumSlots = ARRAY_SIZE(kSlots);
+  Array& entry = Array::Handle();
+  for (intptr_t i = 0; i < kNumSlots; i++) {
+    entry = Array::New(1);
+    entry.SetAt(0, Smi::Handle(Smi::New(kSlots[i])));
+    array.SetAt(kSlots[i], entry);
+  }
+  entry = Array::null();
+  heap->CollectGarbage(Heap::kNew);
+  for (intptr_t i = 0; i < kNumSlots; i++) {
+    EXPECT(IsFilled(array, kSlots[i]));
+  }
+
+  // So does compiled code.
+  const intptr_t kStep = 1000;
+  Dart_Handle args[2] = { Api::NewHandle(isolate, array.raw()),
+                          Dart_NewInteger(kStep) };
+  for (intptr_t i = 0; i < 20; i++) {
+    EXPECT_VALID(Dart_Invoke(lib, NewString("fill"), 2, args));
+    heap->CollectGarbage(Heap::kNew);
+    for (intptr_t j = 0; j < kLength; j += kStep) {
+      EXPECT(IsFilled(array, j));
+    }
+  }
+  heap->CollectGarbage(Heap::kOld);
+  for (intptr_t j = 0; j < kLength; j += kStep) {
+    EXPECT(IsFilled(array, j));
+  }
+}
+
+
+TEST_CASE(ReleaseOldSpaceMemory) {
+  Isolate* isolate = Isolate::Current();
+  Heap* heap = isolate->heap();
+  PageSpace* old_space = heap->old_space();
+  const bool saved_concurrent_sweep = FLAG_concurrent_sweep;
+  const intptr_t saved_shrink_collections = FLAG_old_gen_shrink_collections;
+  FLAG_concurrent_sweep = false;
+  FLAG_old_gen_shrink_collections = 1000;
+  // Fill some pages with objects that die right away.
+  {
+    HANDLESCOPE(isolate);
+    const intptr_t kLength = 40000;
+    const Array& all = Array::Handle(Array::New(kLength, Heap::kOld));
+    for (intptr_t i = 0; i < kLength; i++) {
+      all.SetAt(i, Array::Handle(Array::New(2, Heap::kOld)));
+    }
+  }
+  const intptr_t released_before = old_space->released_in_bytes();
+  heap->CollectGarbage(Heap::kOld);
+  const intptr_t retained = old_space->retained_pages();
+  EXPECT(retained > 0);
+  EXPECT(old_space->released_in_bytes() > released_before);
+  // Growing the heap takes the retained pages first.
+  for (intptr_t i = 0;
+       (i < 1000) && (old_space->retained_pages() == retained);
+       i++) {
+    Array::New(1000, Heap::kOld);
+  }
+  EXPECT(old_space->retained_pages() < retained);
+  // Once the heap is shrinking, empty pages are unmapped.
+  FLAG_old_gen_shrink_collections = 0;
+  heap->CollectGarbage(Heap::kOld);
+  EXPECT_EQ(0, old_space->retained_pages());
+  FLAG_old_gen_shrink_collections = saved_shrink_collections;
+  FLAG_concurrent_sweep = saved_concurrent_sweep;
+}
+
+
+TEST_CASE(RetainLargePages) {
+  Heap* heap = Isolate::Current()->heap();
+  PageSpace* old_space = heap->old_space();
+  const bool saved_concurrent_sweep = FLAG_concurrent_sweep;
+  const intptr_t saved_shrink_collections = FLAG_old_gen_shrink_collections;
+  FLAG_concurrent_sweep = false;
+  FLAG_old_gen_shrink_collections = 1000;
+  const intptr_t kLength = 4 * MB;
+  const intptr_t large_in_words = old_space->GetCurrentUsage().large_in_words;
+  {
+    HANDLESCOPE(Isolate::Current());
+    const TypedData& data = TypedData::Handle(
+        TypedData::New(kTypedDataUint8ArrayCid, kLength, Heap::kOld));
+    NoSafepointScope no_safepoint;
+    memset(data.DataAddr(0), 0xff, kLength);
+    const SpaceUsage usage = old_space->GetCurrentUsage();
+    EXPECT_LE(kLength,
+              (usage.large_in_words - large_in_words) << kWordSizeLog2);
+  }
+  heap->CollectGarbage(Heap::kOld);
+  EXPECT_LE(old_space->GetCurrentUsage().large_in_words, large_in_words);
+  const intptr_t retained_in_words = old_space->retained_large_in_words();
+  EXPECT_LE(kLength, retained_in_words << kWordSizeLog2);
+
+  // A slightly smaller object takes the retained page, zeroed.
+  {
+    HANDLESCOPE(Isolate::Current());
+    const intptr_t kSmallerLength = kLength - 64 * KB;
+    const TypedData& data = TypedData::Handle(
+        TypedData::New(kTypedDataUint8ArrayCid, kSmallerLength, Heap::kOld));
+    EXPECT_LT(old_space->retained_large_in_words(), retained_in_words);
+    NoSafepointScope no_safepoint;
+    const uint8_t* bytes = reinterpret_cast<uint8_t*>(data.DataAddr(0));
+    for (intptr_t i = 0; i < kSmallerLength; i += KB) {
+      EXPECT_EQ(0, bytes[i]);
+    }
+    EXPECT_EQ(0, bytes[kSmallerLength - 1]);
+  }
+  // Once the heap is shrinking, empty large pages are unmapped.
+  FLAG_old_gen_shrink_collections = 0;
+  heap->CollectGarbage(Heap::kOld);
+  EXPECT_EQ(0, old_space->retained_large_in_words());
+  FLAG_old_gen_shrink_collections = saved_shrink_collections;
+  FLAG_concurrent_sweep = saved_concurrent_sweep;
+}
+
+
+static bool HasPretenuredSite(const Library& lib, const char* name) {
+  const Function& function = Function::Handle(
+      lib.LookupLocalFunction(String::Handle(String::New(name))));
+  EXPECT(!function.IsNull());
+  Heap* heap = Isolate::Current()->heap();
+  for (intptr_t pos = function.token_pos();
+       pos <= function.end_token_pos();
+       pos++) {
+    if (heap->ShouldPretenureSite(function, pos)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+TEST_CASE(AllocationSitePretenuring) {
+  const char* kScriptChars =
+      "class Node {\n"
+      "  var next;\n"
+      "  Node(this.next);\n"
+      "}\n"
+      "var keep;\n"
+      "makeList(n) {\n"
+      "  var list = null;\n"
+      "  for (var i = 0; i < n; i++) {\n"
+      "    list = new Node(list);\n"
+      "  }\n"
+      "  return list;\n"
+      "}\n"
+      "makeGarbage(n) {\n"
+      "  var node = null;\n"
+      "  for (var i = 0; i < n; i++) {\n"
+      "    node = new Node(null);\n"
+      "  }\n"
+      "  return node;\n"
+      "}\n"
+      "main() {\n"
+      "  keep = makeList(100000);\n"
+      "  makeGarbage(100000);\n"
+      "}\n";
+  const intptr_t saved_interval = FLAG_pretenure_sample_interval;
+  const bool saved_use_osr = FLAG_use_osr;
+  FLAG_pretenure_sample_interval = 1;
+  // Only unoptimized code samples its allocation sites.
+  FLAG_use_osr = false;
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  EXPECT_VALID(Dart_Invoke(lib, NewString("main"), 0, NULL));
+  // Feed back the samples taken since the last scavenge.
+  Isolate::Current()->heap()->CollectGarbage(Heap::kNew);
+  const Library& library =
+      Library::Handle(Library::RawCast(Api::UnwrapHandle(lib)));
+  EXPECT(HasPretenuredSite(library, "makeList"));
+  EXPECT(!HasPretenuredSite(library, "makeGarbage"));
+
+  if (FlowGraphCompiler::SupportsSitePretenuring()) {
+    const Function& make_list = Function::Handle(
+        library.LookupLocalFunction(String::Handle(String::New("makeList"))));
+    EXPECT(Error::Handle(Compiler::CompileOptimizedFunction(
+        Thread::Current(), make_list)).IsNull());
+    Dart_Handle args[1] = { Dart_NewInteger(10) };
+    Dart_Handle list = Dart_Invoke(lib, NewString("makeList"), 1, args);
+    EXPECT_VALID(list);
+    EXPECT(Api::UnwrapHandle(list)->IsOldObject());
+  }
+  FLAG_use_osr = saved_use_osr;
+  FLAG_pretenure_sample_interval = saved_interval;
+}
+
+
+// Runs while a scavenge is being timed, so that the scavenge takes longer than
+// a pause goal of a few milliseconds however fast the copying is.
+static void SlowFinalizer(void* isolate_callback_data,
+                          Dart_WeakPersistentHandle handle,
+                          void* peer) {
+  OS::Sleep(10);
+}
+
+
+// Allocates an object that dies in the next scavenge, finalized slowly.
+static void AllocateSlowFinalizable() {
+  Dart_EnterScope();
+  Dart_NewWeakPersistentHandle(NewString("slow"), NULL, 0, SlowFinalizer);
+  Dart_ExitScope();
+}
+
+
+TEST_CASE(GrowthPauseGoal) {
+  const char* kScriptChars =
+      "var keep;\n"
+      "retain() {\n"
+      "  keep = new List(10000);\n"
+      "  for (var i = 0; i < keep.length; i++) {\n"
+      "    keep[i] = new List(2);\n"
+      "  }\n"
+      "}\n";
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  Heap* heap = Isolate::Current()->heap();
+  Scavenger* new_space = heap->new_space();
+  // Mostly survivors: new space grows to avoid frequent scavenges.
+  const intptr_t initial_capacity = new_space->CapacityInWords();
+  for (intptr_t i = 0; i < 4; i++) {
+    EXPECT_VALID(Dart_Invoke(lib, NewString("retain"), 0, NULL));
+    heap->CollectGarbage(Heap::kNew);
+  }
+  const intptr_t grown_capacity = new_space->CapacityInWords();
+  EXPECT_LT(initial_capacity, grown_capacity);
+
+  // Scavenges longer than the goal shrink new space, the size taking effect
+  // at the next scavenge, but not below its initial size.
+  const intptr_t saved_pause_goal = FLAG_gc_pause_goal;
+  FLAG_gc_pause_goal = 1;
+  for (intptr_t i = 0; i < 2; i++) {
+    AllocateSlowFinalizable();
+    heap->CollectGarbage(Heap::kNew);
+  }
+  EXPECT_GT(grown_capacity, new_space->CapacityInWords());
+  {
+    JSONStream js;
+    {
+      JSONObject jsobj(&js);
+      heap->PrintToJSONObject(Heap::kNew, &jsobj);
+    }
+    EXPECT_SUBSTRING("\"growthPolicy\":{\"pauseGoalMillis\":1,",
+                     js.ToCString());
+    EXPECT_SUBSTRING("\"limitedBy\":\"pause goal\"", js.ToCString());
+  }
+  for (intptr_t i = 0; i < 3; i++) {
+    AllocateSlowFinalizable();
+    heap->CollectGarbage(Heap::kNew);
+  }
+  EXPECT_EQ(initial_capacity, new_space->CapacityInWords());
+  FLAG_gc_pause_goal = saved_pause_goal;
+}
+
+
+// Returns the old space growth in pages allowed after a collection that took
+// 'pause_micros' and found 15 of 200 pages to be garbage.
+static intptr_t GrowthAfterCollection(Heap* heap, int64_t pause_micros) {
+  const intptr_t kPageSizeInWords = PageSpace::kPageSizeInWords;
+  PageSpaceController controller(heap, 20, 280, 100);
+  SpaceUsage usage;
+  usage.capacity_in_words = 100 * kPageSizeInWords;
+  usage.used_in_words = 50 * kPageSizeInWords;
+  controller.Enable(usage);
+  SpaceUsage before;
+  before.capacity_in_words = 200 * kPageSizeInWords;
+  before.used_in_words = 200 * kPageSizeInWords;
+  SpaceUsage after;
+  after.capacity_in_words = 200 * kPageSizeInWords;
+  after.used_in_words = 185 * kPageSizeInWords;
+  const int64_t start = OS::GetCurrentTimeMicros();
+  controller.EvaluateGarbageCollection(before, after,
+                                       start, start + pause_micros);
+  intptr_t growth = 0;
+  after.capacity_in_words += kPageSizeInWords;
+  while (!controller.NeedsGarbageCollection(after)) {
+    growth++;
+    after.capacity_in_words += kPageSizeInWords;
+  }
+  return growth;
+}
+
+
+TEST_CASE(OldSpaceGrowthPauseGoal) {
+  Heap* heap = Isolate::Current()->heap();
+  const intptr_t saved_pause_goal = FLAG_gc_pause_goal;
+  FLAG_gc_pause_goal = 10;
+  // Little garbage: the space policy allows the maximum growth.
+  EXPECT_EQ(280, GrowthAfterCollection(heap, 0));
+  // Collecting 200 pages in 5 ms meets the goal with up to 400 pages in use.
+  EXPECT_EQ(200, GrowthAfterCollection(heap, 5000));
+  // The goal would collect as soon as the capacity grows, but 20% of the 185
+  // pages in use may still be allocated between collections.
+  EXPECT_EQ(22, GrowthAfterCollection(heap, 10000));
+  // The pages in use alone take longer than the goal: it is ignored.
+  EXPECT_EQ(280, GrowthAfterCollection(heap, 20000));
+  FLAG_gc_pause_goal = saved_pause_goal;
+}
+
 }  // namespace dart.
@@ -573,6 +573,9 @@ void AllocateObjectInstr::PrintOperandsTo(BufferFormatter* f) const {
   if (Identity().IsNotAliased()) {
     f->Print(" <not-aliased>");
   }
+  if (is_pretenured()) {
+    f->Print(" <pretenured>");
+  }
 }
 
 
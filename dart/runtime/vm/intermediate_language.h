@@ -4043,7 +4043,8 @@ class AllocateObjectInstr : public TemplateDefinition<0, NoThrow> {
         cls_(cls),
         arguments_(arguments),
         identity_(AliasIdentity::Unknown()),
-        closure_function_(Function::ZoneHandle()) {
+        closure_function_(Function::ZoneHandle()),
+        is_pretenured_(false) {
     // Either no arguments or one type-argument and one instantiator.
     ASSERT(arguments->is_empty() || (arguments->length() == 1));
   }
@@ -4064,6 +4065,11 @@ class AllocateObjectInstr : public TemplateDefinition<0, NoThrow> {
     closure_function_ ^= function.raw();
   }
 
+  // Whether the object is allocated directly in old space, see
+  // FlowGraphOptimizer::PretenureAllocationSites.
+  bool is_pretenured() const { return is_pretenured_; }
+  void set_is_pretenured(bool value) { is_pretenured_ = value; }
+
   virtual void PrintOperandsTo(BufferFormatter* f) const;
 
   virtual bool CanDeoptimize() const { return false; }
@@ -4079,6 +4085,7 @@ class AllocateObjectInstr : public TemplateDefinition<0, NoThrow> {
   ZoneGrowableArray<PushArgumentInstr*>* const arguments_;
   AliasIdentity identity_;
   Function& closure_function_;
+  bool is_pretenured_;
 
   DISALLOW_COPY_AND_ASSIGN(AllocateObjectInstr);
 };
@@ -4238,7 +4245,8 @@ class CreateArrayInstr : public TemplateDefinition<2, Throws> {
                    Value* num_elements)
       : TemplateDefinition(Isolate::Current()->GetNextDeoptId()),
         token_pos_(token_pos),
-        identity_(AliasIdentity::Unknown())  {
+        identity_(AliasIdentity::Unknown()),
+        is_pretenured_(false) {
     SetInputAt(kElementTypePos, element_type);
     SetInputAt(kLengthPos, num_elements);
   }
@@ -4255,6 +4263,11 @@ class CreateArrayInstr : public TemplateDefinition<2, Throws> {
   Value* element_type() const { return inputs_[kElementTypePos]; }
   Value* num_elements() const { return inputs_[kLengthPos]; }
 
+  // Whether the array is allocated directly in old space, see
+  // FlowGraphOptimizer::PretenureAllocationSites.
+  bool is_pretenured() const { return is_pretenured_; }
+  void set_is_pretenured(bool value) { is_pretenured_ = value; }
+
   // Throw needs environment, which is created only if instruction can
   // deoptimize.
   virtual bool CanDeoptimize() const { return MayThrow(); }
@@ -4267,6 +4280,7 @@ class CreateArrayInstr : public TemplateDefinition<2, Throws> {
  private:
   const intptr_t token_pos_;
   AliasIdentity identity_;
+  bool is_pretenured_;
 
   DISALLOW_COPY_AND_ASSIGN(CreateArrayInstr);
 };
@@ -2042,6 +2042,7 @@ LocationSummary* CreateArrayInstr::MakeLocationSummary(Zone* zone,
 
 // Inlines array allocation for known constant values.
 static void InlineArrayAllocation(FlowGraphCompiler* compiler,
+                                   Heap::Space space,
                                    intptr_t num_elements,
                                    Label* slow_path,
                                    Label* done) {
@@ -2050,15 +2051,21 @@ static void InlineArrayAllocation(FlowGraphCompiler* compiler,
   const Register kElemTypeReg = RBX;
   const intptr_t instance_size = Array::InstanceSize(num_elements);
 
-  __ TryAllocateArray(kArrayCid, instance_size, slow_path, Assembler::kFarJump,
+  __ TryAllocateArray(kArrayCid, space, instance_size,
+                      slow_path, Assembler::kFarJump,
                       RAX,  // instance
                       RCX);  // end address
 
   // RAX: new object start as a tagged pointer.
   // Store the type argument field.
-  __ InitializeFieldNoBarrier(RAX,
-                              FieldAddress(RAX, Array::type_arguments_offset()),
-                              kElemTypeReg);
+  if (space == Heap::kNew) {
+    __ InitializeFieldNoBarrier(
+        RAX, FieldAddress(RAX, Array::type_arguments_offset()), kElemTypeReg);
+  } else {
+    // The element type may be a new object. The barrier preserves RCX.
+    __ StoreIntoObject(
+        RAX, FieldAddress(RAX, Array::type_arguments_offset()), kElemTypeReg);
+  }
 
   // Set the length field.
   __ InitializeFieldNoBarrier(RAX,
@@ -2107,14 +2114,19 @@ void CreateArrayInstr::EmitNativeCode(FlowGraphCompiler* compiler) {
     const intptr_t length = Smi::Cast(num_elements()->BoundConstant()).Value();
     if ((length >= 0) && (length <= Array::kMaxElements)) {
       Label slow_path, done;
-      InlineArrayAllocation(compiler, length, &slow_path, &done);
+      Heap::Space space = is_pretenured() ?
+          Heap::kPretenured :
+          compiler->isolate()->heap()->SpaceForAllocation(kArrayCid);
+      InlineArrayAllocation(compiler, space, length, &slow_path, &done);
       __ Bind(&slow_path);
       __ PushObject(Object::null_object(), PP);  // Make room for the result.
       __ pushq(kLengthReg);
       __ pushq(kElemTypeReg);
       compiler->GenerateRuntimeCall(token_pos(),
                                     deopt_id(),
-                                    kAllocateArrayRuntimeEntry,
+                                    is_pretenured() ?
+                                        kAllocateArrayPretenuredRuntimeEntry :
+                                        kAllocateArrayRuntimeEntry,
                                     2,
                                     locs());
       __ Drop(2);
@@ -6402,7 +6414,71 @@ LocationSummary* AllocateObjectInstr::MakeLocationSummary(Zone* zone,
 }
 
 
+// Inlines the allocation of an object in old space, for allocation sites whose
+// objects were found to survive their first scavenge. The type arguments of
+// the object, if any, are on top of the stack.
+static void InlinePretenuredAllocation(FlowGraphCompiler* compiler,
+                                       AllocateObjectInstr* instr) {
+  const Class& cls = instr->cls();
+  const intptr_t instance_size = cls.instance_size();
+  const int kInlineInstanceSize = 12;  // Same as in the allocation stub.
+  Label slow_path, done;
+  __ TryAllocate(cls, Heap::kPretenured, &slow_path, Assembler::kFarJump,
+                 RAX, PP);
+  // RAX: new object (tagged).
+  __ LoadObject(R12, Object::null_object(), PP);
+  if (instance_size < (kInlineInstanceSize * kWordSize)) {
+    for (intptr_t current_offset = sizeof(RawInstance);
+         current_offset < instance_size;
+         current_offset += kWordSize) {
+      __ InitializeFieldNoBarrier(RAX, FieldAddress(RAX, current_offset), R12);
+    }
+  } else {
+    Label init_loop, init_done;
+    __ leaq(RCX, FieldAddress(RAX, sizeof(RawInstance)));
+    __ leaq(RBX, FieldAddress(RAX, instance_size));
+    __ Bind(&init_loop);
+    __ cmpq(RCX, RBX);
+    __ j(ABOVE_EQUAL, &init_done, Assembler::kNearJump);
+    __ InitializeFieldNoBarrier(RAX, Address(RCX, 0), R12);
+    __ addq(RCX, Immediate(kWordSize));
+    __ jmp(&init_loop, Assembler::kNearJump);
+    __ Bind(&init_done);
+  }
+  if (instr->ArgumentCount() > 0) {
+    // The type arguments may be a new object.
+    __ movq(RDX, Address(RSP, 0));
+    __ StoreIntoObject(RAX,
+                       FieldAddress(RAX, cls.type_arguments_field_offset()),
+                       RDX);
+  }
+  __ jmp(&done);
+
+  __ Bind(&slow_path);
+  __ PushObject(Object::null_object(), PP);  // Make room for the result.
+  __ PushObject(cls, PP);
+  if (instr->ArgumentCount() > 0) {
+    __ pushq(Address(RSP, 2 * kWordSize));  // Type arguments.
+  } else {
+    __ PushObject(Object::null_object(), PP);
+  }
+  compiler->GenerateRuntimeCall(instr->token_pos(),
+                                Isolate::kNoDeoptId,
+                                kAllocateObjectPretenuredRuntimeEntry,
+                                2,
+                                instr->locs());
+  __ Drop(2);
+  __ popq(RAX);
+  __ Bind(&done);
+}
+
+
 void AllocateObjectInstr::EmitNativeCode(FlowGraphCompiler* compiler) {
+  if (is_pretenured()) {
+    InlinePretenuredAllocation(compiler, this);
+    __ Drop(ArgumentCount());  // Discard arguments.
+    return;
+  }
   Isolate* isolate = compiler->isolate();
   StubCode* stub_code = isolate->stub_code();
   const Code& stub = Code::Handle(isolate,
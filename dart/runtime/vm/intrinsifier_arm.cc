@@ -1490,6 +1490,12 @@ void Intrinsifier::ObjectEquals(Assembler* assembler) {
 }
 
 
+void Intrinsifier::Object_getHash(Assembler* assembler) {
+  // The identity hash is kept in the weak table of the heap on 32-bit
+  // platforms: fall through to the native.
+}
+
+
 void Intrinsifier::String_getHashCode(Assembler* assembler) {
   __ ldr(R0, Address(SP, 0 * kWordSize));
   __ ldr(R0, FieldAddress(R0, String::hash_offset()));
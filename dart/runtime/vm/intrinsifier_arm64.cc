@@ -1558,6 +1558,22 @@ void Intrinsifier::ObjectEquals(Assembler* assembler) {
 }
 
 
+void Intrinsifier::Object_getHash(Assembler* assembler) {
+  Label fall_through;
+  __ ldr(R0, Address(SP, 0 * kWordSize));  // Object.
+  __ tsti(R0, Immediate(kSmiTagMask));
+  __ b(&fall_through, EQ);  // Smi.
+  __ LoadFieldFromOffset(R0, R0, Object::header_hash_offset(), kNoPP,
+                         kUnsignedWord);
+  // Not yet set, or kept in the weak table for a VM isolate object.
+  __ CompareRegisters(R0, ZR);
+  __ b(&fall_through, EQ);
+  __ SmiTag(R0);
+  __ ret();
+  __ Bind(&fall_through);
+}
+
+
 void Intrinsifier::String_getHashCode(Assembler* assembler) {
   Label fall_through;
   __ ldr(R0, Address(SP, 0 * kWordSize));
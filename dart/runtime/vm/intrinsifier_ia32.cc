@@ -1630,6 +1630,12 @@ void Intrinsifier::ObjectEquals(Assembler* assembler) {
 }
 
 
+void Intrinsifier::Object_getHash(Assembler* assembler) {
+  // The identity hash is kept in the weak table of the heap on 32-bit
+  // platforms: fall through to the native.
+}
+
+
 void Intrinsifier::String_getHashCode(Assembler* assembler) {
   Label fall_through;
   __ movl(EAX, Address(ESP, + 1 * kWordSize));  // String object.
@@ -1526,6 +1526,21 @@ void Intrinsifier::ObjectEquals(Assembler* assembler) {
 }
 
 
+void Intrinsifier::Object_getHash(Assembler* assembler) {
+  Label fall_through;
+  __ movq(RAX, Address(RSP, + 1 * kWordSize));  // Object.
+  __ testq(RAX, Immediate(kSmiTagMask));
+  __ j(ZERO, &fall_through, Assembler::kNearJump);  // Smi.
+  __ movl(RAX, FieldAddress(RAX, Object::header_hash_offset()));
+  __ cmpq(RAX, Immediate(0));
+  // Not yet set, or kept in the weak table for a VM isolate object.
+  __ j(EQUAL, &fall_through, Assembler::kNearJump);
+  __ SmiTag(RAX);
+  __ ret();
+  __ Bind(&fall_through);
+}
+
+
 void Intrinsifier::String_getHashCode(Assembler* assembler) {
   Label fall_through;
   __ movq(RAX, Address(RSP, + 1 * kWordSize));  // String object.
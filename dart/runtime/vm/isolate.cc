@@ -15,6 +15,7 @@
 #include "vm/debugger.h"
 #include "vm/deopt_instructions.h"
 #include "vm/heap.h"
+#include "vm/isolate_group.h"
 #include "vm/lockers.h"
 #include "vm/log.h"
 #include "vm/message_handler.h"
@@ -124,6 +125,10 @@ class IsolateMessageHandler : public MessageHandler {
 #endif
   bool IsCurrentIsolate() const;
   virtual Isolate* isolate() const { return isolate_; }
+  // The service isolate answers the observatory even when others are busy.
+  virtual bool IsHighPriority() const {
+    return isolate_->is_service_isolate();
+  }
 
  private:
   // Keep both these enums in sync with isolate_patch.dart.
@@ -373,6 +378,7 @@ bool IsolateMessageHandler::HandleMessage(Message* message) {
   // Parse the message.
   SnapshotReader reader(message->data(), message->len(), Snapshot::kMessage,
                         I, zone.GetZone());
+  reader.set_adoptable_message(message);
   const Object& msg_obj = Object::Handle(I, reader.ReadObject());
   if (msg_obj.IsError()) {
     // An error occurred while reading the message.
@@ -559,6 +565,7 @@ Isolate::Isolate()
       start_time_(OS::GetCurrentTimeMicros()),
       main_port_(0),
       origin_id_(0),
+      group_(NULL),
       pause_capability_(0),
       terminate_capability_(0),
       errors_fatal_(true),
@@ -628,6 +635,7 @@ Isolate::Isolate(Isolate* original)
       debugger_name_(NULL),
       start_time_(OS::GetCurrentTimeMicros()),
       main_port_(0),
+      group_(NULL),
       pause_capability_(0),
       terminate_capability_(0),
       errors_fatal_(true),
@@ -701,6 +709,9 @@ Isolate::~Isolate() {
   delete spawn_state_;
   delete log_;
   log_ = NULL;
+  if (group_ != NULL) {
+    group_->Release();
+  }
 }
 
 
@@ -715,6 +726,7 @@ void Isolate::InitOnce() {
   create_callback_ = NULL;
   isolates_list_monitor_ = new Monitor();
   ASSERT(isolates_list_monitor_ != NULL);
+  IsolateGroup::InitOnce();
 }
 
 
@@ -760,6 +772,7 @@ Isolate* Isolate::Init(const char* name_prefix, bool is_vm_isolate) {
   Isolate::VisitIsolates(&id_verifier);
 #endif
   result->set_origin_id(result->main_port());
+  result->group_ = IsolateGroup::Join();
   result->set_pause_capability(result->random()->NextUInt64());
   result->set_terminate_capability(result->random()->NextUInt64());
 
@@ -1380,12 +1393,14 @@ void Isolate::Shutdown() {
   ASSERT(top_resource() == NULL);
 #if defined(DEBUG)
   if (heap_ != NULL) {
+    heap_->AbortIncrementalMarking();
     // Wait for concurrent GC tasks to finish before final verification.
     PageSpace* old_space = heap_->old_space();
     MonitorLocker ml(old_space->tasks_lock());
     while (old_space->tasks() > 0) {
       ml.Wait();
     }
+    old_space->CompleteSweep();
     // The VM isolate keeps all objects marked.
     heap_->Verify(this == Dart::vm_isolate() ? kRequireMarked : kForbidMarked);
   }
@@ -1568,6 +1583,10 @@ void Isolate::PrintJSON(JSONStream* stream, bool ref) {
   }
 
   jsobj.AddProperty("livePorts", message_handler()->live_ports());
+  {
+    JSONObject latency(&jsobj, "_messageQueueLatency");
+    message_handler()->PrintLatencyToJSONObject(&latency);
+  }
   jsobj.AddProperty("pauseOnExit", message_handler()->pause_on_exit());
 
   if (message_handler()->paused_on_start()) {
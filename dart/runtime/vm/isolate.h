@@ -49,6 +49,7 @@ class HandleVisitor;
 class Heap;
 class ICData;
 class Instance;
+class IsolateGroup;
 class IsolateProfilerData;
 class IsolateSpawnState;
 class InterruptableThreadState;
@@ -196,6 +197,9 @@ class Isolate : public BaseIsolate {
            (origin_id_ == main_port_));
     origin_id_ = id;
   }
+  // The group of isolates running the same program this isolate belongs to.
+  IsolateGroup* group() const { return group_; }
+
   void set_pause_capability(uint64_t value) { pause_capability_ = value; }
   uint64_t pause_capability() const { return pause_capability_; }
   void set_terminate_capability(uint64_t value) {
@@ -336,6 +340,7 @@ class Isolate : public BaseIsolate {
   void set_message_handler(MessageHandler* value) { message_handler_ = value; }
 
   bool is_runnable() const { return is_runnable_; }
+  bool is_service_isolate() const { return is_service_isolate_; }
   void set_is_runnable(bool value) { is_runnable_ = value; }
 
   IsolateSpawnState* spawn_state() const { return spawn_state_; }
@@ -699,6 +704,7 @@ class Isolate : public BaseIsolate {
   int64_t start_time_;
   Dart_Port main_port_;
   Dart_Port origin_id_;  // Isolates created by spawnFunc have some origin id.
+  IsolateGroup* group_;
   uint64_t pause_capability_;
   uint64_t terminate_capability_;
   bool errors_fatal_;
@@ -0,0 +1,120 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/isolate_group.h"
+
+#include "platform/assert.h"
+#include "vm/lockers.h"
+
+namespace dart {
+
+ThreadLocalKey IsolateGroup::joining_key_ = OSThread::kUnsetThreadLocalKey;
+
+
+void IsolateGroup::InitOnce() {
+  if (joining_key_ == OSThread::kUnsetThreadLocalKey) {
+    joining_key_ = OSThread::CreateThreadLocal();
+  }
+  ASSERT(joining_key_ != OSThread::kUnsetThreadLocalKey);
+}
+
+
+IsolateGroup::IsolateGroup()
+    : ref_count_(1),
+      snapshot_requested_(false),
+      snapshot_failed_(false),
+      script_snapshot_(NULL),
+      script_snapshot_size_(0) {
+}
+
+
+IsolateGroup::~IsolateGroup() {
+  ASSERT(ref_count_ == 0);
+  free(script_snapshot_);
+}
+
+
+IsolateGroup* IsolateGroup::Join() {
+  IsolateGroup* group =
+      reinterpret_cast<IsolateGroup*>(OSThread::GetThreadLocal(joining_key_));
+  if (group == NULL) {
+    return new IsolateGroup();
+  }
+  group->Retain();
+  return group;
+}
+
+
+void IsolateGroup::Retain() {
+  MutexLocker ml(&mutex_);
+  ASSERT(ref_count_ > 0);
+  ref_count_++;
+}
+
+
+void IsolateGroup::Release() {
+  bool is_last;
+  {
+    MutexLocker ml(&mutex_);
+    ASSERT(ref_count_ > 0);
+    is_last = (--ref_count_ == 0);
+  }
+  if (is_last) {
+    delete this;
+  }
+}
+
+
+const uint8_t* IsolateGroup::ScriptSnapshot(intptr_t* size) {
+  MutexLocker ml(&mutex_);
+  *size = script_snapshot_size_;
+  return script_snapshot_;
+}
+
+
+bool IsolateGroup::RequestScriptSnapshot() {
+  MutexLocker ml(&mutex_);
+  // The first member of a group is loaded before any other joins, so a group
+  // which does not spawn never pays for a snapshot.
+  if ((ref_count_ > 1) && !snapshot_failed_) {
+    snapshot_requested_ = true;
+  }
+  return snapshot_requested_;
+}
+
+
+bool IsolateGroup::WantsScriptSnapshot() {
+  MutexLocker ml(&mutex_);
+  return snapshot_requested_ && (script_snapshot_ == NULL);
+}
+
+
+void IsolateGroup::SetScriptSnapshot(uint8_t* buffer, intptr_t size) {
+  MutexLocker ml(&mutex_);
+  if (buffer == NULL) {
+    // Do not try again for every member.
+    snapshot_requested_ = false;
+    snapshot_failed_ = true;
+  } else if (script_snapshot_ == NULL) {
+    script_snapshot_ = buffer;
+    script_snapshot_size_ = size;
+  } else {
+    // Another member got there first.
+    free(buffer);
+  }
+}
+
+
+IsolateGroupScope::IsolateGroupScope(IsolateGroup* group)
+    : saved_group_(OSThread::GetThreadLocal(IsolateGroup::joining_key_)) {
+  OSThread::SetThreadLocal(IsolateGroup::joining_key_,
+                           reinterpret_cast<uword>(group));
+}
+
+
+IsolateGroupScope::~IsolateGroupScope() {
+  OSThread::SetThreadLocal(IsolateGroup::joining_key_, saved_group_);
+}
+
+}  // namespace dart
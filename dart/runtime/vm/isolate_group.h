@@ -0,0 +1,86 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_ISOLATE_GROUP_H_
+#define VM_ISOLATE_GROUP_H_
+
+#include "vm/globals.h"
+#include "vm/os_thread.h"
+
+namespace dart {
+
+// The isolates which run the same program. An isolate spawned from a function
+// of another isolate joins the group of that isolate, any other isolate starts
+// a group of its own.
+//
+// Each isolate still has its own heap, class table and code, so what members
+// share is immutable: a script snapshot of the program, taken from the first
+// spawned member which is loaded from source, before it runs any Dart code.
+// Later members are loaded from the snapshot instead of from source. The
+// snapshot is only taken with --isolate_group_snapshots.
+class IsolateGroup {
+ public:
+  static void InitOnce();
+
+  // Returns the group an isolate being created on the current thread joins,
+  // which is the one of the innermost IsolateGroupScope if any and else a new
+  // group. The caller owns a reference to the group.
+  static IsolateGroup* Join();
+
+  void Retain();
+  void Release();
+
+  // Returns the program's script snapshot and sets its size, or returns NULL
+  // if the group has none yet. The snapshot does not change once it is set
+  // and lives as long as the group.
+  const uint8_t* ScriptSnapshot(intptr_t* size);
+
+  // Asks for a snapshot of the program if the calling member has been spawned
+  // into the group and no snapshot of it failed before. Returns true if the
+  // snapshot was asked for.
+  bool RequestScriptSnapshot();
+
+  // Whether the next member which becomes runnable should take a snapshot.
+  bool WantsScriptSnapshot();
+
+  // Takes ownership of a snapshot of the program, which may be NULL if it
+  // could not be taken, in which case the group does not ask again. The first
+  // snapshot set is kept, others are freed.
+  void SetScriptSnapshot(uint8_t* buffer, intptr_t size);
+
+ private:
+  friend class IsolateGroupScope;
+
+  IsolateGroup();
+  ~IsolateGroup();
+
+  Mutex mutex_;
+  intptr_t ref_count_;  // Protected by mutex_.
+  bool snapshot_requested_;  // Protected by mutex_.
+  bool snapshot_failed_;  // Protected by mutex_.
+  uint8_t* script_snapshot_;  // Protected by mutex_.
+  intptr_t script_snapshot_size_;  // Protected by mutex_.
+
+  static ThreadLocalKey joining_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(IsolateGroup);
+};
+
+
+// Makes isolates created on the current thread while it is active join
+// 'group', unless it is NULL.
+class IsolateGroupScope {
+ public:
+  explicit IsolateGroupScope(IsolateGroup* group);
+  ~IsolateGroupScope();
+
+ private:
+  uword saved_group_;
+
+  DISALLOW_COPY_AND_ASSIGN(IsolateGroupScope);
+};
+
+}  // namespace dart
+
+#endif  // VM_ISOLATE_GROUP_H_
@@ -0,0 +1,187 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/assert.h"
+#include "vm/isolate.h"
+#include "vm/isolate_group.h"
+#include "vm/unit_test.h"
+
+namespace dart {
+
+DECLARE_FLAG(bool, isolate_group_snapshots);
+
+static const char* kGroupScriptChars =
+    "class Counter {\n"
+    "  static int count = 40;\n"
+    "}\n"
+    "int main() {\n"
+    "  Counter.count += 2;\n"
+    "  return Counter.count;\n"
+    "}\n";
+
+
+static const char* kGroupNativeScriptChars =
+    "int answer() native 'IsolateGroup_Answer';\n"
+    "int main() {\n"
+    "  return answer();\n"
+    "}\n";
+
+
+static void Answer(Dart_NativeArguments args) {
+  Dart_SetReturnValue(args, Dart_NewInteger(42));
+}
+
+
+static Dart_NativeFunction AnswerResolver(Dart_Handle name,
+                                          int num_of_arguments,
+                                          bool* auto_setup_scope) {
+  ASSERT(auto_setup_scope != NULL);
+  *auto_setup_scope = true;
+  return reinterpret_cast<Dart_NativeFunction>(&Answer);
+}
+
+
+// Creates an isolate in 'group' which loads 'script' the way the standalone
+// embedder does. Returns whether it was loaded from the group.
+static bool CreateGroupMember(IsolateGroup* group,
+                              Dart_Isolate* isolate,
+                              const char* script = kGroupScriptChars,
+                              Dart_NativeEntryResolver resolver = NULL) {
+  {
+    IsolateGroupScope group_scope(group);
+    *isolate = TestCase::CreateTestIsolate();
+  }
+  EXPECT(*isolate != NULL);
+  Dart_EnterScope();
+  Dart_Handle lib = Dart_LoadScriptFromIsolateGroup();
+  EXPECT_VALID(lib);
+  const bool from_group = !Dart_IsNull(lib);
+  if (from_group) {
+    EXPECT_VALID(Dart_FinalizeLoading(false));
+  } else {
+    lib = TestCase::LoadTestScript(script, resolver);
+  }
+  Dart_ExitScope();
+  Dart_ExitIsolate();
+  EXPECT(Dart_IsolateMakeRunnable(*isolate));
+  return from_group;
+}
+
+
+static void RunGroupMember(Dart_Isolate isolate) {
+  Dart_EnterIsolate(isolate);
+  Dart_EnterScope();
+  Dart_Handle result = Dart_Invoke(Dart_RootLibrary(), NewString("main"),
+                                   0, NULL);
+  EXPECT_VALID(result);
+  int64_t value = 0;
+  EXPECT_VALID(Dart_IntegerToInt64(result, &value));
+  // Every member starts from the static values of the program, not from the
+  // ones of the member the snapshot was taken from.
+  EXPECT_EQ(42, value);
+  Dart_ExitScope();
+  Dart_ShutdownIsolate();
+}
+
+
+UNIT_TEST_CASE(IsolateGroup_ScriptSnapshot) {
+  const bool saved_flag = FLAG_isolate_group_snapshots;
+  FLAG_isolate_group_snapshots = true;
+  // The first member of a group does not ask for a snapshot.
+  Dart_Isolate first = NULL;
+  EXPECT(!CreateGroupMember(NULL, &first));
+  IsolateGroup* group = reinterpret_cast<Isolate*>(first)->group();
+  intptr_t size = 0;
+  EXPECT(group->ScriptSnapshot(&size) == NULL);
+
+  // The first member spawned into it is loaded from source, and the group
+  // takes a snapshot of it.
+  Dart_Isolate second = NULL;
+  EXPECT(!CreateGroupMember(group, &second));
+  EXPECT_EQ(group, reinterpret_cast<Isolate*>(second)->group());
+  EXPECT(group->ScriptSnapshot(&size) != NULL);
+  EXPECT(size > 0);
+  RunGroupMember(second);
+
+  // Later members are loaded from the snapshot.
+  Dart_Isolate third = NULL;
+  EXPECT(CreateGroupMember(group, &third));
+  RunGroupMember(third);
+
+  // Isolates outside of the group do not see its snapshot.
+  Dart_Isolate other = NULL;
+  EXPECT(!CreateGroupMember(NULL, &other));
+  EXPECT(reinterpret_cast<Isolate*>(other)->group() != group);
+  RunGroupMember(other);
+  RunGroupMember(first);
+  FLAG_isolate_group_snapshots = saved_flag;
+}
+
+
+UNIT_TEST_CASE(IsolateGroup_ScriptSnapshotDisabled) {
+  const bool saved_flag = FLAG_isolate_group_snapshots;
+  FLAG_isolate_group_snapshots = false;
+  Dart_Isolate first = NULL;
+  EXPECT(!CreateGroupMember(NULL, &first));
+  IsolateGroup* group = reinterpret_cast<Isolate*>(first)->group();
+
+  // Without the flag every member is loaded from source.
+  for (intptr_t i = 0; i < 3; i++) {
+    Dart_Isolate member = NULL;
+    EXPECT(!CreateGroupMember(group, &member));
+    intptr_t size = 0;
+    EXPECT(group->ScriptSnapshot(&size) == NULL);
+    RunGroupMember(member);
+  }
+  RunGroupMember(first);
+  FLAG_isolate_group_snapshots = saved_flag;
+}
+
+
+UNIT_TEST_CASE(IsolateGroup_NativeResolver) {
+  const bool saved_flag = FLAG_isolate_group_snapshots;
+  FLAG_isolate_group_snapshots = true;
+  Dart_Isolate first = NULL;
+  EXPECT(!CreateGroupMember(NULL, &first, kGroupNativeScriptChars,
+                            AnswerResolver));
+  IsolateGroup* group = reinterpret_cast<Isolate*>(first)->group();
+
+  // A snapshot would lose the resolver of the program, so every member
+  // spawned into the group is loaded from source.
+  for (intptr_t i = 0; i < 3; i++) {
+    Dart_Isolate member = NULL;
+    EXPECT(!CreateGroupMember(group, &member, kGroupNativeScriptChars,
+                              AnswerResolver));
+    intptr_t size = 0;
+    EXPECT(group->ScriptSnapshot(&size) == NULL);
+    RunGroupMember(member);
+  }
+  RunGroupMember(first);
+  FLAG_isolate_group_snapshots = saved_flag;
+}
+
+
+UNIT_TEST_CASE(IsolateGroup_FailedScriptSnapshot) {
+  IsolateGroup* group = IsolateGroup::Join();
+  // A group with a single member does not ask for a snapshot.
+  EXPECT(!group->RequestScriptSnapshot());
+  {
+    IsolateGroupScope group_scope(group);
+    EXPECT_EQ(group, IsolateGroup::Join());
+  }
+  EXPECT(group->RequestScriptSnapshot());
+  EXPECT(group->WantsScriptSnapshot());
+
+  // Once a snapshot could not be taken, later members do not ask again.
+  group->SetScriptSnapshot(NULL, 0);
+  EXPECT(!group->WantsScriptSnapshot());
+  EXPECT(!group->RequestScriptSnapshot());
+  EXPECT(!group->WantsScriptSnapshot());
+  intptr_t size = 0;
+  EXPECT(group->ScriptSnapshot(&size) == NULL);
+  group->Release();
+  group->Release();
+}
+
+}  // namespace dart
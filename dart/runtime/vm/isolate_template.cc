@@ -0,0 +1,589 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/isolate_template.h"
+
+#include "platform/assert.h"
+#include "platform/utils.h"
+#include "vm/class_table.h"
+#include "vm/flags.h"
+#include "vm/hash_map.h"
+#include "vm/heap.h"
+#include "vm/isolate.h"
+#include "vm/lockers.h"
+#include "vm/object.h"
+#include "vm/object_store.h"
+#include "vm/pages.h"
+#include "vm/raw_object.h"
+#include "vm/snapshot.h"
+#include "vm/stub_code.h"
+#include "vm/verified_memory.h"
+#include "vm/visitor.h"
+
+namespace dart {
+
+DECLARE_FLAG(bool, trace_isolates);
+
+Mutex* IsolateTemplate::mutex_ = NULL;
+IsolateTemplate::Registration* IsolateTemplate::registrations_ = NULL;
+
+// The code and instructions of each bootstrap stub.
+#define COUNT_STUB(name) + 2
+static const intptr_t kNumStubs = 0 BOOTSTRAP_STUB_CODE_LIST(COUNT_STUB);
+#undef COUNT_STUB
+
+
+static void CollectStubs(Isolate* isolate, RawObject** stubs) {
+  StubCode* stub_code = isolate->stub_code();
+  Code& code = Code::Handle(isolate);
+  intptr_t i = 0;
+#define COLLECT_STUB(name)                                                     \
+  code = stub_code->name##_entry()->code();                                    \
+  stubs[i++] = code.raw();                                                     \
+  stubs[i++] = code.instructions();
+  BOOTSTRAP_STUB_CODE_LIST(COLLECT_STUB);
+#undef COLLECT_STUB
+  ASSERT(i == kNumStubs);
+}
+
+
+// Collects the pointer slots visited, in order.
+class SlotCollector : public ObjectPointerVisitor {
+ public:
+  SlotCollector(Isolate* isolate, GrowableArray<RawObject**>* slots)
+      : ObjectPointerVisitor(isolate), slots_(slots) { }
+
+  void VisitPointers(RawObject** first, RawObject** last) {
+    for (RawObject** current = first; current <= last; current++) {
+      slots_->Add(current);
+    }
+  }
+
+ private:
+  GrowableArray<RawObject**>* slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(SlotCollector);
+};
+
+
+class IsolateTemplate::Registration {
+ public:
+  Registration(const uint8_t* snapshot, Registration* next)
+      : snapshot_(snapshot),
+        template_(NULL),
+        capture_started_(false),
+        next_(next) { }
+
+  ~Registration() {
+    delete template_;
+  }
+
+  const uint8_t* snapshot_;
+  IsolateTemplate* template_;
+  bool capture_started_;
+  Registration* next_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Registration);
+};
+
+
+// Maps the objects met while building a template to their index, or to
+// kVMHeapObject for objects of the VM isolate's heap.
+class ObjectIndexTrait {
+ public:
+  struct Pair {
+    Pair() : key(NULL), value(-1) { }
+    Pair(RawObject* k, intptr_t v) : key(k), value(v) { }
+    RawObject* key;
+    intptr_t value;
+  };
+  typedef RawObject* Key;
+  typedef intptr_t Value;
+
+  static Key KeyOf(Pair kv) { return kv.key; }
+  static Value ValueOf(Pair kv) { return kv.value; }
+  static inline intptr_t Hashcode(Key key) {
+    return Utils::WordHash(
+        reinterpret_cast<intptr_t>(key) >> kObjectAlignmentLog2);
+  }
+  static inline bool IsKeyEqual(Pair kv, Key key) { return kv.key == key; }
+};
+
+
+// Builds a template in two passes: the first finds the objects reachable
+// from the roots and lays them out in segments, the second copies them into
+// the image and records the fixups.
+class IsolateTemplate::Builder : public ObjectPointerVisitor {
+ public:
+  Builder(Isolate* isolate, const uint8_t* snapshot);
+
+  // Returns NULL and sets failure() if the isolate cannot be captured.
+  IsolateTemplate* Build();
+
+  const char* failure() const { return failure_; }
+
+  void VisitPointers(RawObject** first, RawObject** last);
+
+ private:
+  static const intptr_t kVMHeapObject = -2;
+
+  void Enqueue(RawObject* raw_obj);
+  void LayOut();
+  void Copy();
+  void EncodeRoot(RawObject* raw_obj, Root* root);
+  // Returns false for pointers which need no fixup.
+  bool Encode(RawObject* raw_obj, uword* value, intptr_t* segment);
+
+  void Fail(const char* reason) {
+    if (failure_ == NULL) {
+      failure_ = reason;
+    }
+  }
+
+  Isolate* isolate_;
+  uword snapshot_start_;
+  uword snapshot_end_;
+  RawObject* stubs_[kNumStubs];
+  bool copying_;
+  const char* failure_;
+
+  GrowableArray<RawObject*> objects_;
+  GrowableArray<intptr_t> object_segments_;
+  GrowableArray<intptr_t> object_offsets_;  // In their segment.
+  GrowableArray<RawExternalTypedData*> external_data_;
+  DirectChainedHashMap<ObjectIndexTrait> indices_;
+
+  IsolateTemplate* result_;
+  uword source_start_;  // Of the object being copied.
+  uint8_t* copy_start_;  // Of its copy.
+  intptr_t copy_segment_;
+
+  DISALLOW_COPY_AND_ASSIGN(Builder);
+};
+
+
+IsolateTemplate::Builder::Builder(Isolate* isolate, const uint8_t* snapshot)
+    : ObjectPointerVisitor(isolate),
+      isolate_(isolate),
+      snapshot_start_(0),
+      snapshot_end_(0),
+      copying_(false),
+      failure_(NULL),
+      result_(NULL),
+      source_start_(0),
+      copy_start_(NULL),
+      copy_segment_(0) {
+  const Snapshot* full_snapshot = Snapshot::SetupFromBuffer(snapshot);
+  ASSERT(full_snapshot != NULL);
+  snapshot_start_ = reinterpret_cast<uword>(full_snapshot->content());
+  snapshot_end_ = snapshot_start_ + full_snapshot->length();
+  CollectStubs(isolate, stubs_);
+}
+
+
+IsolateTemplate* IsolateTemplate::Builder::Build() {
+  // Nothing is allocated in the heap while building, so no object moves.
+  GrowableArray<RawObject**> roots;
+  SlotCollector collector(isolate_, &roots);
+  isolate_->object_store()->VisitObjectPointers(&collector);
+  for (intptr_t i = 0; i < roots.length(); i++) {
+    Enqueue(*roots[i]);
+  }
+  ClassTable* class_table = isolate_->class_table();
+  for (intptr_t cid = 1; cid < class_table->NumCids(); cid++) {
+    Enqueue(class_table->At(cid));
+  }
+  // Objects are appended as they are met, so this is a breadth-first walk.
+  for (intptr_t i = 0; (i < objects_.length()) && (failure_ == NULL); i++) {
+    objects_[i]->VisitPointers(this);
+  }
+  // The token streams read from a snapshot point into it.
+  ExternalTypedData& data = ExternalTypedData::Handle(isolate_);
+  for (intptr_t i = 0; i < external_data_.length(); i++) {
+    data = external_data_[i];
+    const uword start = reinterpret_cast<uword>(data.DataAddr(0));
+    if ((start < snapshot_start_) ||
+        (start + data.LengthInBytes() > snapshot_end_)) {
+      Fail("external typed data");
+    }
+  }
+  if (failure_ != NULL) {
+    return NULL;
+  }
+
+  result_ = new IsolateTemplate();
+  LayOut();
+  if (failure_ != NULL) {
+    delete result_;
+    return NULL;
+  }
+  Copy();
+  for (intptr_t i = 0; i < roots.length(); i++) {
+    Root root;
+    EncodeRoot(*roots[i], &root);
+    result_->object_store_roots_.Add(root);
+  }
+  for (intptr_t cid = 1; cid < class_table->NumCids(); cid++) {
+    Root root;
+    EncodeRoot(class_table->At(cid), &root);
+    result_->class_table_roots_.Add(root);
+  }
+  if (failure_ != NULL) {
+    delete result_;
+    return NULL;
+  }
+  return result_;
+}
+
+
+void IsolateTemplate::Builder::VisitPointers(RawObject** first,
+                                             RawObject** last) {
+  if (!copying_) {
+    for (RawObject** current = first; current <= last; current++) {
+      Enqueue(*current);
+    }
+    return;
+  }
+  for (RawObject** current = first; current <= last; current++) {
+    uword value;
+    intptr_t segment;
+    if (Encode(*current, &value, &segment)) {
+      const intptr_t offset = reinterpret_cast<uword>(current) - source_start_;
+      *reinterpret_cast<uword*>(copy_start_ + offset) = value;
+      const intptr_t segment_offset =
+          (copy_start_ + offset) -
+          (result_->image_ + result_->segments_[copy_segment_].offset);
+      Fixup fixup;
+      fixup.offset = static_cast<int32_t>(segment_offset);
+      if (segment == kStubSegment) {
+        fixup.segment = static_cast<int32_t>(copy_segment_);
+        result_->stub_fixups_.Add(fixup);
+      } else {
+        fixup.segment = static_cast<int32_t>(segment);
+        result_->fixups_.Add(fixup);
+      }
+    }
+  }
+}
+
+
+void IsolateTemplate::Builder::Enqueue(RawObject* raw_obj) {
+  if (!raw_obj->IsHeapObject() || (raw_obj == Object::null())) {
+    return;
+  }
+  if (indices_.Lookup(raw_obj) != -1) {
+    return;
+  }
+  for (intptr_t i = 0; i < kNumStubs; i++) {
+    if (raw_obj == stubs_[i]) {
+      return;
+    }
+  }
+  if (raw_obj->IsNewObject()) {
+    Fail("new space object");
+    return;
+  }
+  if (raw_obj->IsVMHeapObject()) {
+    indices_.Insert(ObjectIndexTrait::Pair(raw_obj, kVMHeapObject));
+    return;
+  }
+  const intptr_t cid = raw_obj->GetClassId();
+  if ((cid == kCodeCid) || (cid == kInstructionsCid)) {
+    Fail("code");
+    return;
+  }
+  if (RawObject::IsExternalStringClassId(cid)) {
+    Fail("external string");
+    return;
+  }
+  if (RawObject::IsExternalTypedDataClassId(cid)) {
+    // Checked once the walk is done, as no handles may be created while
+    // visiting an object.
+    external_data_.Add(reinterpret_cast<RawExternalTypedData*>(raw_obj));
+  }
+  indices_.Insert(ObjectIndexTrait::Pair(raw_obj, objects_.length()));
+  objects_.Add(raw_obj);
+}
+
+
+void IsolateTemplate::Builder::LayOut() {
+  // Each segment must fit in a page unless it holds a single large object.
+  intptr_t segment_size = 0;
+  for (intptr_t i = 0; i < objects_.length(); i++) {
+    const intptr_t size = objects_[i]->Size();
+    if ((segment_size > 0) &&
+        (segment_size + size >= PageSpace::kAllocatablePageSize)) {
+      result_->segments_.Last().size = segment_size;
+      segment_size = 0;
+    }
+    if (segment_size == 0) {
+      Segment segment;
+      segment.offset = result_->size_;
+      segment.size = 0;
+      segment.first_fixup = 0;
+      result_->segments_.Add(segment);
+    }
+    object_segments_.Add(result_->segments_.length() - 1);
+    object_offsets_.Add(segment_size);
+    segment_size += size;
+    result_->size_ += size;
+  }
+  if (segment_size > 0) {
+    result_->segments_.Last().size = segment_size;
+  }
+  if (result_->size_ > kMaxInt32) {
+    Fail("size");
+  }
+}
+
+
+void IsolateTemplate::Builder::Copy() {
+  result_->image_ = reinterpret_cast<uint8_t*>(malloc(result_->size_));
+  if (result_->image_ == NULL) {
+    FATAL("Out of memory.\n");
+  }
+  copying_ = true;
+  copy_segment_ = -1;
+  const uword kClearedTags = (static_cast<uword>(1) << RawObject::kMarkBit) |
+      (static_cast<uword>(1) << RawObject::kRememberedBit) |
+      (static_cast<uword>(1) << RawObject::kCardRememberedBit);
+  for (intptr_t i = 0; i < objects_.length(); i++) {
+    RawObject* raw_obj = objects_[i];
+    if (object_segments_[i] != copy_segment_) {
+      copy_segment_ = object_segments_[i];
+      result_->segments_[copy_segment_].first_fixup = result_->fixups_.length();
+    }
+    source_start_ = RawObject::ToAddr(raw_obj);
+    copy_start_ = result_->image_ +
+        result_->segments_[copy_segment_].offset + object_offsets_[i];
+    const intptr_t size = raw_obj->Size();
+    memmove(copy_start_, reinterpret_cast<void*>(source_start_), size);
+    *reinterpret_cast<uword*>(copy_start_) &= ~kClearedTags;
+    raw_obj->VisitPointers(this);
+  }
+  copying_ = false;
+}
+
+
+void IsolateTemplate::Builder::EncodeRoot(RawObject* raw_obj, Root* root) {
+  if (Encode(raw_obj, &root->value, &root->segment)) {
+    if (root->segment == kStubSegment) {
+      Fail("stub root");
+    }
+  } else {
+    root->value = reinterpret_cast<uword>(raw_obj);
+    root->segment = kNoSegment;
+  }
+}
+
+
+bool IsolateTemplate::Builder::Encode(RawObject* raw_obj,
+                                      uword* value,
+                                      intptr_t* segment) {
+  if (!raw_obj->IsHeapObject() || (raw_obj == Object::null())) {
+    return false;
+  }
+  const intptr_t index = indices_.Lookup(raw_obj);
+  if (index >= 0) {
+    *value = object_offsets_[index] + kHeapObjectTag;
+    *segment = object_segments_[index];
+    return true;
+  }
+  for (intptr_t i = 0; i < kNumStubs; i++) {
+    if (raw_obj == stubs_[i]) {
+      *value = reinterpret_cast<uword>(Smi::New(i));
+      *segment = kStubSegment;
+      return true;
+    }
+  }
+  ASSERT(index == kVMHeapObject);
+  return false;
+}
+
+
+IsolateTemplate::IsolateTemplate()
+    : image_(NULL),
+      size_(0) {
+}
+
+
+IsolateTemplate::~IsolateTemplate() {
+  free(image_);
+}
+
+
+void IsolateTemplate::InitOnce() {
+  mutex_ = new Mutex();
+}
+
+
+void IsolateTemplate::Register(const uint8_t* snapshot) {
+  ASSERT(snapshot != NULL);
+  MutexLocker ml(mutex_);
+  for (Registration* current = registrations_;
+       current != NULL;
+       current = current->next_) {
+    if (current->snapshot_ == snapshot) {
+      return;
+    }
+  }
+  registrations_ = new Registration(snapshot, registrations_);
+}
+
+
+IsolateTemplate* IsolateTemplate::Lookup(const uint8_t* snapshot,
+                                         bool* capture) {
+  *capture = false;
+  MutexLocker ml(mutex_);
+  for (Registration* current = registrations_;
+       current != NULL;
+       current = current->next_) {
+    if (current->snapshot_ == snapshot) {
+      if ((current->template_ == NULL) && !current->capture_started_) {
+        // Isolates initialized while the capture runs read the snapshot.
+        current->capture_started_ = true;
+        *capture = true;
+      }
+      return current->template_;
+    }
+  }
+  return NULL;
+}
+
+
+void IsolateTemplate::Capture(const uint8_t* snapshot, Isolate* isolate) {
+  Builder builder(isolate, snapshot);
+  IsolateTemplate* result = builder.Build();
+  if (FLAG_trace_isolates) {
+    if (result == NULL) {
+      OS::Print("Could not take isolate template: %s\n", builder.failure());
+    } else {
+      OS::Print("Size of isolate template = %" Pd "\n", result->size());
+    }
+  }
+  if (result == NULL) {
+    // The capture is not retried.
+    return;
+  }
+  MutexLocker ml(mutex_);
+  for (Registration* current = registrations_;
+       current != NULL;
+       current = current->next_) {
+    if (current->snapshot_ == snapshot) {
+      ASSERT(current->capture_started_ && (current->template_ == NULL));
+      current->template_ = result;
+      return;
+    }
+  }
+  UNREACHABLE();
+}
+
+
+void IsolateTemplate::Cleanup() {
+  MutexLocker ml(mutex_);
+  while (registrations_ != NULL) {
+    Registration* current = registrations_;
+    registrations_ = current->next_;
+    delete current;
+  }
+}
+
+
+uword IsolateTemplate::Resolve(uword value,
+                               intptr_t segment,
+                               const uword* segment_starts) {
+  if (segment == kNoSegment) {
+    return value;
+  }
+  ASSERT(segment >= 0);
+  return segment_starts[segment] + value;
+}
+
+
+void IsolateTemplate::InitializeIsolate(Isolate* isolate) const {
+  const intptr_t num_segments = segments_.length();
+  uword* segment_starts = isolate->current_zone()->Alloc<uword>(num_segments);
+  Class& cls = Class::Handle(isolate);
+  {
+    NoSafepointScope no_safepoint;
+    PageSpace* old_space = isolate->heap()->old_space();
+    old_space->AcquireDataLock();
+    for (intptr_t i = 0; i < num_segments; i++) {
+      const Segment& segment = segments_[i];
+      const uword address =
+          old_space->TryAllocateDataLocked(segment.size,
+                                           PageSpace::kForceGrowth);
+      if (address == 0) {
+        FATAL("Out of memory.\n");
+      }
+      memmove(reinterpret_cast<void*>(address),
+              image_ + segment.offset,
+              segment.size);
+      VerifiedMemory::Accept(address, segment.size);
+      segment_starts[i] = address;
+    }
+    old_space->ReleaseDataLock();
+
+    // The copies only point to each other, so no barrier is needed.
+    for (intptr_t i = 0; i < num_segments; i++) {
+      const intptr_t end = (i + 1 < num_segments) ?
+          segments_[i + 1].first_fixup : fixups_.length();
+      for (intptr_t j = segments_[i].first_fixup; j < end; j++) {
+        const Fixup& fixup = fixups_[j];
+        uword* slot =
+            reinterpret_cast<uword*>(segment_starts[i] + fixup.offset);
+        *slot = Resolve(*slot, fixup.segment, segment_starts);
+      }
+    }
+
+    GrowableArray<RawObject**> roots;
+    SlotCollector collector(isolate, &roots);
+    isolate->object_store()->VisitObjectPointers(&collector);
+    ASSERT(roots.length() == object_store_roots_.length());
+    for (intptr_t i = 0; i < roots.length(); i++) {
+      const Root& root = object_store_roots_[i];
+      *roots[i] = reinterpret_cast<RawObject*>(
+          Resolve(root.value, root.segment, segment_starts));
+    }
+
+    ClassTable* class_table = isolate->class_table();
+    for (intptr_t i = 0; i < class_table_roots_.length(); i++) {
+      const Root& root = class_table_roots_[i];
+      const intptr_t cid = i + 1;
+      if (root.segment == kNoSegment) {
+        // Classes of the VM isolate are set up with the class table.
+        ASSERT((root.value == 0) ||
+               (reinterpret_cast<uword>(class_table->At(cid)) == root.value));
+        continue;
+      }
+      cls ^= reinterpret_cast<RawObject*>(
+          Resolve(root.value, root.segment, segment_starts));
+      if (cid < kNumPredefinedCids) {
+        ASSERT(cls.id() == cid);
+        class_table->Register(cls);
+      } else {
+        class_table->RegisterAt(cid, cls);
+      }
+    }
+  }
+
+  // Generating the stubs needs the object store. Until they are patched in,
+  // the slots pointing to stubs hold the index of the stub as a Smi.
+  StubCode::InitBootstrapStubs(isolate);
+  RawObject* stubs[kNumStubs];
+  CollectStubs(isolate, stubs);
+  NoSafepointScope no_safepoint;
+  for (intptr_t i = 0; i < stub_fixups_.length(); i++) {
+    const Fixup& fixup = stub_fixups_[i];
+    RawObject** slot = reinterpret_cast<RawObject**>(
+        segment_starts[fixup.segment] + fixup.offset);
+    *slot = stubs[Smi::Value(reinterpret_cast<RawSmi*>(*slot))];
+  }
+#if defined(DEBUG)
+  isolate->ValidateClassTable();
+#endif
+}
+
+}  // namespace dart
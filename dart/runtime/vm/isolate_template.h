@@ -0,0 +1,110 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_ISOLATE_TEMPLATE_H_
+#define VM_ISOLATE_TEMPLATE_H_
+
+#include "vm/allocation.h"
+#include "vm/globals.h"
+#include "vm/growable_array.h"
+
+namespace dart {
+
+// Forward declarations.
+class Isolate;
+class RawObject;
+
+// An image of the heap of an isolate right after it has been read from a full
+// snapshot, from which later isolates created from the same snapshot are
+// cloned instead of reading the snapshot again.
+//
+// The image holds the objects reachable from the object store and the class
+// table, packed into segments which are each copied into one allocation of
+// the old space of a clone. Pointers between the objects are relocated using
+// the fixups of the image, pointers to the bootstrap stubs of the isolate the
+// image was taken from are replaced with the ones of the clone. Any other
+// code, new space objects or external strings make the capture fail, so that
+// the snapshot keeps being read.
+//
+// Templates are only taken for snapshots which the embedder registered, as
+// the snapshot buffer is what identifies a template. A registered snapshot
+// must not change or be freed until the VM is cleaned up.
+class IsolateTemplate {
+ public:
+  static void InitOnce();
+
+  // Registers a snapshot for which the first isolate initialized from it is
+  // taken as a template.
+  static void Register(const uint8_t* snapshot);
+
+  // Returns the template of the snapshot, or NULL if it has none. Sets
+  // *capture if the isolate about to be initialized from the snapshot should
+  // be taken as its template, which is the case for the first one only.
+  static IsolateTemplate* Lookup(const uint8_t* snapshot, bool* capture);
+
+  // Takes the template of the snapshot from an isolate which has just been
+  // read from it. Lookup must have asked for the capture.
+  static void Capture(const uint8_t* snapshot, Isolate* isolate);
+
+  // Frees all templates. No isolate may be running.
+  static void Cleanup();
+
+  // Initializes the heap, object store, class table and bootstrap stubs of a
+  // new isolate from the template.
+  void InitializeIsolate(Isolate* isolate) const;
+
+  intptr_t size() const { return size_; }
+
+ private:
+  class Builder;
+  class Registration;
+
+  // A run of objects which is copied into one allocation.
+  struct Segment {
+    intptr_t offset;  // Offset in image_.
+    intptr_t size;
+    intptr_t first_fixup;  // Index of the first fixup of the segment.
+  };
+
+  // A slot in the image pointing to an object of the image, which holds the
+  // offset of the object in its segment plus kHeapObjectTag. A stub fixup is
+  // for a slot pointing to a stub, which holds the index of the stub as a Smi.
+  struct Fixup {
+    int32_t offset;  // Offset of the slot in its segment.
+    int32_t segment;  // Of the object, or of the slot for a stub fixup.
+  };
+
+  // A pointer in the object store or the class table.
+  struct Root {
+    uword value;  // As held by a slot of the image, or the pointer itself.
+    intptr_t segment;  // Of the object, or kNoSegment.
+  };
+
+  static const intptr_t kNoSegment = -1;
+  static const intptr_t kStubSegment = -2;
+
+  IsolateTemplate();
+  ~IsolateTemplate();
+
+  static uword Resolve(uword value,
+                       intptr_t segment,
+                       const uword* segment_starts);
+
+  uint8_t* image_;
+  intptr_t size_;
+  MallocGrowableArray<Segment> segments_;
+  MallocGrowableArray<Fixup> fixups_;
+  MallocGrowableArray<Fixup> stub_fixups_;
+  MallocGrowableArray<Root> object_store_roots_;
+  MallocGrowableArray<Root> class_table_roots_;
+
+  static Mutex* mutex_;
+  static Registration* registrations_;  // Protected by mutex_.
+
+  DISALLOW_COPY_AND_ASSIGN(IsolateTemplate);
+};
+
+}  // namespace dart
+
+#endif  // VM_ISOLATE_TEMPLATE_H_
@@ -0,0 +1,65 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/assert.h"
+#include "vm/isolate.h"
+#include "vm/isolate_template.h"
+#include "vm/object.h"
+#include "vm/object_store.h"
+#include "vm/unit_test.h"
+
+namespace dart {
+
+static void CountClassesAndLibraries(intptr_t* num_cids,
+                                     intptr_t* num_libraries) {
+  Isolate* isolate = Isolate::Current();
+  StackZone zone(isolate);
+  HandleScope handle_scope(isolate);
+  EXPECT(isolate->heap()->Verify());
+  *num_cids = isolate->class_table()->NumCids();
+  *num_libraries = GrowableObjectArray::Handle(
+      isolate->object_store()->libraries()).Length();
+}
+
+
+UNIT_TEST_CASE(IsolateTemplate_Clone) {
+  // Other tests read the snapshot, so the first test isolate created after
+  // registering it becomes the template.
+  IsolateTemplate::Register(bin::isolate_snapshot_buffer);
+  TestCase::CreateTestIsolate();
+  intptr_t num_cids = 0;
+  intptr_t num_libraries = 0;
+  CountClassesAndLibraries(&num_cids, &num_libraries);
+  Dart_ShutdownIsolate();
+  bool capture = true;
+  EXPECT(IsolateTemplate::Lookup(bin::isolate_snapshot_buffer,
+                                 &capture) != NULL);
+  EXPECT(!capture);
+
+  TestCase::CreateTestIsolate();
+  intptr_t clone_num_cids = 0;
+  intptr_t clone_num_libraries = 0;
+  CountClassesAndLibraries(&clone_num_cids, &clone_num_libraries);
+  EXPECT_EQ(num_cids, clone_num_cids);
+  EXPECT_EQ(num_libraries, clone_num_libraries);
+
+  // The clone loads and runs code like an isolate read from the snapshot.
+  const char* kScriptChars =
+      "main() {\n"
+      "  return [1, 2, 3].map((x) => x * 2).toList().toString();\n"
+      "}\n";
+  Dart_EnterScope();
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  EXPECT_VALID(lib);
+  Dart_Handle result = Dart_Invoke(lib, NewString("main"), 0, NULL);
+  EXPECT_VALID(result);
+  const char* value = NULL;
+  EXPECT_VALID(Dart_StringToCString(result, &value));
+  EXPECT_STREQ("[2, 4, 6]", value);
+  Dart_ExitScope();
+  Dart_ShutdownIsolate();
+  IsolateTemplate::Cleanup();
+}
+
+}  // namespace dart
@@ -4,6 +4,7 @@
 
 #include "vm/message.h"
 
+#include "vm/atomic.h"
 #include "vm/port.h"
 
 namespace dart {
@@ -21,6 +22,7 @@ bool Message::RedirectToDeliveryFailurePort() {
 MessageQueue::MessageQueue() {
   head_ = NULL;
   tail_ = NULL;
+  inbox_ = NULL;
 }
 
 
@@ -28,12 +30,27 @@ MessageQueue::~MessageQueue() {
   // Ensure that all pending messages have been released.
   Clear();
   ASSERT(head_ == NULL);
+  ASSERT(inbox_ == NULL);
 }
 
 
-void MessageQueue::Enqueue(Message* msg, bool before_events) {
+bool MessageQueue::Enqueue(Message* msg, bool before_events) {
   // Make sure messages are not reused.
   ASSERT(msg->next_ == NULL);
+  if (!before_events) {
+    // Push onto the inbox.
+    uword* inbox = reinterpret_cast<uword*>(const_cast<Message**>(&inbox_));
+    uword old_inbox;
+    do {
+      old_inbox = *inbox;
+      msg->next_ = reinterpret_cast<Message*>(old_inbox);
+    } while (AtomicOperations::CompareAndSwapWord(
+        inbox, old_inbox, reinterpret_cast<uword>(msg)) != old_inbox);
+    return old_inbox == 0;
+  }
+  // Messages already in the inbox are pending events too.
+  DrainInbox();
+  const bool was_empty = (head_ == NULL);
   if (head_ == NULL) {
     // Only element in the queue.
     ASSERT(tail_ == NULL);
@@ -41,39 +58,67 @@ void MessageQueue::Enqueue(Message* msg, bool before_events) {
     tail_ = msg;
   } else {
     ASSERT(tail_ != NULL);
-    if (!before_events) {
-        // Append at the tail.
-        tail_->next_ = msg;
-        tail_ = msg;
+    ASSERT(msg->dest_port() == Message::kIllegalPort);
+    if (head_->dest_port() != Message::kIllegalPort) {
+      msg->next_ = head_;
+      head_ = msg;
     } else {
-      ASSERT(msg->dest_port() == Message::kIllegalPort);
-      if (head_->dest_port() != Message::kIllegalPort) {
-        msg->next_ = head_;
-        head_ = msg;
-      } else {
-        Message* cur = head_;
-        while (cur->next_ != NULL) {
-          if (cur->next_->dest_port() != Message::kIllegalPort) {
-            // Splice in the new message at the break.
-            msg->next_ = cur->next_;
-            cur->next_ = msg;
-            return;
-          }
-          cur = cur->next_;
+      Message* cur = head_;
+      while (cur->next_ != NULL) {
+        if (cur->next_->dest_port() != Message::kIllegalPort) {
+          // Splice in the new message at the break.
+          msg->next_ = cur->next_;
+          cur->next_ = msg;
+          return was_empty;
         }
-        // All pending messages are isolate library control messages. Append at
-        // the tail.
-        ASSERT(tail_ == cur);
-        ASSERT(tail_->dest_port() == Message::kIllegalPort);
-        tail_->next_ = msg;
-        tail_ = msg;
+        cur = cur->next_;
       }
+      // All pending messages are isolate library control messages. Append at
+      // the tail.
+      ASSERT(tail_ == cur);
+      ASSERT(tail_->dest_port() == Message::kIllegalPort);
+      tail_->next_ = msg;
+      tail_ = msg;
     }
   }
+  return was_empty;
+}
+
+
+void MessageQueue::DrainInbox() {
+  if (inbox_ == NULL) {
+    return;
+  }
+  // Take the whole inbox at once.
+  uword* inbox = reinterpret_cast<uword*>(const_cast<Message**>(&inbox_));
+  uword old_inbox;
+  do {
+    old_inbox = *inbox;
+  } while (AtomicOperations::CompareAndSwapWord(inbox, old_inbox, 0) !=
+           old_inbox);
+  // Reverse it into posting order and append it to the queue.
+  Message* first = reinterpret_cast<Message*>(old_inbox);
+  Message* last = first;
+  Message* reversed = NULL;
+  while (first != NULL) {
+    Message* next = first->next_;
+    first->next_ = reversed;
+    reversed = first;
+    first = next;
+  }
+  if (head_ == NULL) {
+    head_ = reversed;
+  } else {
+    tail_->next_ = reversed;
+  }
+  tail_ = last;
 }
 
 
 Message* MessageQueue::Dequeue() {
+  if (head_ == NULL) {
+    DrainInbox();
+  }
   Message* result = head_;
   if (result != NULL) {
     head_ = result->next_;
@@ -91,6 +136,7 @@ Message* MessageQueue::Dequeue() {
 
 
 void MessageQueue::Clear() {
+  DrainInbox();
   Message* cur = head_;
   head_ = NULL;
   tail_ = NULL;
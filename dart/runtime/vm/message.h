@@ -50,7 +50,8 @@ class Message {
         delivery_failure_port_(delivery_failure_port),
         data_(data),
         len_(len),
-        priority_(priority) {
+        priority_(priority),
+        post_time_micros_(0) {
     ASSERT((priority == kNormalPriority) ||
            (delivery_failure_port == kIllegalPort));
   }
@@ -61,11 +62,22 @@ class Message {
 
   Dart_Port dest_port() const { return dest_port_; }
   uint8_t* data() const { return data_; }
+  // Transfers ownership of the data to the caller, who becomes responsible
+  // for freeing it. The data stays valid for the rest of the message's life.
+  uint8_t* TakeData() {
+    uint8_t* data = data_;
+    data_ = NULL;
+    return data;
+  }
   intptr_t len() const { return len_; }
   Priority priority() const { return priority_; }
 
   bool IsOOB() const { return priority_ == Message::kOOBPriority; }
 
+  // The time the message was posted to its handler.
+  int64_t post_time_micros() const { return post_time_micros_; }
+  void set_post_time_micros(int64_t value) { post_time_micros_ = value; }
+
   bool RedirectToDeliveryFailurePort();
 
  private:
@@ -77,30 +89,49 @@ class Message {
   uint8_t* data_;
   intptr_t len_;
   Priority priority_;
+  int64_t post_time_micros_;
 
   DISALLOW_COPY_AND_ASSIGN(Message);
 };
 
 // There is a message queue per isolate.
+//
+// Any number of producers may enqueue messages concurrently without locking:
+// they push onto a lock-free inbox. The single consumer takes the whole inbox
+// at once whenever it runs out of messages, so it pays for synchronization
+// once per batch rather than once per message. All other operations are only
+// to be used by the consumer, which must serialize them by other means.
 class MessageQueue {
  public:
   MessageQueue();
   ~MessageQueue();
 
-  void Enqueue(Message* msg, bool before_events);
+  // Appends 'msg' to the queue. Returns true if the queue's inbox was empty,
+  // i.e., if the consumer might have to be woken up to see the message.
+  //
+  // Messages enqueued 'before_events' are placed before any pending events,
+  // but after any pending isolate library control messages. They may only be
+  // enqueued by the consumer.
+  bool Enqueue(Message* msg, bool before_events);
 
   // Gets the next message from the message queue or NULL if no
   // message is available.  This function will not block.
   Message* Dequeue();
 
-  bool IsEmpty() { return head_ == NULL; }
+  bool IsEmpty() { return (head_ == NULL) && (inbox_ == NULL); }
 
   // Clear all messages from the message queue.
   void Clear();
 
  private:
+  // Moves all messages from the inbox to the end of the queue, in the order
+  // in which they were enqueued.
+  void DrainInbox();
+
   Message* head_;
   Message* tail_;
+  // Messages enqueued by producers, most recent first.
+  Message* volatile inbox_;
 
   DISALLOW_COPY_AND_ASSIGN(MessageQueue);
 };
@@ -5,14 +5,58 @@
 #include "vm/message_handler.h"
 
 #include "vm/dart.h"
+#include "vm/json_stream.h"
 #include "vm/lockers.h"
 #include "vm/port.h"
 
 namespace dart {
 
+DEFINE_FLAG(int, message_handler_slice_millis, 0,
+    "If positive, a message handler running on the thread pool gives up its "
+    "worker to other tasks after handling messages for this long.");
+DEFINE_FLAG(bool, message_queue_latency, false,
+    "Record how long messages wait in the queues of their message handler.");
 DECLARE_FLAG(bool, trace_isolates);
 DECLARE_FLAG(bool, trace_service_pause_events);
 
+
+MessageLatencyHistogram::MessageLatencyHistogram()
+    : count_(0), total_micros_(0), max_micros_(0) {
+  for (intptr_t i = 0; i < kNumBuckets; i++) {
+    buckets_[i] = 0;
+  }
+}
+
+
+void MessageLatencyHistogram::Add(int64_t latency_micros) {
+  // The clock is not monotonic.
+  if (latency_micros < 0) {
+    latency_micros = 0;
+  }
+  intptr_t bucket = Utils::BitLength(latency_micros);
+  if (bucket >= kNumBuckets) {
+    bucket = kNumBuckets - 1;
+  }
+  buckets_[bucket]++;
+  count_++;
+  total_micros_ += latency_micros;
+  if (latency_micros > max_micros_) {
+    max_micros_ = latency_micros;
+  }
+}
+
+
+void MessageLatencyHistogram::PrintToJSONObject(JSONObject* obj) const {
+  obj->AddProperty64("count", count_);
+  obj->AddProperty64("totalMicros", total_micros_);
+  obj->AddProperty64("maxMicros", max_micros_);
+  JSONArray arr(obj, "buckets");
+  for (intptr_t i = 0; i < kNumBuckets; i++) {
+    arr.AddValue64(buckets_[i]);
+  }
+}
+
+
 class MessageHandlerTask : public ThreadPool::Task {
  public:
   explicit MessageHandlerTask(MessageHandler* handler)
@@ -88,40 +132,71 @@ void MessageHandler::Run(ThreadPool* pool,
   start_callback_ = start_callback;
   end_callback_ = end_callback;
   callback_data_ = data;
+  RunNewTask(IsHighPriority(), false);
+}
+
+
+void MessageHandler::RunNewTask(bool high_priority, bool later) {
+  ASSERT(task_ == NULL);
   task_ = new MessageHandlerTask(this);
-  pool_->Run(task_);
+  task_->set_high_priority(high_priority);
+  if (later) {
+    pool_->RunLater(task_);
+  } else {
+    pool_->Run(task_);
+  }
 }
 
 
 void MessageHandler::PostMessage(Message* message, bool before_events) {
-  Message::Priority saved_priority;
-  {
-    MonitorLocker ml(&monitor_);
-    if (FLAG_trace_isolates) {
-      const char* source_name = "<native code>";
-      Isolate* source_isolate = Isolate::Current();
-      if (source_isolate) {
-        source_name = source_isolate->name();
-      }
-      OS::Print("[>] Posting message:\n"
-                "\tlen:        %" Pd "\n"
-                "\tsource:     %s\n"
-                "\tdest:       %s\n"
-                "\tdest_port:  %" Pd64 "\n",
-                message->len(), source_name, name(), message->dest_port());
-    }
-
-    saved_priority = message->priority();
-    if (message->IsOOB()) {
-      oob_queue_->Enqueue(message, before_events);
-    } else {
-      queue_->Enqueue(message, before_events);
+  if (FLAG_trace_isolates) {
+    const char* source_name = "<native code>";
+    Isolate* source_isolate = Isolate::Current();
+    if (source_isolate) {
+      source_name = source_isolate->name();
     }
-    message = NULL;  // Do not access message.  May have been deleted.
+    OS::Print("[>] Posting message:\n"
+              "\tlen:        %" Pd "\n"
+              "\tsource:     %s\n"
+              "\tdest:       %s\n"
+              "\tdest_port:  %" Pd64 "\n",
+              message->len(), source_name, name(), message->dest_port());
+  }
 
+  Message::Priority saved_priority = message->priority();
+  if (FLAG_message_queue_latency) {
+    message->set_post_time_micros(OS::GetCurrentTimeMicros());
+  }
+  bool was_empty;
+  if (before_events) {
+    // Only the handler itself enqueues before events, like any consumer-side
+    // queue operation under the monitor.
+    MonitorLocker ml(&monitor_);
+    was_empty = queue_->Enqueue(message, true);
+  } else {
+    // Producers do not need the monitor to enqueue.
+    MessageQueue* queue = message->IsOOB() ? oob_queue_ : queue_;
+    was_empty = queue->Enqueue(message, false);
+  }
+  message = NULL;  // Do not access message.  May have been deleted.
+
+  if (!was_empty && (pool_ != NULL)) {
+    // A handler running on the thread pool drains its queues completely
+    // before it goes idle, so it only needs to be woken up by the post that
+    // made a queue non-empty. Handlers driven by the embedder are notified of
+    // every message, as they handle one message per notification.
+    return;
+  }
+  {
+    bool high_priority =
+        (saved_priority == Message::kOOBPriority) || IsHighPriority();
+    MonitorLocker ml(&monitor_);
     if (pool_ != NULL && task_ == NULL) {
-      task_ = new MessageHandlerTask(this);
-      pool_->Run(task_);
+      RunNewTask(high_priority, false);
+    } else if (high_priority && (task_ != NULL)) {
+      // The task may still wait behind normal priority tasks. It is not
+      // deleted before it clears task_ with monitor_ held.
+      pool_->Promote(task_);
     }
   }
   // Invoke any custom message notification.
@@ -135,12 +210,29 @@ Message* MessageHandler::DequeueMessage(Message::Priority min_priority) {
   if ((message == NULL) && (min_priority < Message::kOOBPriority)) {
     message = queue_->Dequeue();
   }
+  // Messages posted before the flag was set have no post time.
+  if ((message != NULL) && (message->post_time_micros() != 0)) {
+    latency_.Add(OS::GetCurrentTimeMicros() - message->post_time_micros());
+  }
   return message;
 }
 
 
+bool MessageHandler::HasPendingMessages() {
+  // TODO(turnidge): Add assert that monitor_ is held here.
+  return !oob_queue_->IsEmpty() || (!paused() && !queue_->IsEmpty());
+}
+
+
+void MessageHandler::PrintLatencyToJSONObject(JSONObject* obj) {
+  MonitorLocker ml(&monitor_);
+  latency_.PrintToJSONObject(obj);
+}
+
+
 bool MessageHandler::HandleMessages(bool allow_normal_messages,
-                                    bool allow_multiple_normal_messages) {
+                                    bool allow_multiple_normal_messages,
+                                    int64_t deadline_micros) {
   // If isolate() returns NULL StartIsolateScope does nothing.
   StartIsolateScope start_isolate(isolate());
 
@@ -184,6 +276,10 @@ bool MessageHandler::HandleMessages(bool allow_normal_messages,
         !allow_multiple_normal_messages) {
       break;
     }
+    if ((deadline_micros != 0) &&
+        (OS::GetCurrentTimeMicros() >= deadline_micros)) {
+      break;
+    }
 
     // Reevaluate the minimum allowable priority as the paused state might
     // have changed as part of handling the message.
@@ -257,11 +353,24 @@ void MessageHandler::TaskCallback() {
     }
 
     // Handle any pending messages for this message handler.
+    int64_t deadline_micros = 0;
+    if (FLAG_message_handler_slice_millis > 0) {
+      deadline_micros = OS::GetCurrentTimeMicros() +
+          FLAG_message_handler_slice_millis * kMicrosecondsPerMillisecond;
+    }
     if (ok) {
-      ok = HandleMessages(true, true);
+      ok = HandleMessages(true, true, deadline_micros);
     }
     task_ = NULL;  // No task in queue.
 
+    if (ok && (deadline_micros != 0) && HasLivePorts() &&
+        HasPendingMessages()) {
+      // The turn is over. Let the tasks queued meanwhile run before going
+      // on with the remaining messages.
+      RunNewTask(IsHighPriority() || !oob_queue_->IsEmpty(), true);
+      return;
+    }
+
     if (!ok || !HasLivePorts()) {
       if (pause_on_exit()) {
         if (!paused_on_exit_) {
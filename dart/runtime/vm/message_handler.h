@@ -12,6 +12,41 @@
 
 namespace dart {
 
+// Forward declarations.
+class JSONObject;
+
+// A histogram of the time messages wait in the queues of a message handler
+// before they are handled, recorded with --message_queue_latency. Bucket 0 counts waits under a microsecond, bucket
+// i > 0 waits of [2^(i-1), 2^i) microseconds, and the last one all longer
+// waits.
+class MessageLatencyHistogram {
+ public:
+  static const intptr_t kNumBuckets = 32;
+
+  MessageLatencyHistogram();
+
+  void Add(int64_t latency_micros);
+
+  int64_t count() const { return count_; }
+  int64_t total_micros() const { return total_micros_; }
+  int64_t max_micros() const { return max_micros_; }
+  int64_t bucket(intptr_t i) const {
+    ASSERT((i >= 0) && (i < kNumBuckets));
+    return buckets_[i];
+  }
+
+  void PrintToJSONObject(JSONObject* obj) const;
+
+ private:
+  int64_t count_;
+  int64_t total_micros_;
+  int64_t max_micros_;
+  int64_t buckets_[kNumBuckets];
+
+  DISALLOW_COPY_AND_ASSIGN(MessageLatencyHistogram);
+};
+
+
 // A MessageHandler is an entity capable of accepting messages.
 class MessageHandler {
  protected:
@@ -36,6 +71,11 @@ class MessageHandler {
   // no longer has any live ports.  Abnormal termination occurs when
   // HandleMessage() indicates that an error has occurred during
   // message processing.
+  //
+  // If --message_handler_slice_millis is set, a handler which still has
+  // messages once its turn is over gives up its worker and continues in a
+  // new task queued behind the other tasks of the pool. The new task is
+  // high priority if the handler is, or if OOB messages are pending.
   void Run(ThreadPool* pool,
            StartCallback start_callback,
            EndCallback end_callback,
@@ -96,6 +136,9 @@ class MessageHandler {
     return paused_on_exit_;
   }
 
+  // Prints the histogram of the time messages waited to be handled.
+  void PrintLatencyToJSONObject(JSONObject* obj);
+
 
 #if defined(DEBUG)
   // Check that it is safe to access this message handler.
@@ -116,6 +159,10 @@ class MessageHandler {
   // Return Isolate to which this message handler corresponds to.
   virtual Isolate* isolate() const { return NULL; }
 
+  // Whether the tasks of this handler run before the other queued tasks of
+  // the thread pool.
+  virtual bool IsHighPriority() const { return false; }
+
   // Posts a message on this handler's message queue.
   // If before_events is true, then the message is enqueued before any pending
   // events, but after any pending isolate library events.
@@ -159,9 +206,18 @@ class MessageHandler {
   // messages from the queue_.
   Message* DequeueMessage(Message::Priority min_priority);
 
-  // Handles any pending messages.
+  // Handles any pending messages. Stops after the first message handled at
+  // or past deadline_micros, if it is not 0.
   bool HandleMessages(bool allow_normal_messages,
-                      bool allow_multiple_normal_messages);
+                      bool allow_multiple_normal_messages,
+                      int64_t deadline_micros = 0);
+
+  // Returns true if there are messages which HandleMessages would handle.
+  bool HasPendingMessages();
+
+  // Queues a new task to handle the pending messages. Must be called with
+  // monitor_ held.
+  void RunNewTask(bool high_priority, bool later);
 
   Monitor monitor_;  // Protects all fields in MessageHandler.
   MessageQueue* queue_;
@@ -177,6 +233,7 @@ class MessageHandler {
   StartCallback start_callback_;
   EndCallback end_callback_;
   CallbackData callback_data_;
+  MessageLatencyHistogram latency_;
 
   DISALLOW_COPY_AND_ASSIGN(MessageHandler);
 };
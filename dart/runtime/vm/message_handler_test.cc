@@ -8,6 +8,10 @@
 
 namespace dart {
 
+DECLARE_FLAG(int, message_handler_slice_millis);
+DECLARE_FLAG(bool, message_queue_latency);
+DECLARE_FLAG(int, thread_pool_starvation_millis);
+
 class MessageHandlerTestPeer {
  public:
   explicit MessageHandlerTestPeer(MessageHandler* handler)
@@ -22,6 +26,9 @@ class MessageHandlerTestPeer {
 
   MessageQueue* queue() const { return handler_->queue_; }
   MessageQueue* oob_queue() const { return handler_->oob_queue_; }
+  const MessageLatencyHistogram& latency() const {
+    return handler_->latency_;
+  }
 
  private:
   MessageHandler* handler_;
@@ -329,4 +336,175 @@ UNIT_TEST_CASE(MessageHandler_Run) {
   PortMap::ClosePorts(&handler);
 }
 
+
+class SlowTestMessageHandler : public TestMessageHandler {
+ public:
+  SlowTestMessageHandler() { }
+
+  bool HandleMessage(Message* message) {
+    OS::Sleep(2);
+    return TestMessageHandler::HandleMessage(message);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SlowTestMessageHandler);
+};
+
+
+// Records how many messages a handler had handled when the task ran.
+class MessageCountTask : public ThreadPool::Task {
+ public:
+  MessageCountTask(TestMessageHandler* handler, Monitor* sync, int* count)
+      : handler_(handler), sync_(sync), count_(count) {
+  }
+
+  virtual void Run() {
+    MonitorLocker ml(sync_);
+    *count_ = handler_->message_count();
+    ml.Notify();
+  }
+
+ private:
+  TestMessageHandler* handler_;
+  Monitor* sync_;
+  int* count_;
+};
+
+
+UNIT_TEST_CASE(MessageHandler_RunTimeSliced) {
+  const int saved_slice_millis = FLAG_message_handler_slice_millis;
+  FLAG_message_handler_slice_millis = 1;
+  // A single worker, so that the task below only runs once the handler
+  // yields it.
+  ThreadPool pool(1);
+  SlowTestMessageHandler handler;
+  MessageHandlerTestPeer handler_peer(&handler);
+  int sleep = 0;
+  const int kMaxSleep = 20 * 1000;  // 20 seconds.
+  const int kMessageCount = 20;
+
+  handler_peer.increment_live_ports();
+  Dart_Port port = PortMap::CreatePort(&handler);
+  for (int i = 0; i < kMessageCount; i++) {
+    handler_peer.PostMessage(
+        new Message(port, NULL, 0, Message::kNormalPriority));
+  }
+  handler.Run(&pool, NULL, NULL, 0);
+  while (sleep < kMaxSleep && handler.message_count() < 1) {
+    OS::Sleep(1);
+    sleep += 1;
+  }
+  Monitor sync;
+  int count = -1;
+  pool.Run(new MessageCountTask(&handler, &sync, &count));
+  {
+    MonitorLocker ml(&sync);
+    while (count == -1) {
+      ml.Wait();
+    }
+  }
+  EXPECT(count < kMessageCount);
+  while (sleep < kMaxSleep && handler.message_count() < kMessageCount) {
+    OS::Sleep(10);
+    sleep += 10;
+  }
+  EXPECT_EQ(kMessageCount, handler.message_count());
+  EXPECT(!handler.end_called());
+  Dart_Port* handler_ports = handler.port_buffer();
+  for (int i = 0; i < kMessageCount; i++) {
+    EXPECT_EQ(port, handler_ports[i]);
+  }
+  handler_peer.decrement_live_ports();
+  PortMap::ClosePorts(&handler);
+  FLAG_message_handler_slice_millis = saved_slice_millis;
+}
+
+
+// Blocks its worker until it is opened.
+class GateTask : public ThreadPool::Task {
+ public:
+  GateTask(Monitor* sync, bool* open) : sync_(sync), open_(open) {
+  }
+
+  virtual void Run() {
+    MonitorLocker ml(sync_);
+    while (!*open_) {
+      ml.Wait();
+    }
+  }
+
+ private:
+  Monitor* sync_;
+  bool* open_;
+};
+
+
+UNIT_TEST_CASE(MessageHandler_PromoteOnOOB) {
+  // Keep the blocked worker counted, so that the queued tasks wait for it.
+  const int saved_starvation_millis = FLAG_thread_pool_starvation_millis;
+  FLAG_thread_pool_starvation_millis = 20 * 1000;
+  ThreadPool pool(1);
+  TestMessageHandler handler;
+  MessageHandlerTestPeer handler_peer(&handler);
+  Monitor sync;
+  bool open = false;
+  int count = -1;
+  pool.Run(new GateTask(&sync, &open));
+
+  // The handler's task is queued at normal priority, before another task.
+  handler_peer.increment_live_ports();
+  handler.Run(&pool, NULL, NULL, 0);
+  pool.Run(new MessageCountTask(&handler, &sync, &count));
+
+  // An OOB message moves the handler's task ahead.
+  Dart_Port port = PortMap::CreatePort(&handler);
+  handler_peer.PostMessage(new Message(port, NULL, 0, Message::kOOBPriority));
+  EXPECT_EQ(1U, pool.high_priority_tasks_queued());
+  {
+    MonitorLocker ml(&sync);
+    open = true;
+    ml.NotifyAll();
+    while (count == -1) {
+      ml.Wait();
+    }
+  }
+  EXPECT_EQ(1, count);
+  handler_peer.decrement_live_ports();
+  PortMap::ClosePorts(&handler);
+  FLAG_thread_pool_starvation_millis = saved_starvation_millis;
+}
+
+
+UNIT_TEST_CASE(MessageHandler_Latency) {
+  const bool saved_latency = FLAG_message_queue_latency;
+  TestMessageHandler handler;
+  MessageHandlerTestPeer handler_peer(&handler);
+  Dart_Port port = PortMap::CreatePort(&handler);
+  const MessageLatencyHistogram& latency = handler_peer.latency();
+
+  // Nothing is recorded without the flag.
+  FLAG_message_queue_latency = false;
+  handler_peer.PostMessage(
+      new Message(port, NULL, 0, Message::kNormalPriority));
+  EXPECT(handler.HandleNextMessage());
+  EXPECT_EQ(0, latency.count());
+
+  FLAG_message_queue_latency = true;
+  handler_peer.PostMessage(new Message(port, NULL, 0, Message::kOOBPriority));
+  handler_peer.PostMessage(
+      new Message(port, NULL, 0, Message::kNormalPriority));
+  OS::Sleep(2);
+  EXPECT(handler.HandleNextMessage());
+  EXPECT_EQ(2, latency.count());
+  EXPECT(latency.max_micros() >= 2 * kMicrosecondsPerMillisecond);
+  EXPECT(latency.total_micros() >= latency.max_micros());
+  int64_t bucketed = 0;
+  for (intptr_t i = 0; i < MessageLatencyHistogram::kNumBuckets; i++) {
+    bucketed += latency.bucket(i);
+  }
+  EXPECT_EQ(2, bucketed);
+  PortMap::ClosePorts(&handler);
+  FLAG_message_queue_latency = saved_latency;
+}
+
 }  // namespace dart
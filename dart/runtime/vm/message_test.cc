@@ -4,6 +4,8 @@
 
 #include "platform/assert.h"
 #include "vm/message.h"
+#include "vm/os.h"
+#include "vm/os_thread.h"
 #include "vm/unit_test.h"
 
 namespace dart {
@@ -126,4 +128,60 @@ TEST_CASE(MessageQueue_Clear) {
   // msg1 and msg2 already delete by FlushAll.
 }
 
+
+struct EnqueueInfo {
+  MessageQueue* queue;
+  Dart_Port port;
+  intptr_t count;
+};
+
+
+// Enqueues 'count' messages whose lengths are their sequence numbers.
+static void EnqueueMessages(uword param) {
+  EnqueueInfo* info = reinterpret_cast<EnqueueInfo*>(param);
+  for (intptr_t i = 0; i < info->count; i++) {
+    info->queue->Enqueue(
+        new Message(info->port, NULL, i, Message::kNormalPriority), false);
+  }
+}
+
+
+UNIT_TEST_CASE(MessageQueue_ConcurrentEnqueue) {
+  const intptr_t kNumProducers = 4;
+  const intptr_t kMessagesPerProducer = 10000;
+  MessageQueue queue;
+  EnqueueInfo infos[kNumProducers];
+  intptr_t next[kNumProducers];
+  for (intptr_t i = 0; i < kNumProducers; i++) {
+    infos[i].queue = &queue;
+    infos[i].port = i + 1;
+    infos[i].count = kMessagesPerProducer;
+    next[i] = 0;
+    int result = OSThread::Start(EnqueueMessages,
+                                 reinterpret_cast<uword>(&infos[i]));
+    EXPECT_EQ(0, result);
+  }
+  // Dequeue while the producers are running. The messages of each producer
+  // arrive in the order they were enqueued.
+  intptr_t received = 0;
+  int sleep = 0;
+  const int kMaxSleep = 20 * 1000;  // 20 seconds.
+  while ((received < kNumProducers * kMessagesPerProducer) &&
+         (sleep < kMaxSleep)) {
+    Message* msg = queue.Dequeue();
+    if (msg == NULL) {
+      OS::Sleep(1);
+      sleep += 1;
+      continue;
+    }
+    const intptr_t producer = msg->dest_port() - 1;
+    EXPECT_EQ(next[producer], msg->len());
+    next[producer] = msg->len() + 1;
+    received++;
+    delete msg;
+  }
+  EXPECT_EQ(kNumProducers * kMessagesPerProducer, received);
+  EXPECT(queue.IsEmpty());
+}
+
 }  // namespace dart
@@ -181,6 +181,7 @@ namespace dart {
   V(_GrowableList, add, GrowableArray_add, 422087403)                          \
   V(_JSSyntaxRegExp, _ExecuteMatch, JSRegExp_ExecuteMatch, 1654250896)         \
   V(Object, ==, ObjectEquals, 1955975370)                                      \
+  V(Object, _getHash, Object_getHash, 1473311685)                              \
   V(_StringBase, get:hashCode, String_getHashCode, 2102936032)                 \
   V(_StringBase, get:isEmpty, StringBaseIsEmpty, 769493198)                    \
   V(_StringBase, codeUnitAt, StringBaseCodeUnitAt, 397735324)                  \
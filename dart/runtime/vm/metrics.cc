@@ -212,6 +212,12 @@ int64_t MetricHeapOldExternal::Value() const {
 }
 
 
+int64_t MetricHeapOldReleased::Value() const {
+  ASSERT(isolate() == Isolate::Current());
+  return isolate()->heap()->old_space()->released_in_bytes();
+}
+
+
 int64_t MetricHeapNewUsed::Value() const {
   ASSERT(isolate() == Isolate::Current());
   return isolate()->heap()->UsedInWords(Heap::kNew) * kWordSize;
@@ -17,6 +17,7 @@ class JSONStream;
   V(MetricHeapOldUsed, HeapOldUsed, "heap.old.used", kByte)                    \
   V(MetricHeapOldCapacity, HeapOldCapacity, "heap.old.capacity", kByte)        \
   V(MetricHeapOldExternal, HeapOldExternal, "heap.old.external", kByte)        \
+  V(MetricHeapOldReleased, HeapOldReleased, "heap.old.released", kByte)        \
   V(MetricHeapNewUsed, HeapNewUsed, "heap.new.used", kByte)                    \
   V(MetricHeapNewCapacity, HeapNewCapacity, "heap.new.capacity", kByte)        \
   V(MetricHeapNewExternal, HeapNewExternal, "heap.new.external", kByte)        \
@@ -112,6 +113,12 @@ class MetricHeapOldExternal : public Metric {
 };
 
 
+class MetricHeapOldReleased : public Metric {
+ protected:
+  virtual int64_t Value() const;
+};
+
+
 class MetricHeapNewUsed : public Metric {
  protected:
   virtual int64_t Value() const;
@@ -35,6 +35,182 @@ DART_EXPORT bool Dart_PostCObject(Dart_Port port_id, Dart_CObject* message) {
 }
 
 
+static ApiMessageBuilder* MessageBuilder(Dart_MessageBuilder builder) {
+  ASSERT(builder != NULL);
+  return reinterpret_cast<ApiMessageBuilder*>(builder);
+}
+
+
+DART_EXPORT Dart_MessageBuilder Dart_NewMessageBuilder() {
+  return reinterpret_cast<Dart_MessageBuilder>(new ApiMessageBuilder());
+}
+
+
+DART_EXPORT void Dart_DeleteMessageBuilder(Dart_MessageBuilder builder) {
+  delete MessageBuilder(builder);
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderAddNull(Dart_MessageBuilder builder) {
+  return MessageBuilder(builder)->AddNull();
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderAddBool(Dart_MessageBuilder builder,
+                                            bool value) {
+  return MessageBuilder(builder)->AddBool(value);
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderAddInt64(Dart_MessageBuilder builder,
+                                             int64_t value) {
+  return MessageBuilder(builder)->AddInt64(value);
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderAddDouble(Dart_MessageBuilder builder,
+                                              double value) {
+  return MessageBuilder(builder)->AddDouble(value);
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderAddString(Dart_MessageBuilder builder,
+                                              const char* value) {
+  return MessageBuilder(builder)->AddString(value);
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderAddTypedData(Dart_MessageBuilder builder,
+                                                 Dart_TypedData_Type type,
+                                                 const uint8_t* values,
+                                                 intptr_t length) {
+  return MessageBuilder(builder)->AddTypedData(type, values, length);
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderBeginArray(Dart_MessageBuilder builder,
+                                               intptr_t length) {
+  return MessageBuilder(builder)->BeginArray(length);
+}
+
+
+DART_EXPORT bool Dart_MessageBuilderEndArray(Dart_MessageBuilder builder) {
+  return MessageBuilder(builder)->EndArray();
+}
+
+
+DART_EXPORT bool Dart_PostMessageBuilder(Dart_Port port_id,
+                                         Dart_MessageBuilder builder) {
+  uint8_t* buffer = NULL;
+  intptr_t length = 0;
+  if (!MessageBuilder(builder)->Finish(&buffer, &length)) {
+    return false;
+  }
+  return PortMap::PostMessage(new Message(
+      port_id, buffer, length, Message::kNormalPriority));
+}
+
+
+static ApiMessageStreamReader* MessageReader(Dart_MessageReader reader) {
+  ASSERT(reader != NULL);
+  return reinterpret_cast<ApiMessageStreamReader*>(reader);
+}
+
+
+DART_EXPORT Dart_CObject_Type Dart_MessageReaderNextType(
+    Dart_MessageReader reader) {
+  return MessageReader(reader)->NextType();
+}
+
+
+DART_EXPORT bool Dart_MessageReaderReadNull(Dart_MessageReader reader) {
+  return MessageReader(reader)->ReadNull();
+}
+
+
+DART_EXPORT bool Dart_MessageReaderReadBool(Dart_MessageReader reader,
+                                            bool* value) {
+  return MessageReader(reader)->ReadBool(value);
+}
+
+
+DART_EXPORT bool Dart_MessageReaderReadInt64(Dart_MessageReader reader,
+                                             int64_t* value) {
+  return MessageReader(reader)->ReadInt64(value);
+}
+
+
+DART_EXPORT bool Dart_MessageReaderReadDouble(Dart_MessageReader reader,
+                                              double* value) {
+  return MessageReader(reader)->ReadDouble(value);
+}
+
+
+DART_EXPORT bool Dart_MessageReaderReadString(Dart_MessageReader reader,
+                                              const char** value,
+                                              intptr_t* length) {
+  return MessageReader(reader)->ReadString(value, length);
+}
+
+
+DART_EXPORT bool Dart_MessageReaderReadTypedData(Dart_MessageReader reader,
+                                                 Dart_TypedData_Type* type,
+                                                 const uint8_t** values,
+                                                 intptr_t* length) {
+  return MessageReader(reader)->ReadTypedData(type, values, length);
+}
+
+
+DART_EXPORT bool Dart_MessageReaderReadSendPort(Dart_MessageReader reader,
+                                                Dart_Port* port_id) {
+  return MessageReader(reader)->ReadSendPort(port_id);
+}
+
+
+DART_EXPORT bool Dart_MessageReaderBeginArray(Dart_MessageReader reader,
+                                              intptr_t* length) {
+  return MessageReader(reader)->BeginArray(length);
+}
+
+
+DART_EXPORT bool Dart_MessageReaderEndArray(Dart_MessageReader reader) {
+  return MessageReader(reader)->EndArray();
+}
+
+
+DART_EXPORT bool Dart_MessageReaderSkip(Dart_MessageReader reader) {
+  return MessageReader(reader)->Skip();
+}
+
+
+static uint8_t* zone_allocator(uint8_t* ptr,
+                               intptr_t old_size,
+                               intptr_t new_size) {
+  Zone* zone = ApiNativeScope::Current()->zone();
+  return zone->Realloc<uint8_t>(ptr, old_size, new_size);
+}
+
+
+DART_EXPORT Dart_CObject* Dart_MessageReaderReadCObject(
+    Dart_MessageReader reader) {
+  // The native scope of the message handler holds the objects.
+  ASSERT(ApiNativeScope::Current() != NULL);
+  ApiMessageStreamReader* stream_reader = MessageReader(reader);
+  ApiMessageReader message_reader(stream_reader->buffer(),
+                                  stream_reader->length(),
+                                  zone_allocator);
+  return message_reader.ReadMessage();
+}
+
+
+// Must be called without a current isolate.
+static Dart_Port StartNativePort(NativeMessageHandler* nmh) {
+  Dart_Port port_id = PortMap::CreatePort(nmh);
+  nmh->Run(Dart::thread_pool(), NULL, NULL, 0);
+  return port_id;
+}
+
+
 DART_EXPORT Dart_Port Dart_NewNativePort(const char* name,
                                          Dart_NativeMessageHandler handler,
                                          bool handle_concurrently) {
@@ -50,10 +226,27 @@ DART_EXPORT Dart_Port Dart_NewNativePort(const char* name,
   IsolateSaver saver(Isolate::Current());
   Thread::ExitIsolate();
 
-  NativeMessageHandler* nmh = new NativeMessageHandler(name, handler);
-  Dart_Port port_id = PortMap::CreatePort(nmh);
-  nmh->Run(Dart::thread_pool(), NULL, NULL, 0);
-  return port_id;
+  return StartNativePort(new NativeMessageHandler(name, handler));
+}
+
+
+DART_EXPORT Dart_Port Dart_NewNativeStreamPort(
+    const char* name,
+    Dart_NativeMessageStreamHandler handler,
+    bool handle_concurrently) {
+  if (name == NULL) {
+    name = "<UnnamedNativePort>";
+  }
+  if (handler == NULL) {
+    OS::PrintErr("%s expects argument 'handler' to be non-null.\n",
+                 CURRENT_FUNC);
+    return ILLEGAL_PORT;
+  }
+  // Start the native port without a current isolate.
+  IsolateSaver saver(Isolate::Current());
+  Thread::ExitIsolate();
+
+  return StartNativePort(new NativeMessageHandler(name, handler));
 }
 
 
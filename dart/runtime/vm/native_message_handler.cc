@@ -14,13 +14,28 @@ namespace dart {
 NativeMessageHandler::NativeMessageHandler(const char* name,
                                            Dart_NativeMessageHandler func)
     : name_(strdup(name)),
-      func_(func) {
+      func_(func),
+      stream_func_(NULL),
+      stream_reader_(NULL) {
+  // A NativeMessageHandler always has one live port.
+  increment_live_ports();
+}
+
+
+NativeMessageHandler::NativeMessageHandler(
+    const char* name,
+    Dart_NativeMessageStreamHandler stream_func)
+    : name_(strdup(name)),
+      func_(NULL),
+      stream_func_(stream_func),
+      stream_reader_(new ApiMessageStreamReader()) {
   // A NativeMessageHandler always has one live port.
   increment_live_ports();
 }
 
 
 NativeMessageHandler::~NativeMessageHandler() {
+  delete stream_reader_;
   free(name_);
 }
 
@@ -48,9 +63,15 @@ bool NativeMessageHandler::HandleMessage(Message* message) {
   // Enter a native scope for handling the message. This will create a
   // zone for allocating the objects for decoding the message.
   ApiNativeScope scope;
-  ApiMessageReader reader(message->data(), message->len(), zone_allocator);
-  Dart_CObject* object = reader.ReadMessage();
-  (*func())(message->dest_port(), object);
+  if (stream_func() != NULL) {
+    stream_reader_->Reset(message->data(), message->len());
+    (*stream_func())(message->dest_port(),
+                     reinterpret_cast<Dart_MessageReader>(stream_reader_));
+  } else {
+    ApiMessageReader reader(message->data(), message->len(), zone_allocator);
+    Dart_CObject* object = reader.ReadMessage();
+    (*func())(message->dest_port(), object);
+  }
   delete message;
   return true;
 }
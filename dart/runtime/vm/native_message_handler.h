@@ -11,15 +11,21 @@
 
 namespace dart {
 
+// Forward declarations.
+class ApiMessageStreamReader;
+
 // A NativeMessageHandler accepts messages and dispatches them to
-// native C handlers.
+// native C handlers, either decoded or to be read value by value.
 class NativeMessageHandler : public MessageHandler {
  public:
   NativeMessageHandler(const char* name, Dart_NativeMessageHandler func);
+  NativeMessageHandler(const char* name,
+                       Dart_NativeMessageStreamHandler stream_func);
   ~NativeMessageHandler();
 
   const char* name() const { return name_; }
   Dart_NativeMessageHandler func() const { return func_; }
+  Dart_NativeMessageStreamHandler stream_func() const { return stream_func_; }
 
   bool HandleMessage(Message* message);
 
@@ -34,6 +40,9 @@ class NativeMessageHandler : public MessageHandler {
  private:
   char* name_;
   Dart_NativeMessageHandler func_;
+  Dart_NativeMessageStreamHandler stream_func_;
+  // Reused for all messages, which are handled one at a time.
+  ApiMessageStreamReader* stream_reader_;
 };
 
 }  // namespace dart
@@ -35,6 +35,7 @@
 #include "vm/object_id_ring.h"
 #include "vm/object_store.h"
 #include "vm/parser.h"
+#include "vm/profiler.h"
 #include "vm/report.h"
 #include "vm/reusable_handles.h"
 #include "vm/runtime_entry.h"
@@ -1680,6 +1681,9 @@ RawObject* Object::Allocate(intptr_t cls_id,
   } else {
     isolate->class_table()->UpdateAllocatedOld(cls_id, size);
   }
+  if (heap->ShouldProfileAllocation(address, size)) {
+    Profiler::RecordAllocationSample(isolate, cls_id, size);
+  }
   NoSafepointScope no_safepoint;
   InitializeObject(address, cls_id, size);
   RawObject* raw_obj = reinterpret_cast<RawObject*>(address + kHeapObjectTag);
@@ -19122,6 +19126,10 @@ RawArray* Array::New(intptr_t class_id, intptr_t len, Heap::Space space) {
     raw->StoreSmi(&(raw->ptr()->length_), Smi::New(len));
     VerifiedMemory::Accept(reinterpret_cast<uword>(raw->ptr()),
                            Array::InstanceSize(len));
+    if (raw->IsOldObject() &&
+        (Array::InstanceSize(len) >= PageSpace::kAllocatablePageSize)) {
+      HeapPage::EnableCardMarking(raw);
+    }
     return raw;
   }
 }
@@ -276,6 +276,12 @@ class Object {
   }
   inline RawClass* clazz() const;
   static intptr_t tags_offset() { return OFFSET_OF(RawObject, tags_); }
+#if defined(HASH_IN_OBJECT_HEADER)
+  // Offset of the 32-bit identity hash code within the little-endian header.
+  static intptr_t header_hash_offset() {
+    return tags_offset() + RawObject::kHashTagPos / kBitsPerByte;
+  }
+#endif
 
   // Class testers.
 #define DEFINE_CLASS_TESTER(clazz)                                             \
@@ -161,6 +161,9 @@ ObjectGraph::ObjectGraph(Isolate* isolate)
   // The VM isolate has all its objects pre-marked, so iterating over it
   // would be a no-op.
   ASSERT(isolate != Dart::vm_isolate());
+  // The graph uses the mark bits, which incremental marking may have set.
+  isolate->heap()->AbortIncrementalMarking();
+  isolate->heap()->old_space()->CompleteSweep();
   isolate->heap()->WriteProtectCode(false);
 }
 
@@ -420,8 +423,16 @@ static void WriteHeader(RawObject* raw, intptr_t size, intptr_t cid,
 
 class WriteGraphVisitor : public ObjectGraph::Visitor {
  public:
-  WriteGraphVisitor(Isolate* isolate, WriteStream* stream)
-    : stream_(stream), ptr_writer_(isolate, stream), count_(0) {}
+  WriteGraphVisitor(Isolate* isolate,
+                    WriteStream* stream,
+                    ObjectGraph::ChunkWriter* writer,
+                    intptr_t chunk_size)
+    : stream_(stream),
+      ptr_writer_(isolate, stream),
+      writer_(writer),
+      chunk_size_(chunk_size),
+      count_(0),
+      stopped_(false) {}
 
   virtual Direction VisitObject(ObjectGraph::StackIterator* it) {
     RawObject* raw_obj = it->Get();
@@ -434,31 +445,90 @@ class WriteGraphVisitor : public ObjectGraph::Visitor {
     raw_obj->VisitPointers(&ptr_writer_);
     stream_->WriteUnsigned(0);
     ++count_;
+    if ((stream_->bytes_written() >= chunk_size_) && !Flush(false)) {
+      return kAbort;
+    }
     return kProceed;
   }
 
+  // Hands the records written so far to the chunk writer, if any, and reuses
+  // the stream's buffer for the following ones. Returns false once the
+  // writer has stopped the serialization.
+  bool Flush(bool is_last) {
+    if (writer_ == NULL) {
+      return true;
+    }
+    ASSERT(!stopped_);
+    stopped_ =
+        !writer_->WriteChunk(stream_->buffer(), stream_->bytes_written(),
+                             is_last);
+    stream_->set_current(stream_->buffer());
+    return !stopped_;
+  }
+
   intptr_t count() const { return count_; }
+  bool stopped() const { return stopped_; }
 
  private:
   WriteStream* stream_;
   WritePointerVisitor ptr_writer_;
+  ObjectGraph::ChunkWriter* writer_;
+  const intptr_t chunk_size_;
   intptr_t count_;
+  bool stopped_;
 };
 
 
-void ObjectGraph::Serialize(WriteStream* stream) {
+// Returns false if the chunk writer stopped the serialization.
+static bool WriteGraph(ObjectGraph* graph,
+                       Isolate* isolate,
+                       WriteStream* stream,
+                       ObjectGraph::ChunkWriter* writer,
+                       intptr_t chunk_size) {
   // Current encoding assumes objects do not move, so promote everything to old.
-  isolate()->heap()->new_space()->Evacuate();
-  WriteGraphVisitor visitor(isolate(), stream);
+  isolate->heap()->new_space()->Evacuate();
+  WriteGraphVisitor visitor(isolate, stream, writer, chunk_size);
+  // The roots are the successors of a pseudo-object with id 0.
   stream->WriteUnsigned(0);
   stream->WriteUnsigned(0);
   stream->WriteUnsigned(0);
   {
-    WritePointerVisitor ptr_writer(isolate(), stream);
-    isolate()->VisitObjectPointers(&ptr_writer, false, false);
+    WritePointerVisitor ptr_writer(isolate, stream);
+    isolate->VisitObjectPointers(&ptr_writer, false, false);
   }
   stream->WriteUnsigned(0);
-  IterateObjects(&visitor);
+  graph->IterateObjects(&visitor);
+  if (visitor.stopped()) {
+    return false;
+  }
+  return visitor.Flush(true);
+}
+
+
+static uint8_t* ChunkAllocator(uint8_t* ptr,
+                               intptr_t old_size,
+                               intptr_t new_size) {
+  void* new_ptr = realloc(reinterpret_cast<void*>(ptr), new_size);
+  return reinterpret_cast<uint8_t*>(new_ptr);
+}
+
+
+void ObjectGraph::Serialize(WriteStream* stream) {
+  WriteGraph(this, isolate(), stream, NULL, kIntptrMax);
+}
+
+
+bool ObjectGraph::Serialize(ChunkWriter* writer, intptr_t chunk_size) {
+  ASSERT(writer != NULL);
+  ASSERT(chunk_size > 0);
+  uint8_t* buffer = NULL;
+  bool completed;
+  {
+    WriteStream stream(&buffer, &ChunkAllocator, chunk_size);
+    completed = WriteGraph(this, isolate(), &stream, writer, chunk_size);
+  }
+  free(buffer);
+  return completed;
 }
 
 }  // namespace dart
@@ -89,10 +89,42 @@ class ObjectGraph : public StackResource {
   // be live due to references from the stack or embedder handles.
   intptr_t InboundReferences(Object* obj, const Array& references);
 
+  // Receives a serialized object graph piece by piece. Chunks are written
+  // while the graph is being traversed, so 'WriteChunk' must not allocate from
+  // the heap or trigger GC in any way.
+  class ChunkWriter {
+   public:
+    virtual ~ChunkWriter() { }
+    // Called with consecutive pieces of the serialized graph. The data is
+    // only valid during this call. 'is_last' is set on the final chunk, which
+    // may be empty. Returning false stops the serialization; no further chunks
+    // are written.
+    virtual bool WriteChunk(const uint8_t* data,
+                            intptr_t size,
+                            bool is_last) = 0;
+  };
+
   // Write the isolate's object graph to 'stream'. Smis and nulls are omitted.
-  // TODO(koda): Document format; support streaming/chunking.
+  //
+  // The graph is a sequence of records, one per object, each a list of
+  // unsigned integers in the variable length encoding of WriteStream:
+  //
+  //   id size class-id successor-id* 0
+  //
+  // Ids are object addresses in units of kObjectAlignment, which are stable
+  // because new space is evacuated first. The first record is a pseudo-object
+  // with id, size and class id 0 whose successors are the isolate's roots.
+  // Every other object strongly reachable from the roots follows exactly once,
+  // in depth first pre-order. Successors may refer to objects that have no
+  // record of their own, e.g., objects in the VM isolate's heap.
   void Serialize(WriteStream* stream);
 
+  // Like 'Serialize', but hands the graph to 'writer' in chunks of about
+  // 'chunk_size' bytes as it is written, so that the whole graph is never held
+  // in memory. Chunks end on record boundaries. Returns false if 'writer'
+  // stopped the serialization before the last chunk.
+  bool Serialize(ChunkWriter* writer, intptr_t chunk_size);
+
  private:
   DISALLOW_IMPLICIT_CONSTRUCTORS(ObjectGraph);
 };
@@ -3,6 +3,8 @@
 // BSD-style license that can be found in the LICENSE file.
 
 #include "platform/assert.h"
+#include "vm/datastream.h"
+#include "vm/growable_array.h"
 #include "vm/object_graph.h"
 #include "vm/unit_test.h"
 
@@ -136,4 +138,336 @@ TEST_CASE(ObjectGraph) {
   }
 }
 
+
+// Collects the chunks of a serialized object graph into one buffer.
+class CollectChunksWriter : public ObjectGraph::ChunkWriter {
+ public:
+  explicit CollectChunksWriter(intptr_t chunk_size)
+      : chunk_size_(chunk_size), num_chunks_(0), done_(false) { }
+
+  virtual bool WriteChunk(const uint8_t* data, intptr_t size, bool is_last) {
+    EXPECT(!done_);
+    // Only the last chunk may be empty.
+    EXPECT(is_last || (size >= chunk_size_));
+    for (intptr_t i = 0; i < size; i++) {
+      bytes_.Add(data[i]);
+    }
+    num_chunks_++;
+    done_ = is_last;
+    return true;
+  }
+
+  const uint8_t* data() const { return bytes_.data(); }
+  intptr_t size() const { return bytes_.length(); }
+  intptr_t num_chunks() const { return num_chunks_; }
+  bool done() const { return done_; }
+
+ private:
+  const intptr_t chunk_size_;
+  MallocGrowableArray<uint8_t> bytes_;
+  intptr_t num_chunks_;
+  bool done_;
+};
+
+
+// Reads a serialized object graph and computes the dominator tree and
+// retained sizes offline, like a heap snapshot analysis tool would.
+class HeapSnapshotReader {
+ public:
+  HeapSnapshotReader(const uint8_t* data, intptr_t size) {
+    ReadStream stream(data, size);
+    while (stream.PendingBytes() > 0) {
+      ids_.Add(stream.ReadUnsigned());
+      sizes_.Add(stream.ReadUnsigned());
+      stream.ReadUnsigned();  // Class id.
+      edge_starts_.Add(edges_.length());
+      for (intptr_t id = stream.ReadUnsigned();
+           id != 0;
+           id = stream.ReadUnsigned()) {
+        edges_.Add(id);
+      }
+    }
+    edge_starts_.Add(edges_.length());
+    SortIds();
+    // Successors without a record of their own are ignored.
+    for (intptr_t i = 0; i < edges_.length(); i++) {
+      edges_[i] = IndexOf(edges_[i]);
+    }
+    ComputeDominators();
+    ComputeRetainedSizes();
+  }
+
+  intptr_t length() const { return ids_.length(); }
+
+  intptr_t SizeOf(intptr_t id) const { return sizes_[IndexOf(id)]; }
+
+  intptr_t RetainedSizeOf(intptr_t id) const {
+    return retained_sizes_[IndexOf(id)];
+  }
+
+  // The id of the immediate dominator of 'id'.
+  intptr_t DominatorOf(intptr_t id) const {
+    return ids_[dominators_[IndexOf(id)]];
+  }
+
+  static intptr_t IdOf(RawObject* raw) {
+    return RawObject::ToAddr(raw) / kObjectAlignment;
+  }
+
+ private:
+  struct IdAndIndex {
+    intptr_t id;
+    intptr_t index;
+  };
+
+  static int CompareIds(const void* a, const void* b) {
+    intptr_t id_a = reinterpret_cast<const IdAndIndex*>(a)->id;
+    intptr_t id_b = reinterpret_cast<const IdAndIndex*>(b)->id;
+    return (id_a < id_b) ? -1 : ((id_a > id_b) ? 1 : 0);
+  }
+
+  void SortIds() {
+    for (intptr_t i = 0; i < ids_.length(); i++) {
+      IdAndIndex entry = { ids_[i], i };
+      sorted_.Add(entry);
+    }
+    qsort(sorted_.data(), sorted_.length(), sizeof(IdAndIndex), CompareIds);
+  }
+
+  // Returns the index of the record of 'id', or -1.
+  intptr_t IndexOf(intptr_t id) const {
+    intptr_t lo = 0;
+    intptr_t hi = sorted_.length() - 1;
+    while (lo <= hi) {
+      intptr_t mid = lo + (hi - lo) / 2;
+      if (sorted_[mid].id < id) {
+        lo = mid + 1;
+      } else if (sorted_[mid].id > id) {
+        hi = mid - 1;
+      } else {
+        return sorted_[mid].index;
+      }
+    }
+    return -1;
+  }
+
+  // Numbers all records in post-order of a depth first search from the root
+  // (the first record).
+  void ComputePostOrder() {
+    const intptr_t n = length();
+    for (intptr_t i = 0; i < n; i++) {
+      post_order_numbers_.Add(-1);
+    }
+    MallocGrowableArray<intptr_t> stack;
+    MallocGrowableArray<intptr_t> next_edges;
+    MallocGrowableArray<bool> visited;
+    for (intptr_t i = 0; i < n; i++) {
+      visited.Add(false);
+    }
+    stack.Add(0);
+    next_edges.Add(edge_starts_[0]);
+    visited[0] = true;
+    while (!stack.is_empty()) {
+      const intptr_t u = stack.Last();
+      const intptr_t e = next_edges.Last();
+      if (e == edge_starts_[u + 1]) {
+        post_order_numbers_[u] = post_order_.length();
+        post_order_.Add(u);
+        stack.RemoveLast();
+        next_edges.RemoveLast();
+        continue;
+      }
+      next_edges[next_edges.length() - 1] = e + 1;
+      const intptr_t v = edges_[e];
+      if ((v >= 0) && !visited[v]) {
+        visited[v] = true;
+        stack.Add(v);
+        next_edges.Add(edge_starts_[v]);
+      }
+    }
+  }
+
+  intptr_t Intersect(intptr_t u, intptr_t v) const {
+    while (u != v) {
+      while (post_order_numbers_[u] < post_order_numbers_[v]) {
+        u = dominators_[u];
+      }
+      while (post_order_numbers_[v] < post_order_numbers_[u]) {
+        v = dominators_[v];
+      }
+    }
+    return u;
+  }
+
+  // Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+  void ComputeDominators() {
+    ComputePostOrder();
+    const intptr_t n = length();
+    // Predecessors, in the same layout as the successors.
+    MallocGrowableArray<intptr_t> pred_starts;
+    MallocGrowableArray<intptr_t> preds;
+    for (intptr_t i = 0; i <= n; i++) {
+      pred_starts.Add(0);
+    }
+    for (intptr_t i = 0; i < edges_.length(); i++) {
+      if (edges_[i] >= 0) {
+        pred_starts[edges_[i] + 1]++;
+      }
+    }
+    for (intptr_t i = 0; i < n; i++) {
+      pred_starts[i + 1] += pred_starts[i];
+    }
+    MallocGrowableArray<intptr_t> fill;
+    for (intptr_t i = 0; i < n; i++) {
+      fill.Add(pred_starts[i]);
+    }
+    for (intptr_t i = 0; i < edges_.length(); i++) {
+      preds.Add(-1);
+    }
+    for (intptr_t u = 0; u < n; u++) {
+      for (intptr_t e = edge_starts_[u]; e < edge_starts_[u + 1]; e++) {
+        const intptr_t v = edges_[e];
+        if (v >= 0) {
+          preds[fill[v]++] = u;
+        }
+      }
+    }
+    for (intptr_t i = 0; i < n; i++) {
+      dominators_.Add(-1);
+    }
+    dominators_[0] = 0;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      // Reverse post-order, skipping the root.
+      for (intptr_t i = post_order_.length() - 2; i >= 0; i--) {
+        const intptr_t v = post_order_[i];
+        intptr_t new_dominator = -1;
+        for (intptr_t p = pred_starts[v]; p < pred_starts[v + 1]; p++) {
+          const intptr_t u = preds[p];
+          if (dominators_[u] < 0) {
+            continue;
+          }
+          new_dominator = (new_dominator < 0) ? u : Intersect(u, new_dominator);
+        }
+        if (dominators_[v] != new_dominator) {
+          dominators_[v] = new_dominator;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  void ComputeRetainedSizes() {
+    for (intptr_t i = 0; i < length(); i++) {
+      retained_sizes_.Add(sizes_[i]);
+    }
+    // Dominated objects come first in post-order.
+    for (intptr_t i = 0; i < post_order_.length() - 1; i++) {
+      const intptr_t v = post_order_[i];
+      retained_sizes_[dominators_[v]] += retained_sizes_[v];
+    }
+  }
+
+  MallocGrowableArray<intptr_t> ids_;
+  MallocGrowableArray<intptr_t> sizes_;
+  MallocGrowableArray<intptr_t> edge_starts_;
+  MallocGrowableArray<intptr_t> edges_;
+  MallocGrowableArray<IdAndIndex> sorted_;
+  MallocGrowableArray<intptr_t> post_order_;
+  MallocGrowableArray<intptr_t> post_order_numbers_;
+  MallocGrowableArray<intptr_t> dominators_;
+  MallocGrowableArray<intptr_t> retained_sizes_;
+};
+
+
+TEST_CASE(ObjectGraphSerialize) {
+  Isolate* isolate = Isolate::Current();
+  // Same graph as above:
+  //  a+->b+->c
+  //  +   +
+  //  |   v
+  //  +-->d
+  Array& a = Array::Handle(Array::New(12, Heap::kNew));
+  Array& b = Array::Handle(Array::New(2, Heap::kOld));
+  Array& c = Array::Handle(Array::New(0, Heap::kOld));
+  Array& d = Array::Handle(Array::New(0, Heap::kOld));
+  a.SetAt(10, b);
+  b.SetAt(0, c);
+  b.SetAt(1, d);
+  a.SetAt(11, d);
+  intptr_t a_size = a.raw()->Size();
+  intptr_t b_size = b.raw()->Size();
+  intptr_t c_size = c.raw()->Size();
+  intptr_t d_size = d.raw()->Size();
+  b = Array::null();
+  c = Array::null();
+  d = Array::null();
+
+  const intptr_t kChunkSize = 4 * KB;
+  CollectChunksWriter writer(kChunkSize);
+  {
+    ObjectGraph graph(isolate);
+    graph.Serialize(&writer, kChunkSize);
+  }
+  EXPECT(writer.done());
+  EXPECT_LT(1, writer.num_chunks());
+
+  // Serializing evacuated new space, so 'a' has its final address by now.
+  NoSafepointScope no_safepoint_scope;
+  RawObject* a_raw = a.raw();
+  b ^= a.At(10);
+  RawObject* b_raw = b.raw();
+  RawObject* c_raw = b.At(0);
+  RawObject* d_raw = b.At(1);
+  b = Array::null();
+  HeapSnapshotReader reader(writer.data(), writer.size());
+  EXPECT_LT(4, reader.length());
+  const intptr_t a_id = HeapSnapshotReader::IdOf(a_raw);
+  const intptr_t b_id = HeapSnapshotReader::IdOf(b_raw);
+  const intptr_t c_id = HeapSnapshotReader::IdOf(c_raw);
+  const intptr_t d_id = HeapSnapshotReader::IdOf(d_raw);
+  EXPECT_EQ(a_size, reader.SizeOf(a_id));
+  EXPECT_EQ(b_size, reader.SizeOf(b_id));
+  EXPECT_EQ(0, reader.DominatorOf(a_id));
+  EXPECT_EQ(a_id, reader.DominatorOf(b_id));
+  EXPECT_EQ(b_id, reader.DominatorOf(c_id));
+  EXPECT_EQ(a_id, reader.DominatorOf(d_id));
+  EXPECT_EQ(c_size, reader.RetainedSizeOf(c_id));
+  EXPECT_EQ(b_size + c_size, reader.RetainedSizeOf(b_id));
+  EXPECT_EQ(a_size + b_size + c_size + d_size, reader.RetainedSizeOf(a_id));
+  {
+    ObjectGraph graph(isolate);
+    EXPECT_EQ(graph.SizeRetainedByInstance(a), reader.RetainedSizeOf(a_id));
+  }
+}
+
+
+// Accepts the first chunk of a serialized object graph and stops at the next.
+class StopAfterFirstChunkWriter : public ObjectGraph::ChunkWriter {
+ public:
+  StopAfterFirstChunkWriter() : num_chunks_(0) { }
+
+  virtual bool WriteChunk(const uint8_t* data, intptr_t size, bool is_last) {
+    num_chunks_++;
+    return num_chunks_ == 1;
+  }
+
+  intptr_t num_chunks() const { return num_chunks_; }
+
+ private:
+  intptr_t num_chunks_;
+};
+
+
+TEST_CASE(ObjectGraphSerializeStopped) {
+  Isolate* isolate = Isolate::Current();
+  // One chunk per record, so the graph has far more chunks than are taken.
+  const intptr_t kChunkSize = 1;
+  StopAfterFirstChunkWriter writer;
+  ObjectGraph graph(isolate);
+  EXPECT(!graph.Serialize(&writer, kChunkSize));
+  EXPECT_EQ(2, writer.num_chunks());
+}
+
 }  // namespace dart
@@ -4189,6 +4189,7 @@ TEST_CASE(PrintJSON) {
       ml.Wait();
     }
   }
+  old_space->CompleteSweep();
   GrowableArray<Object*> objects;
   ObjectAccumulator acc(&objects);
   heap->VisitObjects(&acc);
@@ -0,0 +1,201 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/page_pool.h"
+
+#include "platform/assert.h"
+#include "platform/utils.h"
+#include "vm/flags.h"
+#include "vm/lockers.h"
+#include "vm/os_thread.h"
+#include "vm/pages.h"
+#include "vm/verified_memory.h"
+#include "vm/virtual_memory.h"
+
+namespace dart {
+
+DEFINE_FLAG(bool, huge_pages, false,
+            "Back heap pages and semispaces with transparent huge pages.");
+DEFINE_FLAG(bool, page_pool, true,
+            "Keep the memory of released heap pages and semispaces for reuse "
+            "by all isolates.");
+DEFINE_FLAG(int, page_pool_high_watermark, 32,
+            "Trim the page pool once it holds more than this many MB.");
+DEFINE_FLAG(int, page_pool_low_watermark, 8,
+            "Trim the page pool down to this many MB.");
+DEFINE_FLAG(int, page_pool_initial_size, 0,
+            "Fill the page pool with this many MB of faulted-in heap pages "
+            "at startup.");
+
+VirtualMemory* PagePool::free_lists_[PagePool::kNumSizeClasses];
+intptr_t PagePool::pooled_in_bytes_ = 0;
+Mutex* PagePool::mutex_ = NULL;
+
+
+static bool IsPoolingEnabled() {
+#if defined(DEBUG)
+  // The shadow copies of reused blocks would be stale.
+  if (FLAG_verified_mem) {
+    return false;
+  }
+#endif
+  return FLAG_page_pool;
+}
+
+
+static inline VirtualMemory** NextAddr(VirtualMemory* memory) {
+  return reinterpret_cast<VirtualMemory**>(memory->address());
+}
+
+
+void PagePool::InitOnce() {
+  ASSERT(mutex_ == NULL);
+  mutex_ = new Mutex();
+  ASSERT(mutex_ != NULL);
+  for (intptr_t i = 0; i < kNumSizeClasses; i++) {
+    free_lists_[i] = NULL;
+  }
+  if (!IsPoolingEnabled()) {
+    return;
+  }
+  const intptr_t page_size = PageSpace::kPageSizeInWords << kWordSizeLog2;
+  const intptr_t num_pages = FLAG_page_pool_initial_size * MB / page_size;
+  for (intptr_t i = 0; i < num_pages; i++) {
+    VirtualMemory* memory = VirtualMemory::Reserve(page_size);
+    if ((memory == NULL) || !memory->Commit(false)) {
+      delete memory;
+      break;
+    }
+    // Touch every page so that the first user does not take the faults.
+    memset(memory->address(), 0, page_size);
+    Free(memory);
+  }
+}
+
+
+intptr_t PagePool::SizeClass(intptr_t size) {
+  if ((size < kMinBlockSize) ||
+      (size > kMaxBlockSize) ||
+      !Utils::IsPowerOfTwo(size)) {
+    return -1;
+  }
+  return Utils::ShiftForPowerOfTwo(size) - kMinBlockSizeLog2;
+}
+
+
+VirtualMemory* PagePool::Allocate(intptr_t size, bool zeroed) {
+  const intptr_t size_class = SizeClass(size);
+  if ((size_class >= 0) && IsPoolingEnabled()) {
+    VirtualMemory* memory = NULL;
+    {
+      MutexLocker ml(mutex_);
+      memory = free_lists_[size_class];
+      if (memory != NULL) {
+        free_lists_[size_class] = *NextAddr(memory);
+        pooled_in_bytes_ -= size;
+      }
+    }
+    if (memory != NULL) {
+      if (zeroed) {
+        memset(memory->address(), 0, size);
+      }
+      return memory;
+    }
+  }
+  if ((size_class >= 0) && IsPoolingEnabled() && FLAG_huge_pages) {
+    VirtualMemory* memory = AllocateHuge(size_class, size);
+    if (memory != NULL) {
+      return memory;
+    }
+  }
+  VirtualMemory* memory = VerifiedMemory::Reserve(size);
+  if ((memory == NULL) || !memory->Commit(false)) {  // Not executable.
+    delete memory;
+    return NULL;
+  }
+  return memory;
+}
+
+
+VirtualMemory* PagePool::AllocateHuge(intptr_t size_class, intptr_t size) {
+  const intptr_t chunk_size = Utils::Maximum(size, kHugePageSize);
+  VirtualMemory* memory =
+      VirtualMemory::ReserveAligned(chunk_size, kHugePageSize);
+  if ((memory == NULL) || !memory->Commit(false)) {  // Not executable.
+    delete memory;
+    return NULL;
+  }
+  if (!VirtualMemory::AdviseHugePages(memory->address(), chunk_size)) {
+    delete memory;
+    return NULL;
+  }
+  if (chunk_size == size) {
+    return memory;
+  }
+  // Pool the rest of the huge page.
+  MutexLocker ml(mutex_);
+  while (memory->size() > size) {
+    VirtualMemory* block = memory->SplitOff(memory->size() - size);
+    *NextAddr(block) = free_lists_[size_class];
+    free_lists_[size_class] = block;
+    pooled_in_bytes_ += size;
+  }
+  return memory;
+}
+
+
+void PagePool::Free(VirtualMemory* memory) {
+  const intptr_t size = memory->size();
+  const intptr_t size_class = SizeClass(size);
+  if ((size_class < 0) || !IsPoolingEnabled()) {
+    delete memory;
+    return;
+  }
+  bool trim = false;
+  {
+    MutexLocker ml(mutex_);
+    *NextAddr(memory) = free_lists_[size_class];
+    free_lists_[size_class] = memory;
+    pooled_in_bytes_ += size;
+    trim = (pooled_in_bytes_ > FLAG_page_pool_high_watermark * MB);
+  }
+  if (trim) {
+    Trim(FLAG_page_pool_low_watermark * MB);
+  }
+}
+
+
+void PagePool::Trim(intptr_t target_in_bytes) {
+  VirtualMemory* trimmed = NULL;
+  {
+    MutexLocker ml(mutex_);
+    // Large blocks are the least likely to be reused with the same size.
+    for (intptr_t i = kNumSizeClasses - 1;
+         (i >= 0) && (pooled_in_bytes_ > target_in_bytes);
+         i--) {
+      while ((free_lists_[i] != NULL) &&
+             (pooled_in_bytes_ > target_in_bytes)) {
+        VirtualMemory* memory = free_lists_[i];
+        free_lists_[i] = *NextAddr(memory);
+        pooled_in_bytes_ -= memory->size();
+        *NextAddr(memory) = trimmed;
+        trimmed = memory;
+      }
+    }
+  }
+  // Unmap outside the lock.
+  while (trimmed != NULL) {
+    VirtualMemory* next = *NextAddr(trimmed);
+    delete trimmed;
+    trimmed = next;
+  }
+}
+
+
+intptr_t PagePool::pooled_in_bytes() {
+  MutexLocker ml(mutex_);
+  return pooled_in_bytes_;
+}
+
+}  // namespace dart
@@ -0,0 +1,75 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_PAGE_POOL_H_
+#define VM_PAGE_POOL_H_
+
+#include "vm/allocation.h"
+#include "vm/globals.h"
+
+namespace dart {
+
+// Forward declarations.
+class Mutex;
+class VirtualMemory;
+
+// A process-wide pool of committed, non-executable memory blocks shared by the
+// heaps of all isolates. Heap pages and semispaces are handed back to the pool
+// instead of being unmapped, so that isolates which are created and shut down
+// frequently do not mmap and fault in their heaps every time.
+//
+// Only blocks whose size is a power of two between kMinBlockSize and
+// kMaxBlockSize are pooled; other sizes go directly to VirtualMemory. Once more
+// than 'page_pool_high_watermark' MB are pooled, the pool is trimmed down to
+// 'page_pool_low_watermark' MB.
+//
+// With 'huge_pages', new blocks are reserved in whole, aligned huge pages and
+// backed by transparent huge pages where the operating system supports it.
+// Blocks smaller than a huge page are carved from one and the rest of it is
+// pooled, so that neighbouring heap pages share a TLB entry.
+class PagePool : public AllStatic {
+ public:
+  static const intptr_t kMinBlockSizeLog2 = 16;  // 64 KB.
+  static const intptr_t kMaxBlockSizeLog2 = 26;  // 64 MB.
+  static const intptr_t kMinBlockSize = 1 << kMinBlockSizeLog2;
+  static const intptr_t kMaxBlockSize = 1 << kMaxBlockSizeLog2;
+  static const intptr_t kHugePageSize = 2 * MB;
+
+  static void InitOnce();
+
+  // Returns a committed, readable and writable block of 'size' bytes, or NULL
+  // if out of memory. Unless 'zeroed' is true, the contents of a pooled block
+  // are undefined, unlike those of freshly committed memory.
+  static VirtualMemory* Allocate(intptr_t size, bool zeroed);
+
+  // Hands back a block returned by Allocate. The block must be readable and
+  // writable.
+  static void Free(VirtualMemory* memory);
+
+  // Unmaps pooled blocks until at most 'target_in_bytes' remain pooled.
+  static void Trim(intptr_t target_in_bytes);
+
+  static intptr_t pooled_in_bytes();
+
+ private:
+  static const intptr_t kNumSizeClasses =
+      kMaxBlockSizeLog2 - kMinBlockSizeLog2 + 1;
+
+  // Returns the size class of a block of 'size' bytes or -1 if such blocks
+  // are not pooled.
+  static intptr_t SizeClass(intptr_t size);
+
+  // Returns a committed block of 'size' bytes backed by huge pages, or NULL if
+  // huge pages are not available.
+  static VirtualMemory* AllocateHuge(intptr_t size_class, intptr_t size);
+
+  // The pooled blocks of each size class, linked through their first words.
+  static VirtualMemory* free_lists_[kNumSizeClasses];
+  static intptr_t pooled_in_bytes_;
+  static Mutex* mutex_;
+};
+
+}  // namespace dart
+
+#endif  // VM_PAGE_POOL_H_
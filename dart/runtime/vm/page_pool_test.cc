@@ -0,0 +1,64 @@
+// Copyright (c) 2015, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/assert.h"
+#include "vm/page_pool.h"
+#include "vm/unit_test.h"
+#include "vm/virtual_memory.h"
+
+namespace dart {
+
+DECLARE_FLAG(bool, huge_pages);
+DECLARE_FLAG(bool, page_pool);
+
+UNIT_TEST_CASE(PagePool) {
+  if (!FLAG_page_pool) {
+    return;
+  }
+  // Huge pages would fill the pool with the rest of each huge page.
+  const bool saved_huge_pages = FLAG_huge_pages;
+  FLAG_huge_pages = false;
+  PagePool::Trim(0);
+  EXPECT_EQ(0, PagePool::pooled_in_bytes());
+
+  const intptr_t kBlockSize = 256 * KB;
+  VirtualMemory* block = PagePool::Allocate(kBlockSize, false);
+  EXPECT(block != NULL);
+  EXPECT_EQ(kBlockSize, block->size());
+  // The block is committed and writable.
+  memset(block->address(), 0xab, kBlockSize);
+  const uword start = block->start();
+  PagePool::Free(block);
+  EXPECT_EQ(kBlockSize, PagePool::pooled_in_bytes());
+
+  // Blocks of a different size class are not handed out.
+  VirtualMemory* other = PagePool::Allocate(kBlockSize / 2, false);
+  EXPECT(other != NULL);
+  EXPECT(other->start() != start);
+  EXPECT_EQ(kBlockSize, PagePool::pooled_in_bytes());
+
+  // The pooled block is reused, and zeroed on request.
+  block = PagePool::Allocate(kBlockSize, true);
+  EXPECT_EQ(start, block->start());
+  EXPECT_EQ(0, reinterpret_cast<uint8_t*>(block->address())[kBlockSize - 1]);
+  EXPECT_EQ(0, PagePool::pooled_in_bytes());
+  PagePool::Free(block);
+  PagePool::Free(other);
+  EXPECT_EQ(kBlockSize + kBlockSize / 2, PagePool::pooled_in_bytes());
+
+  // Blocks whose size is not a power of two are not pooled.
+  VirtualMemory* odd = PagePool::Allocate(3 * kBlockSize, false);
+  EXPECT(odd != NULL);
+  PagePool::Free(odd);
+  EXPECT_EQ(kBlockSize + kBlockSize / 2, PagePool::pooled_in_bytes());
+
+  // Trimming releases the largest blocks first.
+  PagePool::Trim(kBlockSize);
+  EXPECT_EQ(kBlockSize / 2, PagePool::pooled_in_bytes());
+  PagePool::Trim(0);
+  EXPECT_EQ(0, PagePool::pooled_in_bytes());
+  FLAG_huge_pages = saved_huge_pages;
+}
+
+}  // namespace dart
@@ -6,16 +6,22 @@
 
 #include "platform/assert.h"
 #include "vm/compiler_stats.h"
+#include "vm/gc_compactor.h"
 #include "vm/gc_marker.h"
 #include "vm/gc_sweeper.h"
 #include "vm/lockers.h"
 #include "vm/object.h"
 #include "vm/os_thread.h"
+#include "vm/page_pool.h"
 #include "vm/verified_memory.h"
 #include "vm/virtual_memory.h"
 
 namespace dart {
 
+DECLARE_FLAG(int, gc_pause_goal);
+DECLARE_FLAG(int, gc_time_goal);
+DECLARE_FLAG(int, marking_step_kb);
+
 DEFINE_FLAG(int, heap_growth_rate, 0,
             "The max number of pages the heap can grow at a time");
 DEFINE_FLAG(int, old_gen_growth_space_ratio, 20,
@@ -43,34 +49,122 @@ DEFINE_FLAG(bool, concurrent_sweep, false,
 DEFINE_FLAG(bool, concurrent_sweep, true,
             "Concurrent sweep for old generation.");
 #endif  // TARGET_ARCH_MIPS || TARGET_ARCH_ARM64
+DEFINE_FLAG(bool, lazy_sweep, false,
+            "Sweep regular sized old generation data pages on allocation "
+            "instead of after marking.");
+DEFINE_FLAG(int, lazy_sweep_pages, 4,
+            "Maximum number of pages swept by an old generation allocation "
+            "before trying to grow the heap.");
 DEFINE_FLAG(bool, log_growth, false, "Log PageSpace growth policy decisions.");
+DEFINE_FLAG(bool, compact_old_space, false,
+            "Evacuate sparse old generation pages after marking.");
+DEFINE_FLAG(int, compaction_free_ratio, 50,
+            "Compact the old generation when more than this percentage of its "
+            "capacity is free after marking. Pages that are free by more than "
+            "this percentage are evacuated.");
+DEFINE_FLAG(bool, log_compaction, false, "Log old generation compactions.");
+DEFINE_FLAG(bool, card_marking, true,
+            "Remember stores into large old arrays per card instead of per "
+            "array.");
+DEFINE_FLAG(bool, old_gen_release_memory, true,
+            "Return the memory of large free blocks and of empty pages in the "
+            "old generation to the OS.");
+DEFINE_FLAG(int, old_gen_retained_free_pages, 4,
+            "Maximum number of empty old generation pages kept for reuse "
+            "instead of being unmapped.");
+DEFINE_FLAG(int, old_gen_retained_large_pages, 32,
+            "Maximum number of MB of empty large object pages kept for reuse "
+            "by large objects of similar size.");
+DEFINE_FLAG(int, old_gen_shrink_collections, 3,
+            "After this many consecutive old generation collections with low "
+            "usage, freed capacity is no longer kept for growth.");
 
 HeapPage* HeapPage::Initialize(VirtualMemory* memory, PageType type) {
   ASSERT(memory->size() > VirtualMemory::PageSize());
   bool is_executable = (type == kExecutable);
-  memory->Commit(is_executable);
 
   HeapPage* result = reinterpret_cast<HeapPage*>(memory->address());
   result->memory_ = memory;
   result->next_ = NULL;
   result->executable_ = is_executable;
+  result->card_table_ = NULL;
   return result;
 }
 
 
 HeapPage* HeapPage::Allocate(intptr_t size_in_words, PageType type) {
-  VirtualMemory* memory =
-      VerifiedMemory::Reserve(size_in_words << kWordSizeLog2);
-  if (memory == NULL) {
-    return NULL;
+  const intptr_t size = size_in_words << kWordSizeLog2;
+  VirtualMemory* memory = NULL;
+  if (type == kExecutable) {
+    memory = VerifiedMemory::Reserve(size);
+    if ((memory == NULL) || !memory->Commit(true)) {
+      delete memory;
+      return NULL;
+    }
+  } else {
+    // The snapshot reader relies on new pages being zeroed.
+    memory = PagePool::Allocate(size, true);
+    if (memory == NULL) {
+      return NULL;
+    }
   }
   return Initialize(memory, type);
 }
 
 
 void HeapPage::Deallocate() {
+  free(card_table_);
   // The memory for this object will become unavailable after the delete below.
-  delete memory_;
+  if (executable_) {
+    delete memory_;
+  } else {
+    PagePool::Free(memory_);
+  }
+}
+
+
+void HeapPage::EnableCardMarking(RawObject* raw_obj) {
+  if (!FLAG_card_marking) {
+    return;
+  }
+  ASSERT(raw_obj->IsOldObject());
+  ASSERT((raw_obj->GetClassId() == kArrayCid) ||
+         (raw_obj->GetClassId() == kImmutableArrayCid));
+  HeapPage* page = OfLargeObject(raw_obj);
+  ASSERT(page->card_table_ == NULL);
+  intptr_t num_cards = page->memory_->size() >> kCardSizeLog2;
+  page->card_table_ = reinterpret_cast<uint8_t*>(calloc(num_cards, 1));
+  if (page->card_table_ == NULL) {
+    // Keep remembering the whole array.
+    return;
+  }
+  raw_obj->SetCardRememberedBitUnsynchronized();
+}
+
+
+void HeapPage::VisitRememberedCards(ObjectPointerVisitor* visitor) {
+  ASSERT(card_table_ != NULL);
+  RawArray* raw_array = reinterpret_cast<RawArray*>(
+      RawObject::FromAddr(object_start()));
+  ASSERT(raw_array->IsCardRemembered());
+  RawObject** first = raw_array->from();
+  RawObject** last = raw_array->to(Smi::Value(raw_array->ptr()->length_));
+  const uword page_start = reinterpret_cast<uword>(this);
+  const intptr_t first_card =
+      (reinterpret_cast<uword>(first) - page_start) >> kCardSizeLog2;
+  const intptr_t last_card =
+      (reinterpret_cast<uword>(last) - page_start) >> kCardSizeLog2;
+  for (intptr_t i = first_card; i <= last_card; i++) {
+    if (card_table_[i] == 0) {
+      continue;
+    }
+    card_table_[i] = 0;
+    RawObject** card_first =
+        reinterpret_cast<RawObject**>(page_start + (i << kCardSizeLog2));
+    RawObject** card_last = card_first + (kCardSize / kWordSize) - 1;
+    visitor->VisitPointers(Utils::Maximum(first, card_first),
+                           Utils::Minimum(last, card_last));
+  }
 }
 
 
@@ -144,8 +238,16 @@ PageSpace::PageSpace(Heap* heap,
       exec_pages_(NULL),
       exec_pages_tail_(NULL),
       large_pages_(NULL),
+      retained_pages_(NULL),
+      retained_pages_count_(0),
+      retained_pages_limit_(FLAG_old_gen_retained_free_pages),
+      released_in_bytes_(0),
+      retained_large_in_words_(0),
       bump_top_(0),
       bump_end_(0),
+      unswept_(NULL),
+      unswept_prev_(NULL),
+      unswept_last_(NULL),
       max_capacity_in_words_(max_capacity_in_words),
       max_external_in_words_(max_external_in_words),
       tasks_lock_(new Monitor()),
@@ -154,8 +256,13 @@ PageSpace::PageSpace(Heap* heap,
                              FLAG_old_gen_growth_space_ratio,
                              FLAG_old_gen_growth_rate,
                              FLAG_old_gen_growth_time_ratio),
+      marker_(NULL),
+      used_at_last_step_in_words_(0),
       gc_time_micros_(0),
       collections_(0) {
+  for (intptr_t i = 0; i < kNumLargePageSizeClasses; i++) {
+    retained_large_pages_[i] = NULL;
+  }
 }
 
 
@@ -166,9 +273,14 @@ PageSpace::~PageSpace() {
       ml.Wait();
     }
   }
+  delete marker_;
   FreePages(pages_);
   FreePages(exec_pages_);
   FreePages(large_pages_);
+  FreePages(retained_pages_);
+  for (intptr_t i = 0; i < kNumLargePageSizeClasses; i++) {
+    FreePages(retained_large_pages_[i]);
+  }
   delete pages_lock_;
   delete tasks_lock_;
 }
@@ -182,12 +294,15 @@ intptr_t PageSpace::LargePageSizeInWordsFor(intptr_t size) {
 
 
 HeapPage* PageSpace::AllocatePage(HeapPage::PageType type) {
-  HeapPage* page = HeapPage::Allocate(kPageSizeInWords, type);
+  bool is_exec = (type == HeapPage::kExecutable);
+  HeapPage* page = is_exec ? NULL : TakeRetainedPage();
+  if (page == NULL) {
+    page = HeapPage::Allocate(kPageSizeInWords, type);
+  }
   if (page == NULL) {
     return NULL;
   }
 
-  bool is_exec = (type == HeapPage::kExecutable);
 
   MutexLocker ml(pages_lock_);
   if (!is_exec) {
@@ -219,13 +334,22 @@ HeapPage* PageSpace::AllocatePage(HeapPage::PageType type) {
 
 HeapPage* PageSpace::AllocateLargePage(intptr_t size, HeapPage::PageType type) {
   intptr_t page_size_in_words = LargePageSizeInWordsFor(size);
-  HeapPage* page = HeapPage::Allocate(page_size_in_words, type);
+  HeapPage* page = NULL;
+  if (type == HeapPage::kData) {
+    page = TakeRetainedLargePage(page_size_in_words);
+  }
+  if (page != NULL) {
+    // Zero only the part of the page used by the new object.
+    memset(reinterpret_cast<void*>(page->object_start()), 0, size);
+  } else {
+    page = HeapPage::Allocate(page_size_in_words, type);
+  }
   if (page == NULL) {
     return NULL;
   }
   page->set_next(large_pages_);
   large_pages_ = page;
-  IncreaseCapacityInWords(page_size_in_words);
+  IncreaseLargeCapacityInWords(page_size_in_words);
   // Only one object in this page (at least until String::MakeExternal or
   // Array::MakeArray is called).
   page->set_object_end(page->object_start() + size);
@@ -244,7 +368,8 @@ void PageSpace::TruncateLargePage(HeapPage* page,
   const intptr_t old_page_size_in_words = (memory->size() >> kWordSizeLog2);
   if (new_page_size_in_words < old_page_size_in_words) {
     memory->Truncate(new_page_size_in_words << kWordSizeLog2);
-    IncreaseCapacityInWords(new_page_size_in_words - old_page_size_in_words);
+    IncreaseLargeCapacityInWords(
+        new_page_size_in_words - old_page_size_in_words);
     page->set_object_end(page->object_start() + new_object_size_in_bytes);
   }
 }
@@ -277,20 +402,170 @@ void PageSpace::FreePage(HeapPage* page, HeapPage* previous_page) {
       }
     }
   }
-  // TODO(iposva): Consider adding to a pool of empty pages.
-  page->Deallocate();
+  if (is_exec || !RetainFreePage(page)) {
+    page->Deallocate();
+  }
+}
+
+
+bool PageSpace::RetainFreePage(HeapPage* page) {
+  ASSERT(page->type() == HeapPage::kData);
+  ASSERT(page->card_table_ == NULL);
+  intptr_t released = 0;
+  if (FLAG_old_gen_release_memory) {
+    // Release the memory before the page can be taken again.
+    released = VirtualMemory::Discard(page->object_start(),
+                                      page->memory_->end());
+  }
+  MutexLocker ml(pages_lock_);
+  if (retained_pages_count_ >= retained_pages_limit_) {
+    return false;
+  }
+  page->set_next(retained_pages_);
+  retained_pages_ = page;
+  retained_pages_count_++;
+  released_in_bytes_ += released;
+  return true;
+}
+
+
+HeapPage* PageSpace::TakeRetainedPage() {
+  MutexLocker ml(pages_lock_);
+  HeapPage* page = retained_pages_;
+  if (page != NULL) {
+    retained_pages_ = page->next();
+    retained_pages_count_--;
+    page->set_next(NULL);
+  }
+  return page;
+}
+
+
+intptr_t PageSpace::LargePageSizeClass(intptr_t page_size_in_words) {
+  intptr_t size_class = 0;
+  intptr_t limit_in_words = 2 * (kAllocatablePageSize >> kWordSizeLog2);
+  while ((page_size_in_words >= limit_in_words) &&
+         (size_class < kNumLargePageSizeClasses - 1)) {
+    size_class++;
+    limit_in_words *= 2;
+  }
+  return size_class;
+}
+
+
+bool PageSpace::RetainFreeLargePage(HeapPage* page) {
+  ASSERT(page->type() == HeapPage::kData);
+#if defined(DEBUG)
+  // The shadow copy of a reused page would be stale.
+  if (FLAG_verified_mem) {
+    return false;
+  }
+#endif
+  const intptr_t page_size_in_words = page->memory_->size() >> kWordSizeLog2;
+  if (page_size_in_words >
+      FLAG_old_gen_retained_large_pages * MBInWords) {
+    return false;
+  }
+  free(page->card_table_);
+  page->card_table_ = NULL;
+  intptr_t released = 0;
+  if (FLAG_old_gen_release_memory) {
+    // Release the memory before the page can be taken again. Its contents are
+    // undefined afterwards, so a reused page is zeroed again on allocation.
+    released = VirtualMemory::Discard(page->object_start(),
+                                      page->memory_->end());
+  }
+  MutexLocker ml(pages_lock_);
+  // Like empty pages, large pages are not kept once the heap is shrinking.
+  if ((retained_pages_limit_ == 0) ||
+      (retained_large_in_words_ + page_size_in_words >
+       FLAG_old_gen_retained_large_pages * MBInWords)) {
+    return false;
+  }
+  const intptr_t size_class = LargePageSizeClass(page_size_in_words);
+  page->set_next(retained_large_pages_[size_class]);
+  retained_large_pages_[size_class] = page;
+  retained_large_in_words_ += page_size_in_words;
+  released_in_bytes_ += released;
+  return true;
+}
+
+
+HeapPage* PageSpace::TakeRetainedLargePage(intptr_t page_size_in_words) {
+  MutexLocker ml(pages_lock_);
+  if (retained_large_in_words_ == 0) {
+    return NULL;
+  }
+  // A page of the same size class or the next one may fit. Do not waste more
+  // than half of a reused page.
+  const intptr_t size_class = LargePageSizeClass(page_size_in_words);
+  const intptr_t last_class =
+      Utils::Minimum(size_class + 1, kNumLargePageSizeClasses - 1);
+  for (intptr_t i = size_class; i <= last_class; i++) {
+    HeapPage* previous_page = NULL;
+    HeapPage* page = retained_large_pages_[i];
+    while (page != NULL) {
+      const intptr_t size_in_words = page->memory_->size() >> kWordSizeLog2;
+      if ((size_in_words >= page_size_in_words) &&
+          (size_in_words <= 2 * page_size_in_words)) {
+        if (previous_page != NULL) {
+          previous_page->set_next(page->next());
+        } else {
+          retained_large_pages_[i] = page->next();
+        }
+        page->set_next(NULL);
+        retained_large_in_words_ -= size_in_words;
+        if (size_in_words > page_size_in_words) {
+          page->memory_->Truncate(page_size_in_words << kWordSizeLog2);
+        }
+        return page;
+      }
+      previous_page = page;
+      page = page->next();
+    }
+  }
+  return NULL;
+}
+
+
+void PageSpace::ReleaseRetainedPages() {
+  HeapPage* pages = NULL;
+  HeapPage* large_pages[kNumLargePageSizeClasses];
+  {
+    MutexLocker ml(pages_lock_);
+    pages = retained_pages_;
+    retained_pages_ = NULL;
+    retained_pages_count_ = 0;
+    for (intptr_t i = 0; i < kNumLargePageSizeClasses; i++) {
+      large_pages[i] = retained_large_pages_[i];
+      retained_large_pages_[i] = NULL;
+    }
+    retained_large_in_words_ = 0;
+  }
+  FreePages(pages);
+  for (intptr_t i = 0; i < kNumLargePageSizeClasses; i++) {
+    FreePages(large_pages[i]);
+  }
+}
+
+
+void PageSpace::AddReleasedInBytes(intptr_t size) {
+  MutexLocker ml(pages_lock_);
+  released_in_bytes_ += size;
 }
 
 
 void PageSpace::FreeLargePage(HeapPage* page, HeapPage* previous_page) {
-  IncreaseCapacityInWords(-(page->memory_->size() >> kWordSizeLog2));
+  IncreaseLargeCapacityInWords(-(page->memory_->size() >> kWordSizeLog2));
   // Remove the page from the list.
   if (previous_page != NULL) {
     previous_page->set_next(page->next());
   } else {
     large_pages_ = page->next();
   }
-  page->Deallocate();
+  if ((page->type() == HeapPage::kExecutable) || !RetainFreeLargePage(page)) {
+    page->Deallocate();
+  }
 }
 
 
@@ -310,6 +585,13 @@ uword PageSpace::TryAllocateInFreshPage(intptr_t size,
                                         bool is_locked) {
   ASSERT(size < kAllocatablePageSize);
   uword result = 0;
+  if (type == HeapPage::kData) {
+    // Reuse the memory of unswept pages before growing.
+    result = TryAllocateSwept(size, FLAG_lazy_sweep_pages, is_locked);
+    if (result != 0) {
+      return result;
+    }
+  }
   SpaceUsage after_allocation = GetCurrentUsage();
   after_allocation.used_in_words += size >> kWordSizeLog2;
   // Can we grow by one page?
@@ -335,11 +617,78 @@ uword PageSpace::TryAllocateInFreshPage(intptr_t size,
         freelist_[type].Free(free_start, free_size);
       }
     }
+  } else if (type == HeapPage::kData) {
+    // Sweep the remaining pages before a garbage collection is triggered.
+    result = TryAllocateSwept(size, -1, is_locked);
   }
   return result;
 }
 
 
+uword PageSpace::TryAllocateSwept(intptr_t size,
+                                  intptr_t max_pages,
+                                  bool is_locked) {
+  FreeList* freelist = &freelist_[HeapPage::kData];
+  if (!is_locked) {
+    MutexLocker ml(freelist->mutex());
+    return TryAllocateSweptLocked(size, max_pages);
+  }
+  return TryAllocateSweptLocked(size, max_pages);
+}
+
+
+uword PageSpace::TryAllocateSweptLocked(intptr_t size, intptr_t max_pages) {
+  FreeList* freelist = &freelist_[HeapPage::kData];
+  intptr_t swept = 0;
+  while ((unswept_ != NULL) && ((max_pages < 0) || (swept < max_pages))) {
+    SweepNextPageLocked();
+    swept++;
+    uword result = freelist->TryAllocateLocked(size, false);
+    if (result != 0) {
+      usage_.used_in_words += size >> kWordSizeLog2;
+      return result;
+    }
+  }
+  return 0;
+}
+
+
+void PageSpace::SweepNextPageLocked() {
+  ASSERT(unswept_ != NULL);
+  HeapPage* page = unswept_;
+  HeapPage* next_page = page->next();
+  GCSweeper sweeper;
+  bool page_in_use = sweeper.SweepPage(page, &freelist_[HeapPage::kData], true);
+  AddReleasedInBytes(sweeper.released_in_bytes());
+  unswept_ = (page == unswept_last_) ? NULL : next_page;
+  if (page_in_use) {
+    unswept_prev_ = page;
+  } else {
+    FreePage(page, unswept_prev_);
+  }
+  if (unswept_ == NULL) {
+    unswept_prev_ = NULL;
+    unswept_last_ = NULL;
+  }
+}
+
+
+void PageSpace::CompleteSweep() {
+  MutexLocker ml(freelist_[HeapPage::kData].mutex());
+  while (unswept_ != NULL) {
+    SweepNextPageLocked();
+  }
+}
+
+
+void PageSpace::SweepUntil(int64_t deadline) {
+  MutexLocker ml(freelist_[HeapPage::kData].mutex());
+  while ((unswept_ != NULL) && (OS::GetCurrentTimeMicros() < deadline)) {
+    SweepNextPageLocked();
+  }
+}
+
+
 uword PageSpace::TryAllocateInternal(intptr_t size,
                             HeapPage::PageType type,
                             GrowthPolicy growth_policy,
@@ -518,6 +867,11 @@ void PageSpace::AbandonBumpAllocation() {
 }
 
 
+void PageSpace::RecordAllocation(uword addr) {
+  marker_->RecordAllocation(addr);
+}
+
+
 bool PageSpace::Contains(uword addr) const {
   for (ExclusivePageIterator it(this); !it.Done(); it.Advance()) {
     if (it.page()->Contains(addr)) {
@@ -649,6 +1003,7 @@ void PageSpace::PrintToJSONObject(JSONObject* object) {
   } else {
     space.AddProperty("avgCollectionPeriodMillis", 0.0);
   }
+  page_space_controller_.PrintToJSONObject(&space);
 }
 
 
@@ -757,6 +1112,8 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
     }
     set_tasks(1);
   }
+  // Marking must not see the mark bits of the last cycle.
+  CompleteSweep();
 
   // Perform various cleanup that relies on no tasks interfering.
   isolate->class_table()->FreeOldTables();
@@ -772,7 +1129,7 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
 
   if (FLAG_verify_before_gc) {
     OS::PrintErr("Verifying before marking...");
-    heap_->Verify();
+    heap_->Verify(IsMarking() ? kAllowMarked : kForbidMarked);
     OS::PrintErr(" done.\n");
   }
 
@@ -784,11 +1141,17 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
   // Save old value before GCMarker visits the weak persistent handles.
   SpaceUsage usage_before = GetCurrentUsage();
 
-  // Mark all reachable old-gen objects.
+  // Mark all reachable old-gen objects, finishing incremental marking if it
+  // was started.
   bool collect_code = FLAG_collect_code && ShouldCollectCode();
-  GCMarker marker(heap_);
-  marker.MarkObjects(isolate, this, invoke_api_callbacks, collect_code);
-  usage_.used_in_words = marker.marked_words();
+  GCMarker* marker = marker_;
+  marker_ = NULL;
+  if (marker == NULL) {
+    marker = new GCMarker(heap_);
+  }
+  marker->MarkObjects(isolate, this, invoke_api_callbacks, collect_code);
+  usage_.used_in_words = marker->marked_words();
+  delete marker;
 
   int64_t mid1 = OS::GetCurrentTimeMicros();
 
@@ -807,6 +1170,16 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
       heap_->Verify(kAllowMarked);
       OS::PrintErr(" done.\n");
     }
+    // Release sparse data pages instead of sweeping them. Unmarked objects
+    // may point into the released pages until they are swept.
+    if (page_space_controller_.NeedsCompaction(usage_)) {
+      GCCompactor compactor(heap_, this);
+      compactor.CompactSparsePages(isolate, 100 - FLAG_compaction_free_ratio);
+      if (FLAG_log_compaction) {
+        OS::PrintErr("Compaction released %" Pd " pages\n",
+                     compactor.released_pages());
+      }
+    }
     GCSweeper sweeper;
 
     // During stop-the-world phases we should use bulk lock when adding elements
@@ -847,7 +1220,13 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
 
     mid3 = OS::GetCurrentTimeMicros();
 
-    if (!FLAG_concurrent_sweep) {
+    if (FLAG_lazy_sweep) {
+      // Leave the regular sized pages to the allocations that miss the
+      // freelist.
+      unswept_ = pages_;
+      unswept_prev_ = NULL;
+      unswept_last_ = pages_tail_;
+    } else if (!FLAG_concurrent_sweep) {
       // Sweep all regular sized pages now.
       prev_page = NULL;
       page = pages_;
@@ -873,6 +1252,7 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
       GCSweeper::SweepConcurrent(
           isolate, pages_, pages_tail_, &freelist_[HeapPage::kData]);
     }
+    AddReleasedInBytes(sweeper.released_in_bytes());
   }
 
   // Make code pages read-only.
@@ -884,6 +1264,15 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
   page_space_controller_.EvaluateGarbageCollection(usage_before,
                                                    GetCurrentUsage(),
                                                    start, end);
+  // Keep no empty pages around once the heap is shrinking.
+  {
+    MutexLocker ml(pages_lock_);
+    retained_pages_limit_ = page_space_controller_.is_shrinking() ?
+        0 : FLAG_old_gen_retained_free_pages;
+  }
+  if (page_space_controller_.is_shrinking()) {
+    ReleaseRetainedPages();
+  }
 
   heap_->RecordTime(kMarkObjects, mid1 - start);
   heap_->RecordTime(kResetFreeLists, mid2 - mid1);
@@ -906,18 +1295,105 @@ void PageSpace::MarkSweep(bool invoke_api_callbacks) {
 }
 
 
+void PageSpace::StartIncrementalMarking() {
+  Isolate* isolate = heap_->isolate();
+  ASSERT(isolate == Isolate::Current());
+  ASSERT(!IsMarking());
+
+  // The sweeper must not see mark bits of the next cycle.
+  {
+    MonitorLocker locker(tasks_lock());
+    while (tasks() > 0) {
+      locker.Wait();
+    }
+  }
+  CompleteSweep();
+  NoHandleScope no_handles(isolate);
+  AbandonBumpAllocation();
+  used_at_last_step_in_words_ = usage_.used_in_words;
+  GCMarker* marker = new GCMarker(heap_);
+  marker->StartIncremental(isolate, this);
+  marker_ = marker;
+}
+
+
+bool PageSpace::IncrementalMarkingStep() {
+  ASSERT(IsMarking());
+  Isolate* isolate = heap_->isolate();
+  NoHandleScope no_handles(isolate);
+  // Scan at least twice as much as was allocated since the last step so that
+  // marking finishes before the heap has to grow much.
+  const intptr_t allocated_in_words =
+      usage_.used_in_words - used_at_last_step_in_words_;
+  used_at_last_step_in_words_ = usage_.used_in_words;
+  const intptr_t budget = Utils::Maximum(
+      static_cast<intptr_t>(FLAG_marking_step_kb) * KB,
+      2 * (allocated_in_words << kWordSizeLog2));
+  return marker_->IncrementalStep(isolate, budget);
+}
+
+
+bool PageSpace::IncrementalMarkingStepUntil(int64_t deadline) {
+  ASSERT(IsMarking());
+  Isolate* isolate = heap_->isolate();
+  NoHandleScope no_handles(isolate);
+  const intptr_t budget = static_cast<intptr_t>(FLAG_marking_step_kb) * KB;
+  while (!marker_->IncrementalStep(isolate, budget)) {
+    if (OS::GetCurrentTimeMicros() >= deadline) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+class MarkBitClearer : public ObjectVisitor {
+ public:
+  explicit MarkBitClearer(Isolate* isolate) : ObjectVisitor(isolate) { }
+
+  void VisitObject(RawObject* obj) {
+    if (obj->IsMarked()) {
+      obj->ClearMarkBit();
+    }
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MarkBitClearer);
+};
+
+
+void PageSpace::AbortIncrementalMarking() {
+  if (!IsMarking()) {
+    return;
+  }
+  GCMarker* marker = marker_;
+  marker_ = NULL;
+  marker->AbortIncremental();
+  delete marker;
+  WriteProtectCode(false);
+  MarkBitClearer clearer(heap_->isolate());
+  VisitObjects(&clearer);
+  WriteProtectCode(true);
+}
+
+
 uword PageSpace::TryAllocateDataBumpInternal(intptr_t size,
                                              GrowthPolicy growth_policy,
                                              bool is_locked) {
   ASSERT(size >= kObjectAlignment);
   ASSERT(Utils::IsAligned(size, kObjectAlignment));
+  if (size >= kAllocatablePageSize) {
+    // Large objects are alone on their page, see HeapPage::EnableCardMarking.
+    return TryAllocateInternal(
+        size, HeapPage::kData, growth_policy, false, is_locked);
+  }
   intptr_t remaining = bump_end_ - bump_top_;
   if (remaining < size) {
-    // Checking this first would be logical, but needlessly slow.
-    if (size >= kAllocatablePageSize) {
-      return is_locked ?
-          TryAllocateDataLocked(size, growth_policy) :
-          TryAllocate(size, HeapPage::kData, growth_policy);
+    // While marking, generated code must not bump allocate without recording
+    // the objects, so no new bump block is set up.
+    if (IsMarking()) {
+      return TryAllocateInternal(
+          size, HeapPage::kData, growth_policy, false, is_locked);
     }
     FreeListElement* block = is_locked ?
         freelist_[HeapPage::kData].TryAllocateLargeLocked(size) :
@@ -962,7 +1438,11 @@ uword PageSpace::TryAllocateDataBumpInternal(intptr_t size,
 
 uword PageSpace::TryAllocateDataBump(intptr_t size,
                                      GrowthPolicy growth_policy) {
-  return TryAllocateDataBumpInternal(size, growth_policy, false);
+  uword result = TryAllocateDataBumpInternal(size, growth_policy, false);
+  if ((marker_ != NULL) && (result != 0)) {
+    RecordAllocation(result);
+  }
+  return result;
 }
 
 
@@ -986,12 +1466,47 @@ uword PageSpace::TryAllocatePromoLocked(intptr_t size,
 }
 
 
+uword PageSpace::TryAllocatePromoLabLocked(intptr_t size,
+                                           GrowthPolicy growth_policy) {
+  ASSERT(Utils::IsAligned(size, kObjectAlignment));
+  ASSERT(size < kAllocatablePageSize);
+  FreeList* freelist = &freelist_[HeapPage::kData];
+  FreeListElement* block = freelist->TryAllocateLargeLocked(size);
+  if (block == NULL) {
+    // Note: usage_ is updated by the call below.
+    return TryAllocateInFreshPage(size,
+                                  HeapPage::kData,
+                                  growth_policy,
+                                  true);
+  }
+  uword result = reinterpret_cast<uword>(block);
+  intptr_t remaining = block->Size() - size;
+  if (remaining > 0) {
+    freelist->FreeLocked(result + size, remaining);
+  }
+  usage_.used_in_words += size >> kWordSizeLog2;
+  return result;
+}
+
+
+void PageSpace::ReleasePromoLabLocked(uword top, uword end) {
+  ASSERT(top <= end);
+  if (top < end) {
+    freelist_[HeapPage::kData].FreeLocked(top, end - top);
+    usage_.used_in_words -= (end - top) >> kWordSizeLog2;
+  }
+}
+
+
 uword PageSpace::TryAllocateSmiInitializedLocked(intptr_t size,
                                                  GrowthPolicy growth_policy) {
   uword result = TryAllocateDataBumpLocked(size, growth_policy);
   if (collections() != 0) {
     FATAL1("%" Pd " GCs before TryAllocateSmiInitializedLocked", collections());
   }
+  if ((marker_ != NULL) && (result != 0)) {
+    RecordAllocation(result);
+  }
 #if defined(DEBUG)
   RawObject** begin = reinterpret_cast<RawObject**>(result);
   RawObject** end = reinterpret_cast<RawObject**>(result + size);
@@ -1010,33 +1525,82 @@ PageSpaceController::PageSpaceController(Heap* heap,
     : heap_(heap),
       is_enabled_(false),
       grow_heap_(heap_growth_max / 2),
+      underused_collections_(0),
       heap_growth_ratio_(heap_growth_ratio),
       desired_utilization_((100.0 - heap_growth_ratio) / 100.0),
       heap_growth_max_(heap_growth_max),
       garbage_collection_time_ratio_(garbage_collection_time_ratio),
-      last_code_collection_in_us_(OS::GetCurrentTimeMicros()) {
+      last_code_collection_in_us_(OS::GetCurrentTimeMicros()),
+      last_pause_micros_(0),
+      last_gc_time_fraction_(0),
+      growth_limit_("initial") {
 }
 
 
 PageSpaceController::~PageSpaceController() {}
 
 
-bool PageSpaceController::NeedsGarbageCollection(SpaceUsage after) const {
-  if (!is_enabled_) {
-    return false;
-  }
-  if (heap_growth_ratio_ == 100) {
+// Returns the usage of the pages of small objects. Large pages are assumed to
+// be fully used by their objects.
+static SpaceUsage WithoutLargePages(SpaceUsage usage) {
+  SpaceUsage result = usage;
+  result.capacity_in_words -= usage.large_in_words;
+  result.used_in_words =
+      Utils::Maximum<intptr_t>(0, usage.used_in_words - usage.large_in_words);
+  result.large_in_words = 0;
+  return result;
+}
+
+
+bool PageSpaceController::NeedsCompaction(SpaceUsage after) const {
+  if (!FLAG_compact_old_space) {
     return false;
   }
+  // Large pages are never evacuated.
+  after = WithoutLargePages(after);
+  const intptr_t free_in_words =
+      after.capacity_in_words - after.used_in_words;
+  return free_in_words * 100 >
+      after.capacity_in_words * FLAG_compaction_free_ratio;
+}
+
+
+intptr_t PageSpaceController::CapacityIncreaseInPages(SpaceUsage after) const {
   intptr_t capacity_increase_in_words =
-      after.capacity_in_words - last_usage_.capacity_in_words;
+      WithoutLargePages(after).capacity_in_words -
+      WithoutLargePages(last_usage_).capacity_in_words;
   // The concurrent sweeper might have freed more capacity than was allocated.
   capacity_increase_in_words =
       Utils::Maximum<intptr_t>(0, capacity_increase_in_words);
   capacity_increase_in_words =
       Utils::RoundUp(capacity_increase_in_words, PageSpace::kPageSizeInWords);
-  intptr_t capacity_increase_in_pages =
-      capacity_increase_in_words / PageSpace::kPageSizeInWords;
+  return capacity_increase_in_words / PageSpace::kPageSizeInWords;
+}
+
+
+intptr_t PageSpaceController::LargeCapacityIncreaseInPages(
+    SpaceUsage after) const {
+  const intptr_t large_increase_in_words = Utils::Maximum<intptr_t>(
+      0, after.large_in_words - last_usage_.large_in_words);
+  return Utils::RoundUp(large_increase_in_words, PageSpace::kPageSizeInWords) /
+      PageSpace::kPageSizeInWords;
+}
+
+
+intptr_t PageSpaceController::LargeGrowthLimitInPages() const {
+  return Utils::Maximum(
+      last_usage_.large_in_words / PageSpace::kPageSizeInWords, grow_heap_);
+}
+
+
+bool PageSpaceController::NeedsGarbageCollection(SpaceUsage after) const {
+  if (!is_enabled_) {
+    return false;
+  }
+  if (heap_growth_ratio_ == 100) {
+    return false;
+  }
+  intptr_t capacity_increase_in_pages = CapacityIncreaseInPages(after);
   double multiplier = 1.0;
   // To avoid waste, the first GC should be triggered before too long. After
   // kInitialTimeoutSeconds, gradually lower the capacity limit.
@@ -1057,10 +1621,42 @@ bool PageSpaceController::NeedsGarbageCollection(SpaceUsage after) const {
                  needs_gc ? ">" : "<=",
                  grow_heap_);
   }
+  if (!needs_gc) {
+    const intptr_t large_increase_in_pages =
+        LargeCapacityIncreaseInPages(after);
+    const intptr_t large_limit_in_pages = LargeGrowthLimitInPages();
+    needs_gc = large_increase_in_pages * multiplier > large_limit_in_pages;
+    if (FLAG_log_growth && (large_increase_in_pages > 0)) {
+      OS::PrintErr("%s: large %" Pd " * %f %s %" Pd "\n",
+                   needs_gc ? "NEEDS GC" : "grow",
+                   large_increase_in_pages,
+                   multiplier,
+                   needs_gc ? ">" : "<=",
+                   large_limit_in_pages);
+    }
+  }
   return needs_gc;
 }
 
 
+bool PageSpaceController::NeedsIdleGarbageCollection(
+    SpaceUsage current) const {
+  if (!is_enabled_) {
+    return false;
+  }
+  if (heap_growth_ratio_ == 100) {
+    return false;
+  }
+  const intptr_t capacity_increase_in_pages = CapacityIncreaseInPages(current);
+  const intptr_t large_increase_in_pages =
+      LargeCapacityIncreaseInPages(current);
+  return ((capacity_increase_in_pages > 0) &&
+          (2 * capacity_increase_in_pages > grow_heap_)) ||
+         ((large_increase_in_pages > 0) &&
+          (2 * large_increase_in_pages > LargeGrowthLimitInPages()));
+}
+
+
 void PageSpaceController::EvaluateGarbageCollection(
     SpaceUsage before, SpaceUsage after, int64_t start, int64_t end) {
   ASSERT(end >= start);
@@ -1068,10 +1664,17 @@ void PageSpaceController::EvaluateGarbageCollection(
   int gc_time_fraction = history_.GarbageCollectionTimeFraction();
   heap_->RecordData(PageSpace::kGCTimeFraction, gc_time_fraction);
 
+  // The growth of the pages of small objects is controlled below. Large pages
+  // grow relative to their usage after this collection.
+  const SpaceUsage usage_after = after;
+  const SpaceUsage last_usage = WithoutLargePages(last_usage_);
+  before = WithoutLargePages(before);
+  after = WithoutLargePages(after);
+
   // Assume garbage increases linearly with allocation:
   // G = kA, and estimate k from the previous cycle.
   intptr_t allocated_since_previous_gc =
-      before.used_in_words - last_usage_.used_in_words;
+      before.used_in_words - last_usage.used_in_words;
   intptr_t garbage = before.used_in_words - after.used_in_words;
   double k = garbage / static_cast<double>(allocated_since_previous_gc);
   heap_->RecordData(PageSpace::kGarbageRatio, static_cast<int>(k * 100));
@@ -1096,13 +1699,132 @@ void PageSpaceController::EvaluateGarbageCollection(
   }
   heap_->RecordData(PageSpace::kPageGrowth, grow_heap_);
 
-  // Limit shrinkage: allow growth by at least half the pages freed by GC.
-  intptr_t freed_pages =
-      (before.capacity_in_words - after.capacity_in_words) /
-      PageSpace::kPageSizeInWords;
-  grow_heap_ = Utils::Maximum(grow_heap_, freed_pages / 2);
+  // Track how long the heap has been used well below its capacity. Compare
+  // with the capacity before the collection, as sweeping may already have
+  // released the empty pages.
+  if (after.used_in_words <
+      before.capacity_in_words * desired_utilization_ / 2) {
+    underused_collections_++;
+  } else {
+    underused_collections_ = 0;
+  }
+
+  // Limit shrinkage: allow growth by at least half the pages freed by GC,
+  // unless the heap has been underused for a while.
+  if (!is_shrinking()) {
+    intptr_t freed_pages =
+        (before.capacity_in_words - after.capacity_in_words) /
+        PageSpace::kPageSizeInWords;
+    grow_heap_ = Utils::Maximum(grow_heap_, freed_pages / 2);
+  } else if (FLAG_log_growth) {
+    OS::PrintErr("shrink: %" Pd " underused collections, grow %" Pd "\n",
+                 underused_collections_,
+                 grow_heap_);
+  }
+  growth_limit_ = "space";
+  last_pause_micros_ = end - start;
+  last_gc_time_fraction_ = gc_time_fraction;
+  if ((FLAG_gc_pause_goal > 0) || (FLAG_gc_time_goal > 0)) {
+    ApplyGoals(before, after, end - start, gc_time_fraction);
+  }
   heap_->RecordData(PageSpace::kAllowedGrowth, grow_heap_);
-  last_usage_ = after;
+  last_usage_ = usage_after;
+}
+
+
+void PageSpaceController::ApplyGoals(SpaceUsage before,
+                                     SpaceUsage after,
+                                     int64_t pause_micros,
+                                     int gc_time_fraction) {
+  const intptr_t space_growth = grow_heap_;
+  // The time spent in GC is roughly inversely proportional to the allocation
+  // between collections, i.e., to the free space after a collection.
+  const intptr_t allocated_in_words =
+      before.used_in_words - WithoutLargePages(last_usage_).used_in_words;
+  if ((FLAG_gc_time_goal > 0) &&
+      (gc_time_fraction > FLAG_gc_time_goal) &&
+      (allocated_in_words > 0)) {
+    const double needed_in_words = allocated_in_words *
+        (gc_time_fraction / static_cast<double>(FLAG_gc_time_goal));
+    const intptr_t free_in_words =
+        after.capacity_in_words - after.used_in_words;
+    const intptr_t time_growth = Utils::Minimum<intptr_t>(
+        heap_growth_max_,
+        static_cast<intptr_t>((needed_in_words - free_in_words) /
+                              PageSpace::kPageSizeInWords) + 1);
+    if (time_growth > grow_heap_) {
+      grow_heap_ = time_growth;
+      growth_limit_ = "time goal";
+    }
+  }
+  // The pause is roughly proportional to the heap in use when collecting,
+  // which is the capacity once the allowed growth has been used up.
+  if ((FLAG_gc_pause_goal > 0) &&
+      (pause_micros > 0) &&
+      (before.used_in_words > 0)) {
+    const double micros_per_word =
+        pause_micros / static_cast<double>(before.used_in_words);
+    const double max_used_in_words =
+        (FLAG_gc_pause_goal * kMicrosecondsPerMillisecond) / micros_per_word;
+    if (max_used_in_words <= after.used_in_words) {
+      // Marking the live data alone takes longer than the goal allows, and
+      // collecting more often would not shorten the pauses.
+      if (FLAG_log_growth) {
+        OS::PrintErr("goals: pause goal %d ms unreachable with %" Pd " KB "
+                     "in use, ignored\n",
+                     FLAG_gc_pause_goal,
+                     (after.used_in_words << kWordSizeLog2) / KB);
+      }
+    } else {
+      // Still allow the space policy's share of the data in use to be
+      // allocated between collections, so that a tight goal does not collect
+      // after every page.
+      const intptr_t min_free_in_words =
+          after.used_in_words * heap_growth_ratio_ / 100;
+      const intptr_t free_in_words =
+          after.capacity_in_words - after.used_in_words;
+      const intptr_t min_growth =
+          Utils::RoundUp(Utils::Maximum<intptr_t>(
+                             0, min_free_in_words - free_in_words),
+                         PageSpace::kPageSizeInWords) /
+          PageSpace::kPageSizeInWords;
+      const intptr_t pause_growth = Utils::Maximum<intptr_t>(
+          min_growth,
+          static_cast<intptr_t>((max_used_in_words - after.capacity_in_words) /
+                                PageSpace::kPageSizeInWords));
+      if (pause_growth < grow_heap_) {
+        grow_heap_ = pause_growth;
+        growth_limit_ = "pause goal";
+      }
+    }
+  }
+  if (FLAG_log_growth) {
+    OS::PrintErr("goals: pause %" Pd64 " us (goal %d ms), "
+                 "gc time %d%% (goal %d%%), grow %" Pd " -> %" Pd " (%s)\n",
+                 pause_micros,
+                 FLAG_gc_pause_goal,
+                 gc_time_fraction,
+                 FLAG_gc_time_goal,
+                 space_growth,
+                 grow_heap_,
+                 growth_limit_);
+  }
+}
+
+
+void PageSpaceController::PrintToJSONObject(JSONObject* object) const {
+  JSONObject policy(object, "growthPolicy");
+  policy.AddProperty("pauseGoalMillis",
+                     static_cast<intptr_t>(FLAG_gc_pause_goal));
+  policy.AddProperty("timeGoalPercent",
+                     static_cast<intptr_t>(FLAG_gc_time_goal));
+  policy.AddProperty("lastPauseMillis",
+                     MicrosecondsToMilliseconds(last_pause_micros_));
+  policy.AddProperty("gcTimePercent",
+                     static_cast<intptr_t>(last_gc_time_fraction_));
+  policy.AddProperty("allowedGrowth",
+                     grow_heap_ * PageSpace::kPageSizeInWords * kWordSize);
+  policy.AddProperty("limitedBy", growth_limit_);
 }
 
 
@@ -1115,6 +1837,20 @@ void PageSpaceGarbageCollectionHistory::
 }
 
 
+int64_t PageSpaceGarbageCollectionHistory::
+    AverageGarbageCollectionMicros() const {
+  if (history_.Size() == 0) {
+    return 0;
+  }
+  int64_t total = 0;
+  for (int i = 0; i < history_.Size(); i++) {
+    const Entry& entry = history_.Get(i);
+    total += entry.end - entry.start;
+  }
+  return total / history_.Size();
+}
+
+
 int PageSpaceGarbageCollectionHistory::GarbageCollectionTimeFraction() {
   int64_t gc_time = 0;
   int64_t total_time = 0;
@@ -16,11 +16,16 @@
 namespace dart {
 
 DECLARE_FLAG(bool, collect_code);
+DECLARE_FLAG(bool, compact_old_space);
 DECLARE_FLAG(bool, log_code_drop);
 DECLARE_FLAG(bool, always_drop_code);
+DECLARE_FLAG(bool, card_marking);
+DECLARE_FLAG(bool, old_gen_release_memory);
+DECLARE_FLAG(int, old_gen_shrink_collections);
 DECLARE_FLAG(bool, write_protect_code);
 
 // Forward declarations.
+class GCMarker;
 class Heap;
 class JSONObject;
 class ObjectPointerVisitor;
@@ -63,6 +68,36 @@ class HeapPage {
     return Utils::RoundUp(sizeof(HeapPage), OS::kMaxPreferredCodeAlignment);
   }
 
+  // A large array is alone on its page and is remembered per card of
+  // kCardSize bytes of the page, see RawObject::IsCardRemembered.
+  static const intptr_t kCardSizeLog2 = 9;
+  static const intptr_t kCardSize = 1 << kCardSizeLog2;
+
+  // Returns the page of an object allocated in a large page.
+  static HeapPage* OfLargeObject(RawObject* raw_obj) {
+    return reinterpret_cast<HeapPage*>(
+        RawObject::ToAddr(raw_obj) - ObjectStartOffset());
+  }
+
+  // Sets up card marking for the array at the start of a large page if
+  // --card_marking is enabled.
+  static void EnableCardMarking(RawObject* raw_obj);
+
+  void RememberCard(RawObject* const* slot) {
+    ASSERT(Contains(reinterpret_cast<uword>(slot)));
+    intptr_t index =
+        (reinterpret_cast<uword>(slot) - reinterpret_cast<uword>(this)) >>
+        kCardSizeLog2;
+    card_table_[index] = 1;
+  }
+
+  // Visits the slots of the array in the marked cards and clears the cards.
+  void VisitRememberedCards(ObjectPointerVisitor* visitor);
+
+  static intptr_t card_table_offset() {
+    return OFFSET_OF(HeapPage, card_table_);
+  }
+
  private:
   void set_object_end(uword val) {
     ASSERT((val & kObjectAlignmentMask) == kOldObjectAlignmentOffset);
@@ -80,6 +115,7 @@ class HeapPage {
   HeapPage* next_;
   uword object_end_;
   bool executable_;
+  uint8_t* card_table_;
 
   friend class PageSpace;
 
@@ -99,6 +135,9 @@ class PageSpaceGarbageCollectionHistory {
 
   int GarbageCollectionTimeFraction();
 
+  // The average duration of the recorded collections, or 0 if there are none.
+  int64_t AverageGarbageCollectionMicros() const;
+
   bool IsEmpty() const { return history_.Size() == 0; }
 
  private:
@@ -115,6 +154,13 @@ class PageSpaceGarbageCollectionHistory {
 
 
 // PageSpaceController controls the heap size.
+//
+// With --gc_pause_goal or --gc_time_goal, the growth allowed before the next
+// GC is also adapted to the measured collections: the heap grows faster while
+// too much time is spent in GC, and is kept small enough for the expected
+// pause. The pause goal wins when the two conflict. It never lowers the growth
+// below the space policy's share of the data in use, and is ignored while the
+// data in use alone takes longer than the goal to collect.
 class PageSpaceController {
  public:
   // The heap is passed in for recording stats only. The controller does not
@@ -130,11 +176,31 @@ class PageSpaceController {
   // (e.g., promotion), as it does not change the state of the controller.
   bool NeedsGarbageCollection(SpaceUsage after) const;
 
+  // Returns whether half of the growth allowed before the next GC has been
+  // used, so that collecting in idle time is likely to prevent a GC later.
+  bool NeedsIdleGarbageCollection(SpaceUsage current) const;
+
+  int64_t EstimateGarbageCollectionMicros() const {
+    return history_.AverageGarbageCollectionMicros();
+  }
+
+  // Returns whether the free space left by marking 'after' should be compacted
+  // rather than swept into the freelist.
+  bool NeedsCompaction(SpaceUsage after) const;
+
   // Should be called after each collection to update the controller state.
   void EvaluateGarbageCollection(SpaceUsage before,
                                  SpaceUsage after,
                                  int64_t start, int64_t end);
 
+  void PrintToJSONObject(JSONObject* object) const;
+
+  // Returns whether the heap has been used well below its capacity for
+  // several collections, so that freed capacity should not be kept around.
+  bool is_shrinking() const {
+    return underused_collections_ >= FLAG_old_gen_shrink_collections;
+  }
+
   int64_t last_code_collection_in_us() { return last_code_collection_in_us_; }
   void set_last_code_collection_in_us(int64_t t) {
     last_code_collection_in_us_ = t;
@@ -152,6 +218,20 @@ class PageSpaceController {
   }
 
  private:
+  // The growth of the pages of small objects since the last collection.
+  intptr_t CapacityIncreaseInPages(SpaceUsage after) const;
+  // Large pages are allowed to grow independently, by as much as they held
+  // after the last collection but at least by 'grow_heap_' pages, so that
+  // short-lived large objects do not distort the growth of the other pages.
+  intptr_t LargeCapacityIncreaseInPages(SpaceUsage after) const;
+  intptr_t LargeGrowthLimitInPages() const;
+
+  // Adjusts 'grow_heap_' to the pause and time goals.
+  void ApplyGoals(SpaceUsage before,
+                  SpaceUsage after,
+                  int64_t pause_micros,
+                  int gc_time_fraction);
+
   Heap* heap_;
 
   bool is_enabled_;
@@ -162,6 +242,10 @@ class PageSpaceController {
   // Pages of capacity growth allowed before next GC is advised.
   intptr_t grow_heap_;
 
+  // Number of consecutive collections after which less than half of the
+  // desired utilization of the capacity was used.
+  intptr_t underused_collections_;
+
   // If the garbage collector was not able to free more than heap_growth_ratio_
   // memory, then the heap is grown. Otherwise garbage collection is performed.
   int heap_growth_ratio_;
@@ -181,6 +265,11 @@ class PageSpaceController {
   // code.
   int64_t last_code_collection_in_us_;
 
+  // The last collection and what determined 'grow_heap_' after it.
+  int64_t last_pause_micros_;
+  int last_gc_time_fraction_;
+  const char* growth_limit_;
+
   PageSpaceGarbageCollectionHistory history_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(PageSpaceController);
@@ -191,6 +280,8 @@ class PageSpace {
  public:
   // TODO(iposva): Determine heap sizes and tune the page size accordingly.
   static const intptr_t kPageSizeInWords = 256 * KBInWords;
+  // Objects of at least this size are allocated in their own large page.
+  static const intptr_t kAllocatablePageSize = 64 * KB;
 
   enum GrowthPolicy {
     kControlGrowth,
@@ -208,14 +299,26 @@ class PageSpace {
     bool is_protected =
         (type == HeapPage::kExecutable) && FLAG_write_protect_code;
     bool is_locked = false;
-    return TryAllocateInternal(
+    uword result = TryAllocateInternal(
         size, type, growth_policy, is_protected, is_locked);
+    if ((marker_ != NULL) && (result != 0)) {
+      RecordAllocation(result);
+    }
+    return result;
   }
 
   bool NeedsGarbageCollection() const {
     return page_space_controller_.NeedsGarbageCollection(usage_) ||
            NeedsExternalGC();
   }
+  bool NeedsIdleGarbageCollection() const {
+    return page_space_controller_.NeedsIdleGarbageCollection(usage_) ||
+           NeedsExternalGC();
+  }
+  // The average duration of the recent collections, or 0 if there were none.
+  int64_t EstimateGarbageCollectionMicros() const {
+    return page_space_controller_.EstimateGarbageCollectionMicros();
+  }
 
   intptr_t UsedInWords() const { return usage_.used_in_words; }
   intptr_t CapacityInWords() const {
@@ -230,6 +333,11 @@ class PageSpace {
     DEBUG_ASSERT(pages_lock_->IsOwnedByCurrentThread());
     usage_.capacity_in_words += increase_in_words;
   }
+  void IncreaseLargeCapacityInWords(intptr_t increase_in_words) {
+    MutexLocker ml(pages_lock_);
+    usage_.capacity_in_words += increase_in_words;
+    usage_.large_in_words += increase_in_words;
+  }
   intptr_t ExternalInWords() const {
     return usage_.external_in_words;
   }
@@ -254,9 +362,35 @@ class PageSpace {
   // code.
   bool ShouldCollectCode();
 
-  // Collect the garbage in the page space using mark-sweep.
+  // Collect the garbage in the page space using mark-sweep. Finishes the
+  // incremental marking cycle if one is in progress.
   void MarkSweep(bool invoke_api_callbacks);
 
+  // Incremental marking, see GCMarker. While marking is in progress, bump
+  // allocation is disabled so that every allocation can be recorded.
+  bool IsMarking() const { return marker_ != NULL; }
+  GCMarker* incremental_marker() const { return marker_; }
+  void StartIncrementalMarking();
+  // Performs a marking step proportional to the allocation since the last
+  // step. Returns true when marking can be finished by MarkSweep.
+  bool IncrementalMarkingStep();
+  // Performs marking steps until marking can be finished or until 'deadline',
+  // in microseconds as returned by OS::GetCurrentTimeMicros.
+  bool IncrementalMarkingStepUntil(int64_t deadline);
+  // Discards the marking progress and clears all mark bits.
+  void AbortIncrementalMarking();
+  // Generated code tests the word at this address to skip the marking barrier.
+  uword* IncrementalMarkingAddress() {
+    return reinterpret_cast<uword*>(&marker_);
+  }
+
+  // With --lazy_sweep, MarkSweep leaves the regular sized data pages to be
+  // swept by the allocations that miss the freelist. Sweeps the remaining
+  // pages, e.g., before the heap is walked or marked again.
+  void CompleteSweep();
+  // Sweeps the pages left by MarkSweep until 'deadline'.
+  void SweepUntil(int64_t deadline);
+
   void StartEndAddress(uword* start, uword* end) const;
 
   void SetGrowthControlState(bool state) {
@@ -302,6 +436,21 @@ class PageSpace {
   void AllocateExternal(intptr_t size);
   void FreeExternal(intptr_t size);
 
+  // Memory returned to the OS, see --old_gen_release_memory.
+  void AddReleasedInBytes(intptr_t size);
+  intptr_t released_in_bytes() const {
+    MutexLocker ml(pages_lock_);
+    return released_in_bytes_;
+  }
+  intptr_t retained_pages() const {
+    MutexLocker ml(pages_lock_);
+    return retained_pages_count_;
+  }
+  intptr_t retained_large_in_words() const {
+    MutexLocker ml(pages_lock_);
+    return retained_large_in_words_;
+  }
+
   // Bulk data allocation.
   void AcquireDataLock();
   void ReleaseDataLock();
@@ -327,6 +476,11 @@ class PageSpace {
   uword TryAllocateDataBumpLocked(intptr_t size, GrowthPolicy growth_policy);
   // Prefer small freelist blocks, then chip away at the bump block.
   uword TryAllocatePromoLocked(intptr_t size, GrowthPolicy growth_policy);
+  // Carves a private bump region of 'size' bytes out of the data freelist or a
+  // fresh page for a parallel scavenge worker. The whole region counts as used
+  // until the unconsumed part is handed back with ReleasePromoLabLocked.
+  uword TryAllocatePromoLabLocked(intptr_t size, GrowthPolicy growth_policy);
+  void ReleasePromoLabLocked(uword top, uword end);
   // Allocates memory where every word is guaranteed to be a Smi. Calling this
   // method after the first garbage collection is inefficient in release mode
   // and illegal in debug mode.
@@ -343,7 +497,7 @@ class PageSpace {
     // Time
     kMarkObjects = 0,
     kResetFreeLists = 1,
-    kSweepPages = 2,
+    kSweepPages = 2,  // Includes compaction.
     kSweepLargePages = 3,
     // Data
     kGarbageRatio = 0,
@@ -352,8 +506,6 @@ class PageSpace {
     kAllowedGrowth = 3
   };
 
-  static const intptr_t kAllocatablePageSize = 64 * KB;
-
   uword TryAllocateInternal(intptr_t size,
                             HeapPage::PageType type,
                             GrowthPolicy growth_policy,
@@ -366,12 +518,29 @@ class PageSpace {
   uword TryAllocateDataBumpInternal(intptr_t size,
                                     GrowthPolicy growth_policy,
                                     bool is_locked);
+  // Sweeps up to 'max_pages' unswept pages, or all of them if negative, until
+  // 'size' bytes can be allocated from the data freelist.
+  uword TryAllocateSwept(intptr_t size, intptr_t max_pages, bool is_locked);
+  uword TryAllocateSweptLocked(intptr_t size, intptr_t max_pages);
+  void SweepNextPageLocked();
   // Makes bump block walkable; do not call concurrently with mutator.
   void MakeIterable() const;
   // Return any bump allocation block to the freelist.
   void AbandonBumpAllocation();
+  void RecordAllocation(uword addr);
   HeapPage* AllocatePage(HeapPage::PageType type);
   void FreePage(HeapPage* page, HeapPage* previous_page);
+  // Empty data pages are kept for reuse, up to --old_gen_retained_free_pages,
+  // after returning their memory to the OS.
+  bool RetainFreePage(HeapPage* page);
+  HeapPage* TakeRetainedPage();
+  void ReleaseRetainedPages();
+  // Empty data pages of large objects are kept for reuse by large objects of
+  // similar size, up to --old_gen_retained_large_pages MB, in lists by size
+  // class.
+  static intptr_t LargePageSizeClass(intptr_t page_size_in_words);
+  bool RetainFreeLargePage(HeapPage* page);
+  HeapPage* TakeRetainedLargePage(intptr_t page_size_in_words);
   HeapPage* AllocateLargePage(intptr_t size, HeapPage::PageType type);
   void TruncateLargePage(HeapPage* page, intptr_t new_object_size_in_bytes);
   void FreeLargePage(HeapPage* page, HeapPage* previous_page);
@@ -407,12 +576,27 @@ class PageSpace {
   HeapPage* exec_pages_;
   HeapPage* exec_pages_tail_;
   HeapPage* large_pages_;
+  // Empty data pages whose memory was returned to the OS.
+  HeapPage* retained_pages_;
+  intptr_t retained_pages_count_;
+  intptr_t retained_pages_limit_;
+  intptr_t released_in_bytes_;
+  // Empty large data pages, by the size class of their memory.
+  static const intptr_t kNumLargePageSizeClasses = 8;
+  HeapPage* retained_large_pages_[kNumLargePageSizeClasses];
+  intptr_t retained_large_in_words_;
 
   // A block of memory in a data page, managed by bump allocation. The remainder
   // is kept formatted as a FreeListElement, but is not in any freelist.
   uword bump_top_;
   uword bump_end_;
 
+  // The data pages from unswept_ to unswept_last_ are left to a lazy sweep.
+  // unswept_prev_ is the page before unswept_, or NULL.
+  HeapPage* unswept_;
+  HeapPage* unswept_prev_;
+  HeapPage* unswept_last_;
+
   // Various sizes being tracked for this generation.
   intptr_t max_capacity_in_words_;
   intptr_t max_external_in_words_;
@@ -426,12 +610,17 @@ class PageSpace {
 
   PageSpaceController page_space_controller_;
 
+  // Non-NULL while incremental marking is in progress.
+  GCMarker* marker_;
+  intptr_t used_at_last_step_in_words_;
+
   int64_t gc_time_micros_;
   intptr_t collections_;
 
   friend class ExclusivePageIterator;
   friend class ExclusiveCodePageIterator;
   friend class ExclusiveLargePageIterator;
+  friend class GCCompactor;
   friend class PageSpaceController;
   friend class SweeperTask;
 
@@ -5,6 +5,7 @@
 #include "vm/port.h"
 
 #include "platform/utils.h"
+#include "vm/atomic.h"
 #include "vm/dart_api_impl.h"
 #include "vm/isolate.h"
 #include "vm/lockers.h"
@@ -15,16 +16,23 @@ namespace dart {
 
 DECLARE_FLAG(bool, trace_isolates);
 
-Mutex* PortMap::mutex_ = NULL;
-PortMap::Entry* PortMap::map_ = NULL;
+PortMap::Shard* PortMap::shards_ = NULL;
+uintptr_t PortMap::next_shard_ = 0;
 MessageHandler* PortMap::deleted_entry_ = reinterpret_cast<MessageHandler*>(1);
-intptr_t PortMap::capacity_ = 0;
-intptr_t PortMap::used_ = 0;
-intptr_t PortMap::deleted_ = 0;
-Random* PortMap::prng_ = NULL;
 
 
-intptr_t PortMap::FindPort(Dart_Port port) {
+PortMap::Shard* PortMap::ShardOf(Dart_Port port) {
+  return &shards_[port & (kNumShards - 1)];
+}
+
+
+intptr_t PortMap::HashIndex(Dart_Port port, intptr_t capacity) {
+  // The low bits of the ports in a shard are all the same.
+  return (static_cast<uint64_t>(port) >> kShardBits) % capacity;
+}
+
+
+intptr_t PortMap::FindPort(Shard* shard, Dart_Port port) {
   // ILLEGAL_PORT (0) is used as a sentinel value in Entry.port. The loop below
   // could return the index to a deleted port when we are searching for
   // port id ILLEGAL_PORT. Return -1 immediately to indicate the port
@@ -33,41 +41,43 @@ intptr_t PortMap::FindPort(Dart_Port port) {
     return -1;
   }
   ASSERT(port != ILLEGAL_PORT);
-  intptr_t index = port % capacity_;
+  ASSERT(shard == ShardOf(port));
+  const intptr_t capacity = shard->capacity;
+  intptr_t index = HashIndex(port, capacity);
   intptr_t start_index = index;
-  Entry entry = map_[index];
+  Entry entry = shard->map[index];
   while (entry.handler != NULL) {
     if (entry.port == port) {
       return index;
     }
-    index = (index + 1) % capacity_;
+    index = (index + 1) % capacity;
     // Prevent endless loops.
     ASSERT(index != start_index);
-    entry = map_[index];
+    entry = shard->map[index];
   }
   return -1;
 }
 
 
-void PortMap::Rehash(intptr_t new_capacity) {
+void PortMap::Rehash(Shard* shard, intptr_t new_capacity) {
   Entry* new_ports = new Entry[new_capacity];
   memset(new_ports, 0, new_capacity * sizeof(Entry));
 
-  for (intptr_t i = 0; i < capacity_; i++) {
-    Entry entry = map_[i];
+  for (intptr_t i = 0; i < shard->capacity; i++) {
+    Entry entry = shard->map[i];
     // Skip free and deleted entries.
     if (entry.port != 0) {
-      intptr_t new_index = entry.port % new_capacity;
+      intptr_t new_index = HashIndex(entry.port, new_capacity);
       while (new_ports[new_index].port != 0) {
         new_index = (new_index + 1) % new_capacity;
       }
       new_ports[new_index] = entry;
     }
   }
-  delete[] map_;
-  map_ = new_ports;
-  capacity_ = new_capacity;
-  deleted_ = 0;
+  delete[] shard->map;
+  shard->map = new_ports;
+  shard->capacity = new_capacity;
+  shard->deleted = 0;
 }
 
 
@@ -86,93 +96,103 @@ const char* PortMap::PortStateString(PortState kind) {
 }
 
 
-Dart_Port PortMap::AllocatePort() {
+Dart_Port PortMap::AllocatePort(Shard* shard) {
   const Dart_Port kMASK = 0x3fffffff;
-  Dart_Port result = prng_->NextUInt32() & kMASK;
+  const Dart_Port kShardMask = kNumShards - 1;
+  const Dart_Port shard_bits = shard - shards_;
+  Dart_Port result =
+      (shard->prng->NextUInt32() & kMASK & ~kShardMask) | shard_bits;
 
   // Keep getting new values while we have an illegal port number or the port
   // number is already in use.
-  while ((result == 0) || (FindPort(result) >= 0)) {
-    result = prng_->NextUInt32() & kMASK;
+  while ((result == 0) || (FindPort(shard, result) >= 0)) {
+    result = (shard->prng->NextUInt32() & kMASK & ~kShardMask) | shard_bits;
   }
 
   ASSERT(result != 0);
-  ASSERT(FindPort(result) < 0);
+  ASSERT(FindPort(shard, result) < 0);
   return result;
 }
 
 
 void PortMap::SetPortState(Dart_Port port, PortState state) {
-  MutexLocker ml(mutex_);
-  intptr_t index = FindPort(port);
+  Shard* shard = ShardOf(port);
+  MutexLocker ml(shard->mutex);
+  intptr_t index = FindPort(shard, port);
   ASSERT(index >= 0);
-  PortState old_state = map_[index].state;
+  Entry* map = shard->map;
+  PortState old_state = map[index].state;
   ASSERT(old_state == kNewPort);
-  map_[index].state = state;
+  map[index].state = state;
   if (state == kLivePort) {
-    map_[index].handler->increment_live_ports();
+    map[index].handler->increment_live_ports();
   }
   if (FLAG_trace_isolates) {
     OS::Print("[^] Port (%s) -> (%s): \n"
               "\thandler:    %s\n"
               "\tport:       %" Pd64 "\n",
               PortStateString(old_state), PortStateString(state),
-              map_[index].handler->name(), port);
+              map[index].handler->name(), port);
   }
 }
 
 
-void PortMap::MaintainInvariants() {
-  intptr_t empty = capacity_ - used_ - deleted_;
-  if (used_ > ((capacity_ / 4) * 3)) {
-    // Grow the port map.
-    Rehash(capacity_ * 2);
-  } else if (empty < deleted_) {
+void PortMap::MaintainInvariants(Shard* shard) {
+  intptr_t capacity = shard->capacity;
+  intptr_t empty = capacity - shard->used - shard->deleted;
+  if (shard->used > ((capacity / 4) * 3)) {
+    // Grow the shard.
+    Rehash(shard, capacity * 2);
+  } else if (empty < shard->deleted) {
     // Rehash without growing the table to flush the deleted slots out of the
-    // map.
-    Rehash(capacity_);
+    // shard.
+    Rehash(shard, capacity);
   }
 }
 
 
 Dart_Port PortMap::CreatePort(MessageHandler* handler) {
   ASSERT(handler != NULL);
-  MutexLocker ml(mutex_);
+  Shard* shard =
+      &shards_[AtomicOperations::FetchAndIncrement(&next_shard_) % kNumShards];
+  MutexLocker ml(shard->mutex);
 #if defined(DEBUG)
   handler->CheckAccess();
 #endif
 
   Entry entry;
-  entry.port = AllocatePort();
+  entry.port = AllocatePort(shard);
   entry.handler = handler;
   entry.state = kNewPort;
 
   // Search for the first unused slot. Make use of the knowledge that here is
   // currently no port with this id in the port map.
-  ASSERT(FindPort(entry.port) < 0);
-  intptr_t index = entry.port % capacity_;
-  Entry cur = map_[index];
+  ASSERT(FindPort(shard, entry.port) < 0);
+  const intptr_t capacity = shard->capacity;
+  Entry* map = shard->map;
+  intptr_t index = HashIndex(entry.port, capacity);
+  Entry cur = map[index];
   // Stop the search at the first found unused (free or deleted) slot.
   while (cur.port != 0) {
-    index = (index + 1) % capacity_;
-    cur = map_[index];
+    index = (index + 1) % capacity;
+    cur = map[index];
   }
 
   // Insert the newly created port at the index.
   ASSERT(index >= 0);
-  ASSERT(index < capacity_);
-  ASSERT(map_[index].port == 0);
-  ASSERT((map_[index].handler == NULL) ||
-         (map_[index].handler == deleted_entry_));
-  if (map_[index].handler == deleted_entry_) {
+  ASSERT(index < capacity);
+  ASSERT(map[index].port == 0);
+  ASSERT((map[index].handler == NULL) ||
+         (map[index].handler == deleted_entry_));
+  if (map[index].handler == deleted_entry_) {
     // Consuming a deleted entry.
-    deleted_--;
+    shard->deleted--;
   }
-  map_[index] = entry;
+  map[index] = entry;
 
   // Increment number of used slots and grow if necessary.
-  used_++;
-  MaintainInvariants();
+  shard->used++;
+  MaintainInvariants(shard);
 
   if (FLAG_trace_isolates) {
     OS::Print("[+] Opening port: \n"
@@ -188,32 +208,34 @@ Dart_Port PortMap::CreatePort(MessageHandler* handler) {
 bool PortMap::ClosePort(Dart_Port port) {
   MessageHandler* handler = NULL;
   {
-    MutexLocker ml(mutex_);
-    intptr_t index = FindPort(port);
+    Shard* shard = ShardOf(port);
+    MutexLocker ml(shard->mutex);
+    intptr_t index = FindPort(shard, port);
     if (index < 0) {
       return false;
     }
-    ASSERT(index < capacity_);
-    ASSERT(map_[index].port != 0);
-    ASSERT(map_[index].handler != deleted_entry_);
-    ASSERT(map_[index].handler != NULL);
+    Entry* map = shard->map;
+    ASSERT(index < shard->capacity);
+    ASSERT(map[index].port != 0);
+    ASSERT(map[index].handler != deleted_entry_);
+    ASSERT(map[index].handler != NULL);
 
-    handler = map_[index].handler;
+    handler = map[index].handler;
 #if defined(DEBUG)
     handler->CheckAccess();
 #endif
     // Before releasing the lock mark the slot in the map as deleted. This makes
     // it possible to release the port map lock before flushing all of its
     // pending messages below.
-    map_[index].port = 0;
-    map_[index].handler = deleted_entry_;
-    if (map_[index].state == kLivePort) {
+    map[index].port = 0;
+    map[index].handler = deleted_entry_;
+    if (map[index].state == kLivePort) {
       handler->decrement_live_ports();
     }
 
-    used_--;
-    deleted_++;
-    MaintainInvariants();
+    shard->used--;
+    shard->deleted++;
+    MaintainInvariants(shard);
   }
   handler->ClosePort(port);
   if (!handler->HasLivePorts() && handler->OwnedByPortMap()) {
@@ -224,37 +246,45 @@ bool PortMap::ClosePort(Dart_Port port) {
 
 
 void PortMap::ClosePorts(MessageHandler* handler) {
-  {
-    MutexLocker ml(mutex_);
-    for (intptr_t i = 0; i < capacity_; i++) {
-      if (map_[i].handler == handler) {
+  // Visiting every shard also waits for any message being posted to the
+  // handler under a shard's lock.
+  for (intptr_t s = 0; s < kNumShards; s++) {
+    Shard* shard = &shards_[s];
+    MutexLocker ml(shard->mutex);
+    Entry* map = shard->map;
+    for (intptr_t i = 0; i < shard->capacity; i++) {
+      if (map[i].handler == handler) {
         // Mark the slot as deleted.
-        map_[i].port = 0;
-        map_[i].handler = deleted_entry_;
-        if (map_[i].state == kLivePort) {
+        map[i].port = 0;
+        map[i].handler = deleted_entry_;
+        if (map[i].state == kLivePort) {
           handler->decrement_live_ports();
         }
-        used_--;
-        deleted_++;
+        shard->used--;
+        shard->deleted++;
       }
     }
-    MaintainInvariants();
+    MaintainInvariants(shard);
   }
   handler->CloseAllPorts();
 }
 
 
 bool PortMap::PostMessage(Message* message) {
-  MutexLocker ml(mutex_);
-  intptr_t index = FindPort(message->dest_port());
+  const Dart_Port port = message->dest_port();
+  // Only the destination's shard is locked. Holding its lock keeps the
+  // handler from being closed and deleted while the message is posted.
+  Shard* shard = ShardOf(port);
+  MutexLocker ml(shard->mutex);
+  intptr_t index = FindPort(shard, port);
   if (index < 0) {
     delete message;
     return false;
   }
   ASSERT(index >= 0);
-  ASSERT(index < capacity_);
-  MessageHandler* handler = map_[index].handler;
-  ASSERT(map_[index].port != 0);
+  ASSERT(index < shard->capacity);
+  MessageHandler* handler = shard->map[index].handler;
+  ASSERT(shard->map[index].port != 0);
   ASSERT((handler != NULL) && (handler != deleted_entry_));
   handler->PostMessage(message);
   return true;
@@ -262,43 +292,48 @@ bool PortMap::PostMessage(Message* message) {
 
 
 bool PortMap::IsLocalPort(Dart_Port id) {
-  MutexLocker ml(mutex_);
-  intptr_t index = FindPort(id);
+  Shard* shard = ShardOf(id);
+  MutexLocker ml(shard->mutex);
+  intptr_t index = FindPort(shard, id);
   if (index < 0) {
     // Port does not exist.
     return false;
   }
 
-  MessageHandler* handler = map_[index].handler;
+  MessageHandler* handler = shard->map[index].handler;
   return handler->IsCurrentIsolate();
 }
 
 
 Isolate* PortMap::GetIsolate(Dart_Port id) {
-  MutexLocker ml(mutex_);
-  intptr_t index = FindPort(id);
+  Shard* shard = ShardOf(id);
+  MutexLocker ml(shard->mutex);
+  intptr_t index = FindPort(shard, id);
   if (index < 0) {
     // Port does not exist.
     return NULL;
   }
 
-  MessageHandler* handler = map_[index].handler;
+  MessageHandler* handler = shard->map[index].handler;
   return handler->isolate();
 }
 
 
 void PortMap::InitOnce() {
-  mutex_ = new Mutex();
-  prng_ = new Random();
-
   static const intptr_t kInitialCapacity = 8;
   // TODO(iposva): Verify whether we want to keep exponentially growing.
   ASSERT(Utils::IsPowerOfTwo(kInitialCapacity));
-  map_ = new Entry[kInitialCapacity];
-  memset(map_, 0, kInitialCapacity * sizeof(Entry));
-  capacity_ = kInitialCapacity;
-  used_ = 0;
-  deleted_ = 0;
+  shards_ = new Shard[kNumShards];
+  for (intptr_t s = 0; s < kNumShards; s++) {
+    Shard* shard = &shards_[s];
+    shard->mutex = new Mutex();
+    shard->map = new Entry[kInitialCapacity];
+    memset(shard->map, 0, kInitialCapacity * sizeof(Entry));
+    shard->capacity = kInitialCapacity;
+    shard->used = 0;
+    shard->deleted = 0;
+    shard->prng = new Random();
+  }
 }
 
 }  // namespace dart
@@ -68,30 +68,38 @@ class PortMap: public AllStatic {
     PortState state;
   } Entry;
 
-  static const char* PortStateString(PortState state);
+  // The map is split into shards by the low bits of the port ids, each with
+  // its own lock and hashmap, so that operations on ports in different shards
+  // do not contend.
+  static const intptr_t kShardBits = 6;
+  static const intptr_t kNumShards = 1 << kShardBits;
 
-  // Allocate a new unique port.
-  static Dart_Port AllocatePort();
+  typedef struct {
+    Mutex* mutex;  // Protects all other fields of the shard.
+    Entry* map;
+    intptr_t capacity;
+    intptr_t used;
+    intptr_t deleted;
+    Random* prng;
+  } Shard;
 
-  static bool IsActivePort(Dart_Port id);
-  static bool IsLivePort(Dart_Port id);
+  static const char* PortStateString(PortState state);
 
-  static intptr_t FindPort(Dart_Port port);
-  static void Rehash(intptr_t new_capacity);
+  static Shard* ShardOf(Dart_Port port);
+  static intptr_t HashIndex(Dart_Port port, intptr_t capacity);
 
-  static void MaintainInvariants();
+  // Allocate a new unique port in 'shard'.
+  static Dart_Port AllocatePort(Shard* shard);
 
-  // Lock protecting access to the port map.
-  static Mutex* mutex_;
+  static intptr_t FindPort(Shard* shard, Dart_Port port);
+  static void Rehash(Shard* shard, intptr_t new_capacity);
 
-  // Hashmap of ports.
-  static Entry* map_;
-  static MessageHandler* deleted_entry_;
-  static intptr_t capacity_;
-  static intptr_t used_;
-  static intptr_t deleted_;
+  static void MaintainInvariants(Shard* shard);
 
-  static Random* prng_;
+  static Shard* shards_;
+  // Round-robin counter for spreading new ports over the shards.
+  static uintptr_t next_shard_;
+  static MessageHandler* deleted_entry_;
 };
 
 }  // namespace dart
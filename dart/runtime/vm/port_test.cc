@@ -15,17 +15,19 @@ namespace dart {
 class PortMapTestPeer {
  public:
   static bool IsActivePort(Dart_Port port) {
-    MutexLocker ml(PortMap::mutex_);
-    return (PortMap::FindPort(port) >= 0);
+    PortMap::Shard* shard = PortMap::ShardOf(port);
+    MutexLocker ml(shard->mutex);
+    return (PortMap::FindPort(shard, port) >= 0);
   }
 
   static bool IsLivePort(Dart_Port port) {
-    MutexLocker ml(PortMap::mutex_);
-    intptr_t index = PortMap::FindPort(port);
+    PortMap::Shard* shard = PortMap::ShardOf(port);
+    MutexLocker ml(shard->mutex);
+    intptr_t index = PortMap::FindPort(shard, port);
     if (index < 0) {
       return false;
     }
-    return PortMap::map_[index].state == PortMap::kLivePort;
+    return shard->map[index].state == PortMap::kLivePort;
   }
 };
 
@@ -100,6 +102,26 @@ TEST_CASE(PortMap_CreateManyPorts) {
 }
 
 
+TEST_CASE(PortMap_ClosePortsInAllShards) {
+  // Enough ports to be spread over all shards and to grow them.
+  const intptr_t kNumPorts = 1000;
+  PortTestMessageHandler handler;
+  Dart_Port* ports = new Dart_Port[kNumPorts];
+  for (intptr_t i = 0; i < kNumPorts; i++) {
+    ports[i] = PortMap::CreatePort(&handler);
+    EXPECT_NE(0, ports[i]);
+  }
+  for (intptr_t i = 0; i < kNumPorts; i++) {
+    EXPECT(PortMapTestPeer::IsActivePort(ports[i]));
+  }
+  PortMap::ClosePorts(&handler);
+  for (intptr_t i = 0; i < kNumPorts; i++) {
+    EXPECT(!PortMapTestPeer::IsActivePort(ports[i]));
+  }
+  delete[] ports;
+}
+
+
 TEST_CASE(PortMap_SetPortState) {
   PortTestMessageHandler handler;
 
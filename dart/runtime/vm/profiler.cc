@@ -35,6 +35,9 @@ DEFINE_FLAG(int, profile_period, 1000,
             "Time between profiler samples in microseconds. Minimum 50.");
 DEFINE_FLAG(int, profile_depth, 8,
             "Maximum number stack frames walked. Minimum 1. Maximum 255.");
+DEFINE_FLAG(int, profile_allocation_interval, 0,
+            "Record the stack of one allocation per this many KB allocated "
+            "(0 disables allocation sampling).");
 #if defined(PROFILE_NATIVE_CODE) || defined(USING_SIMULATOR)
 DEFINE_FLAG(bool, profile_vm, true,
             "Always collect native stack traces.");
@@ -1078,4 +1081,35 @@ void Profiler::RecordSampleInterruptCallback(
   }
 }
 
+
+void Profiler::RecordAllocationSample(Isolate* isolate,
+                                      intptr_t cid,
+                                      intptr_t size) {
+  ASSERT(isolate == Isolate::Current());
+  if (isolate->top_exit_frame_info() == 0) {
+    // Not called from Dart code, e.g., by the embedder.
+    return;
+  }
+  IsolateProfilerData* profiler_data = isolate->profiler_data();
+  if (profiler_data == NULL) {
+    // Profiler not initialized.
+    return;
+  }
+  SampleBuffer* sample_buffer = profiler_data->sample_buffer();
+  if (sample_buffer == NULL) {
+    // Profiler not initialized.
+    return;
+  }
+  Sample* sample = sample_buffer->ReserveSample();
+  sample->Init(isolate,
+               OS::GetCurrentTimeMicros(),
+               OSThread::GetCurrentThreadId());
+  sample->set_vm_tag(isolate->vm_tag());
+  sample->set_user_tag(isolate->user_tag());
+  sample->SetAllocation(cid, size);
+  // Allocating from the runtime or from a native called by Dart code.
+  ProfilerDartExitStackWalker stackWalker(isolate, sample);
+  stackWalker.walk();
+}
+
 }  // namespace dart
@@ -37,6 +37,13 @@ class Profiler : public AllStatic {
   static void BeginExecution(Isolate* isolate);
   static void EndExecution(Isolate* isolate);
 
+  // Records the Dart stack of an allocation of 'size' bytes of class 'cid',
+  // see --profile_allocation_interval. Must be called from the mutator
+  // thread of 'isolate'.
+  static void RecordAllocationSample(Isolate* isolate,
+                                     intptr_t cid,
+                                     intptr_t size);
+
   static SampleBuffer* sample_buffer() {
     return sample_buffer_;
   }
@@ -82,7 +89,8 @@ class IsolateProfilerData {
 
 class SampleVisitor : public ValueObject {
  public:
-  explicit SampleVisitor(Isolate* isolate) : isolate_(isolate), visited_(0) { }
+  explicit SampleVisitor(Isolate* isolate)
+      : isolate_(isolate), visited_(0), allocation_samples_(false) { }
   virtual ~SampleVisitor() {}
 
   virtual void VisitSample(Sample* sample) = 0;
@@ -99,9 +107,19 @@ class SampleVisitor : public ValueObject {
     return isolate_;
   }
 
+  // Whether allocation samples are visited instead of CPU samples.
+  bool allocation_samples() const {
+    return allocation_samples_;
+  }
+
+  void set_allocation_samples(bool allocation_samples) {
+    allocation_samples_ = allocation_samples;
+  }
+
  private:
   Isolate* isolate_;
   intptr_t visited_;
+  bool allocation_samples_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(SampleVisitor);
 };
@@ -163,6 +181,8 @@ class Sample {
     lr_ = 0;
     fp_ = 0;
     state_ = 0;
+    allocation_cid_ = 0;
+    allocation_size_ = 0;
     uword* pcs = GetPCArray();
     for (intptr_t i = 0; i < pcs_length_; i++) {
       pcs[i] = 0;
@@ -306,6 +326,25 @@ class Sample {
     state_ = TruncatedTraceBit::update(truncated_trace, state_);
   }
 
+  // Allocation samples record the class and size of the allocated object.
+  bool is_allocation_sample() const {
+    return AllocationSampleBit::decode(state_);
+  }
+
+  intptr_t allocation_cid() const {
+    return allocation_cid_;
+  }
+
+  intptr_t allocation_size() const {
+    return allocation_size_;
+  }
+
+  void SetAllocation(intptr_t cid, intptr_t size) {
+    state_ = AllocationSampleBit::update(true, state_);
+    allocation_cid_ = cid;
+    allocation_size_ = size;
+  }
+
   static void InitOnce();
 
   static intptr_t instance_size() {
@@ -329,6 +368,7 @@ class Sample {
     kExitFrameBit = 3,
     kMissingFrameInsertedBit = 4,
     kTruncatedTrace = 5,
+    kAllocationSampleBit = 6,
   };
   class ProcessedBit : public BitField<bool, kProcessedBit, 1> {};
   class LeafFrameIsDart : public BitField<bool, kLeafFrameIsDartBit, 1> {};
@@ -337,6 +377,8 @@ class Sample {
   class MissingFrameInsertedBit
     : public BitField<bool, kMissingFrameInsertedBit, 1> {};
   class TruncatedTraceBit : public BitField<bool, kTruncatedTrace, 1> {};
+  class AllocationSampleBit
+    : public BitField<bool, kAllocationSampleBit, 1> {};
 
   int64_t timestamp_;
   ThreadId tid_;
@@ -349,6 +391,8 @@ class Sample {
   uword fp_;
   uword lr_;
   uword state_;
+  intptr_t allocation_cid_;
+  intptr_t allocation_size_;
 
   /* There are a variable number of words that follow, the words hold the
    * sampled pc values. Access via GetPCArray() */
@@ -391,6 +435,10 @@ class SampleBuffer {
         // Another isolate.
         continue;
       }
+      if (sample->is_allocation_sample() != visitor->allocation_samples()) {
+        // Another kind of sample.
+        continue;
+      }
       if (sample->timestamp() == 0) {
         // Empty.
         continue;
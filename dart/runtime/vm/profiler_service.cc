@@ -14,6 +14,7 @@
 
 namespace dart {
 
+DECLARE_FLAG(int, profile_allocation_interval);
 DECLARE_FLAG(int, profile_depth);
 DECLARE_FLAG(int, profile_period);
 
@@ -2156,7 +2157,59 @@ class CodeRegionTrieBuilder : public SampleVisitor {
 };
 
 
+// Totals the allocation samples per class.
+class AllocationClassCounter : public SampleVisitor {
+ public:
+  explicit AllocationClassCounter(Isolate* isolate)
+      : SampleVisitor(isolate) {
+    set_allocation_samples(true);
+  }
+
+  void VisitSample(Sample* sample) {
+    const intptr_t cid = sample->allocation_cid();
+    while (samples_.length() <= cid) {
+      samples_.Add(0);
+      bytes_.Add(0);
+    }
+    samples_[cid]++;
+    bytes_[cid] += sample->allocation_size();
+  }
+
+  void PrintToJSONArray(JSONArray* classes) const {
+    ClassTable* class_table = isolate()->class_table();
+    Class& cls = Class::Handle(isolate());
+    for (intptr_t cid = 0; cid < samples_.length(); cid++) {
+      if ((samples_[cid] == 0) || !class_table->HasValidClassAt(cid)) {
+        continue;
+      }
+      cls = class_table->At(cid);
+      JSONObject entry(classes);
+      entry.AddProperty("class", cls);
+      entry.AddProperty("samples", samples_[cid]);
+      entry.AddProperty("sampledBytes", bytes_[cid]);
+    }
+  }
+
+ private:
+  GrowableArray<intptr_t> samples_;
+  GrowableArray<intptr_t> bytes_;
+};
+
+
 void ProfilerService::PrintJSON(JSONStream* stream, TagOrder tag_order) {
+  PrintJSONImpl(stream, tag_order, false);
+}
+
+
+void ProfilerService::PrintAllocationJSON(JSONStream* stream,
+                                          TagOrder tag_order) {
+  PrintJSONImpl(stream, tag_order, true);
+}
+
+
+void ProfilerService::PrintJSONImpl(JSONStream* stream,
+                                    TagOrder tag_order,
+                                    bool allocation_samples) {
   Isolate* isolate = Isolate::Current();
   // Disable profile interrupts while processing the buffer.
   Profiler::EndExecution(isolate);
@@ -2190,6 +2243,7 @@ void ProfilerService::PrintJSON(JSONStream* stream, TagOrder tag_order) {
         ScopeTimer sw("PreprocessSamples", FLAG_trace_profiler);
         // Preprocess samples.
         PreprocessVisitor preprocessor(isolate);
+        preprocessor.set_allocation_samples(allocation_samples);
         sample_buffer->VisitSamples(&preprocessor);
       }
 
@@ -2199,6 +2253,7 @@ void ProfilerService::PrintJSON(JSONStream* stream, TagOrder tag_order) {
                                      &dead_code_table,
                                      &tag_code_table,
                                      deoptimized_code);
+      builder.set_allocation_samples(allocation_samples);
       {
         ScopeTimer sw("CodeRegionTableBuilder", FLAG_trace_profiler);
         sample_buffer->VisitSamples(&builder);
@@ -2241,6 +2296,7 @@ void ProfilerService::PrintJSON(JSONStream* stream, TagOrder tag_order) {
                                               &dead_code_table,
                                               &tag_code_table);
       code_trie_builder.set_tag_order(tag_order);
+      code_trie_builder.set_allocation_samples(allocation_samples);
       {
         // Build CodeRegion trie.
         ScopeTimer sw("CodeRegionTrieBuilder", FLAG_trace_profiler);
@@ -2259,6 +2315,7 @@ void ProfilerService::PrintJSON(JSONStream* stream, TagOrder tag_order) {
                                                        &tag_code_table,
                                                        &function_table);
       function_trie_builder.set_tag_order(tag_order);
+      function_trie_builder.set_allocation_samples(allocation_samples);
       {
         // Build ProfileFunction trie.
         ScopeTimer sw("ProfileFunctionTrieBuilder",
@@ -2276,10 +2333,17 @@ void ProfilerService::PrintJSON(JSONStream* stream, TagOrder tag_order) {
         ScopeTimer sw("CpuProfileJSONStream", FLAG_trace_profiler);
         // Serialize to JSON.
         JSONObject obj(stream);
-        obj.AddProperty("type", "_CpuProfile");
-        obj.AddProperty("sampleCount", samples);
-        obj.AddProperty("samplePeriod",
-                        static_cast<intptr_t>(FLAG_profile_period));
+        if (allocation_samples) {
+          obj.AddProperty("type", "_AllocationSamples");
+          obj.AddProperty("sampleCount", samples);
+          obj.AddProperty("sampleInterval",
+                          FLAG_profile_allocation_interval * KB);
+        } else {
+          obj.AddProperty("type", "_CpuProfile");
+          obj.AddProperty("sampleCount", samples);
+          obj.AddProperty("samplePeriod",
+                          static_cast<intptr_t>(FLAG_profile_period));
+        }
         obj.AddProperty("stackDepth",
                         static_cast<intptr_t>(FLAG_profile_depth));
         obj.AddProperty("timeSpan",
@@ -2336,6 +2400,12 @@ void ProfilerService::PrintJSON(JSONStream* stream, TagOrder tag_order) {
             function->PrintToJSONArray(&functions);
           }
         }
+        if (allocation_samples) {
+          AllocationClassCounter class_counter(isolate);
+          sample_buffer->VisitSamples(&class_counter);
+          JSONArray classes(&obj, "classes");
+          class_counter.PrintToJSONArray(&classes);
+        }
       }
       // Update the isolates set of dead code.
       deoptimized_code->UpdateIsolate(isolate);
@@ -2362,6 +2432,9 @@ void ProfilerService::ClearSamples() {
 
   ClearProfileVisitor clear_profile(isolate);
   sample_buffer->VisitSamples(&clear_profile);
+  ClearProfileVisitor clear_allocation_profile(isolate);
+  clear_allocation_profile.set_allocation_samples(true);
+  sample_buffer->VisitSamples(&clear_allocation_profile);
 
   // Enable profile interrupts.
   Profiler::BeginExecution(isolate);
@@ -34,7 +34,18 @@ class ProfilerService : public AllStatic {
   static void PrintJSON(JSONStream* stream,
                         TagOrder tag_order);
 
+  // Prints the allocation samples, see --profile_allocation_interval, in the
+  // format of a CPU profile where the exclusive tries are rooted at the
+  // allocating code, followed by the sampled allocations per class.
+  static void PrintAllocationJSON(JSONStream* stream,
+                                  TagOrder tag_order);
+
   static void ClearSamples();
+
+ private:
+  static void PrintJSONImpl(JSONStream* stream,
+                            TagOrder tag_order,
+                            bool allocation_samples);
 };
 
 }  // namespace dart
@@ -8,10 +8,14 @@
 #include "vm/dart_api_state.h"
 #include "vm/globals.h"
 #include "vm/profiler.h"
+#include "vm/profiler_service.h"
 #include "vm/unit_test.h"
 
 namespace dart {
 
+DECLARE_FLAG(bool, profile);
+DECLARE_FLAG(int, profile_allocation_interval);
+
 class ProfileSampleBufferTestHelper {
  public:
   static intptr_t IterateCount(const Isolate* isolate,
@@ -88,4 +92,46 @@ TEST_CASE(ProfilerSampleBufferIterateTest) {
   delete sample_buffer;
 }
 
+
+TEST_CASE(ProfilerAllocationSamples) {
+  if (!FLAG_profile) {
+    return;
+  }
+  const char* kScriptChars =
+      "class Leaf {\n"
+      "  var x;\n"
+      "}\n"
+      "allocate() {\n"
+      "  var leaf;\n"
+      "  for (var i = 0; i < 100000; i++) {\n"
+      "    leaf = new Leaf();\n"
+      "  }\n"
+      "  return leaf;\n"
+      "}\n";
+  const intptr_t saved_interval = FLAG_profile_allocation_interval;
+  FLAG_profile_allocation_interval = 1;
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  EXPECT_VALID(lib);
+  ProfilerService::ClearSamples();
+  // The sampling limit of new space takes the interval into account after
+  // the next sample.
+  Isolate::Current()->heap()->CollectGarbage(Heap::kNew);
+  EXPECT_VALID(Dart_Invoke(lib, NewString("allocate"), 0, NULL));
+  {
+    JSONStream js;
+    ProfilerService::PrintAllocationJSON(&js, ProfilerService::kNoTags);
+    EXPECT_SUBSTRING("\"type\":\"_AllocationSamples\"", js.ToCString());
+    EXPECT_SUBSTRING("\"name\":\"Leaf\"", js.ToCString());
+    EXPECT_SUBSTRING("\"name\":\"allocate\"", js.ToCString());
+    EXPECT_NOTSUBSTRING("\"sampleCount\":0,", js.ToCString());
+  }
+  ProfilerService::ClearSamples();
+  {
+    JSONStream js;
+    ProfilerService::PrintAllocationJSON(&js, ProfilerService::kNoTags);
+    EXPECT_SUBSTRING("\"sampleCount\":0,", js.ToCString());
+  }
+  FLAG_profile_allocation_interval = saved_interval;
+}
+
 }  // namespace dart
@@ -7,8 +7,11 @@
 #include "vm/class_table.h"
 #include "vm/dart.h"
 #include "vm/freelist.h"
+#include "vm/gc_marker.h"
+#include "vm/heap.h"
 #include "vm/isolate.h"
 #include "vm/object.h"
+#include "vm/pages.h"
 #include "vm/visitor.h"
 
 
@@ -64,11 +67,11 @@ void RawObject::Validate(Isolate* isolate) const {
 }
 
 
-intptr_t RawObject::SizeFromClass() const {
+intptr_t RawObject::SizeFromClass(uword tags) const {
   // Only reasonable to be called on heap objects.
   ASSERT(IsHeapObject());
 
-  intptr_t class_id = GetClassId();
+  intptr_t class_id = ClassIdTag::decode(tags);
   intptr_t instance_size = 0;
   switch (class_id) {
     case kCodeCid: {
@@ -125,9 +128,9 @@ intptr_t RawObject::SizeFromClass() const {
     CLASS_LIST_TYPED_DATA(SIZE_FROM_CLASS) {
       const RawTypedData* raw_obj =
           reinterpret_cast<const RawTypedData*>(this);
-      intptr_t cid = raw_obj->GetClassId();
       intptr_t array_len = Smi::Value(raw_obj->ptr()->length_);
-      intptr_t lengthInBytes = array_len * TypedData::ElementSizeInBytes(cid);
+      intptr_t lengthInBytes =
+          array_len * TypedData::ElementSizeInBytes(class_id);
       instance_size = TypedData::InstanceSize(lengthInBytes);
       break;
     }
@@ -184,7 +187,7 @@ intptr_t RawObject::SizeFromClass() const {
       if (!class_table->IsValidIndex(class_id) ||
           !class_table->HasValidClassAt(class_id)) {
         FATAL2("Invalid class id: %" Pd " from tags %" Px "\n",
-               class_id, ptr()->tags_);
+               class_id, tags);
       }
 #endif  // DEBUG
       RawClass* raw_class = class_table->At(class_id);
@@ -195,7 +198,6 @@ intptr_t RawObject::SizeFromClass() const {
   }
   ASSERT(instance_size != 0);
 #if defined(DEBUG)
-  uword tags = ptr()->tags_;
   intptr_t tags_size = SizeTag::decode(tags);
   if ((class_id == kArrayCid) && (instance_size > tags_size && tags_size > 0)) {
     // TODO(22501): Array::MakeArray could be in the process of shrinking
@@ -218,6 +220,23 @@ intptr_t RawObject::SizeFromClass() const {
 }
 
 
+void RawObject::RememberCard(RawObject* const* slot) {
+  HeapPage::OfLargeObject(this)->RememberCard(slot);
+}
+
+
+void RawObject::MarkingBarrier(RawObject* value) {
+  Heap* heap = Isolate::Current()->heap();
+  if (heap == NULL) {
+    return;
+  }
+  GCMarker* marker = heap->old_space()->incremental_marker();
+  if (marker != NULL) {
+    marker->MarkIncremental(value);
+  }
+}
+
+
 #if defined(DEBUG)
 void RawObject::ValidateOverwrittenPointer(RawObject* raw) {
   if (FLAG_validate_overwrite) {
@@ -7,6 +7,7 @@
 
 #include "platform/assert.h"
 #include "vm/atomic.h"
+#include "vm/flags.h"
 #include "vm/globals.h"
 #include "vm/snapshot.h"
 #include "vm/token.h"
@@ -14,6 +15,8 @@
 
 namespace dart {
 
+DECLARE_FLAG(bool, incremental_marking);
+
 // Macrobatics to define the Object hierarchy of VM implementation classes.
 #define CLASS_LIST_NO_OBJECT_NOR_STRING_NOR_ARRAY(V)                           \
   V(Class)                                                                     \
@@ -224,6 +227,12 @@ CLASS_LIST_TYPED_DATA(V)
     SNAPSHOT_WRITER_SUPPORT()                                                  \
     HEAP_PROFILER_SUPPORT()                                                    \
 
+#if defined(ARCH_IS_64_BIT)
+// The identity hash code of an object is kept in the upper half of its header
+// rather than in the kHashes weak table of the heap.
+#define HASH_IN_OBJECT_HEADER 1
+#endif
+
 // RawObject is the base class of all raw objects, even though it carries the
 // class_ field not all raw objects are allocated in the heap and thus cannot
 // be dereferenced (e.g. RawSmi).
@@ -237,12 +246,17 @@ class RawObject {
     kCanonicalBit = 2,
     kFromSnapshotBit = 3,
     kRememberedBit = 4,
-    kReservedTagPos = 5,  // kReservedBit{10K,100K,1M,10M}
-    kReservedTagSize = 3,
+    kCardRememberedBit = 5,
+    kReservedTagPos = 6,  // kReservedBit{1M,10M}
+    kReservedTagSize = 2,
     kSizeTagPos = kReservedTagPos + kReservedTagSize,  // = 8
     kSizeTagSize = 8,
     kClassIdTagPos = kSizeTagPos + kSizeTagSize,  // = 16
     kClassIdTagSize = 16,
+#if defined(HASH_IN_OBJECT_HEADER)
+    kHashTagPos = kClassIdTagPos + kClassIdTagSize,  // = 32
+    kHashTagSize = 32,
+#endif
   };
 
   // Encodes the object size in the tag in units of object alignment.
@@ -328,11 +342,45 @@ class RawObject {
     uword tags = ptr()->tags_;
     ptr()->tags_ = MarkBit::update(true, tags);
   }
+  // Atomically sets the mark bit. Returns false if it was already set, e.g.,
+  // by another marking thread.
+  bool TryAcquireMarkBit() {
+    uword tags = ptr()->tags_;
+    uword old_tags;
+    do {
+      old_tags = tags;
+      if (MarkBit::decode(old_tags)) {
+        return false;
+      }
+      uword new_tags = MarkBit::update(true, old_tags);
+      tags = AtomicOperations::CompareAndSwapWord(
+          &ptr()->tags_, old_tags, new_tags);
+    } while (tags != old_tags);
+    return true;
+  }
   void ClearMarkBit() {
     ASSERT(IsMarked());
     UpdateTagBit<MarkBit>(false);
   }
 
+#if defined(HASH_IN_OBJECT_HEADER)
+  // The identity hash code of the object, 0 if none was assigned yet.
+  uint32_t GetHeaderHash() const {
+    return HashTag::decode(ptr()->tags_);
+  }
+  void SetHeaderHash(uint32_t hash) {
+    // Other tag bits may be updated concurrently, e.g. by the marker.
+    uword tags = ptr()->tags_;
+    uword old_tags;
+    do {
+      old_tags = tags;
+      uword new_tags = HashTag::update(hash, old_tags);
+      tags = AtomicOperations::CompareAndSwapWord(
+          &ptr()->tags_, old_tags, new_tags);
+    } while (tags != old_tags);
+  }
+#endif
+
   // Support for GC watched bit.
   // TODO(iposva): Get rid of this.
   bool IsWatched() const {
@@ -383,6 +431,19 @@ class RawObject {
     ptr()->tags_ = RememberedBit::update(false, tags);
   }
 
+  // Support for card marking. Stores into a card remembered object also mark
+  // the card of the updated slot, so that only the marked cards are visited
+  // when the object is found in the store buffer.
+  bool IsCardRemembered() const {
+    return CardRememberedBit::decode(ptr()->tags_);
+  }
+  void SetCardRememberedBitUnsynchronized() {
+    ASSERT(!IsCardRemembered());
+    uword tags = ptr()->tags_;
+    ptr()->tags_ = CardRememberedBit::update(true, tags);
+  }
+  void RememberCard(RawObject* const* slot);
+
   bool IsDartInstance() {
     return (!IsHeapObject() || (GetClassId() >= kInstanceCid));
   }
@@ -391,13 +452,19 @@ class RawObject {
   }
 
   intptr_t Size() const {
-    uword tags = ptr()->tags_;
+    return SizeFromTags(ptr()->tags_);
+  }
+
+  // Computes the size of this object from a header word loaded earlier by the
+  // caller, without reading the header again. Used by collectors where other
+  // threads may concurrently install a forwarding pointer in the header.
+  intptr_t SizeFromTags(uword tags) const {
     intptr_t result = SizeTag::decode(tags);
     if (result != 0) {
-      ASSERT(result == SizeFromClass());
+      ASSERT(result == SizeFromClass(tags));
       return result;
     }
-    result = SizeFromClass();
+    result = SizeFromClass(tags);
     ASSERT(result > SizeTag::kMaxSizeTag);
     return result;
   }
@@ -457,6 +524,8 @@ class RawObject {
 
   class RememberedBit : public BitField<bool, kRememberedBit, 1> {};
 
+  class CardRememberedBit : public BitField<bool, kCardRememberedBit, 1> {};
+
   class CanonicalObjectTag : public BitField<bool, kCanonicalBit, 1> {};
 
   class CreatedFromSnapshotTag : public BitField<bool, kFromSnapshotBit, 1> {};
@@ -464,6 +533,10 @@ class RawObject {
   class ReservedBits : public
       BitField<intptr_t, kReservedTagPos, kReservedTagSize> {};  // NOLINT
 
+#if defined(HASH_IN_OBJECT_HEADER)
+  class HashTag : public BitField<uint32_t, kHashTagPos, kHashTagSize> {};
+#endif
+
   // TODO(koda): After handling tags_, return const*, like Object::raw_ptr().
   RawObject* ptr() const {
     ASSERT(IsHeapObject());
@@ -471,7 +544,10 @@ class RawObject {
         reinterpret_cast<uword>(this) - kHeapObjectTag);
   }
 
-  intptr_t SizeFromClass() const;
+  intptr_t SizeFromClass() const {
+    return SizeFromClass(ptr()->tags_);
+  }
+  intptr_t SizeFromClass(uword tags) const;
 
   intptr_t GetClassId() const {
     uword tags = ptr()->tags_;
@@ -502,10 +578,17 @@ class RawObject {
     VerifiedMemory::Write(const_cast<type*>(addr), value);
     // Filter stores based on source and target.
     if (!value->IsHeapObject()) return;
-    if (value->IsNewObject() && this->IsOldObject() &&
-        !this->IsRemembered()) {
-      this->SetRememberedBit();
-      Isolate::Current()->store_buffer()->AddObject(this);
+    if (value->IsNewObject() && this->IsOldObject()) {
+      if (this->IsCardRemembered()) {
+        RememberCard(reinterpret_cast<RawObject* const*>(addr));
+      }
+      if (!this->IsRemembered()) {
+        this->SetRememberedBit();
+        Isolate::Current()->store_buffer()->AddObject(this);
+      }
+    } else if (FLAG_incremental_marking && value->IsOldObject() &&
+               !value->IsMarked() && this->IsOldObject()) {
+      MarkingBarrier(value);
     }
   }
 
@@ -528,6 +611,9 @@ class RawObject {
     VerifiedMemory::Write(const_cast<RawSmi**>(addr), value);
   }
 
+  // Shades 'value' if the current isolate is marking incrementally.
+  static void MarkingBarrier(RawObject* value);
+
 #if defined(DEBUG)
   static void ValidateOverwrittenPointer(RawObject* raw);
   static void ValidateOverwrittenSmi(RawSmi* raw);
@@ -545,8 +631,10 @@ class RawObject {
   friend class ForwardList;
   friend class GrowableObjectArray;  // StorePointer
   friend class Heap;
+  friend class HeapPage;  // GetClassId
   friend class HeapMapAsJSONVisitor;
   friend class ClassStatsVisitor;
+  friend class IsolateTemplate;  // GetClassId
   friend class MarkingVisitor;
   friend class Object;
   friend class OneByteString;  // StoreSmi
@@ -554,6 +642,7 @@ class RawObject {
   friend class RawInstructions;
   friend class RawInstance;
   friend class RawTypedData;
+  friend class ParallelScavengerVisitor;
   friend class Scavenger;
   friend class ScavengerVisitor;
   friend class SizeExcludingClassVisitor;  // GetClassId
@@ -1591,6 +1680,7 @@ class RawOneByteString : public RawString {
   const uint8_t* data() const { OPEN_ARRAY_START(uint8_t, uint8_t); }
 
   friend class ApiMessageReader;
+  friend class ApiMessageStreamReader;
   friend class SnapshotReader;
 };
 
@@ -1686,6 +1776,7 @@ class RawArray : public RawInstance {
   friend class Object;
   friend class ICData;  // For high performance access.
   friend class SubtypeTestCache;  // For high performance access.
+  friend class HeapPage;  // For card marking.
 };
 
 
@@ -1902,6 +1993,7 @@ class RawWeakProperty : public RawInstance {
 
   friend class GCMarker;
   friend class MarkingVisitor;
+  friend class ParallelScavengerVisitor;
   friend class Scavenger;
   friend class ScavengerVisitor;
 };
@@ -5,17 +5,23 @@
 #include "vm/scavenger.h"
 
 #include <algorithm>
-#include <map>
-#include <utility>
 
+#include "vm/allocation_site_table.h"
 #include "vm/dart.h"
 #include "vm/dart_api_state.h"
+#include "vm/ephemeron_table.h"
+#include "vm/freelist.h"
+#include "vm/gc_marker.h"
+#include "vm/growable_array.h"
 #include "vm/isolate.h"
 #include "vm/lockers.h"
 #include "vm/object.h"
 #include "vm/object_id_ring.h"
+#include "vm/page_pool.h"
 #include "vm/stack_frame.h"
 #include "vm/store_buffer.h"
+#include "vm/thread.h"
+#include "vm/thread_pool.h"
 #include "vm/verified_memory.h"
 #include "vm/verifier.h"
 #include "vm/visitor.h"
@@ -29,7 +35,16 @@ DEFINE_FLAG(int, early_tenuring_threshold, 66,
 DEFINE_FLAG(int, new_gen_garbage_threshold, 90,
             "Grow new gen when less than this percentage is garbage.");
 DEFINE_FLAG(int, new_gen_growth_factor, 4, "Grow new gen by this factor.");
+DEFINE_FLAG(int, scavenger_tasks, 0,
+            "Number of helper tasks used to scavenge in parallel with the "
+            "mutator thread (0 means scavenge serially).");
 DECLARE_FLAG(bool, concurrent_sweep);
+DECLARE_FLAG(int, gc_pause_goal);
+DECLARE_FLAG(int, gc_time_goal);
+DECLARE_FLAG(bool, log_growth);
+DECLARE_FLAG(int, pretenure_sample_interval);
+DECLARE_FLAG(int, profile_allocation_interval);
+DECLARE_FLAG(bool, lazy_sweep);
 
 // Scavenger uses RawObject::kMarkBit to distinguish forwaded and non-forwarded
 // objects. The kMarkBit does not intersect with the target address because of
@@ -61,6 +76,18 @@ static inline void ForwardTo(uword original, uword target) {
 }
 
 
+// Large arrays are promoted into their own large page, where stores into them
+// are remembered per card.
+static inline void PromotedLargeObject(uword addr,
+                                       intptr_t cid,
+                                       intptr_t size) {
+  if ((size >= PageSpace::kAllocatablePageSize) &&
+      ((cid == kArrayCid) || (cid == kImmutableArrayCid))) {
+    HeapPage::EnableCardMarking(RawObject::FromAddr(addr));
+  }
+}
+
+
 class BoolScope : public ValueObject {
  public:
   BoolScope(bool* addr, bool value) : _addr(addr), _value(*addr) {
@@ -97,7 +124,7 @@ class ScavengerVisitor : public ObjectPointerVisitor {
     }
   }
 
-  GrowableArray<RawObject*>* DelayedWeakStack() {
+  MallocGrowableArray<RawWeakProperty*>* DelayedWeakStack() {
     return &delayed_weak_stack_;
   }
 
@@ -108,20 +135,20 @@ class ScavengerVisitor : public ObjectPointerVisitor {
 
   void DelayWeakProperty(RawWeakProperty* raw_weak) {
     RawObject* raw_key = raw_weak->ptr()->key_;
-    DelaySet::iterator it = delay_set_.find(raw_key);
-    if (it != delay_set_.end()) {
-      ASSERT(raw_key->IsWatched());
-    } else {
+    if (ephemerons_.Add(raw_key, raw_weak)) {
       ASSERT(!raw_key->IsWatched());
       raw_key->SetWatchedBitUnsynchronized();
+    } else {
+      ASSERT(raw_key->IsWatched());
     }
-    delay_set_.insert(std::make_pair(raw_key, raw_weak));
   }
 
   void Finalize() {
-    DelaySet::iterator it = delay_set_.begin();
-    for (; it != delay_set_.end(); ++it) {
-      WeakProperty::Clear(it->second);
+    // The remaining keys were not reached.
+    MallocGrowableArray<RawWeakProperty*> unreachable;
+    ephemerons_.RemoveAll(NULL, &unreachable);
+    for (intptr_t i = 0; i < unreachable.length(); i++) {
+      WeakProperty::Clear(unreachable[i]);
     }
   }
 
@@ -135,7 +162,13 @@ class ScavengerVisitor : public ObjectPointerVisitor {
     ASSERT(!heap_->CodeContains(ptr));
     ASSERT(heap_->Contains(ptr));
     // If the newly written object is not a new object, drop it immediately.
-    if (!obj->IsNewObject() || visiting_old_object_->IsRemembered()) {
+    if (!obj->IsNewObject()) {
+      return;
+    }
+    if (visiting_old_object_->IsCardRemembered()) {
+      HeapPage::OfLargeObject(visiting_old_object_)->RememberCard(p);
+    }
+    if (visiting_old_object_->IsRemembered()) {
       return;
     }
     visiting_old_object_->SetRememberedBit();
@@ -176,21 +209,16 @@ class ScavengerVisitor : public ObjectPointerVisitor {
     } else {
       if (raw_obj->IsWatched()) {
         raw_obj->ClearWatchedBitUnsynchronized();
-        std::pair<DelaySet::iterator, DelaySet::iterator> ret;
-        // Visit all elements with a key equal to this raw_obj.
-        ret = delay_set_.equal_range(raw_obj);
-        for (DelaySet::iterator it = ret.first; it != ret.second; ++it) {
-          // Remember the delayed WeakProperty. These objects have been
-          // forwarded, but have not been scavenged because their key was not
-          // known to be reachable. Now that the key object is known to be
-          // reachable, we need to visit its key and value pointers.
-          delayed_weak_stack_.Add(it->second);
-        }
-        delay_set_.erase(ret.first, ret.second);
+        // Remember the WeakProperties delayed on this key. These objects have
+        // been forwarded, but have not been scavenged because their key was
+        // not known to be reachable. Now that the key object is known to be
+        // reachable, we need to visit their key and value pointers.
+        ephemerons_.Remove(raw_obj, &delayed_weak_stack_);
       }
       intptr_t size = raw_obj->Size();
       intptr_t cid = raw_obj->GetClassId();
       ClassTable* class_table = isolate()->class_table();
+      bool promoted = false;
       // Check whether object should be promoted.
       if (scavenger_->survivor_end_ <= raw_addr) {
         // Not a survivor of a previous scavenge. Just copy the object into the
@@ -210,6 +238,7 @@ class ScavengerVisitor : public ObjectPointerVisitor {
           // If promotion succeeded then we need to remember it so that it can
           // be traversed later.
           scavenger_->PushToPromotedStack(new_addr);
+          promoted = true;
           bytes_promoted_ += size;
           class_table->UpdateAllocatedOld(cid, size);
         } else {
@@ -226,6 +255,9 @@ class ScavengerVisitor : public ObjectPointerVisitor {
               reinterpret_cast<void*>(raw_addr),
               size);
       VerifiedMemory::Accept(new_addr, size);
+      if (promoted) {
+        PromotedLargeObject(new_addr, cid, size);
+      }
       // Remember forwarding address.
       ForwardTo(raw_addr, new_addr);
     }
@@ -245,9 +277,8 @@ class ScavengerVisitor : public ObjectPointerVisitor {
   Heap* heap_;
   Heap* vm_heap_;
   PageSpace* page_space_;
-  typedef std::multimap<RawObject*, RawWeakProperty*> DelaySet;
-  DelaySet delay_set_;
-  GrowableArray<RawObject*> delayed_weak_stack_;
+  EphemeronTable ephemerons_;
+  MallocGrowableArray<RawWeakProperty*> delayed_weak_stack_;
   // TODO(cshapiro): use this value to compute survival statistics for
   // new space growth policy.
   intptr_t bytes_promoted_;
@@ -258,6 +289,557 @@ class ScavengerVisitor : public ObjectPointerVisitor {
 };
 
 
+// A unit of work shared between the workers of a parallel scavenge.
+struct ScavengeWorkItem {
+  enum Kind {
+    kStoreBufferBlock,  // 'start' is a StoreBufferBlock to process.
+    kObjectIdRing,      // Visit the isolate's object id ring.
+    kToSpaceRange,      // Copied objects in [start, end) still to be scanned.
+    kPromotedObject,    // 'start' is a promoted object still to be scanned.
+  };
+
+  Kind kind;
+  uword start;
+  uword end;
+};
+
+
+// Work list shared by the workers of a parallel scavenge. Workers only turn to
+// the list once they have drained their local work. The scavenge terminates
+// when all workers are waiting for work at the same time.
+class ScavengerWorkList {
+ public:
+  explicit ScavengerWorkList(intptr_t num_workers)
+      : num_workers_(num_workers),
+        idle_workers_(0),
+        running_tasks_(0),
+        done_(false) { }
+
+  void Push(ScavengeWorkItem::Kind kind, uword start, uword end) {
+    MonitorLocker ml(&monitor_);
+    ASSERT(!done_);
+    ScavengeWorkItem item;
+    item.kind = kind;
+    item.start = start;
+    item.end = end;
+    items_.Add(item);
+    if (idle_workers_ > 0) {
+      ml.Notify();
+    }
+  }
+
+  // Blocks until work is available. Returns false once all work is done.
+  bool Pop(ScavengeWorkItem* item) {
+    MonitorLocker ml(&monitor_);
+    while (true) {
+      if (!items_.is_empty()) {
+        *item = items_.RemoveLast();
+        return true;
+      }
+      if (done_) {
+        return false;
+      }
+      idle_workers_++;
+      if (idle_workers_ == num_workers_) {
+        done_ = true;
+        ml.NotifyAll();
+        return false;
+      }
+      ml.Wait();
+      idle_workers_--;
+    }
+  }
+
+  // Racy hint used by busy workers to decide whether to split off work.
+  bool HasHungryWorkers() const {
+    return (idle_workers_ > 0) && items_.is_empty();
+  }
+
+  void TaskStarted() {
+    MonitorLocker ml(&monitor_);
+    running_tasks_++;
+  }
+
+  void TaskFinished() {
+    MonitorLocker ml(&monitor_);
+    running_tasks_--;
+    ml.NotifyAll();
+  }
+
+  void WaitForTasks() {
+    MonitorLocker ml(&monitor_);
+    while (running_tasks_ > 0) {
+      ml.Wait();
+    }
+  }
+
+ private:
+  Monitor monitor_;
+  MallocGrowableArray<ScavengeWorkItem> items_;
+  const intptr_t num_workers_;
+  intptr_t idle_workers_;
+  intptr_t running_tasks_;
+  bool done_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScavengerWorkList);
+};
+
+
+// Visitor run by each worker of a parallel scavenge. Objects are claimed by
+// installing the forwarding pointer with a compare-and-swap; a worker that
+// loses the race discards its copy. Copies go to worker-local buffers carved
+// out of the to space and the old space, so allocation needs no locking in the
+// common case. Results that are not thread-safe to publish (store buffer
+// entries, class statistics, delayed weak properties) are kept per worker and
+// merged by the mutator thread at the end.
+class ParallelScavengerVisitor : public ObjectPointerVisitor {
+ public:
+  // Objects larger than a fraction of a buffer are allocated individually.
+  static const intptr_t kCopyBufferSize = 32 * KB;
+  static const intptr_t kPromoBufferSize = 32 * KB;
+  static const intptr_t kMaxBufferedObjectSize = 4 * KB;
+
+  ParallelScavengerVisitor(Isolate* isolate,
+                           Scavenger* scavenger,
+                           ScavengerWorkList* work_list)
+      : ObjectPointerVisitor(isolate),
+        scavenger_(scavenger),
+        work_list_(work_list),
+        from_start_(scavenger->from_->start()),
+        from_size_(scavenger->from_->end() - scavenger->from_->start()),
+        survivor_end_(scavenger->survivor_end_),
+        heap_(scavenger->heap_),
+        page_space_(scavenger->heap_->old_space()),
+        copy_top_(0),
+        copy_end_(0),
+        scan_(0),
+        promo_top_(0),
+        promo_end_(0),
+        num_cids_(isolate->class_table()->NumCids()),
+        class_stats_(new AllocStats<intptr_t>[num_cids_]),
+        bytes_promoted_(0),
+        is_marking_(page_space_->IsMarking()),
+        visiting_old_object_(NULL) {
+    for (intptr_t i = 0; i < num_cids_; i++) {
+      class_stats_[i].Reset();
+    }
+  }
+
+  ~ParallelScavengerVisitor() {
+    delete[] class_stats_;
+  }
+
+  void VisitPointers(RawObject** first, RawObject** last) {
+    for (RawObject** current = first; current <= last; current++) {
+      ScavengePointer(current);
+    }
+  }
+
+  // Processes local and shared work until the scavenge is complete.
+  void ProcessWork() {
+    ScavengeWorkItem item;
+    do {
+      DrainLocalWork();
+    } while (work_list_->Pop(&item) && ProcessWorkItem(item));
+    RetireBuffers();
+  }
+
+  // Publishes the per-worker results. Called on the mutator thread after all
+  // workers are done.
+  void Finalize(ScavengerVisitor* visitor) {
+    StoreBuffer* store_buffer = heap_->isolate()->store_buffer();
+    for (intptr_t i = 0; i < remembered_.length(); i++) {
+      store_buffer->AddObjectGC(remembered_[i]);
+    }
+    if (is_marking_) {
+      GCMarker* marker = page_space_->incremental_marker();
+      for (intptr_t i = 0; i < shade_.length(); i++) {
+        marker->MarkIncremental(RawObject::FromAddr(shade_[i]));
+      }
+    }
+    ClassTable* class_table = heap_->isolate()->class_table();
+    for (intptr_t cid = 1; cid < num_cids_; cid++) {
+      const AllocStats<intptr_t>& stats = class_stats_[cid];
+      if ((stats.new_count == 0) && (stats.old_count == 0)) {
+        continue;
+      }
+      ClassHeapStats* class_stats = class_table->PreliminaryStatsAt(cid);
+      class_stats->post_gc.new_count += stats.new_count;
+      class_stats->post_gc.new_size += stats.new_size;
+      class_stats->recent.old_count += stats.old_count;
+      class_stats->recent.old_size += stats.old_size;
+    }
+    for (intptr_t i = 0; i < delayed_weak_.length(); i++) {
+      RawWeakProperty* raw_weak = delayed_weak_[i];
+      uword key_addr = RawObject::ToAddr(raw_weak->ptr()->key_);
+      if (IsForwarding(*reinterpret_cast<uword*>(key_addr))) {
+        // The key was reached after the weak property was scanned.
+        visitor->DelayedWeakStack()->Add(raw_weak);
+      } else {
+        visitor->DelayWeakProperty(raw_weak);
+      }
+    }
+  }
+
+  intptr_t bytes_promoted() const { return bytes_promoted_; }
+
+ private:
+  void DrainLocalWork() {
+    while (true) {
+      if (work_list_->HasHungryWorkers()) {
+        ShareWork();
+      }
+      if (scan_ < copy_top_) {
+        RawObject* raw_obj = RawObject::FromAddr(scan_);
+        // Advance first: visiting may retire the current copy buffer, which
+        // hands its unscanned part to the other workers.
+        scan_ += raw_obj->Size();
+        ScanToSpaceObject(raw_obj);
+      } else if (!promoted_.is_empty()) {
+        ScanPromotedObject(RawObject::FromAddr(promoted_.RemoveLast()));
+      } else {
+        return;
+      }
+    }
+  }
+
+  void ShareWork() {
+    if (scan_ < copy_top_) {
+      work_list_->Push(ScavengeWorkItem::kToSpaceRange, scan_, copy_top_);
+      scan_ = copy_top_;
+    }
+    intptr_t keep = promoted_.length() / 2;
+    while (promoted_.length() > keep) {
+      work_list_->Push(ScavengeWorkItem::kPromotedObject,
+                       promoted_.RemoveLast(), 0);
+    }
+  }
+
+  bool ProcessWorkItem(const ScavengeWorkItem& item) {
+    switch (item.kind) {
+      case ScavengeWorkItem::kStoreBufferBlock:
+        ProcessStoreBufferBlock(
+            reinterpret_cast<StoreBufferBlock*>(item.start));
+        break;
+      case ScavengeWorkItem::kObjectIdRing: {
+        ObjectIdRing* ring = heap_->isolate()->object_id_ring();
+        ASSERT(ring != NULL);
+        ring->VisitPointers(this);
+        break;
+      }
+      case ScavengeWorkItem::kToSpaceRange: {
+        uword current = item.start;
+        while (current < item.end) {
+          RawObject* raw_obj = RawObject::FromAddr(current);
+          current += raw_obj->Size();
+          ScanToSpaceObject(raw_obj);
+        }
+        ASSERT(current == item.end);
+        break;
+      }
+      case ScavengeWorkItem::kPromotedObject:
+        ScanPromotedObject(RawObject::FromAddr(item.start));
+        break;
+    }
+    return true;
+  }
+
+  void ProcessStoreBufferBlock(StoreBufferBlock* block) {
+    // Generated code appends to store buffers; tell MemorySanitizer.
+    MSAN_UNPOISON(block, sizeof(*block));
+    intptr_t count = block->Count();
+    for (intptr_t i = 0; i < count; i++) {
+      RawObject* raw_object = block->At(i);
+      ASSERT(raw_object->IsRemembered());
+      raw_object->ClearRememberedBit();
+      visiting_old_object_ = raw_object;
+      if (raw_object->IsCardRemembered()) {
+        HeapPage::OfLargeObject(raw_object)->VisitRememberedCards(this);
+      } else {
+        raw_object->VisitPointers(this);
+      }
+    }
+    visiting_old_object_ = NULL;
+    delete block;
+  }
+
+  void ScanToSpaceObject(RawObject* raw_obj) {
+    if (raw_obj->GetClassId() == kWeakPropertyCid) {
+      RawWeakProperty* raw_weak = reinterpret_cast<RawWeakProperty*>(raw_obj);
+      RawObject* raw_key = raw_weak->ptr()->key_;
+      if (raw_key->IsHeapObject() && raw_key->IsNewObject() &&
+          ((reinterpret_cast<uword>(raw_key) - from_start_) <= from_size_)) {
+        uword header = *reinterpret_cast<uword*>(RawObject::ToAddr(raw_key));
+        if (!IsForwarding(header)) {
+          // Key is white. Let the mutator thread decide after the parallel
+          // phase, when the watched bits can be used without races.
+          delayed_weak_.Add(raw_weak);
+          return;
+        }
+      }
+    }
+    raw_obj->VisitPointers(this);
+  }
+
+  void ScanPromotedObject(RawObject* raw_obj) {
+    ASSERT(!raw_obj->IsRemembered());
+    visiting_old_object_ = raw_obj;
+    raw_obj->VisitPointers(this);
+    visiting_old_object_ = NULL;
+  }
+
+  void UpdateStoreBuffer(RawObject** p, RawObject* obj) {
+    uword ptr = reinterpret_cast<uword>(p);
+    ASSERT(obj->IsHeapObject());
+    // Heap::Contains walks the page list under its lock and is not safe to
+    // call from a helper task; the page checks are left to the main visitor.
+    ASSERT(!scavenger_->Contains(ptr));
+    // If the newly written object is not a new object, drop it immediately.
+    // Each old object is visited by exactly one worker, so there is no race
+    // on its remembered bit or its cards.
+    if (!obj->IsNewObject()) {
+      return;
+    }
+    if (visiting_old_object_->IsCardRemembered()) {
+      HeapPage::OfLargeObject(visiting_old_object_)->RememberCard(p);
+    }
+    if (visiting_old_object_->IsRemembered()) {
+      return;
+    }
+    visiting_old_object_->SetRememberedBit();
+    remembered_.Add(visiting_old_object_);
+  }
+
+  void ScavengePointer(RawObject** p) {
+    RawObject* raw_obj = *p;
+
+    if (raw_obj->IsSmiOrOldObject()) {
+      return;
+    }
+
+    // See ScavengerVisitor::ScavengePointer.
+    uword obj_offset = reinterpret_cast<uword>(raw_obj) - from_start_;
+    if (obj_offset > from_size_) {
+      ASSERT(scavenger_->to_->Contains(RawObject::ToAddr(raw_obj)));
+      return;
+    }
+
+    uword raw_addr = RawObject::ToAddr(raw_obj);
+    uword header = *reinterpret_cast<volatile uword*>(raw_addr);
+    uword new_addr = IsForwarding(header) ?
+        ForwardedAddr(header) : CopyObject(raw_obj, header);
+    // Update the reference.
+    RawObject* new_obj = RawObject::FromAddr(new_addr);
+    *p = new_obj;
+    // Update the store buffer as needed.
+    if (visiting_old_object_ != NULL) {
+      VerifiedMemory::Accept(reinterpret_cast<uword>(p), sizeof(*p));
+      UpdateStoreBuffer(p, new_obj);
+    }
+  }
+
+  // Copies the object whose header word was read as 'header' and tries to
+  // install the forwarding pointer. Returns the address of the winning copy.
+  uword CopyObject(RawObject* raw_obj, uword header) {
+    uword raw_addr = RawObject::ToAddr(raw_obj);
+    // The header may be overwritten by a competing worker at any time, so
+    // only the value read before is used to size the object.
+    intptr_t size = raw_obj->SizeFromTags(header);
+    intptr_t cid = RawObject::ClassIdTag::decode(header);
+    bool promoted = false;
+    uword new_addr = 0;
+    if (survivor_end_ > raw_addr) {
+      // This object is a survivor of a previous scavenge. Attempt to promote
+      // the object.
+      new_addr = TryAllocatePromo(size);
+      promoted = (new_addr != 0);
+    }
+    if (new_addr == 0) {
+      new_addr = TryAllocateCopy(size);
+    }
+    if (new_addr == 0) {
+      // Buffer fragmentation can exhaust the to space; promote instead.
+      new_addr = TryAllocatePromo(size);
+      promoted = true;
+      if (new_addr == 0) {
+        FATAL("Out of memory.\n");
+      }
+    }
+    memmove(reinterpret_cast<void*>(new_addr),
+            reinterpret_cast<void*>(raw_addr),
+            size);
+    *reinterpret_cast<uword*>(new_addr) = header;
+    uword old_header = AtomicOperations::CompareAndSwapWord(
+        reinterpret_cast<uword*>(raw_addr), header, new_addr | kForwarded);
+    if (old_header != header) {
+      // Another worker copied the object first. Discard our copy.
+      ASSERT(IsForwarding(old_header));
+      UndoAllocation(new_addr, size, promoted);
+      return ForwardedAddr(old_header);
+    }
+    VerifiedMemory::Accept(new_addr, size);
+    if (promoted) {
+      PromotedLargeObject(new_addr, cid, size);
+      promoted_.Add(new_addr);
+      if (is_marking_) {
+        shade_.Add(new_addr);
+      }
+      bytes_promoted_ += size;
+      class_stats_[cid].AddOld(size);
+    } else {
+      class_stats_[cid].AddNew(size);
+      if (size > kMaxBufferedObjectSize) {
+        // Individually allocated, so not covered by a copy buffer scan.
+        work_list_->Push(ScavengeWorkItem::kToSpaceRange,
+                         new_addr, new_addr + size);
+      }
+    }
+    return new_addr;
+  }
+
+  void UndoAllocation(uword addr, intptr_t size, bool promoted) {
+    if (promoted) {
+      if ((addr + size) == promo_top_) {
+        promo_top_ = addr;
+        return;
+      }
+    } else if ((addr + size) == copy_top_) {
+      copy_top_ = addr;
+      return;
+    }
+    // Individually allocated. Leave a filler to keep the space walkable.
+    FreeListElement::AsElement(addr, size);
+  }
+
+  uword TryAllocateCopy(intptr_t size) {
+    if (size > kMaxBufferedObjectSize) {
+      return scavenger_->TryAllocateParallel(size);
+    }
+    if ((copy_end_ - copy_top_) < static_cast<uword>(size)) {
+      uword buffer = scavenger_->TryAllocateParallel(kCopyBufferSize);
+      if (buffer == 0) {
+        return 0;
+      }
+      RetireCopyBuffer();
+      copy_top_ = buffer;
+      copy_end_ = buffer + kCopyBufferSize;
+      scan_ = buffer;
+    }
+    uword result = copy_top_;
+    copy_top_ += size;
+    return result;
+  }
+
+  uword TryAllocatePromo(intptr_t size) {
+    if (size > kMaxBufferedObjectSize) {
+      page_space_->AcquireDataLock();
+      uword result =
+          page_space_->TryAllocatePromoLocked(size, PageSpace::kForceGrowth);
+      page_space_->ReleaseDataLock();
+      return result;
+    }
+    if ((promo_end_ - promo_top_) < static_cast<uword>(size)) {
+      page_space_->AcquireDataLock();
+      uword buffer = page_space_->TryAllocatePromoLabLocked(
+          kPromoBufferSize, PageSpace::kForceGrowth);
+      if (buffer != 0) {
+        page_space_->ReleasePromoLabLocked(promo_top_, promo_end_);
+        promo_top_ = buffer;
+        promo_end_ = buffer + kPromoBufferSize;
+      }
+      page_space_->ReleaseDataLock();
+      if (buffer == 0) {
+        return 0;
+      }
+    }
+    uword result = promo_top_;
+    promo_top_ += size;
+    return result;
+  }
+
+  // Hands the unscanned part of the copy buffer to the other workers and
+  // formats the unused tail as a filler object.
+  void RetireCopyBuffer() {
+    if (scan_ < copy_top_) {
+      work_list_->Push(ScavengeWorkItem::kToSpaceRange, scan_, copy_top_);
+    }
+    if (copy_top_ < copy_end_) {
+      FreeListElement::AsElement(copy_top_, copy_end_ - copy_top_);
+    }
+    copy_top_ = copy_end_ = scan_ = 0;
+  }
+
+  void RetireBuffers() {
+    ASSERT(scan_ == copy_top_);
+    RetireCopyBuffer();
+    if (promo_top_ < promo_end_) {
+      page_space_->AcquireDataLock();
+      page_space_->ReleasePromoLabLocked(promo_top_, promo_end_);
+      page_space_->ReleaseDataLock();
+    }
+    promo_top_ = promo_end_ = 0;
+  }
+
+  Scavenger* scavenger_;
+  ScavengerWorkList* work_list_;
+  uword from_start_;
+  uword from_size_;
+  uword survivor_end_;
+  Heap* heap_;
+  PageSpace* page_space_;
+  // Copy buffer in the to space. Objects in [scan_, copy_top_) are not
+  // scanned yet.
+  uword copy_top_;
+  uword copy_end_;
+  uword scan_;
+  // Promotion buffer in the old space.
+  uword promo_top_;
+  uword promo_end_;
+  MallocGrowableArray<uword> promoted_;
+  MallocGrowableArray<RawObject*> remembered_;
+  MallocGrowableArray<RawWeakProperty*> delayed_weak_;
+  intptr_t num_cids_;
+  AllocStats<intptr_t>* class_stats_;
+  intptr_t bytes_promoted_;
+  // Objects promoted while the old generation is being marked incrementally.
+  // They are shaded on the mutator thread by Finalize.
+  const bool is_marking_;
+  MallocGrowableArray<uword> shade_;
+  RawObject* visiting_old_object_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelScavengerVisitor);
+};
+
+
+class ParallelScavengerTask : public ThreadPool::Task {
+ public:
+  ParallelScavengerTask(Isolate* task_isolate,
+                        ParallelScavengerVisitor* visitor,
+                        ScavengerWorkList* work_list)
+      : task_isolate_(task_isolate),
+        visitor_(visitor),
+        work_list_(work_list) {
+    work_list_->TaskStarted();
+  }
+
+  virtual void Run() {
+    Thread::EnterIsolate(task_isolate_);
+    visitor_->ProcessWork();
+    Thread::ExitIsolate();
+    // The visitor and isolate are released by the mutator thread, which may
+    // proceed as soon as this is signalled.
+    work_list_->TaskFinished();
+  }
+
+ private:
+  Isolate* task_isolate_;
+  ParallelScavengerVisitor* visitor_;
+  ScavengerWorkList* work_list_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelScavengerTask);
+};
+
+
 class ScavengerWeakVisitor : public HandleVisitor {
  public:
   // 'prologue_weak_were_strong' is currently only used for sanity checking.
@@ -327,40 +909,18 @@ SemiSpace::~SemiSpace() {
     memset(reserved_->address(), Heap::kZapByte,
            size_in_words() << kWordSizeLog2);
 #endif  // defined(DEBUG)
-    delete reserved_;
+    PagePool::Free(reserved_);
   }
 }
 
 
-Mutex* SemiSpace::mutex_ = NULL;
-SemiSpace* SemiSpace::cache_ = NULL;
-
-
-void SemiSpace::InitOnce() {
-  ASSERT(mutex_ == NULL);
-  mutex_ = new Mutex();
-  ASSERT(mutex_ != NULL);
-}
-
-
 SemiSpace* SemiSpace::New(intptr_t size_in_words) {
-  {
-    MutexLocker locker(mutex_);
-    // TODO(koda): Cache one entry per size.
-    if (cache_ != NULL && cache_->size_in_words() == size_in_words) {
-      SemiSpace* result = cache_;
-      cache_ = NULL;
-      return result;
-    }
-  }
   if (size_in_words == 0) {
     return new SemiSpace(NULL);
   } else {
     intptr_t size_in_bytes = size_in_words << kWordSizeLog2;
-    VirtualMemory* reserved = VerifiedMemory::Reserve(size_in_bytes);
-    if ((reserved == NULL) || !reserved->Commit(false)) {  // Not executable.
-      // TODO(koda): If cache_ is not empty, we could try to delete it.
-      delete reserved;
+    VirtualMemory* reserved = PagePool::Allocate(size_in_bytes, false);
+    if (reserved == NULL) {
       return NULL;
     }
 #if defined(DEBUG)
@@ -373,20 +933,7 @@ SemiSpace* SemiSpace::New(intptr_t size_in_words) {
 
 
 void SemiSpace::Delete() {
-#ifdef DEBUG
-  if (reserved_ != NULL) {
-    const intptr_t size_in_bytes = size_in_words() << kWordSizeLog2;
-    memset(reserved_->address(), Heap::kZapByte, size_in_bytes);
-    VerifiedMemory::Accept(reserved_->start(), size_in_bytes);
-  }
-#endif
-  SemiSpace* old_cache = NULL;
-  {
-    MutexLocker locker(mutex_);
-    old_cache = cache_;
-    cache_ = this;
-  }
-  delete old_cache;
+  delete this;
 }
 
 
@@ -404,6 +951,8 @@ Scavenger::Scavenger(Heap* heap,
                      uword object_alignment)
     : heap_(heap),
       max_semi_capacity_in_words_(max_semi_capacity_in_words),
+      semi_capacity_in_words_(0),
+      growth_decision_("initial"),
       object_alignment_(object_alignment),
       scavenging_(false),
       gc_time_micros_(0),
@@ -414,9 +963,8 @@ Scavenger::Scavenger(Heap* heap,
   ASSERT(Object::tags_offset() == 0);
 
   // Set initial size resulting in a total of three different levels.
-  const intptr_t initial_semi_capacity_in_words = max_semi_capacity_in_words /
-      (FLAG_new_gen_growth_factor * FLAG_new_gen_growth_factor);
-  to_ = SemiSpace::New(initial_semi_capacity_in_words);
+  semi_capacity_in_words_ = MinSemiCapacityInWords();
+  to_ = SemiSpace::New(semi_capacity_in_words_);
   if (to_ == NULL) {
     FATAL("Out of memory.\n");
   }
@@ -426,6 +974,8 @@ Scavenger::Scavenger(Heap* heap,
   top_ = FirstObjectStart();
   resolved_top_ = top_;
   end_ = to_->end();
+  sample_candidate_ = 0;
+  ResetSamplingLimit();
 
   survivor_end_ = FirstObjectStart();
 }
@@ -438,17 +988,68 @@ Scavenger::~Scavenger() {
 }
 
 
-intptr_t Scavenger::NewSizeInWords(intptr_t old_size_in_words) const {
+int64_t Scavenger::EstimateScavengeMicros() const {
+  if (stats_history_.Size() == 0) {
+    return 0;
+  }
+  int64_t total = 0;
+  for (intptr_t i = 0; i < stats_history_.Size(); i++) {
+    total += stats_history_.Get(i).DurationMicros();
+  }
+  return total / stats_history_.Size();
+}
+
+
+intptr_t Scavenger::MinSemiCapacityInWords() const {
+  return max_semi_capacity_in_words_ /
+      (FLAG_new_gen_growth_factor * FLAG_new_gen_growth_factor);
+}
+
+
+intptr_t Scavenger::NewSizeInWords(intptr_t old_size_in_words) {
   if (stats_history_.Size() == 0) {
     return old_size_in_words;
   }
-  double garbage = stats_history_.Get(0).GarbageFraction();
-  if (garbage < (FLAG_new_gen_garbage_threshold / 100.0)) {
-    return Utils::Minimum(max_semi_capacity_in_words_,
-                          old_size_in_words * FLAG_new_gen_growth_factor);
+  const ScavengeStats& last = stats_history_.Get(0);
+  const int64_t pause_micros = last.DurationMicros();
+  bool exceeds_time_goal = false;
+  if ((FLAG_gc_time_goal > 0) && (stats_history_.Size() >= 2)) {
+    const int64_t period_micros =
+        last.EndMicros() - stats_history_.Get(1).EndMicros();
+    exceeds_time_goal =
+        (pause_micros * 100 > FLAG_gc_time_goal * period_micros);
+  }
+  intptr_t new_size_in_words = old_size_in_words;
+  if ((FLAG_gc_pause_goal > 0) &&
+      (pause_micros > FLAG_gc_pause_goal * kMicrosecondsPerMillisecond)) {
+    // Fewer objects survive to be copied from a smaller new space.
+    new_size_in_words = Utils::Maximum(
+        MinSemiCapacityInWords(),
+        old_size_in_words / FLAG_new_gen_growth_factor);
+    growth_decision_ = "pause goal";
+  } else if (exceeds_time_goal) {
+    new_size_in_words = Utils::Minimum(
+        max_semi_capacity_in_words_,
+        old_size_in_words * FLAG_new_gen_growth_factor);
+    growth_decision_ = "time goal";
   } else {
-    return old_size_in_words;
+    double garbage = last.GarbageFraction();
+    if (garbage < (FLAG_new_gen_garbage_threshold / 100.0)) {
+      new_size_in_words = Utils::Minimum(
+          max_semi_capacity_in_words_,
+          old_size_in_words * FLAG_new_gen_growth_factor);
+    }
+    growth_decision_ = "survival";
+  }
+  if (FLAG_log_growth && (new_size_in_words != old_size_in_words)) {
+    OS::PrintErr("new space: %" Pd " -> %" Pd " KB after a %" Pd64 " us "
+                 "scavenge (%s)\n",
+                 (old_size_in_words << kWordSizeLog2) / KB,
+                 (new_size_in_words << kWordSizeLog2) / KB,
+                 pause_micros,
+                 growth_decision_);
   }
+  return new_size_in_words;
 }
 
 
@@ -459,7 +1060,11 @@ void Scavenger::Prologue(Isolate* isolate, bool invoke_api_callbacks) {
   // Flip the two semi-spaces so that to_ is always the space for allocating
   // objects.
   from_ = to_;
-  to_ = SemiSpace::New(NewSizeInWords(from_->size_in_words()));
+  // The to-space must hold everything that could survive from the from-space,
+  // so a smaller target size only takes effect once the scavenge is done.
+  const intptr_t used_in_words = (top_ - from_->start()) >> kWordSizeLog2;
+  semi_capacity_in_words_ = NewSizeInWords(semi_capacity_in_words_);
+  to_ = SemiSpace::New(Utils::Maximum(semi_capacity_in_words_, used_in_words));
   if (to_ == NULL) {
     // TODO(koda): We could try to recover (collect old space, wait for another
     // isolate to finish scavenge, etc.).
@@ -468,6 +1073,9 @@ void Scavenger::Prologue(Isolate* isolate, bool invoke_api_callbacks) {
   top_ = FirstObjectStart();
   resolved_top_ = top_;
   end_ = to_->end();
+  // Scavenge workers allocate up to the end.
+  limit_ = end_;
+  sample_candidate_ = 0;
 }
 
 
@@ -489,6 +1097,12 @@ void Scavenger::Epilogue(Isolate* isolate,
     // objects candidates for promotion next time.
     survivor_end_ = end_;
   }
+  // Leave room for at most the target size until the next scavenge.
+  end_ = Utils::Minimum(
+      to_->end(),
+      Utils::Maximum(top_, to_->start() +
+                           (semi_capacity_in_words_ << kWordSizeLog2)));
+  ResetSamplingLimit();
   VerifiedMemory::Accept(to_->start(), to_->end() - to_->start());
 #if defined(DEBUG)
   // We can only safely verify the store buffers from old space if there is no
@@ -529,7 +1143,12 @@ void Scavenger::IterateStoreBuffers(Isolate* isolate,
       ASSERT(raw_object->IsRemembered());
       raw_object->ClearRememberedBit();
       visitor->VisitingOldObject(raw_object);
-      raw_object->VisitPointers(visitor);
+      if (raw_object->IsCardRemembered()) {
+        // Only the slots of large arrays in marked cards can be new pointers.
+        HeapPage::OfLargeObject(raw_object)->VisitRememberedCards(visitor);
+      } else {
+        raw_object->VisitPointers(visitor);
+      }
     }
     delete pending;
     pending = next;
@@ -570,6 +1189,78 @@ void Scavenger::IterateRoots(Isolate* isolate,
 }
 
 
+intptr_t Scavenger::ParallelScavenge(
+    Isolate* isolate,
+    ScavengerVisitor* visitor,
+    bool visit_prologue_weak_persistent_handles) {
+  int64_t start = OS::GetCurrentTimeMicros();
+  const intptr_t num_tasks = FLAG_scavenger_tasks;
+  ScavengerWorkList work_list(num_tasks + 1);
+
+  // Seed the shared work list with the roots that can be split up.
+  StoreBuffer* buffer = isolate->store_buffer();
+  heap_->RecordData(kStoreBufferEntries, buffer->Count());
+  StoreBufferBlock* pending = buffer->Blocks();
+  while (pending != NULL) {
+    StoreBufferBlock* next = pending->next();
+    work_list.Push(ScavengeWorkItem::kStoreBufferBlock,
+                   reinterpret_cast<uword>(pending), 0);
+    pending = next;
+  }
+  heap_->RecordData(kDataUnused1, 0);
+  heap_->RecordData(kDataUnused2, 0);
+  if (isolate->object_id_ring() != NULL) {
+    work_list.Push(ScavengeWorkItem::kObjectIdRing, 0, 0);
+  } else {
+    // --gc_at_alloc can get us here before the ring has been initialized.
+    ASSERT(FLAG_gc_at_alloc);
+  }
+
+  ParallelScavengerVisitor main_visitor(isolate, this, &work_list);
+  Isolate** task_isolates = new Isolate*[num_tasks];
+  ParallelScavengerVisitor** task_visitors =
+      new ParallelScavengerVisitor*[num_tasks];
+  ThreadPool* pool = Dart::thread_pool();
+  for (intptr_t i = 0; i < num_tasks; i++) {
+    task_isolates[i] = isolate->ShallowCopy();
+    task_visitors[i] =
+        new ParallelScavengerVisitor(task_isolates[i], this, &work_list);
+    pool->RunDedicated(new ParallelScavengerTask(task_isolates[i],
+                                                 task_visitors[i],
+                                                 &work_list));
+  }
+
+  // Stack frames can only be walked by the mutator thread.
+  isolate->VisitObjectPointers(&main_visitor,
+                               visit_prologue_weak_persistent_handles,
+                               StackFrameIterator::kDontValidateFrames);
+  int64_t middle = OS::GetCurrentTimeMicros();
+  main_visitor.ProcessWork();
+  work_list.WaitForTasks();
+
+  // All reachable objects have been copied and scanned. Merge the results of
+  // the workers and leave the rest to the serial scavenge.
+  intptr_t bytes_promoted = main_visitor.bytes_promoted();
+  main_visitor.Finalize(visitor);
+  for (intptr_t i = 0; i < num_tasks; i++) {
+    bytes_promoted += task_visitors[i]->bytes_promoted();
+    task_visitors[i]->Finalize(visitor);
+    delete task_visitors[i];
+    delete task_isolates[i];
+  }
+  delete[] task_visitors;
+  delete[] task_isolates;
+  ASSERT(!PromotedStackHasMore());
+  resolved_top_ = top_;
+  int64_t end = OS::GetCurrentTimeMicros();
+  heap_->RecordData(kToKBAfterStoreBuffer, RoundWordsToKB(UsedInWords()));
+  heap_->RecordTime(kVisitIsolateRoots, middle - start);
+  // Store buffers are processed together with the to space.
+  heap_->RecordTime(kIterateStoreBuffers, end - middle);
+  return bytes_promoted;
+}
+
+
 bool Scavenger::IsUnreachable(RawObject** p) {
   RawObject* raw_obj = *p;
   if (!raw_obj->IsHeapObject()) {
@@ -662,7 +1353,10 @@ void Scavenger::IterateWeakRoots(Isolate* isolate,
 
 
 void Scavenger::ProcessToSpace(ScavengerVisitor* visitor) {
-  GrowableArray<RawObject*>* delayed_weak_stack = visitor->DelayedWeakStack();
+  MallocGrowableArray<RawWeakProperty*>* delayed_weak_stack =
+      visitor->DelayedWeakStack();
+  // Promoted objects are shaded while the old generation is being marked.
+  GCMarker* marker = heap_->old_space()->incremental_marker();
 
   // Iterate until all work has been drained.
   while ((resolved_top_ < top_) ||
@@ -687,12 +1381,15 @@ void Scavenger::ProcessToSpace(ScavengerVisitor* visitor) {
         ASSERT(!raw_object->IsRemembered());
         visitor->VisitingOldObject(raw_object);
         raw_object->VisitPointers(visitor);
+        if (marker != NULL) {
+          marker->MarkIncremental(raw_object);
+        }
       }
       visitor->VisitingOldObject(NULL);
     }
     while (!delayed_weak_stack->is_empty()) {
       // Pop the delayed weak object from the stack and visit its pointers.
-      RawObject* weak_property = delayed_weak_stack->RemoveLast();
+      RawWeakProperty* weak_property = delayed_weak_stack->RemoveLast();
       weak_property->VisitPointers(visitor);
     }
   }
@@ -723,6 +1420,10 @@ void Scavenger::ProcessWeakTables() {
        sel++) {
     WeakTable* table = heap_->GetWeakTable(
         Heap::kNew, static_cast<Heap::WeakSelector>(sel));
+    if (table->used() == 0) {
+      // Nothing to rehash, e.g. the hashCodes kept in the object headers.
+      continue;
+    }
     heap_->SetWeakTable(Heap::kNew,
                         static_cast<Heap::WeakSelector>(sel),
                         WeakTable::NewFrom(table));
@@ -750,6 +1451,57 @@ void Scavenger::ProcessWeakTables() {
 }
 
 
+intptr_t Scavenger::SamplingIntervalInBytes() {
+  intptr_t interval = FLAG_pretenure_sample_interval;
+  if ((FLAG_profile_allocation_interval > 0) &&
+      ((interval <= 0) || (FLAG_profile_allocation_interval < interval))) {
+    interval = FLAG_profile_allocation_interval;
+  }
+  return Utils::Maximum<intptr_t>(0, interval) * KB;
+}
+
+
+void Scavenger::SampleAllocation(uword addr) {
+  ASSERT(!scavenging_);
+  if (SamplingIntervalInBytes() > 0) {
+    sample_candidate_ = addr;
+  }
+  ResetSamplingLimit();
+}
+
+
+void Scavenger::ResetSamplingLimit() {
+  const intptr_t interval = SamplingIntervalInBytes();
+  if (interval == 0) {
+    limit_ = end_;
+    return;
+  }
+  const intptr_t remaining = end_ - top_;
+  limit_ = top_ + Utils::Minimum(remaining, interval);
+}
+
+
+void Scavenger::AddAllocationSample(uword addr, intptr_t site) {
+  ASSERT(to_->Contains(addr));
+  AllocationSample sample;
+  sample.addr = addr;
+  sample.site = site;
+  samples_.Add(sample);
+}
+
+
+void Scavenger::ProcessAllocationSamples() {
+  AllocationSiteTable* sites = heap_->allocation_sites();
+  for (intptr_t i = 0; i < samples_.length(); i++) {
+    const AllocationSample& sample = samples_[i];
+    ASSERT(from_->Contains(sample.addr));
+    uword header = *reinterpret_cast<uword*>(sample.addr);
+    sites->AddSample(sample.site, IsForwarding(header));
+  }
+  samples_.Clear();
+}
+
+
 void Scavenger::VisitObjectPointers(ObjectPointerVisitor* visitor) const {
   uword cur = FirstObjectStart();
   while (cur < top_) {
@@ -803,9 +1555,9 @@ void Scavenger::Scavenge(bool invoke_api_callbacks) {
   NoHandleScope no_handles(isolate);
 
   // TODO(koda): Make verification more compatible with concurrent sweep.
-  if (FLAG_verify_before_gc && !FLAG_concurrent_sweep) {
+  if (FLAG_verify_before_gc && !FLAG_concurrent_sweep && !FLAG_lazy_sweep) {
     OS::PrintErr("Verifying before Scavenge...");
-    heap_->Verify(kForbidMarked);
+    heap_->Verify(page_space->IsMarking() ? kAllowMarked : kForbidMarked);
     OS::PrintErr(" done.\n");
   }
 
@@ -820,9 +1572,18 @@ void Scavenger::Scavenge(bool invoke_api_callbacks) {
     StackZone zone(isolate);
     // Setup the visitor and run the scavenge.
     ScavengerVisitor visitor(isolate, this);
-    page_space->AcquireDataLock();
     const bool prologue_weak_are_strong = !invoke_api_callbacks;
-    IterateRoots(isolate, &visitor, prologue_weak_are_strong);
+    intptr_t parallel_bytes_promoted = 0;
+    if (FLAG_scavenger_tasks > 0) {
+      // The parallel workers take the data lock only to refill their
+      // promotion buffers.
+      parallel_bytes_promoted =
+          ParallelScavenge(isolate, &visitor, prologue_weak_are_strong);
+      page_space->AcquireDataLock();
+    } else {
+      page_space->AcquireDataLock();
+      IterateRoots(isolate, &visitor, prologue_weak_are_strong);
+    }
     int64_t start = OS::GetCurrentTimeMicros();
     ProcessToSpace(&visitor);
     int64_t middle = OS::GetCurrentTimeMicros();
@@ -833,6 +1594,7 @@ void Scavenger::Scavenge(bool invoke_api_callbacks) {
     IterateWeakRoots(isolate, &weak_visitor, visit_prologue_weak_handles);
     visitor.Finalize();
     ProcessWeakTables();
+    ProcessAllocationSamples();
     page_space->ReleaseDataLock();
 
     // Scavenge finished. Run accounting.
@@ -843,14 +1605,15 @@ void Scavenger::Scavenge(bool invoke_api_callbacks) {
         ScavengeStats(start, end,
                       usage_before, GetCurrentUsage(),
                       promo_candidate_words,
-                      visitor.bytes_promoted() >> kWordSizeLog2));
+                      (visitor.bytes_promoted() +
+                       parallel_bytes_promoted) >> kWordSizeLog2));
   }
   Epilogue(isolate, invoke_api_callbacks);
 
   // TODO(koda): Make verification more compatible with concurrent sweep.
-  if (FLAG_verify_after_gc && !FLAG_concurrent_sweep) {
+  if (FLAG_verify_after_gc && !FLAG_concurrent_sweep && !FLAG_lazy_sweep) {
     OS::PrintErr("Verifying after Scavenge...");
-    heap_->Verify(kForbidMarked);
+    heap_->Verify(page_space->IsMarking() ? kAllowMarked : kForbidMarked);
     OS::PrintErr(" done.\n");
   }
 
@@ -891,6 +1654,17 @@ void Scavenger::PrintToJSONObject(JSONObject* object) {
   space.AddProperty("capacity", CapacityInWords() * kWordSize);
   space.AddProperty("external", ExternalInWords() * kWordSize);
   space.AddProperty("time", MicrosecondsToSeconds(gc_time_micros()));
+  JSONObject policy(&space, "growthPolicy");
+  policy.AddProperty("pauseGoalMillis",
+                     static_cast<intptr_t>(FLAG_gc_pause_goal));
+  policy.AddProperty("timeGoalPercent",
+                     static_cast<intptr_t>(FLAG_gc_time_goal));
+  if (stats_history_.Size() > 0) {
+    policy.AddProperty("lastPauseMillis", MicrosecondsToMilliseconds(
+        stats_history_.Get(0).DurationMicros()));
+  }
+  policy.AddProperty("maxCapacity", max_semi_capacity_in_words_ * kWordSize);
+  policy.AddProperty("limitedBy", growth_decision_);
 }
 
 
@@ -7,9 +7,11 @@
 
 #include "platform/assert.h"
 #include "platform/utils.h"
+#include "vm/atomic.h"
 #include "vm/dart.h"
 #include "vm/flags.h"
 #include "vm/globals.h"
+#include "vm/growable_array.h"
 #include "vm/raw_object.h"
 #include "vm/ring_buffer.h"
 #include "vm/spaces.h"
@@ -22,21 +24,21 @@ namespace dart {
 class Heap;
 class Isolate;
 class JSONObject;
+class ParallelScavengerVisitor;
 class ScavengerVisitor;
 
 DECLARE_FLAG(bool, gc_at_alloc);
+DECLARE_FLAG(int, scavenger_tasks);
 
 
 // Wrapper around VirtualMemory that adds caching and handles the empty case.
 class SemiSpace {
  public:
-  static void InitOnce();
-
   // Get a space of the given size. Returns NULL on out of memory. If size is 0,
   // returns an empty space: pointer(), start() and end() all return NULL.
   static SemiSpace* New(intptr_t size_in_words);
 
-  // Hand back an unused space.
+  // Hand back an unused space. Its memory goes back to the PagePool.
   void Delete();
 
   void* pointer() const { return region_.pointer(); }
@@ -58,9 +60,6 @@ class SemiSpace {
 
   VirtualMemory* reserved_;  // NULL for an emtpy space.
   MemoryRegion region_;
-
-  static SemiSpace* cache_;
-  static Mutex* mutex_;
 };
 
 
@@ -99,6 +98,10 @@ class ScavengeStats {
     return end_micros_ - start_micros_;
   }
 
+  int64_t EndMicros() const {
+    return end_micros_;
+  }
+
  private:
   int64_t start_micros_;
   int64_t end_micros_;
@@ -148,9 +151,32 @@ class Scavenger {
 
     top_ += size;
     ASSERT(to_->Contains(top_) || (top_ == to_->end()));
+    if (top_ >= limit_) {
+      SampleAllocation(result);
+    }
     return result;
   }
 
+  // Returns true if the object at 'addr' was just allocated as the current
+  // allocation sample, which is then taken by the caller.
+  bool TakeAllocationSample(uword addr) {
+    if (!IsAllocationSample(addr)) {
+      return false;
+    }
+    sample_candidate_ = 0;
+    return true;
+  }
+  bool IsAllocationSample(uword addr) const {
+    return (sample_candidate_ != 0) && (sample_candidate_ == addr);
+  }
+  // The number of bytes allocated between two samples, the smaller of
+  // --pretenure_sample_interval and --profile_allocation_interval, or 0 if
+  // sampling is disabled.
+  static intptr_t SamplingIntervalInBytes();
+  // Records whether the sampled object at 'addr' survives the next scavenge
+  // as feedback for the allocation site 'site'.
+  void AddAllocationSample(uword addr, intptr_t site);
+
   // Collect the garbage in this scavenger.
   void Scavenge();
   void Scavenge(bool invoke_api_callbacks);
@@ -162,17 +188,19 @@ class Scavenger {
     ASSERT(UsedInWords() == 0);
   }
 
-  // Accessors to generate code for inlined allocation.
+  // Accessors to generate code for inlined allocation. Inlined allocation
+  // stops at the sampling limit so that the next sample is taken by the
+  // runtime.
   uword* TopAddress() { return &top_; }
-  uword* EndAddress() { return &end_; }
+  uword* EndAddress() { return &limit_; }
   static intptr_t top_offset() { return OFFSET_OF(Scavenger, top_); }
-  static intptr_t end_offset() { return OFFSET_OF(Scavenger, end_); }
+  static intptr_t end_offset() { return OFFSET_OF(Scavenger, limit_); }
 
   intptr_t UsedInWords() const {
     return (top_ - FirstObjectStart()) >> kWordSizeLog2;
   }
   intptr_t CapacityInWords() const {
-    return to_->size_in_words();
+    return semi_capacity_in_words_;
   }
   intptr_t ExternalInWords() const {
     return external_size_ >> kWordSizeLog2;
@@ -211,6 +239,9 @@ class Scavenger {
     return collections_;
   }
 
+  // The average duration of the recent scavenges, or 0 if there were none.
+  int64_t EstimateScavengeMicros() const;
+
   void PrintToJSONObject(JSONObject* object);
 
   void AllocateExternal(intptr_t size);
@@ -238,6 +269,12 @@ class Scavenger {
   void IterateRoots(Isolate* isolate,
                     ScavengerVisitor* visitor,
                     bool visit_prologue_weak_persistent_handles);
+  // Copies the objects reachable from the roots using the mutator thread and
+  // --scavenger_tasks helper tasks. Leaves the weak properties found with
+  // unreachable keys to 'visitor' and returns the number of bytes promoted.
+  intptr_t ParallelScavenge(Isolate* isolate,
+                            ScavengerVisitor* visitor,
+                            bool visit_prologue_weak_persistent_handles);
   void IterateWeakProperties(Isolate* isolate, ScavengerVisitor* visitor);
   void IterateWeakReferences(Isolate* isolate, ScavengerVisitor* visitor);
   void IterateWeakRoots(Isolate* isolate,
@@ -251,6 +288,26 @@ class Scavenger {
 
   bool IsUnreachable(RawObject** p);
 
+  // Thread-safe variant of TryAllocate used by parallel scavenge workers to
+  // claim copy buffers in the to space.
+  uword TryAllocateParallel(intptr_t size) {
+    ASSERT(scavenging_);
+    ASSERT(Utils::IsAligned(size, kObjectAlignment));
+    uword top = top_;
+    while (true) {
+      intptr_t remaining = end_ - top;
+      if (remaining < size) {
+        return 0;
+      }
+      uword prev = AtomicOperations::CompareAndSwapWord(&top_, top, top + size);
+      if (prev == top) {
+        ASSERT(to_->Contains(top));
+        return top;
+      }
+      top = prev;
+    }
+  }
+
   // During a scavenge we need to remember the promoted objects.
   // This is implemented as a stack of objects at the end of the to space. As
   // object sizes are always greater than sizeof(uword) and promoted objects do
@@ -275,7 +332,18 @@ class Scavenger {
 
   void ProcessWeakTables();
 
-  intptr_t NewSizeInWords(intptr_t old_size_in_words) const;
+  // Makes the object at 'addr' the current sample candidate and moves the
+  // sampling limit past it.
+  void SampleAllocation(uword addr);
+  void ResetSamplingLimit();
+  // Feeds the survival of the sampled objects back to their allocation sites.
+  void ProcessAllocationSamples();
+
+  // Returns the size of the next to-space. With --gc_pause_goal or
+  // --gc_time_goal, new space shrinks while scavenges take longer than the
+  // pause goal and grows while too much time is spent scavenging.
+  intptr_t NewSizeInWords(intptr_t old_size_in_words);
+  intptr_t MinSemiCapacityInWords() const;
 
   SemiSpace* from_;
   SemiSpace* to_;
@@ -286,6 +354,17 @@ class Scavenger {
   // from generated code.
   uword top_;
   uword end_;
+  // Allocation sampling limit, at most end_. Generated code allocates up to
+  // this limit only.
+  uword limit_;
+
+  // The last object allocated past the sampling limit, until it is taken.
+  uword sample_candidate_;
+  struct AllocationSample {
+    uword addr;
+    intptr_t site;
+  };
+  MallocGrowableArray<AllocationSample> samples_;
 
   // A pointer to the first unscanned object.  Scanning completes when
   // this value meets the allocation top.
@@ -296,6 +375,12 @@ class Scavenger {
 
   intptr_t max_semi_capacity_in_words_;
 
+  // The target size of the to-space. It may be smaller than the to-space
+  // itself right after new space was shrunk.
+  intptr_t semi_capacity_in_words_;
+  // What determined the target size.
+  const char* growth_decision_;
+
   // All object are aligned to this value.
   uword object_alignment_;
 
@@ -310,6 +395,7 @@ class Scavenger {
   // The total size of external data associated with objects in this scavenger.
   intptr_t external_size_;
 
+  friend class ParallelScavengerVisitor;
   friend class ScavengerVisitor;
   friend class ScavengerWeakVisitor;
 
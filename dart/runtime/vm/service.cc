@@ -11,6 +11,7 @@
 #include "vm/coverage.h"
 #include "vm/cpu.h"
 #include "vm/dart_api_impl.h"
+#include "vm/dart_api_message.h"
 #include "vm/dart_entry.h"
 #include "vm/debugger.h"
 #include "vm/isolate.h"
@@ -2114,6 +2115,21 @@ static bool GetCpuProfile(Isolate* isolate, JSONStream* js) {
 }
 
 
+static const MethodParameter* get_allocation_samples_params[] = {
+  ISOLATE_PARAMETER,
+  new EnumParameter("tags", true, tags_enum_names),
+  NULL,
+};
+
+
+static bool GetAllocationSamples(Isolate* isolate, JSONStream* js) {
+  ProfilerService::TagOrder tag_order =
+      EnumMapper(js->LookupParam("tags"), tags_enum_names, tags_enum_values);
+  ProfilerService::PrintAllocationJSON(js, tag_order);
+  return true;
+}
+
+
 static const MethodParameter* clear_cpu_profile_params[] = {
   ISOLATE_PARAMETER,
   NULL,
@@ -2185,7 +2201,10 @@ static const MethodParameter* request_heap_snapshot_params[] = {
 
 
 static bool RequestHeapSnapshot(Isolate* isolate, JSONStream* js) {
-  Service::SendGraphEvent(isolate);
+  if (!Service::SendGraphEvent(isolate)) {
+    PrintError(js, "%s: failed to send the heap snapshot", js->method());
+    return true;
+  }
   // TODO(koda): Provide some id that ties this request to async response(s).
   JSONObject jsobj(js);
   jsobj.AddProperty("type", "OK");
@@ -2194,20 +2213,77 @@ static bool RequestHeapSnapshot(Isolate* isolate, JSONStream* js) {
 }
 
 
-void Service::SendGraphEvent(Isolate* isolate) {
-  uint8_t* buffer = NULL;
-  WriteStream stream(&buffer, &allocator, 1 * MB);
+static const intptr_t kGraphEventChunkSize = 1 * MB;
+
+
+// Posts the object graph as a sequence of '_Graph' events, one per chunk, as
+// it is being serialized. The Dart heap must not be touched while the graph is
+// traversed, so the events are posted as C objects with the same layout as
+// those of Service::SendEvent. The stream stops at the first chunk that cannot
+// be sent, e.g., because the service isolate has shut down.
+class GraphEventWriter : public ObjectGraph::ChunkWriter {
+ public:
+  explicit GraphEventWriter(Isolate* isolate)
+      : isolate_(isolate), chunk_index_(0) { }
+
+  virtual bool WriteChunk(const uint8_t* data, intptr_t size, bool is_last) {
+    JSONStream js;
+    {
+      JSONObject jsobj(&js);
+      jsobj.AddProperty("type", "ServiceEvent");
+      jsobj.AddProperty("eventType", "_Graph");
+      jsobj.AddProperty("isolate", isolate_);
+      jsobj.AddProperty("chunkIndex", chunk_index_);
+      jsobj.AddProperty("lastChunk", is_last);
+    }
+    chunk_index_++;
+    const intptr_t meta_bytes = js.buffer()->length();
+    const intptr_t total_bytes = sizeof(uint64_t) + meta_bytes + size;
+    uint8_t* message = reinterpret_cast<uint8_t*>(malloc(total_bytes));
+    if (message == NULL) {
+      FATAL("Out of memory.\n");
+    }
+    const uint64_t meta_size = Utils::HostToBigEndian64(meta_bytes);
+    memmove(message, &meta_size, sizeof(meta_size));
+    memmove(message + sizeof(uint64_t), js.buffer()->buf(), meta_bytes);
+    memmove(message + sizeof(uint64_t) + meta_bytes, data, size);
+    Dart_CObject cobj;
+    cobj.type = Dart_CObject_kTypedData;
+    cobj.value.as_typed_data.type = Dart_TypedData_kUint8;
+    cobj.value.as_typed_data.length = total_bytes;
+    cobj.value.as_typed_data.values = message;
+    uint8_t* buffer = NULL;
+    ApiMessageWriter writer(&buffer, allocator);
+    bool success = writer.WriteCMessage(&cobj);
+    free(message);
+    if (!success) {
+      free(buffer);
+      return false;
+    }
+    return PortMap::PostMessage(new Message(ServiceIsolate::Port(),
+                                            buffer,
+                                            writer.BytesWritten(),
+                                            Message::kNormalPriority));
+  }
+
+ private:
+  Isolate* isolate_;
+  intptr_t chunk_index_;
+};
+
+
+bool Service::SendGraphEvent(Isolate* isolate) {
+  if (!ServiceIsolate::IsRunning()) {
+    return false;
+  }
+  GraphEventWriter writer(isolate);
   ObjectGraph graph(isolate);
-  graph.Serialize(&stream);
-  JSONStream js;
-  {
-    JSONObject jsobj(&js);
-    jsobj.AddProperty("type", "ServiceEvent");
-    jsobj.AddProperty("eventType", "_Graph");
-    jsobj.AddProperty("isolate", isolate);
+  const bool completed = graph.Serialize(&writer, kGraphEventChunkSize);
+  if (!completed && FLAG_trace_service) {
+    OS::Print("vm-service: Stopped sending the heap snapshot of isolate %s\n",
+              isolate->name());
   }
-  const String& message = String::Handle(String::New(js.ToCString()));
-  SendEvent(message, buffer, stream.bytes_written());
+  return completed;
 }
 
 
@@ -2513,6 +2589,8 @@ static ServiceMethodDescriptor service_methods_[] = {
     eval_frame_params },
   { "_getAllocationProfile", GetAllocationProfile,
     get_allocation_profile_params },
+  { "_getAllocationSamples", GetAllocationSamples,
+    get_allocation_samples_params },
   { "_getCallSiteData", GetCallSiteData,
     get_call_site_data_params },
   { "getClassList", GetClassList,
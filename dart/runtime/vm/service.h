@@ -47,7 +47,8 @@ class Service : public AllStatic {
       void* user_data);
 
   static void SendEchoEvent(Isolate* isolate, const char* text);
-  static void SendGraphEvent(Isolate* isolate);
+  // Returns false if the graph could not be sent in full.
+  static bool SendGraphEvent(Isolate* isolate);
 
  private:
   static void InvokeMethod(Isolate* isolate, const Array& message);
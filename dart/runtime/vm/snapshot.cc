@@ -7,11 +7,14 @@
 #include "platform/assert.h"
 #include "vm/bootstrap.h"
 #include "vm/class_finalizer.h"
+#include "vm/dart_api_state.h"
 #include "vm/dart_entry.h"
 #include "vm/exceptions.h"
+#include "vm/flags.h"
 #include "vm/heap.h"
 #include "vm/lockers.h"
 #include "vm/longjump.h"
+#include "vm/message.h"
 #include "vm/object.h"
 #include "vm/object_store.h"
 #include "vm/snapshot_ids.h"
@@ -24,6 +27,10 @@ namespace dart {
 static const int kNumInitialReferencesInFullSnapshot = 160 * KB;
 static const int kNumInitialReferences = 64;
 
+DEFINE_FLAG(int, message_adopt_threshold, 64 * KB,
+    "Byte arrays of at least this many bytes in an isolate message are read "
+    "in place over the message buffer instead of being copied (0 disables).");
+
 
 static bool IsSingletonClassId(intptr_t class_id) {
   // Check if this is a singleton object class which is shared by all isolates.
@@ -187,7 +194,9 @@ SnapshotReader::SnapshotReader(const uint8_t* buffer,
       error_(UnhandledException::Handle(isolate)),
       backward_references_((kind == Snapshot::kFull) ?
                            kNumInitialReferencesInFullSnapshot :
-                           kNumInitialReferences) {
+                           kNumInitialReferences),
+      adoptable_message_(NULL),
+      adopted_buffer_(NULL) {
 }
 
 
@@ -421,7 +430,7 @@ RawObject* SnapshotReader::ReadObjectRef() {
 
     CLASS_LIST_TYPED_DATA(SNAPSHOT_READ) {
       tags = RawObject::ClassIdTag::update(class_id, tags);
-      pobj_ = TypedData::ReadFrom(this, object_id, tags, kind_);
+      pobj_ = ReadTypedData(object_id, tags);
       break;
     }
 #undef SNAPSHOT_READ
@@ -1075,7 +1084,7 @@ RawObject* SnapshotReader::ReadInlinedObject(intptr_t object_id) {
 
     CLASS_LIST_TYPED_DATA(SNAPSHOT_READ) {
       tags = RawObject::ClassIdTag::update(class_id, tags);
-      pobj_ = TypedData::ReadFrom(this, object_id, tags, kind_);
+      pobj_ = ReadTypedData(object_id, tags);
       break;
     }
 #undef SNAPSHOT_READ
@@ -1097,6 +1106,81 @@ RawObject* SnapshotReader::ReadInlinedObject(intptr_t object_id) {
 }
 
 
+// The buffer of a message which byte arrays have been read in place over. It
+// is freed when the last of these arrays is finalized, which always happens
+// on the thread of the isolate that read the message.
+class AdoptedMessageBuffer {
+ public:
+  explicit AdoptedMessageBuffer(uint8_t* data) : data_(data), refs_(0) {}
+  ~AdoptedMessageBuffer() { free(data_); }
+
+  void Retain() { refs_++; }
+
+  static void Release(void* isolate_callback_data,
+                      Dart_WeakPersistentHandle handle,
+                      void* peer) {
+    AdoptedMessageBuffer* buffer =
+        reinterpret_cast<AdoptedMessageBuffer*>(peer);
+    ASSERT(buffer->refs_ > 0);
+    if (--buffer->refs_ == 0) {
+      delete buffer;
+    }
+  }
+
+ private:
+  uint8_t* data_;
+  intptr_t refs_;
+
+  DISALLOW_COPY_AND_ASSIGN(AdoptedMessageBuffer);
+};
+
+
+RawObject* SnapshotReader::ReadTypedData(intptr_t object_id, intptr_t tags) {
+  const intptr_t cid = RawObject::ClassIdTag::decode(tags);
+  // Only byte arrays can be adopted, as the buffer gives no alignment.
+  if ((adoptable_message_ != NULL) &&
+      (FLAG_message_adopt_threshold > 0) &&
+      ((cid == kTypedDataInt8ArrayCid) ||
+       (cid == kTypedDataUint8ArrayCid) ||
+       (cid == kTypedDataUint8ClampedArrayCid))) {
+    // Peek at the length without consuming it.
+    BaseReader peek(CurrentBufferAddress(), PendingBytes());
+    const intptr_t len = peek.ReadSmiValue();
+    if (len >= FLAG_message_adopt_threshold) {
+      ReadSmiValue();
+      ExternalTypedData& result =
+          ExternalTypedData::ZoneHandle(zone(), AdoptTypedData(cid, len));
+      AddBackRef(object_id, &result, kIsDeserialized);
+      return result.raw();
+    }
+  }
+  return TypedData::ReadFrom(this, object_id, tags, kind_);
+}
+
+
+RawExternalTypedData* SnapshotReader::AdoptTypedData(intptr_t class_id,
+                                                     intptr_t len) {
+  ASSERT(kind_ == Snapshot::kMessage);
+  const intptr_t external_cid =
+      kExternalTypedDataInt8ArrayCid + (class_id - kTypedDataInt8ArrayCid);
+  uint8_t* data = const_cast<uint8_t*>(CurrentBufferAddress());
+  Advance(len);
+  // Allocate before taking the buffer, so that the message still frees it if
+  // the allocation fails.
+  const ExternalTypedData& result = ExternalTypedData::Handle(
+      zone(), ExternalTypedData::New(external_cid, data, len, Heap::kNew));
+  if (adopted_buffer_ == NULL) {
+    // From here on the message no longer frees its data; the arrays do.
+    adopted_buffer_ = new AdoptedMessageBuffer(adoptable_message_->TakeData());
+  }
+  adopted_buffer_->Retain();
+  FinalizablePersistentHandle* handle =
+      result.AddFinalizer(adopted_buffer_, AdoptedMessageBuffer::Release);
+  handle->SetExternalSize(len, isolate());
+  return result.raw();
+}
+
+
 void SnapshotReader::ArrayReadFrom(const Array& result,
                                    intptr_t len,
                                    intptr_t tags) {
@@ -1376,6 +1460,7 @@ ForwardList::ForwardList(intptr_t first_object_id)
   while (page_space->tasks() > 0) {
     ml.Wait();
   }
+  page_space->CompleteSweep();
   page_space->set_tasks(1);
 }
 
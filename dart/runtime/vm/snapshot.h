@@ -19,6 +19,7 @@ namespace dart {
 
 // Forward declarations.
 class AbstractType;
+class AdoptedMessageBuffer;
 class Array;
 class Class;
 class ClassTable;
@@ -27,6 +28,7 @@ class GrowableObjectArray;
 class Heap;
 class LanguageError;
 class Library;
+class Message;
 class Object;
 class PassiveObject;
 class ObjectStore;
@@ -40,6 +42,7 @@ class RawClass;
 class RawClosureData;
 class RawContext;
 class RawDouble;
+class RawExternalTypedData;
 class RawField;
 class RawFloat32x4;
 class RawFloat64x2;
@@ -263,6 +266,15 @@ class SnapshotReader : public BaseReader {
   TokenStream* StreamHandle() { return &stream_; }
   ExternalTypedData* DataHandle() { return &data_; }
 
+  // Allows byte arrays of at least FLAG_message_adopt_threshold bytes to be
+  // read as external typed data over the buffer of 'message' rather than
+  // copied. The reader takes the buffer from 'message' on the first such
+  // array; it is freed once none of them are reachable any more.
+  void set_adoptable_message(Message* message) {
+    ASSERT(kind_ == Snapshot::kMessage);
+    adoptable_message_ = message;
+  }
+
   // Reads an object.
   RawObject* ReadObject();
 
@@ -369,6 +381,10 @@ class SnapshotReader : public BaseReader {
 
   void ArrayReadFrom(const Array& result, intptr_t len, intptr_t tags);
 
+  // Reads typed data, in place over the message buffer if possible.
+  RawObject* ReadTypedData(intptr_t object_id, intptr_t tags);
+  RawExternalTypedData* AdoptTypedData(intptr_t class_id, intptr_t len);
+
   intptr_t NextAvailableObjectId() const;
 
   void SetReadException(const char* msg);
@@ -392,6 +408,8 @@ class SnapshotReader : public BaseReader {
   ExternalTypedData& data_;  // Temporary stream data handle.
   UnhandledException& error_;  // Error handle.
   GrowableArray<BackRefNode> backward_references_;
+  Message* adoptable_message_;  // Message whose buffer may be read in place.
+  AdoptedMessageBuffer* adopted_buffer_;  // Once taken from the message.
 
   friend class ApiError;
   friend class Array;
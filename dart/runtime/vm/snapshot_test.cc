@@ -11,6 +11,7 @@
 #include "vm/dart_api_message.h"
 #include "vm/dart_api_state.h"
 #include "vm/flags.h"
+#include "vm/message.h"
 #include "vm/snapshot.h"
 #include "vm/symbols.h"
 #include "vm/unicode.h"
@@ -19,6 +20,7 @@
 namespace dart {
 
 DECLARE_FLAG(bool, enable_type_checks);
+DECLARE_FLAG(int, message_adopt_threshold);
 
 // Check if serialized and deserialized objects are equal.
 static bool Equals(const Object& expected, const Object& actual) {
@@ -816,6 +818,51 @@ TEST_CASE(SerializeEmptyByteArray) {
 }
 
 
+TEST_CASE(SerializeAdoptedByteArray) {
+  StackZone zone(Isolate::Current());
+
+  // Write a message with one byte array above and one below the threshold.
+  uint8_t* buffer;
+  MessageWriter writer(&buffer, &malloc_allocator, true);
+  const intptr_t kLargeLength = FLAG_message_adopt_threshold;
+  const intptr_t kSmallLength = 16;
+  const Array& array = Array::Handle(Array::New(2));
+  TypedData& typed_data = TypedData::Handle(
+      TypedData::New(kTypedDataUint8ArrayCid, kLargeLength));
+  for (intptr_t i = 0; i < kLargeLength; i++) {
+    typed_data.SetUint8(i, i & 0xff);
+  }
+  array.SetAt(0, typed_data);
+  typed_data = TypedData::New(kTypedDataInt8ArrayCid, kSmallLength);
+  array.SetAt(1, typed_data);
+  writer.WriteMessage(array);
+  Message* message = new Message(Message::kIllegalPort,
+                                 buffer,
+                                 writer.BytesWritten(),
+                                 Message::kNormalPriority);
+
+  // Read it back, adopting the message buffer for the large array.
+  SnapshotReader reader(message->data(), message->len(),
+                        Snapshot::kMessage, Isolate::Current(), zone.GetZone());
+  reader.set_adoptable_message(message);
+  Array& serialized_array = Array::Handle();
+  serialized_array ^= reader.ReadObject();
+  EXPECT(message->data() == NULL);
+  delete message;
+
+  ExternalTypedData& adopted = ExternalTypedData::Handle();
+  adopted ^= serialized_array.At(0);
+  EXPECT_EQ(kExternalTypedDataUint8ArrayCid, adopted.GetClassId());
+  EXPECT_EQ(kLargeLength, adopted.Length());
+  for (intptr_t i = 0; i < kLargeLength; i++) {
+    EXPECT_EQ(i & 0xff, adopted.GetUint8(i));
+  }
+  typed_data ^= serialized_array.At(1);
+  EXPECT_EQ(kTypedDataInt8ArrayCid, typed_data.GetClassId());
+  EXPECT_EQ(kSmallLength, typed_data.Length());
+}
+
+
 class TestSnapshotWriter : public SnapshotWriter {
  public:
   static const intptr_t kInitialSize = 64 * KB;
@@ -2754,6 +2801,325 @@ UNIT_TEST_CASE(PostCObject) {
 }
 
 
+// Builds a message of the values the builder supports.
+static void BuildMessage(ApiMessageBuilder* builder) {
+  static const uint8_t kBytes[] = { 1, 2, 255 };
+  // Two words, 0 and 0xFFFFFFFF, starting at an unaligned offset.
+  static const uint8_t kWords[] = { 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+  EXPECT(builder->BeginArray(12));
+  EXPECT(builder->AddNull());
+  EXPECT(builder->AddBool(true));
+  EXPECT(builder->AddInt64(42));
+  EXPECT(builder->AddInt64(kMaxInt64));
+  EXPECT(builder->AddDouble(3.14));
+  EXPECT(builder->AddString("Hello"));
+  EXPECT(builder->AddString("æøå"));
+  EXPECT(builder->AddString("\xF0\x9D\x84\x9E"));  // U+1D11E.
+  EXPECT(builder->BeginArray(3));
+  EXPECT(builder->AddInt64(1));
+  EXPECT(builder->BeginArray(2));
+  EXPECT(builder->AddInt64(2));
+  EXPECT(builder->AddString("x"));
+  EXPECT(builder->EndArray());
+  EXPECT(builder->BeginArray(0));
+  EXPECT(builder->EndArray());
+  EXPECT(builder->EndArray());
+  EXPECT(builder->AddTypedData(Dart_TypedData_kUint8, kBytes, sizeof(kBytes)));
+  EXPECT(builder->AddTypedData(Dart_TypedData_kUint32,
+                               kWords + 1,
+                               sizeof(kWords) - 1));
+  EXPECT(builder->BeginArray(1));
+  EXPECT(builder->AddString("last"));
+  EXPECT(builder->EndArray());
+  EXPECT(builder->EndArray());
+}
+
+
+TEST_CASE(MessageBuilder) {
+  ApiMessageBuilder builder;
+  uint8_t* buffer = NULL;
+  intptr_t buffer_len = 0;
+  // The builder is reused from one message to the next.
+  for (intptr_t i = 0; i < 2; i++) {
+    BuildMessage(&builder);
+    free(buffer);
+    EXPECT(builder.Finish(&buffer, &buffer_len));
+  }
+
+  // Read the message back as Dart objects.
+  {
+    StackZone zone(Isolate::Current());
+    SnapshotReader reader(buffer, buffer_len,
+                          Snapshot::kMessage, Isolate::Current(),
+                          zone.GetZone());
+    const Array& array = Array::CheckedHandle(reader.ReadObject());
+    EXPECT_EQ(12, array.Length());
+    EXPECT(array.At(0) == Object::null());
+    EXPECT(array.At(1) == Bool::True().raw());
+    EXPECT_EQ(42, Smi::Value(Smi::RawCast(array.At(2))));
+    EXPECT_EQ(kMaxInt64, Integer::Handle(Integer::RawCast(
+        array.At(3))).AsInt64Value());
+    EXPECT_EQ(3.14, Double::Handle(Double::RawCast(array.At(4))).value());
+    EXPECT(String::Handle(String::RawCast(array.At(6))).Equals(
+        String::Handle(String::New("æøå"))));
+    const String& supplementary = String::Handle(String::RawCast(array.At(7)));
+    EXPECT(supplementary.IsTwoByteString());
+    EXPECT_EQ(2, supplementary.Length());
+    const Array& nested = Array::Handle(Array::RawCast(array.At(8)));
+    EXPECT_EQ(3, nested.Length());
+    EXPECT_EQ(2, Array::Handle(Array::RawCast(nested.At(1))).Length());
+    EXPECT_EQ(0, Array::Handle(Array::RawCast(nested.At(2))).Length());
+    const TypedData& words = TypedData::Handle(TypedData::RawCast(
+        array.At(10)));
+    EXPECT_EQ(2, words.Length());
+    EXPECT_EQ(0U, words.GetUint32(0));
+    EXPECT_EQ(0xFFFFFFFF, words.GetUint32(sizeof(uint32_t)));
+    const Array& last = Array::Handle(Array::RawCast(array.At(11)));
+    EXPECT(String::Handle(String::RawCast(last.At(0))).Equals("last"));
+  }
+
+  // Read the message back into a C structure.
+  ApiNativeScope scope;
+  ApiMessageReader api_reader(buffer, buffer_len, &zone_allocator);
+  Dart_CObject* root = api_reader.ReadMessage();
+  EXPECT_EQ(Dart_CObject_kArray, root->type);
+  EXPECT_EQ(12, root->value.as_array.length);
+  Dart_CObject** values = root->value.as_array.values;
+  EXPECT_EQ(Dart_CObject_kNull, values[0]->type);
+  EXPECT(values[1]->value.as_bool);
+  EXPECT_EQ(42, values[2]->value.as_int32);
+  EXPECT_EQ(kMaxInt64, values[3]->value.as_int64);
+  EXPECT_STREQ("Hello", values[5]->value.as_string);
+  EXPECT_STREQ("\xF0\x9D\x84\x9E", values[7]->value.as_string);
+  Dart_CObject* nested = values[8]->value.as_array.values[1];
+  EXPECT_EQ(2, nested->value.as_array.length);
+  EXPECT_STREQ("x", nested->value.as_array.values[1]->value.as_string);
+  EXPECT_EQ(Dart_TypedData_kUint8, values[9]->value.as_typed_data.type);
+  EXPECT_EQ(255, values[9]->value.as_typed_data.values[2]);
+
+  // Read the message back value by value.
+  ApiMessageStreamReader stream_reader;
+  EXPECT(stream_reader.Reset(buffer, buffer_len));
+  intptr_t length = 0;
+  EXPECT(stream_reader.BeginArray(&length));
+  EXPECT_EQ(12, length);
+  EXPECT(stream_reader.ReadNull());
+  bool bool_value = false;
+  EXPECT(stream_reader.ReadBool(&bool_value));
+  EXPECT(bool_value);
+  int64_t int_value = 0;
+  EXPECT_EQ(Dart_CObject_kInt32, stream_reader.NextType());
+  EXPECT(stream_reader.ReadInt64(&int_value));
+  EXPECT_EQ(42, int_value);
+  EXPECT_EQ(Dart_CObject_kInt64, stream_reader.NextType());
+  EXPECT(stream_reader.ReadInt64(&int_value));
+  EXPECT_EQ(kMaxInt64, int_value);
+  double double_value = 0.0;
+  EXPECT(!stream_reader.ReadInt64(&int_value));
+  EXPECT(stream_reader.ReadDouble(&double_value));
+  EXPECT_EQ(3.14, double_value);
+  const char* str = NULL;
+  EXPECT(stream_reader.ReadString(&str, &length));
+  EXPECT_STREQ("Hello", str);
+  EXPECT(stream_reader.ReadString(&str, &length));
+  EXPECT_STREQ("æøå", str);
+  EXPECT_EQ(6, length);
+  EXPECT(stream_reader.ReadString(&str, &length));
+  EXPECT_STREQ("\xF0\x9D\x84\x9E", str);
+  EXPECT(stream_reader.BeginArray(&length));
+  EXPECT_EQ(3, length);
+  EXPECT(stream_reader.ReadInt64(&int_value));
+  EXPECT_EQ(1, int_value);
+  EXPECT(!stream_reader.EndArray());
+  EXPECT(stream_reader.Skip());
+  EXPECT(stream_reader.BeginArray(&length));
+  EXPECT_EQ(0, length);
+  EXPECT(stream_reader.EndArray());
+  EXPECT(stream_reader.EndArray());
+  Dart_TypedData_Type type;
+  const uint8_t* data = NULL;
+  EXPECT(stream_reader.ReadTypedData(&type, &data, &length));
+  EXPECT_EQ(Dart_TypedData_kUint8, type);
+  EXPECT_EQ(3, length);
+  EXPECT_EQ(255, data[2]);
+  EXPECT(stream_reader.ReadTypedData(&type, &data, &length));
+  EXPECT_EQ(Dart_TypedData_kUint32, type);
+  EXPECT_EQ(8, length);
+  EXPECT_EQ(0xFFFFFFFF, reinterpret_cast<const uint32_t*>(data)[1]);
+  EXPECT(stream_reader.BeginArray(&length));
+  EXPECT(stream_reader.ReadString(&str, &length));
+  EXPECT_STREQ("last", str);
+  EXPECT(stream_reader.EndArray());
+  EXPECT_EQ(Dart_CObject_kUnsupported, stream_reader.NextType());
+  EXPECT(stream_reader.EndArray());
+  EXPECT_EQ(Dart_CObject_kUnsupported, stream_reader.NextType());
+  free(buffer);
+}
+
+
+TEST_CASE(MessageBuilderFails) {
+  ApiMessageBuilder builder;
+  uint8_t* buffer = NULL;
+  intptr_t buffer_len = 0;
+  EXPECT(!builder.Finish(&buffer, &buffer_len));
+
+  // Only one value makes a message.
+  EXPECT(builder.AddInt64(1));
+  EXPECT(!builder.AddInt64(2));
+  EXPECT(!builder.Finish(&buffer, &buffer_len));
+
+  // Arrays take exactly their length of elements.
+  EXPECT(builder.BeginArray(1));
+  EXPECT(!builder.EndArray());
+  EXPECT(!builder.Finish(&buffer, &buffer_len));
+  EXPECT(builder.BeginArray(1));
+  EXPECT(builder.AddNull());
+  EXPECT(!builder.AddNull());
+  EXPECT(!builder.Finish(&buffer, &buffer_len));
+  EXPECT(builder.BeginArray(1));
+  EXPECT(builder.AddNull());
+  EXPECT(!builder.Finish(&buffer, &buffer_len));
+
+  EXPECT(!builder.AddString("\xFF"));
+  EXPECT(!builder.Finish(&buffer, &buffer_len));
+  int16_t halves[] = { 1, 2 };
+  EXPECT(!builder.AddTypedData(Dart_TypedData_kInt16,
+                               reinterpret_cast<uint8_t*>(halves),
+                               sizeof(halves)));
+  EXPECT(!builder.Finish(&buffer, &buffer_len));
+
+  // A failed message does not affect the next one.
+  EXPECT(builder.AddString("ok"));
+  EXPECT(builder.Finish(&buffer, &buffer_len));
+  ApiMessageStreamReader reader;
+  EXPECT(reader.Reset(buffer, buffer_len));
+  const char* str = NULL;
+  intptr_t length = 0;
+  EXPECT(reader.ReadString(&str, &length));
+  EXPECT_STREQ("ok", str);
+  free(buffer);
+}
+
+
+// Serializes the result of a top level Dart function into a message.
+static void GetDartMessage(Dart_Handle lib,
+                           const char* dart_function,
+                           uint8_t** buffer,
+                           intptr_t* buffer_len) {
+  Dart_Handle result = Dart_Invoke(lib, NewString(dart_function), 0, NULL);
+  EXPECT_VALID(result);
+  MessageWriter writer(buffer, &zone_allocator, false);
+  const Object& object = Object::Handle(Api::UnwrapHandle(result));
+  writer.WriteMessage(object);
+  *buffer_len = writer.BytesWritten();
+}
+
+
+UNIT_TEST_CASE(DartGeneratedMessageStreamReader) {
+  static const char* kScriptChars =
+      "import 'dart:typed_data';\n"
+      "getList() {\n"
+      "  var s = 'shared';\n"
+      "  var fixed = new List(2);\n"
+      "  fixed[0] = s;\n"
+      "  fixed[1] = 0x7FFFFFFFFFFFFFFF;\n"
+      "  var bytes = new Uint8List(3);\n"
+      "  bytes[1] = 7;\n"
+      "  var halves = new Int16List(2);\n"
+      "  halves[1] = -3;\n"
+      "  return [s, 1, 2.5, null, [true, [s]], fixed, fixed, bytes, halves,\n"
+      "          const ['c']];\n"
+      "}\n"
+      "getView() {\n"
+      "  return [1, new Uint8List.view(new Uint8List(4).buffer, 1, 2)];\n"
+      "}\n";
+
+  TestCase::CreateTestIsolate();
+  Isolate* isolate = Isolate::Current();
+  EXPECT(isolate != NULL);
+  Dart_EnterScope();
+
+  Dart_Handle lib = TestCase::LoadTestScript(kScriptChars, NULL);
+  EXPECT_VALID(lib);
+
+  {
+    DARTSCOPE(isolate);
+    ApiMessageStreamReader reader;
+    uint8_t* buffer;
+    intptr_t buffer_len;
+
+    GetDartMessage(lib, "getList", &buffer, &buffer_len);
+    EXPECT(reader.Reset(buffer, buffer_len));
+    intptr_t length = 0;
+    const char* str = NULL;
+    int64_t int_value = 0;
+    EXPECT(reader.BeginArray(&length));
+    EXPECT_EQ(10, length);
+    EXPECT(reader.ReadString(&str, &length));
+    EXPECT_STREQ("shared", str);
+    EXPECT(reader.ReadInt64(&int_value));
+    EXPECT_EQ(1, int_value);
+    EXPECT_EQ(Dart_CObject_kDouble, reader.NextType());
+    EXPECT(reader.Skip());
+    EXPECT(reader.ReadNull());
+    // A growable list within the list.
+    EXPECT(reader.BeginArray(&length));
+    EXPECT_EQ(2, length);
+    bool bool_value = false;
+    EXPECT(reader.ReadBool(&bool_value));
+    EXPECT(bool_value);
+    EXPECT(reader.BeginArray(&length));
+    EXPECT_EQ(1, length);
+    EXPECT(reader.ReadString(&str, &length));
+    EXPECT_STREQ("shared", str);
+    EXPECT(reader.EndArray());
+    EXPECT(reader.EndArray());
+    // A fixed length list, written after the list and then referenced.
+    for (intptr_t i = 0; i < 2; i++) {
+      EXPECT(reader.BeginArray(&length));
+      EXPECT_EQ(2, length);
+      EXPECT(reader.ReadString(&str, &length));
+      EXPECT_STREQ("shared", str);
+      EXPECT(reader.ReadInt64(&int_value));
+      EXPECT_EQ(kMaxInt64, int_value);
+      EXPECT(reader.EndArray());
+    }
+    Dart_TypedData_Type type;
+    const uint8_t* data = NULL;
+    EXPECT(reader.ReadTypedData(&type, &data, &length));
+    EXPECT_EQ(Dart_TypedData_kUint8, type);
+    EXPECT_EQ(3, length);
+    EXPECT_EQ(7, data[1]);
+    EXPECT(reader.ReadTypedData(&type, &data, &length));
+    EXPECT_EQ(Dart_TypedData_kInt16, type);
+    EXPECT_EQ(4, length);
+    EXPECT_EQ(-3, reinterpret_cast<const int16_t*>(data)[1]);
+    EXPECT(reader.BeginArray(&length));
+    EXPECT_EQ(1, length);
+    EXPECT(reader.Skip());
+    EXPECT(reader.EndArray());
+    EXPECT(reader.EndArray());
+
+    // Instances, such as typed data views, cannot be read value by value,
+    // but the message can still be decoded.
+    GetDartMessage(lib, "getView", &buffer, &buffer_len);
+    EXPECT(!reader.Reset(buffer, buffer_len));
+    EXPECT_EQ(Dart_CObject_kUnsupported, reader.NextType());
+    EXPECT(!reader.BeginArray(&length));
+    ApiNativeScope scope;
+    Dart_CObject* root = Dart_MessageReaderReadCObject(
+        reinterpret_cast<Dart_MessageReader>(&reader));
+    EXPECT_EQ(Dart_CObject_kArray, root->type);
+    EXPECT_EQ(2, root->value.as_array.length);
+    Dart_CObject* view = root->value.as_array.values[1];
+    EXPECT_EQ(Dart_CObject_kTypedData, view->type);
+    EXPECT_EQ(2, view->value.as_typed_data.length);
+  }
+  Dart_ExitScope();
+  Dart_ShutdownIsolate();
+}
+
+
 TEST_CASE(OmittedObjectEncodingLength) {
   StackZone zone(Isolate::Current());
   uint8_t* buffer;
@@ -15,10 +15,13 @@ struct SpaceUsage {
   SpaceUsage()
     : capacity_in_words(0),
       used_in_words(0),
-      external_in_words(0) {}
+      external_in_words(0),
+      large_in_words(0) {}
   intptr_t capacity_in_words;
   intptr_t used_in_words;
   intptr_t external_in_words;
+  // The part of the capacity in pages holding a single large object.
+  intptr_t large_in_words;
 };
 
 }  // namespace dart
@@ -47,6 +47,7 @@ class RawCode;
   V(FixAllocateArrayStubTarget)                                                \
   V(CallClosureNoSuchMethod)                                                   \
   V(AllocateContext)                                                           \
+  V(MarkingBarrier)                                                            \
   V(UpdateStoreBuffer)                                                         \
   V(OneArgCheckInlineCache)                                                    \
   V(TwoArgsCheckInlineCache)                                                   \
@@ -960,15 +960,62 @@ void StubCode::GenerateAllocateContextStub(Assembler* assembler) {
 }
 
 
+DECLARE_LEAF_RUNTIME_ENTRY(void,
+                           MarkingBarrier,
+                           Isolate* isolate,
+                           RawObject* value);
+
+// Helper stub to implement the incremental marking barrier of
+// Assembler::StoreIntoObject.
+// Input parameters:
+//   R0: Old object being stored
+void StubCode::GenerateMarkingBarrierStub(Assembler* assembler) {
+  // Skip the runtime call if the value is already marked.
+  Label shade;
+  __ ldr(IP, FieldAddress(R0, Object::tags_offset()));
+  __ tst(IP, Operand(1 << RawObject::kMarkBit));
+  __ b(&shade, EQ);
+  __ Ret();
+
+  __ Bind(&shade);
+  // Setup frame, push callee-saved registers.
+  __ EnterCallRuntimeFrame(0 * kWordSize);
+  __ mov(R1, Operand(R0));
+  __ LoadIsolate(R0);
+  __ CallRuntime(kMarkingBarrierRuntimeEntry, 2);
+  // Restore callee-saved registers, tear down frame.
+  __ LeaveCallRuntimeFrame();
+  __ Ret();
+}
+
+
 DECLARE_LEAF_RUNTIME_ENTRY(void, StoreBufferBlockProcess, Isolate* isolate);
 
 // Helper stub to implement Assembler::StoreIntoObject.
 // Input parameters:
 //   R0: address (i.e. object) being stored into.
+//   R1: address of the updated slot.
 void StubCode::GenerateUpdateStoreBufferStub(Assembler* assembler) {
   // Save values being destroyed.
   __ PushList((1 << R1) | (1 << R2) | (1 << R3));
 
+  // Mark the card of the slot if the object is a card remembered array. The
+  // array is alone on its large page.
+  // Spilled: R1, R2, R3
+  // R0: Address being stored
+  // R1: Address of the updated slot
+  Label remember_object;
+  __ ldr(R2, FieldAddress(R0, Object::tags_offset()));
+  __ tst(R2, Operand(1 << RawObject::kCardRememberedBit));
+  __ b(&remember_object, EQ);
+  __ AddImmediate(R3, R0, -kHeapObjectTag - HeapPage::ObjectStartOffset());
+  __ sub(R2, R1, Operand(R3));
+  __ mov(R2, Operand(R2, LSR, HeapPage::kCardSizeLog2));
+  __ ldr(R3, Address(R3, HeapPage::card_table_offset()));
+  __ mov(R1, Operand(1));
+  __ strb(R1, Address(R3, R2));
+  __ Bind(&remember_object);
+
   Label add_to_buffer;
   // Check whether this object has already been remembered. Skip adding to the
   // store buffer if the object is in the store buffer already.
@@ -1004,12 +1004,57 @@ void StubCode::GenerateAllocateContextStub(Assembler* assembler) {
 }
 
 
+DECLARE_LEAF_RUNTIME_ENTRY(void,
+                           MarkingBarrier,
+                           Isolate* isolate,
+                           RawObject* value);
+
+// Helper stub to implement the incremental marking barrier of
+// Assembler::StoreIntoObject.
+// Input parameters:
+//   R0: Old object being stored
+void StubCode::GenerateMarkingBarrierStub(Assembler* assembler) {
+  // Skip the runtime call if the value is already marked.
+  Label shade;
+  __ LoadFieldFromOffset(TMP, R0, Object::tags_offset(), kNoPP);
+  __ tsti(TMP, Immediate(1 << RawObject::kMarkBit));
+  __ b(&shade, EQ);
+  __ ret();
+
+  __ Bind(&shade);
+  // Setup frame, push callee-saved registers.
+  __ EnterCallRuntimeFrame(0 * kWordSize);
+  __ mov(R1, R0);
+  __ LoadIsolate(R0, kNoPP);
+  __ CallRuntime(kMarkingBarrierRuntimeEntry, 2);
+  // Restore callee-saved registers, tear down frame.
+  __ LeaveCallRuntimeFrame();
+  __ ret();
+}
+
+
 DECLARE_LEAF_RUNTIME_ENTRY(void, StoreBufferBlockProcess, Isolate* isolate);
 
 // Helper stub to implement Assembler::StoreIntoObject.
 // Input parameters:
 //   R0: Address being stored
+//   R1: Address of the updated slot, preserved by the caller
 void StubCode::GenerateUpdateStoreBufferStub(Assembler* assembler) {
+  // Mark the card of the slot if the object is a card remembered array. The
+  // array is alone on its large page.
+  Label remember_object;
+  __ LoadFieldFromOffset(TMP, R0, Object::tags_offset(), kNoPP);
+  __ tsti(TMP, Immediate(1 << RawObject::kCardRememberedBit));
+  __ b(&remember_object, EQ);
+  __ AddImmediate(TMP2, R0, -kHeapObjectTag - HeapPage::ObjectStartOffset(),
+                  kNoPP);
+  __ sub(R1, R1, Operand(TMP2));
+  __ LsrImmediate(R1, R1, HeapPage::kCardSizeLog2);
+  __ LoadFromOffset(TMP2, TMP2, HeapPage::card_table_offset(), kNoPP);
+  __ LoadImmediate(TMP, 1, kNoPP);
+  __ str(TMP, Address(TMP2, R1), kUnsignedByte);
+  __ Bind(&remember_object);
+
   Label add_to_buffer;
   // Check whether this object has already been remembered. Skip adding to the
   // store buffer if the object is in the store buffer already.
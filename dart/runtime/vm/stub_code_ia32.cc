@@ -915,16 +915,65 @@ void StubCode::GenerateAllocateContextStub(Assembler* assembler) {
   __ ret();
 }
 
+DECLARE_LEAF_RUNTIME_ENTRY(void,
+                           MarkingBarrier,
+                           Isolate* isolate,
+                           RawObject* value);
+
+// Helper stub to implement the incremental marking barrier of
+// Assembler::StoreIntoObject.
+// Input parameters:
+//   EDX: Old object being stored
+void StubCode::GenerateMarkingBarrierStub(Assembler* assembler) {
+  // Skip the runtime call if the value is already marked.
+  Label shade;
+  __ pushl(ECX);
+  __ movl(ECX, FieldAddress(EDX, Object::tags_offset()));
+  __ testl(ECX, Immediate(1 << RawObject::kMarkBit));
+  __ popl(ECX);
+  __ j(ZERO, &shade, Assembler::kNearJump);
+  __ ret();
+
+  __ Bind(&shade);
+  // Setup frame, push callee-saved registers.
+  __ EnterCallRuntimeFrame(2 * kWordSize);
+  __ movl(Address(ESP, 1 * kWordSize), EDX);  // Value.
+  __ LoadIsolate(EAX);
+  __ movl(Address(ESP, 0 * kWordSize), EAX);  // Isolate.
+  __ CallRuntime(kMarkingBarrierRuntimeEntry, 2);
+  // Restore callee-saved registers, tear down frame.
+  __ LeaveCallRuntimeFrame();
+  __ ret();
+}
+
+
 DECLARE_LEAF_RUNTIME_ENTRY(void, StoreBufferBlockProcess, Isolate* isolate);
 
 // Helper stub to implement Assembler::StoreIntoObject.
 // Input parameters:
 //   EDX: Address being stored
+//   ESP + 4: Address of the updated slot
 void StubCode::GenerateUpdateStoreBufferStub(Assembler* assembler) {
   // Save values being destroyed.
   __ pushl(EAX);
   __ pushl(ECX);
 
+  // Mark the card of the slot if the object is a card remembered array. The
+  // array is alone on its large page.
+  // Spilled: EAX, ECX
+  // EDX: Address being stored
+  Label remember_object;
+  __ movl(ECX, FieldAddress(EDX, Object::tags_offset()));
+  __ testl(ECX, Immediate(1 << RawObject::kCardRememberedBit));
+  __ j(ZERO, &remember_object, Assembler::kNearJump);
+  __ leal(EAX, Address(EDX, -kHeapObjectTag - HeapPage::ObjectStartOffset()));
+  __ movl(ECX, Address(ESP, 3 * kWordSize));
+  __ subl(ECX, EAX);
+  __ shrl(ECX, Immediate(HeapPage::kCardSizeLog2));
+  __ movl(EAX, Address(EAX, HeapPage::card_table_offset()));
+  __ movb(Address(EAX, ECX, TIMES_1, 0), Immediate(1));
+  __ Bind(&remember_object);
+
   Label add_to_buffer;
   // Check whether this object has already been remembered. Skip adding to the
   // store buffer if the object is in the store buffer already.
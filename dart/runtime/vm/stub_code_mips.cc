@@ -1059,12 +1059,45 @@ void StubCode::GenerateAllocateContextStub(Assembler* assembler) {
 }
 
 
+DECLARE_LEAF_RUNTIME_ENTRY(void,
+                           MarkingBarrier,
+                           Isolate* isolate,
+                           RawObject* value);
+
+
+// Helper stub to implement the incremental marking barrier of
+// Assembler::StoreIntoObject.
+// Input parameters:
+//   T0: Old object being stored.
+void StubCode::GenerateMarkingBarrierStub(Assembler* assembler) {
+  __ Comment("MarkingBarrierStub");
+  // Skip the runtime call if the value is already marked.
+  Label shade;
+  __ lw(TMP, FieldAddress(T0, Object::tags_offset()));
+  __ andi(CMPRES1, TMP, Immediate(1 << RawObject::kMarkBit));
+  __ beq(CMPRES1, ZR, &shade);
+  __ Ret();
+
+  __ Bind(&shade);
+  // Setup frame, push callee-saved registers.
+  __ EnterCallRuntimeFrame(2 * kWordSize);
+  __ mov(A1, T0);
+  __ LoadIsolate(A0);
+  __ CallRuntime(kMarkingBarrierRuntimeEntry, 2);
+  __ Comment("MarkingBarrierStub return");
+  // Restore callee-saved registers, tear down frame.
+  __ LeaveCallRuntimeFrame();
+  __ Ret();
+}
+
+
 DECLARE_LEAF_RUNTIME_ENTRY(void, StoreBufferBlockProcess, Isolate* isolate);
 
 
 // Helper stub to implement Assembler::StoreIntoObject.
 // Input parameters:
 //   T0: Address (i.e. object) being stored into.
+//   T1: Address of the updated slot.
 void StubCode::GenerateUpdateStoreBufferStub(Assembler* assembler) {
   // Save values being destroyed.
   __ Comment("UpdateStoreBufferStub");
@@ -1073,6 +1106,24 @@ void StubCode::GenerateUpdateStoreBufferStub(Assembler* assembler) {
   __ sw(T2, Address(SP, 1 * kWordSize));
   __ sw(T1, Address(SP, 0 * kWordSize));
 
+  // Mark the card of the slot if the object is a card remembered array. The
+  // array is alone on its large page.
+  // Spilled: T1, T2, T3.
+  // T0: Address being stored.
+  // T1: Address of the updated slot.
+  Label remember_object;
+  __ lw(T2, FieldAddress(T0, Object::tags_offset()));
+  __ andi(CMPRES1, T2, Immediate(1 << RawObject::kCardRememberedBit));
+  __ beq(CMPRES1, ZR, &remember_object);
+  __ AddImmediate(T3, T0, -kHeapObjectTag - HeapPage::ObjectStartOffset());
+  __ subu(T2, T1, T3);
+  __ srl(T2, T2, HeapPage::kCardSizeLog2);
+  __ lw(T3, Address(T3, HeapPage::card_table_offset()));
+  __ addu(T3, T3, T2);
+  __ LoadImmediate(T2, 1);
+  __ sb(T2, Address(T3, 0));
+  __ Bind(&remember_object);
+
   Label add_to_buffer;
   // Check whether this object has already been remembered. Skip adding to the
   // store buffer if the object is in the store buffer already.
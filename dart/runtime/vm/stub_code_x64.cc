@@ -952,16 +952,63 @@ void StubCode::GenerateAllocateContextStub(Assembler* assembler) {
 }
 
 
+DECLARE_LEAF_RUNTIME_ENTRY(void,
+                           MarkingBarrier,
+                           Isolate* isolate,
+                           RawObject* value);
+
+// Helper stub to implement the incremental marking barrier of
+// Assembler::StoreIntoObject.
+// Input parameters:
+//   RDX: Old object being stored
+void StubCode::GenerateMarkingBarrierStub(Assembler* assembler) {
+  // Skip the runtime call if the value is already marked.
+  Label shade;
+  __ pushq(RCX);
+  __ movq(RCX, FieldAddress(RDX, Object::tags_offset()));
+  __ testq(RCX, Immediate(1 << RawObject::kMarkBit));
+  __ popq(RCX);
+  __ j(ZERO, &shade, Assembler::kNearJump);
+  __ ret();
+
+  __ Bind(&shade);
+  // Setup frame, push callee-saved registers.
+  __ EnterCallRuntimeFrame(0);
+  __ movq(CallingConventions::kArg2Reg, RDX);
+  __ LoadIsolate(CallingConventions::kArg1Reg);
+  __ CallRuntime(kMarkingBarrierRuntimeEntry, 2);
+  __ LeaveCallRuntimeFrame();
+  __ ret();
+}
+
+
 DECLARE_LEAF_RUNTIME_ENTRY(void, StoreBufferBlockProcess, Isolate* isolate);
 
 // Helper stub to implement Assembler::StoreIntoObject.
 // Input parameters:
 //   RDX: Address being stored
+//   RSP + 8: Address of the updated slot
 void StubCode::GenerateUpdateStoreBufferStub(Assembler* assembler) {
   // Save registers being destroyed.
   __ pushq(RAX);
   __ pushq(RCX);
 
+  // Mark the card of the slot if the object is a card remembered array. The
+  // array is alone on its large page.
+  // Spilled: RAX, RCX
+  // RDX: Address being stored
+  Label remember_object;
+  __ movq(RCX, FieldAddress(RDX, Object::tags_offset()));
+  __ testq(RCX, Immediate(1 << RawObject::kCardRememberedBit));
+  __ j(ZERO, &remember_object, Assembler::kNearJump);
+  __ leaq(RAX, Address(RDX, -kHeapObjectTag - HeapPage::ObjectStartOffset()));
+  __ movq(RCX, Address(RSP, 3 * kWordSize));
+  __ subq(RCX, RAX);
+  __ shrq(RCX, Immediate(HeapPage::kCardSizeLog2));
+  __ movq(RAX, Address(RAX, HeapPage::card_table_offset()));
+  __ movb(Address(RAX, RCX, TIMES_1, 0), Immediate(1));
+  __ Bind(&remember_object);
+
   Label add_to_buffer;
   // Check whether this object has already been remembered. Skip adding to the
   // store buffer if the object is in the store buffer already.
@@ -602,6 +602,7 @@ PREDEFINED_SYMBOLS_LIST(DEFINE_SYMBOL_HANDLE_ACCESSOR)
   friend class SnapshotReader;
   friend class SnapshotWriter;
   friend class ApiMessageReader;
+  friend class ApiMessageStreamReader;
 
   DISALLOW_COPY_AND_ASSIGN(Symbols);
 };
@@ -4,6 +4,7 @@
 
 #include "vm/thread_pool.h"
 
+#include "vm/atomic.h"
 #include "vm/flags.h"
 #include "vm/lockers.h"
 
@@ -11,18 +12,71 @@ namespace dart {
 
 DEFINE_FLAG(int, worker_timeout_millis, 5000,
             "Free workers when they have been idle for this amount of time.");
-
+DEFINE_FLAG(int, thread_pool_size, 0,
+            "Number of workers a thread pool keeps running tasks at once "
+            "(0 means one per processor).");
+DEFINE_FLAG(int, thread_pool_starvation_millis, 50,
+            "Stop counting a worker toward the size of its thread pool once "
+            "it has run the same task for this amount of time, so that "
+            "queued tasks run on another worker.");
+
+ThreadLocalKey ThreadPool::worker_key_ = OSThread::kUnsetThreadLocalKey;
 Monitor* ThreadPool::exit_monitor_ = NULL;
 int* ThreadPool::exit_count_ = NULL;
 
+
+static intptr_t DefaultPoolSize() {
+  if (FLAG_thread_pool_size > 0) {
+    return FLAG_thread_pool_size;
+  }
+  return OS::NumberOfAvailableProcessors();
+}
+
+
 ThreadPool::ThreadPool()
-  : shutting_down_(false),
+  : size_(DefaultPoolSize()),
+    shutting_down_(false),
+    all_workers_(NULL),
+    idle_workers_(NULL),
+    watcher_running_(false),
+    watcher_waiting_(0),
+    queue_on_workers_(0),
+    count_started_(0),
+    count_stopped_(0),
+    count_running_(0),
+    count_idle_(0),
+    count_blocked_(0),
+    count_stolen_(0),
+    count_rescued_(0),
+    count_high_priority_queued_(0),
+    max_queue_depth_(0) {
+  if (worker_key_ == OSThread::kUnsetThreadLocalKey) {
+    worker_key_ = OSThread::CreateThreadLocal();
+  }
+}
+
+
+ThreadPool::ThreadPool(intptr_t size)
+  : size_(size),
+    shutting_down_(false),
     all_workers_(NULL),
     idle_workers_(NULL),
+    watcher_running_(false),
+    watcher_waiting_(0),
+    queue_on_workers_(0),
     count_started_(0),
     count_stopped_(0),
     count_running_(0),
-    count_idle_(0) {
+    count_idle_(0),
+    count_blocked_(0),
+    count_stolen_(0),
+    count_rescued_(0),
+    count_high_priority_queued_(0),
+    max_queue_depth_(0) {
+  ASSERT(size > 0);
+  if (worker_key_ == OSThread::kUnsetThreadLocalKey) {
+    worker_key_ = OSThread::CreateThreadLocal();
+  }
 }
 
 
@@ -31,36 +85,76 @@ ThreadPool::~ThreadPool() {
 }
 
 
+static void UpdateMaximum(intptr_t* maximum, intptr_t value) {
+  uword old_value = static_cast<uword>(*maximum);
+  while (static_cast<intptr_t>(old_value) < value) {
+    uword seen = AtomicOperations::CompareAndSwapWord(
+        reinterpret_cast<uword*>(maximum), old_value, value);
+    if (seen == old_value) {
+      return;
+    }
+    old_value = seen;
+  }
+}
+
+
 void ThreadPool::Run(Task* task) {
+  RunInternal(task, false);
+}
+
+
+void ThreadPool::RunLater(Task* task) {
+  RunInternal(task, true);
+}
+
+
+void ThreadPool::RunInternal(Task* task, bool later) {
+  Worker* current = CurrentWorker();
+  // Once all workers are busy, the tasks run by a worker are queued on it
+  // without taking the pool's monitor. The flag may be stale, but a task
+  // queued while a worker was idle is found by the starvation watcher.
+  if (!task->is_high_priority() &&
+      !later &&
+      (current != NULL) &&
+      (AtomicOperations::LoadRelaxed(&queue_on_workers_) != 0)) {
+    UpdateMaximum(&max_queue_depth_, current->AddLocalTask(task));
+    // The watcher set the flag before it last looked at our tasks, so it
+    // either saw this one or is waiting to be notified.
+    if (AtomicOperations::LoadRelaxed(&watcher_waiting_) != 0) {
+      MonitorLocker ml(&monitor_);
+      NotifyWatcher();
+    }
+    return;
+  }
   Worker* worker = NULL;
   bool new_worker = false;
   {
-    // We need ThreadPool::mutex_ to access worker lists and other
+    // We need ThreadPool::monitor_ to access worker lists and other
     // ThreadPool state.
-    MutexLocker ml(&mutex_);
+    MonitorLocker ml(&monitor_);
     if (shutting_down_) {
       return;
     }
-    if (idle_workers_ == NULL) {
-      worker = new Worker(this);
-      ASSERT(worker != NULL);
+    worker = TakeIdleWorker();
+    if ((worker == NULL) && !IsFull()) {
+      worker = AddWorker();
       new_worker = true;
-      count_started_++;
-
-      // Add worker to the all_workers_ list.
-      worker->all_next_ = all_workers_;
-      all_workers_ = worker;
-      worker->owned_ = true;
-    } else {
-      // Get the first worker from the idle worker list.
-      worker = idle_workers_;
-      idle_workers_ = worker->idle_next_;
-      worker->idle_next_ = NULL;
-      count_idle_--;
     }
-    count_running_++;
+    if (worker == NULL) {
+      if (task->is_high_priority()) {
+        high_priority_queue_.Add(task);
+        count_high_priority_queued_++;
+      } else if ((current != NULL) && !later) {
+        UpdateMaximum(&max_queue_depth_, current->AddLocalTask(task));
+      } else {
+        queue_.Add(task);
+        UpdateMaximum(&max_queue_depth_, queue_.length());
+      }
+      NotifyWatcher();
+      return;
+    }
   }
-  // Release ThreadPool::mutex_ before calling Worker functions.
+  // Release ThreadPool::monitor_ before calling Worker functions.
   ASSERT(worker != NULL);
   worker->SetTask(task);
   if (new_worker) {
@@ -70,10 +164,69 @@ void ThreadPool::Run(Task* task) {
 }
 
 
+void ThreadPool::RunDedicated(Task* task) {
+  Worker* worker = NULL;
+  bool new_worker = false;
+  {
+    MonitorLocker ml(&monitor_);
+    if (shutting_down_) {
+      return;
+    }
+    worker = TakeIdleWorker();
+    if (worker == NULL) {
+      worker = AddWorker();
+      new_worker = true;
+    }
+  }
+  // Release ThreadPool::monitor_ before calling Worker functions.
+  worker->SetTask(task);
+  if (new_worker) {
+    worker->StartThread();
+  }
+}
+
+
+bool ThreadPool::Promote(Task* task) {
+  MonitorLocker ml(&monitor_);
+  if (task->is_high_priority()) {
+    return false;
+  }
+  bool queued = queue_.Remove(task);
+  for (Worker* current = all_workers_;
+       !queued && (current != NULL);
+       current = current->all_next_) {
+    queued = current->RemoveLocalTask(task);
+  }
+  if (!queued) {
+    return false;
+  }
+  task->set_high_priority(true);
+  high_priority_queue_.Add(task);
+  count_high_priority_queued_++;
+  return true;
+}
+
+
+intptr_t ThreadPool::QueuedTasks() {
+  MonitorLocker ml(&monitor_);
+  intptr_t count = queue_.length() + high_priority_queue_.length();
+  for (Worker* current = all_workers_;
+       current != NULL;
+       current = current->all_next_) {
+    MutexLocker ql(&current->queue_mutex_);
+    count += current->run_queue_.length();
+    if (current->lifo_slot_ != NULL) {
+      count++;
+    }
+  }
+  return count;
+}
+
+
 void ThreadPool::Shutdown() {
   Worker* saved = NULL;
   {
-    MutexLocker ml(&mutex_);
+    MonitorLocker ml(&monitor_);
     shutting_down_ = true;
     saved = all_workers_;
     all_workers_ = NULL;
@@ -90,13 +243,29 @@ void ThreadPool::Shutdown() {
 
     count_idle_ = 0;
     count_running_ = 0;
+    count_blocked_ = 0;
+    UpdateQueueOnWorkers();
     ASSERT(count_started_ == count_stopped_);
+
+    // Tasks which have not started by now never will.
+    while (!queue_.IsEmpty()) {
+      delete queue_.RemoveFirst();
+    }
+    while (!high_priority_queue_.IsEmpty()) {
+      delete high_priority_queue_.RemoveFirst();
+    }
+
+    // The watcher must be gone before the pool is.
+    ml.NotifyAll();
+    while (watcher_running_) {
+      ml.Wait();
+    }
   }
-  // Release ThreadPool::mutex_ before calling Worker functions.
+  // Release ThreadPool::monitor_ before calling Worker functions.
 
   Worker* current = saved;
   while (current != NULL) {
-    // We may access all_next_ without holding ThreadPool::mutex_ here
+    // We may access all_next_ without holding ThreadPool::monitor_ here
     // because the worker is no longer owned by the ThreadPool.
     Worker* next = current->all_next_;
     current->all_next_ = NULL;
@@ -174,21 +343,165 @@ bool ThreadPool::RemoveWorkerFromAllList(Worker* worker) {
 }
 
 
-void ThreadPool::SetIdle(Worker* worker) {
-  MutexLocker ml(&mutex_);
-  if (shutting_down_) {
+ThreadPool::Worker* ThreadPool::TakeIdleWorker() {
+  Worker* worker = idle_workers_;
+  if (worker == NULL) {
+    return NULL;
+  }
+  // Get the first worker from the idle worker list.
+  idle_workers_ = worker->idle_next_;
+  worker->idle_next_ = NULL;
+  count_idle_--;
+  count_running_++;
+  UpdateQueueOnWorkers();
+  return worker;
+}
+
+
+ThreadPool::Worker* ThreadPool::AddWorker() {
+  Worker* worker = new Worker(this);
+  ASSERT(worker != NULL);
+  count_started_++;
+
+  // Add worker to the all_workers_ list.
+  worker->all_next_ = all_workers_;
+  all_workers_ = worker;
+  worker->owned_ = true;
+  count_running_++;
+  UpdateQueueOnWorkers();
+  // Workers only notify the watcher once it waits, so it has to run before
+  // they queue tasks without monitor_.
+  NotifyWatcher();
+  return worker;
+}
+
+
+void ThreadPool::UpdateQueueOnWorkers() {
+  const bool busy = !shutting_down_ && (count_idle_ == 0) && IsFull();
+  AtomicOperations::StoreRelaxed(&queue_on_workers_, busy ? 1 : 0);
+}
+
+
+void ThreadPool::NotifyWatcher() {
+  // The watcher only looks for blocked workers while tasks are queued.
+  if (watcher_running_) {
+    if (watcher_waiting_ != 0) {
+      monitor_.Notify();
+    }
     return;
   }
+  watcher_running_ = true;
+  int result = OSThread::Start(&ThreadPool::WatcherMain,
+                               reinterpret_cast<uword>(this));
+  if (result != 0) {
+    FATAL1("Could not start thread pool watcher: result = %d.", result);
+  }
+}
+
+
+ThreadPool::Task* ThreadPool::StealTask(Worker* thief) {
+  // Prefer the tasks a busy worker will not get to next.
+  for (Worker* victim = all_workers_;
+       victim != NULL;
+       victim = victim->all_next_) {
+    if (victim != thief) {
+      MutexLocker ql(&victim->queue_mutex_);
+      if (!victim->run_queue_.IsEmpty()) {
+        return victim->run_queue_.RemoveFirst();
+      }
+    }
+  }
+  for (Worker* victim = all_workers_;
+       victim != NULL;
+       victim = victim->all_next_) {
+    if (victim != thief) {
+      Task* task = victim->StealLocalTask();
+      if (task != NULL) {
+        return task;
+      }
+    }
+  }
+  return NULL;
+}
+
+
+ThreadPool::Worker* ThreadPool::CurrentWorker() {
+  Worker* worker =
+      reinterpret_cast<Worker*>(OSThread::GetThreadLocal(worker_key_));
+  if ((worker != NULL) && (worker->pool_ == this)) {
+    return worker;
+  }
+  return NULL;
+}
+
+
+ThreadPool::Task* ThreadPool::TakeHighPriorityTask() {
+  // The check is racy so that workers need not take the pool's monitor
+  // between tasks. A task it misses is taken once the worker runs out of
+  // local tasks.
+  if (high_priority_queue_.IsEmpty()) {
+    return NULL;
+  }
+  MonitorLocker ml(&monitor_);
+  return high_priority_queue_.RemoveFirst();
+}
+
+
+ThreadPool::Task* ThreadPool::NextTaskOrSetIdle(Worker* worker) {
+  // The check is done without monitor_: a worker the watcher finds blocked
+  // just as its task ends is only counted again after its next task.
+  if (AtomicOperations::LoadRelaxed(&worker->blocked_) != 0) {
+    MonitorLocker ml(&monitor_);
+    UnblockWorker(worker);
+  }
+  Task* task = TakeHighPriorityTask();
+  if (task != NULL) {
+    return task;
+  }
+  task = worker->TakeLocalTask();
+  if (task != NULL) {
+    return task;
+  }
+  MonitorLocker ml(&monitor_);
+  if (shutting_down_) {
+    return NULL;
+  }
   ASSERT(worker->owned_ && !IsIdle(worker));
+  UnblockWorker(worker);
+  if (!high_priority_queue_.IsEmpty()) {
+    return high_priority_queue_.RemoveFirst();
+  }
+  // Workers started above the pool's size take no more work.
+  if (CountedRunning() <= static_cast<uint64_t>(size_)) {
+    if (!queue_.IsEmpty()) {
+      return queue_.RemoveFirst();
+    }
+    task = StealTask(worker);
+    if (task != NULL) {
+      count_stolen_++;
+      return task;
+    }
+  }
   worker->idle_next_ = idle_workers_;
   idle_workers_ = worker;
   count_idle_++;
   count_running_--;
+  UpdateQueueOnWorkers();
+  return NULL;
+}
+
+
+void ThreadPool::UnblockWorker(Worker* worker) {
+  if (worker->blocked_ != 0) {
+    AtomicOperations::StoreRelaxed(&worker->blocked_, 0);
+    count_blocked_--;
+    UpdateQueueOnWorkers();
+  }
 }
 
 
 bool ThreadPool::ReleaseIdleWorker(Worker* worker) {
-  MutexLocker ml(&mutex_);
+  MonitorLocker ml(&monitor_);
   if (shutting_down_) {
     return false;
   }
@@ -202,11 +515,165 @@ bool ThreadPool::ReleaseIdleWorker(Worker* worker) {
 
   count_stopped_++;
   count_idle_--;
+  UpdateQueueOnWorkers();
   return true;
 }
 
 
-ThreadPool::Task::Task() {
+// static
+void ThreadPool::WatcherMain(uword args) {
+  ThreadPool* pool = reinterpret_cast<ThreadPool*>(args);
+  pool->WatchForStarvation();
+}
+
+
+void ThreadPool::WatchForStarvation() {
+  MonitorLocker ml(&monitor_);
+  while (!shutting_down_) {
+    // Set before looking for tasks, so that a worker which queues one
+    // without monitor_ afterwards notifies us.
+    AtomicOperations::StoreRelaxed(&watcher_waiting_, 1);
+    if (!HasQueuedTasks()) {
+      ml.Wait();
+      AtomicOperations::StoreRelaxed(&watcher_waiting_, 0);
+      continue;
+    }
+    AtomicOperations::StoreRelaxed(&watcher_waiting_, 0);
+    ml.Wait(FLAG_thread_pool_starvation_millis);
+    FindBlockedWorkers();
+    // Hand queued tasks to other workers in place of the blocked ones. Once
+    // running, these take further tasks as usual.
+    while (!shutting_down_ && !IsFull()) {
+      Task* task = TakeQueuedTask();
+      if (task == NULL) {
+        break;
+      }
+      count_rescued_++;
+      bool new_worker = false;
+      Worker* worker = TakeIdleWorker();
+      if (worker == NULL) {
+        worker = AddWorker();
+        new_worker = true;
+      }
+      // Release ThreadPool::monitor_ before calling Worker functions.
+      // Shutdown waits for the watcher, so the pool stays alive meanwhile.
+      monitor_.Exit();
+      worker->SetTask(task);
+      if (new_worker) {
+        worker->StartThread();
+      }
+      monitor_.Enter();
+    }
+  }
+  watcher_running_ = false;
+  ml.NotifyAll();
+}
+
+
+bool ThreadPool::HasQueuedTasks() {
+  if (!queue_.IsEmpty() || !high_priority_queue_.IsEmpty()) {
+    return true;
+  }
+  for (Worker* current = all_workers_;
+       current != NULL;
+       current = current->all_next_) {
+    if (current->HasLocalTasks()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// The low bits of the current time in milliseconds, which are never 0. Their
+// differences are right for spans below 2^32 milliseconds.
+static uword TaskStartMillis() {
+  const uword millis = static_cast<uword>(OS::GetCurrentTimeMillis());
+  return (millis == 0) ? 1 : millis;
+}
+
+
+void ThreadPool::FindBlockedWorkers() {
+  const uword now = TaskStartMillis();
+  const uword starvation_millis =
+      static_cast<uword>(FLAG_thread_pool_starvation_millis);
+  for (Worker* current = all_workers_;
+       current != NULL;
+       current = current->all_next_) {
+    const uword start =
+        AtomicOperations::LoadRelaxed(&current->task_start_millis_);
+    if ((current->blocked_ == 0) &&
+        (start != 0) &&
+        (now - start >= starvation_millis)) {
+      AtomicOperations::StoreRelaxed(&current->blocked_, 1);
+      count_blocked_++;
+    }
+  }
+  UpdateQueueOnWorkers();
+}
+
+
+ThreadPool::Task* ThreadPool::TakeQueuedTask() {
+  Task* task = high_priority_queue_.RemoveFirst();
+  if (task == NULL) {
+    task = queue_.RemoveFirst();
+  }
+  if (task == NULL) {
+    task = StealTask(NULL);
+  }
+  return task;
+}
+
+
+void ThreadPool::TaskQueue::Add(Task* task) {
+  ASSERT(task->next_ == NULL);
+  if (tail_ == NULL) {
+    head_ = task;
+  } else {
+    tail_->next_ = task;
+  }
+  tail_ = task;
+  length_++;
+}
+
+
+ThreadPool::Task* ThreadPool::TaskQueue::RemoveFirst() {
+  Task* task = head_;
+  if (task != NULL) {
+    head_ = task->next_;
+    if (head_ == NULL) {
+      tail_ = NULL;
+    }
+    task->next_ = NULL;
+    length_--;
+  }
+  return task;
+}
+
+
+bool ThreadPool::TaskQueue::Remove(Task* task) {
+  Task* previous = NULL;
+  for (Task* current = head_; current != NULL; current = current->next_) {
+    if (current == task) {
+      if (previous == NULL) {
+        head_ = task->next_;
+      } else {
+        previous->next_ = task->next_;
+      }
+      if (tail_ == task) {
+        tail_ = previous;
+      }
+      task->next_ = NULL;
+      length_--;
+      return true;
+    }
+    previous = current;
+  }
+  return false;
+}
+
+
+ThreadPool::Task::Task() : next_(NULL), high_priority_(false) {
 }
 
 
@@ -217,7 +684,10 @@ ThreadPool::Task::~Task() {
 ThreadPool::Worker::Worker(ThreadPool* pool)
   : pool_(pool),
     task_(NULL),
+    lifo_slot_(NULL),
+    task_start_millis_(0),
     owned_(false),
+    blocked_(0),
     all_next_(NULL),
     idle_next_(NULL) {
 }
@@ -246,6 +716,64 @@ void ThreadPool::Worker::SetTask(Task* task) {
 }
 
 
+intptr_t ThreadPool::Worker::AddLocalTask(Task* task) {
+  MutexLocker ql(&queue_mutex_);
+  Task* displaced = lifo_slot_;
+  lifo_slot_ = task;
+  if (displaced != NULL) {
+    run_queue_.Add(displaced);
+  }
+  return run_queue_.length();
+}
+
+
+bool ThreadPool::Worker::HasLocalTasks() {
+  MutexLocker ql(&queue_mutex_);
+  return (lifo_slot_ != NULL) || !run_queue_.IsEmpty();
+}
+
+
+ThreadPool::Task* ThreadPool::Worker::TakeLocalTask() {
+  MutexLocker ql(&queue_mutex_);
+  Task* task = lifo_slot_;
+  if (task != NULL) {
+    lifo_slot_ = NULL;
+    return task;
+  }
+  return run_queue_.RemoveFirst();
+}
+
+
+ThreadPool::Task* ThreadPool::Worker::StealLocalTask() {
+  MutexLocker ql(&queue_mutex_);
+  Task* task = run_queue_.RemoveFirst();
+  if (task == NULL) {
+    task = lifo_slot_;
+    lifo_slot_ = NULL;
+  }
+  return task;
+}
+
+
+bool ThreadPool::Worker::RemoveLocalTask(Task* task) {
+  MutexLocker ql(&queue_mutex_);
+  if (lifo_slot_ == task) {
+    lifo_slot_ = NULL;
+    return true;
+  }
+  return run_queue_.Remove(task);
+}
+
+
+void ThreadPool::Worker::DeleteLocalTasks() {
+  Task* task = TakeLocalTask();
+  while (task != NULL) {
+    delete task;
+    task = TakeLocalTask();
+  }
+}
+
+
 static int64_t ComputeTimeout(int64_t idle_start) {
   if (FLAG_worker_timeout_millis <= 0) {
     // No timeout.
@@ -265,6 +793,7 @@ static int64_t ComputeTimeout(int64_t idle_start) {
 
 
 void ThreadPool::Worker::Loop() {
+  OSThread::SetThreadLocal(worker_key_, reinterpret_cast<uword>(this));
   MonitorLocker ml(&monitor_);
   int64_t idle_start;
   while (true) {
@@ -274,12 +803,14 @@ void ThreadPool::Worker::Loop() {
 
     // Release monitor while handling the task.
     monitor_.Exit();
+    AtomicOperations::StoreRelaxed(&task_start_millis_, TaskStartMillis());
     Thread::EnsureInit();
     task->Run();
     ASSERT(Isolate::Current() == NULL);
     // Prevent unintended sharing of state between tasks.
     Thread::CleanUp();
     delete task;
+    AtomicOperations::StoreRelaxed(&task_start_millis_, 0);
     monitor_.Enter();
 
     ASSERT(task_ == NULL);
@@ -287,7 +818,10 @@ void ThreadPool::Worker::Loop() {
       return;
     }
     ASSERT(pool_ != NULL);
-    pool_->SetIdle(this);
+    task_ = pool_->NextTaskOrSetIdle(this);
+    if (task_ != NULL) {
+      continue;
+    }
     idle_start = OS::GetCurrentTimeMillis();
     while (true) {
       Monitor::WaitResult result = ml.Wait(ComputeTimeout(idle_start));
@@ -326,6 +860,10 @@ void ThreadPool::Worker::Main(uword args) {
          worker->all_next_ == NULL &&
          worker->idle_next_ == NULL);
 
+  // Tasks queued on the worker when its pool shut down never run.
+  worker->DeleteLocalTasks();
+  OSThread::SetThreadLocal(worker_key_, 0);
+
   // The exit monitor is only used during testing.
   if (ThreadPool::exit_monitor_) {
     MonitorLocker ml(ThreadPool::exit_monitor_);
@@ -10,6 +10,25 @@
 
 namespace dart {
 
+// A pool of worker threads which keeps at most 'size' of them running tasks
+// at once.
+//
+// A task is handed to an idle worker, or to a new worker while fewer than
+// 'size' are running. Otherwise it is queued: on the pool if it is run from
+// outside the pool, and else on the worker which runs it. A worker keeps the
+// most recent of its tasks in a slot which it takes first, as the task is
+// likely to use what its creator just touched, and the ones it displaces at
+// the back of a run queue. Workers which run out of tasks steal from the run
+// queues of the others.
+//
+// High priority tasks which have to be queued are queued on the pool, and
+// run before any other queued task, even the local tasks of a worker.
+//
+// Tasks may block. A worker which has been running the same task for
+// --thread_pool_starvation_millis no longer counts toward the pool's size,
+// and a watcher hands queued tasks to other workers, started above the size
+// if need be, until the size is reached again. Workers above the size go idle
+// once they are done.
 class ThreadPool {
  public:
   // Subclasses of Task are able to run on a ThreadPool.
@@ -23,12 +42,25 @@ class ThreadPool {
     // Override this to provide task-specific behavior.
     virtual void Run() = 0;
 
+    // Must be set before the task is run on a pool.
+    bool is_high_priority() const { return high_priority_; }
+    void set_high_priority(bool value) { high_priority_ = value; }
+
    private:
+    friend class ThreadPool;
+
+    Task* next_;  // Used by the queue the task is in, if any.
+    bool high_priority_;
+
     DISALLOW_COPY_AND_ASSIGN(Task);
   };
 
+  // Creates a pool with the size given by --thread_pool_size.
   ThreadPool();
 
+  // Creates a pool which keeps at most 'size' workers running tasks at once.
+  explicit ThreadPool(intptr_t size);
+
   // Shuts down this thread pool.  Causes workers to terminate
   // themselves when they are active again.
   ~ThreadPool();
@@ -36,15 +68,67 @@ class ThreadPool {
   // Runs a task on the thread pool.
   void Run(Task* task);
 
+  // Like Run, but a task which has to be queued is queued on the pool behind
+  // the tasks already queued there, even if it is run from a worker. This is
+  // for tasks which give up their worker to let others run, and continue in
+  // a new task.
+  void RunLater(Task* task);
+
+  // Runs a task right away on a worker of its own, even if the pool already
+  // runs as many tasks as its size. This is for tasks that their creator
+  // waits for, such as GC helper tasks.
+  void RunDedicated(Task* task);
+
+  // Makes a task which was run on the pool high priority if it is still
+  // queued, so that it runs before the other queued tasks. Returns whether
+  // it was queued. The caller must make sure that the task has not been
+  // deleted, but it may be running.
+  bool Promote(Task* task);
+
+  intptr_t size() const { return size_; }
+
   // Some simple stats.
   uint64_t workers_running() const { return count_running_; }
   uint64_t workers_idle() const { return count_idle_; }
   uint64_t workers_started() const { return count_started_; }
   uint64_t workers_stopped() const { return count_stopped_; }
+  uint64_t tasks_stolen() const { return count_stolen_; }
+  // The number of queued tasks the watcher handed to a worker in place of
+  // one blocked for --thread_pool_starvation_millis.
+  uint64_t tasks_rescued() const { return count_rescued_; }
+  // The number of high priority tasks which had to be queued.
+  uint64_t high_priority_tasks_queued() const {
+    return count_high_priority_queued_;
+  }
+  // The longest any run queue has been.
+  intptr_t max_queue_depth() const { return max_queue_depth_; }
+  // The number of tasks currently waiting to be run.
+  intptr_t QueuedTasks();
 
  private:
   friend class ThreadPoolTestPeer;
 
+  // A FIFO list of tasks.
+  class TaskQueue {
+   public:
+    TaskQueue() : head_(NULL), tail_(NULL), length_(0) { }
+
+    bool IsEmpty() const { return head_ == NULL; }
+    intptr_t length() const { return length_; }
+
+    void Add(Task* task);
+    Task* RemoveFirst();
+    // Returns whether the task was in the queue.
+    bool Remove(Task* task);
+
+   private:
+    Task* head_;
+    Task* tail_;
+    intptr_t length_;
+
+    DISALLOW_COPY_AND_ASSIGN(TaskQueue);
+  };
+
   class Worker {
    public:
     explicit Worker(ThreadPool* pool);
@@ -70,16 +154,39 @@ class ThreadPool {
 
     bool IsDone() const { return pool_ == NULL; }
 
+    // Local tasks are only added by the worker's own thread, but may be
+    // taken by any.
+    // Returns the length of the run queue.
+    intptr_t AddLocalTask(Task* task);
+    bool HasLocalTasks();
+    Task* TakeLocalTask();
+    Task* StealLocalTask();
+    bool RemoveLocalTask(Task* task);
+    void DeleteLocalTasks();
+
     // Fields owned by Worker.
     Monitor monitor_;
     ThreadPool* pool_;
     Task* task_;
 
+    // The worker's local tasks, protected by queue_mutex_. The worker runs
+    // the task in lifo_slot_ first. Thieves take from the front of
+    // run_queue_ first.
+    Mutex queue_mutex_;
+    Task* lifo_slot_;
+    TaskQueue run_queue_;
+
+    // The low bits of the time in milliseconds at which the worker started
+    // its current task, or 0 between tasks. Accessed atomically, as the
+    // starvation watcher reads it.
+    uword task_start_millis_;
+
     // Fields owned by ThreadPool.  Workers should not look at these
     // directly.  It's like looking at the sun.
-    bool owned_;         // Protected by ThreadPool::mutex_
-    Worker* all_next_;   // Protected by ThreadPool::mutex_
-    Worker* idle_next_;  // Protected by ThreadPool::mutex_
+    bool owned_;         // Protected by ThreadPool::monitor_
+    uword blocked_;      // Written with ThreadPool::monitor_ held
+    Worker* all_next_;   // Protected by ThreadPool::monitor_
+    Worker* idle_next_;  // Protected by ThreadPool::monitor_
 
     DISALLOW_COPY_AND_ASSIGN(Worker);
   };
@@ -92,18 +199,66 @@ class ThreadPool {
   bool RemoveWorkerFromIdleList(Worker* worker);
   bool RemoveWorkerFromAllList(Worker* worker);
 
+  void RunInternal(Task* task, bool later);
+  Task* TakeHighPriorityTask();
+
+  // The following must be called with monitor_ held. The returned worker
+  // must be given its task after monitor_ is released.
+  Worker* TakeIdleWorker();
+  Worker* AddWorker();
+  // Publishes whether workers queue their tasks without monitor_, after the
+  // worker counts changed.
+  void UpdateQueueOnWorkers();
+  // Wakes the watcher, starting it if need be, after a task was queued or a
+  // worker added.
+  void NotifyWatcher();
+  Task* StealTask(Worker* thief);
+
+  // Returns the current thread's worker if it belongs to this pool.
+  Worker* CurrentWorker();
+
+  // The number of running workers which count toward the pool's size. Must
+  // be called with monitor_ held.
+  uint64_t CountedRunning() const { return count_running_ - count_blocked_; }
+  bool IsFull() const {
+    return CountedRunning() >= static_cast<uint64_t>(size_);
+  }
+
   // Worker operations.
-  void SetIdle(Worker* worker);
+  Task* NextTaskOrSetIdle(Worker* worker);
+  void UnblockWorker(Worker* worker);
   bool ReleaseIdleWorker(Worker* worker);
 
-  Mutex mutex_;
+  // Starvation watcher.
+  static void WatcherMain(uword args);
+  void WatchForStarvation();
+  bool HasQueuedTasks();
+  void FindBlockedWorkers();
+  Task* TakeQueuedTask();
+
+  const intptr_t size_;
+  Monitor monitor_;
   bool shutting_down_;
   Worker* all_workers_;
   Worker* idle_workers_;
+  TaskQueue queue_;  // Tasks run from outside the pool, or run later.
+  TaskQueue high_priority_queue_;
+  bool watcher_running_;
+  // Set while the watcher waits for a task to be queued. Also read without
+  // monitor_, so accessed atomically.
+  uword watcher_waiting_;
+  uword queue_on_workers_;  // Read without monitor_, so accessed atomically.
   uint64_t count_started_;
   uint64_t count_stopped_;
   uint64_t count_running_;
   uint64_t count_idle_;
+  uint64_t count_blocked_;  // Running workers not counted toward size_.
+  uint64_t count_stolen_;
+  uint64_t count_rescued_;
+  uint64_t count_high_priority_queued_;
+  intptr_t max_queue_depth_;
+
+  static ThreadLocalKey worker_key_;
 
   static Monitor* exit_monitor_;  // Used only in testing.
   static int* exit_count_;        // Used only in testing.
@@ -215,4 +215,287 @@ UNIT_TEST_CASE(ThreadPool_RecursiveSpawn) {
 }
 
 
+UNIT_TEST_CASE(ThreadPool_Bounded) {
+  const int kTaskCount = 100;
+  ThreadPool thread_pool(2);
+  Monitor sync[kTaskCount];
+  bool done[kTaskCount];
+
+  for (int i = 0; i < kTaskCount; i++) {
+    done[i] = false;
+    thread_pool.Run(new TestTask(&sync[i], &done[i]));
+  }
+  for (int i = 0; i < kTaskCount; i++) {
+    MonitorLocker ml(&sync[i]);
+    while (!done[i]) {
+      ml.Wait();
+    }
+  }
+  // The tasks queued on the pool rather than starting more workers.
+  EXPECT(thread_pool.workers_started() <= 2U);
+  EXPECT_EQ(0, thread_pool.QueuedTasks());
+}
+
+
+// Runs tasks on its own worker and waits until they are done, so that they
+// have to be run by another worker.
+class ForkTask : public ThreadPool::Task {
+ public:
+  ForkTask(ThreadPool* pool, Monitor* sync, int count, int* done)
+      : pool_(pool), sync_(sync), count_(count), done_(done) {
+  }
+
+  virtual void Run() {
+    Monitor child_sync;
+    int child_done = 0;
+    for (int i = 0; i < count_; i++) {
+      pool_->Run(new SpawnTask(pool_, &child_sync, 1, count_, &child_done));
+    }
+    {
+      MonitorLocker ml(&child_sync);
+      while (child_done < count_) {
+        ml.Wait();
+      }
+    }
+    MonitorLocker ml(sync_);
+    *done_ = child_done;
+    ml.Notify();
+  }
+
+ private:
+  ThreadPool* pool_;
+  Monitor* sync_;
+  int count_;
+  int* done_;
+};
+
+
+UNIT_TEST_CASE(ThreadPool_Steal) {
+  ThreadPool thread_pool(2);
+  Monitor sync;
+  const int kChildTasks = 100;
+  int done = 0;
+  thread_pool.Run(new ForkTask(&thread_pool, &sync, kChildTasks, &done));
+  {
+    MonitorLocker ml(&sync);
+    while (done < kChildTasks) {
+      ml.Wait();
+    }
+  }
+  EXPECT_EQ(kChildTasks, done);
+  // The first child started the second worker, which stole the others. A
+  // third may have replaced the first worker if it blocked long enough.
+  EXPECT(thread_pool.workers_started() <= 3U);
+  EXPECT(thread_pool.tasks_stolen() > 0U);
+  EXPECT(thread_pool.max_queue_depth() > 0);
+}
+
+
+UNIT_TEST_CASE(ThreadPool_Starvation) {
+  // The only worker blocks until its child has run, so the child must be
+  // handed to an extra worker.
+  ThreadPool thread_pool(1);
+  Monitor sync;
+  int done = 0;
+  thread_pool.Run(new ForkTask(&thread_pool, &sync, 1, &done));
+  {
+    MonitorLocker ml(&sync);
+    while (done < 1) {
+      ml.Wait();
+    }
+  }
+  EXPECT_EQ(1, done);
+  EXPECT_EQ(2U, thread_pool.workers_started());
+  EXPECT_EQ(1U, thread_pool.tasks_rescued());
+}
+
+
+UNIT_TEST_CASE(ThreadPool_StarvationReplacement) {
+  // The only worker blocks until its children have run. A single replacement
+  // runs all of them rather than one per watcher tick.
+  ThreadPool thread_pool(1);
+  Monitor sync;
+  const int kChildTasks = 100;
+  int done = 0;
+  thread_pool.Run(new ForkTask(&thread_pool, &sync, kChildTasks, &done));
+  {
+    MonitorLocker ml(&sync);
+    while (done < kChildTasks) {
+      ml.Wait();
+    }
+  }
+  EXPECT_EQ(kChildTasks, done);
+  EXPECT_EQ(2U, thread_pool.workers_started());
+  EXPECT_EQ(1U, thread_pool.tasks_rescued());
+}
+
+
+// Blocks its worker until it is opened.
+class GateTask : public ThreadPool::Task {
+ public:
+  GateTask(Monitor* sync, bool* open) : sync_(sync), open_(open) {
+  }
+
+  virtual void Run() {
+    MonitorLocker ml(sync_);
+    while (!*open_) {
+      ml.Wait();
+    }
+  }
+
+ private:
+  Monitor* sync_;
+  bool* open_;
+};
+
+
+// Records the order in which tasks run.
+class OrderTask : public ThreadPool::Task {
+ public:
+  OrderTask(Monitor* sync, int* order, int* count, int id)
+      : sync_(sync), order_(order), count_(count), id_(id) {
+  }
+
+  virtual void Run() {
+    MonitorLocker ml(sync_);
+    order_[(*count_)++] = id_;
+    ml.Notify();
+  }
+
+ private:
+  Monitor* sync_;
+  int* order_;
+  int* count_;
+  int id_;
+};
+
+
+UNIT_TEST_CASE(ThreadPool_HighPriority) {
+  ThreadPool thread_pool(1);
+  Monitor sync;
+  bool open = false;
+  const int kTaskCount = 4;
+  int order[kTaskCount];
+  int count = 0;
+  thread_pool.Run(new GateTask(&sync, &open));
+  // The only worker is busy, so the tasks are queued.
+  for (int i = 0; i < kTaskCount - 1; i++) {
+    thread_pool.Run(new OrderTask(&sync, order, &count, i));
+  }
+  OrderTask* task = new OrderTask(&sync, order, &count, kTaskCount - 1);
+  task->set_high_priority(true);
+  thread_pool.Run(task);
+  {
+    MonitorLocker ml(&sync);
+    open = true;
+    ml.NotifyAll();
+    while (count < kTaskCount) {
+      ml.Wait();
+    }
+  }
+  EXPECT_EQ(1U, thread_pool.high_priority_tasks_queued());
+  EXPECT_EQ(kTaskCount - 1, order[0]);
+  for (int i = 1; i < kTaskCount; i++) {
+    EXPECT_EQ(i - 1, order[i]);
+  }
+}
+
+
+UNIT_TEST_CASE(ThreadPool_PromoteQueued) {
+  ThreadPool thread_pool(1);
+  Monitor sync;
+  bool open = false;
+  const int kTaskCount = 4;
+  int order[kTaskCount];
+  int count = 0;
+  thread_pool.Run(new GateTask(&sync, &open));
+  // The only worker is busy, so the tasks are queued on the pool.
+  OrderTask* tasks[kTaskCount];
+  for (int i = 0; i < kTaskCount; i++) {
+    tasks[i] = new OrderTask(&sync, order, &count, i);
+    thread_pool.Run(tasks[i]);
+  }
+  EXPECT(thread_pool.Promote(tasks[2]));
+  EXPECT(!thread_pool.Promote(tasks[2]));
+  {
+    MonitorLocker ml(&sync);
+    open = true;
+    ml.NotifyAll();
+    while (count < kTaskCount) {
+      ml.Wait();
+    }
+  }
+  EXPECT_EQ(1U, thread_pool.high_priority_tasks_queued());
+  EXPECT_EQ(2, order[0]);
+  EXPECT_EQ(0, order[1]);
+  EXPECT_EQ(1, order[2]);
+  EXPECT_EQ(3, order[3]);
+}
+
+
+// Queues tasks on its own worker and promotes the second one.
+class PromoteLocalTask : public ThreadPool::Task {
+ public:
+  PromoteLocalTask(ThreadPool* pool,
+                   Monitor* sync,
+                   int* order,
+                   int* count,
+                   int task_count,
+                   bool* promoted)
+      : pool_(pool),
+        sync_(sync),
+        order_(order),
+        count_(count),
+        task_count_(task_count),
+        promoted_(promoted) {
+  }
+
+  virtual void Run() {
+    ThreadPool::Task* second = NULL;
+    for (int i = 0; i < task_count_; i++) {
+      ThreadPool::Task* task = new OrderTask(sync_, order_, count_, i);
+      if (i == 1) {
+        second = task;
+      }
+      pool_->Run(task);
+    }
+    // The tasks are still queued on the worker, as this task holds the only
+    // one.
+    *promoted_ = pool_->Promote(second);
+  }
+
+ private:
+  ThreadPool* pool_;
+  Monitor* sync_;
+  int* order_;
+  int* count_;
+  int task_count_;
+  bool* promoted_;
+};
+
+
+UNIT_TEST_CASE(ThreadPool_PromoteLocal) {
+  ThreadPool thread_pool(1);
+  Monitor sync;
+  const int kTaskCount = 4;
+  int order[kTaskCount];
+  int count = 0;
+  bool promoted = false;
+  thread_pool.Run(new PromoteLocalTask(&thread_pool, &sync, order, &count,
+                                       kTaskCount, &promoted));
+  {
+    MonitorLocker ml(&sync);
+    while (count < kTaskCount) {
+      ml.Wait();
+    }
+  }
+  EXPECT(promoted);
+  // The worker would otherwise run the most recent task first.
+  EXPECT_EQ(1, order[0]);
+  EXPECT_EQ(kTaskCount - 1, order[1]);
+  EXPECT_EQ(0, order[2]);
+  EXPECT_EQ(2, order[3]);
+}
+
+
 }  // namespace dart
@@ -15,6 +15,51 @@ bool VirtualMemory::InSamePage(uword address0, uword address1) {
 }
 
 
+intptr_t VirtualMemory::Discard(uword start, uword end) {
+  uword page_start = Utils::RoundUp(start, PageSize());
+  uword page_end = Utils::RoundDown(end, PageSize());
+  if (page_start >= page_end) {
+    return 0;
+  }
+  intptr_t size = page_end - page_start;
+  if (!DiscardPages(reinterpret_cast<void*>(page_start), size)) {
+    return 0;
+  }
+  return size;
+}
+
+
+VirtualMemory* VirtualMemory::ReserveAligned(intptr_t size,
+                                             intptr_t alignment) {
+  ASSERT(Utils::IsPowerOfTwo(alignment));
+  ASSERT((size & (PageSize() - 1)) == 0);
+  VirtualMemory* result = Reserve(size + alignment);
+  if (result == NULL) {
+    return NULL;
+  }
+  const intptr_t head = Utils::RoundUp(result->start(), alignment) -
+      result->start();
+  if ((head > 0) && FreeSubSegment(result->address(), head)) {
+    result->region_.Subregion(result->region_, head, result->size() - head);
+    result->reserved_size_ -= head;
+  }
+  result->Truncate(size);
+  return result;
+}
+
+
+VirtualMemory* VirtualMemory::SplitOff(intptr_t offset) {
+  ASSERT((offset & (PageSize() - 1)) == 0);
+  ASSERT((offset > 0) && (offset < size()));
+  ASSERT(reserved_size_ == size());
+  MemoryRegion tail;
+  tail.Subregion(region_, offset, size() - offset);
+  region_.Subregion(region_, 0, offset);
+  reserved_size_ = offset;
+  return new VirtualMemory(tail);
+}
+
+
 void VirtualMemory::Truncate(intptr_t new_size, bool try_unmap) {
   ASSERT((new_size & (PageSize() - 1)) == 0);
   ASSERT(new_size <= size());
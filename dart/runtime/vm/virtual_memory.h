@@ -52,6 +52,11 @@ class VirtualMemory {
     return ReserveInternal(size);
   }
 
+  // Reserves a virtual memory segment with size whose start is a multiple of
+  // alignment, if the platform can release the unaligned parts of a larger
+  // reservation. Returns NULL if out of memory.
+  static VirtualMemory* ReserveAligned(intptr_t size, intptr_t alignment);
+
   static intptr_t PageSize() {
     ASSERT(page_size_ != 0);
     ASSERT(Utils::IsPowerOfTwo(page_size_));
@@ -60,6 +65,21 @@ class VirtualMemory {
 
   static bool InSamePage(uword address0, uword address1);
 
+  // Returns the physical memory of the whole pages between start and end to
+  // the operating system. The range stays accessible, but its contents are
+  // undefined afterwards. Returns the number of bytes released.
+  static intptr_t Discard(uword start, uword end);
+
+  // Asks the operating system to back the range with transparent huge pages.
+  // Returns false if huge pages are not supported.
+  static bool AdviseHugePages(void* address, intptr_t size);
+
+  // Splits this segment at offset and returns a new segment, which owns the
+  // part of the reservation above offset. Only possible where parts of a
+  // reservation can be released independently, i.e., if AdviseHugePages
+  // succeeds.
+  VirtualMemory* SplitOff(intptr_t offset);
+
   // Truncate this virtual memory segment. If try_unmap is false, the
   // memory beyond the new end is still accessible, but will be returned
   // upon destruction.
@@ -75,6 +95,9 @@ class VirtualMemory {
   // can give back the virtual memory to the system. Returns true on success.
   static bool FreeSubSegment(void* address, intptr_t size);
 
+  // Releases the physical memory of whole pages. Returns true on success.
+  static bool DiscardPages(void* address, intptr_t size);
+
   // This constructor is only used internally when reserving new virtual spaces.
   // It does not reserve any virtual address space on its own.
   explicit VirtualMemory(const MemoryRegion& region) :
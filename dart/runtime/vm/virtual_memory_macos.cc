@@ -63,6 +63,17 @@ bool VirtualMemory::FreeSubSegment(void* address, intptr_t size) {
 }
 
 
+bool VirtualMemory::DiscardPages(void* address, intptr_t size) {
+  return madvise(address, size, MADV_DONTNEED) == 0;
+}
+
+
+bool VirtualMemory::AdviseHugePages(void* address, intptr_t size) {
+  // Transparent huge pages are a Linux feature.
+  return false;
+}
+
+
 bool VirtualMemory::Commit(uword addr, intptr_t size, bool executable) {
   ASSERT(Contains(addr));
   ASSERT(Contains(addr + size) || (addr + size == end()));
@@ -107,4 +107,52 @@ UNIT_TEST_CASE(VirtualMemoryCommitPartial) {
   delete vm;
 }
 
+
+UNIT_TEST_CASE(DiscardVirtualMemory) {
+  const intptr_t kVirtualMemoryBlockSize = 64 * KB;
+  VirtualMemory* vm = VirtualMemory::Reserve(kVirtualMemoryBlockSize);
+  EXPECT(vm != NULL);
+  vm->Commit(false);
+  const intptr_t page_size = VirtualMemory::PageSize();
+  // Only whole pages inside the range are released.
+  EXPECT_EQ(0, VirtualMemory::Discard(vm->start() + 1,
+                                      vm->start() + page_size));
+  EXPECT_EQ(vm->size() - 2 * page_size,
+            VirtualMemory::Discard(vm->start() + 1, vm->end() - 1));
+  // The memory stays accessible.
+  char* buf = reinterpret_cast<char*>(vm->start() + page_size);
+  buf[0] = 'a';
+  buf[1] = 0;
+  EXPECT_STREQ("a", buf);
+  delete vm;
+}
+
+
+UNIT_TEST_CASE(ReserveAlignedVirtualMemory) {
+  const intptr_t kAlignment = 2 * MB;
+  const intptr_t kVirtualMemoryBlockSize = 2 * kAlignment;
+  VirtualMemory* vm =
+      VirtualMemory::ReserveAligned(kVirtualMemoryBlockSize, kAlignment);
+  EXPECT(vm != NULL);
+  EXPECT_EQ(kVirtualMemoryBlockSize, vm->size());
+  vm->Commit(false);
+  if (!VirtualMemory::AdviseHugePages(vm->address(), vm->size())) {
+    // The alignment is not guaranteed without huge page support.
+    delete vm;
+    return;
+  }
+  EXPECT(Utils::IsAligned(vm->start(), kAlignment));
+  VirtualMemory* tail = vm->SplitOff(kAlignment);
+  EXPECT_EQ(kAlignment, vm->size());
+  EXPECT_EQ(kAlignment, tail->size());
+  EXPECT_EQ(vm->end(), tail->start());
+  // Both parts stay accessible until they are deleted separately.
+  delete vm;
+  char* buf = reinterpret_cast<char*>(tail->address());
+  buf[0] = 'a';
+  buf[1] = 0;
+  EXPECT_STREQ("a", buf);
+  delete tail;
+}
+
 }  // namespace dart
@@ -50,6 +50,18 @@ bool VirtualMemory::FreeSubSegment(void* address, intptr_t size) {
 }
 
 
+bool VirtualMemory::DiscardPages(void* address, intptr_t size) {
+  // The pages stay committed, but their contents need not be preserved.
+  return VirtualAlloc(address, size, MEM_RESET, PAGE_READWRITE) != NULL;
+}
+
+
+bool VirtualMemory::AdviseHugePages(void* address, intptr_t size) {
+  // Large pages have to be requested up front with MEM_LARGE_PAGES.
+  return false;
+}
+
+
 bool VirtualMemory::Commit(uword addr, intptr_t size, bool executable) {
   ASSERT(Contains(addr));
   ASSERT(Contains(addr + size) || (addr + size == end()));
@@ -54,7 +54,10 @@ void main() {
     return copyFileToDirectory(testExtensionTesterFile, testDirectory);
   }).then((_) {
     var script = join(testDirectory, 'test_extension_tester.dart');
-    return Process.run(Platform.executable, [script]);
+    // Have spawned isolates load from their group's snapshot, which must not
+    // lose the extension.
+    return Process.run(Platform.executable,
+                       ['--isolate_group_snapshots', script]);
   })..then((ProcessResult result) {
     if (result.exitCode != 0) {
       print('Subprocess failed with exit code ${result.exitCode}');
@@ -4,6 +4,8 @@
 
 library test_extension_test;
 
+import 'dart:isolate';
+
 import "test_extension.dart";
 
 class Expect {
@@ -22,6 +24,21 @@ class Expect {
   }
 }
 
+// Isolates spawned from a function of the program resolve its natives too.
+void isolateMain(SendPort replyPort) {
+  replyPort.send(Cat.ifNull(null, 3));
+}
+
+void spawnIsolates(int count) {
+  if (count == 0) return;
+  var port = new ReceivePort();
+  Isolate.spawn(isolateMain, port.sendPort);
+  port.first.then((reply) {
+    Expect.equals(3, reply, 'Cat.ifNull(null, 3) in a spawned isolate');
+    spawnIsolates(count - 1);
+  });
+}
+
 main() {
   Expect.equals('cat 13', new Cat(13).toString(), 'new Cat(13).toString()');
 
@@ -35,4 +52,6 @@ main() {
   } on String catch (e) {
     Expect.equals("ball", e);
   }
+
+  spawnIsolates(3);
 }